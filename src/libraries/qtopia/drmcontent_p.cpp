@@ -23,6 +23,7 @@
 #include <qcontentfilter.h>
 #include <QPainter>
 #include <QThread>
+#include <QMutex>
 #include <QPixmapCache>
 #ifndef QTOPIA_CONTENT_INSTALLER
 #include <qtopiaapplication.h>
@@ -296,7 +297,16 @@ bool DrmContentPrivate::installContent( const QString &filePath, QContent *conte
 {
     QDrmContentPlugin *p = plugin( filePath );
 
-    return p ? p->installContent( filePath, content ) : false;
+    if( !p )
+        return false;
+
+    // Content may be installed from several threads at once but DRM agents aren't required to be
+    // thread safe, so only allow one file to be installed by an agent at a time.
+    static QMutex installMutex;
+
+    QMutexLocker locker( &installMutex );
+
+    return p->installContent( filePath, content );
 }
 
 bool DrmContentPrivate::updateContent( QContent *content )
@@ -116,14 +116,22 @@ void DawgReduction<T>::updateWords(const QString &characters)
         }
     }
 
-    // add partial words and words that haven't been explicitly deleted
-    const QDawg& del = Qtopia::dawg("deleted");
-    qDeleteAll(m_words);
+    // words that have been explicitly deleted are kept as partial words, so
+    // that longer words starting with them can still be found.  The words
+    // are looked up together to share the traversal of common prefixes.
+    QStringList candidates;
+    foreach (T* t, total) {
+        if (t->isWord)
+            candidates << t->word;
+    }
+    QList<bool> deleted = Qtopia::dawg("deleted").contains(candidates);
+    int candidate = 0;
     foreach (T* t, total) {
-        if (!t->isWord || !del.contains(t->word))
-            m_words.append(t);
+        if (t->isWord && deleted.at(candidate++))
+            t->isWord = false;
     }
 
+    qDeleteAll(m_words);
     m_isEmpty = false;
     m_words = total;
 }
@@ -158,6 +158,7 @@ PRIVATE_HEADERS=\
     qcontentfilterselector_p.h \
     qsparselist_p.h \
     qtopiamessagehandler_p.h \
+    qperformancelog_p.h \
     qtopiaservicehistorymodel_p.h\
     qtagmap_p.h \
     keyboard_p.h
@@ -38,9 +38,20 @@
 #include "qfscontentengine_p.h"
 #include <QContentSet>
 #include <QContentFilter>
+#include <QThread>
+#include <QWaitCondition>
 
 static const uint ContentCacheSize = 100;
 
+// The maximum number of threads used to extract the meta-data of a batch of files.
+static const int MaxInstallThreads = 4;
+
+// Batches smaller than this are installed on the calling thread.
+static const int MinThreadedInstallCount = 8;
+
+// The number of installed files committed to the database in a single transaction.
+static const int InstallCommitCount = 50;
+
 /*!
     \variable QContent::InvalidId
     \brief A constant representing an invalid QContent identifier
@@ -458,11 +469,150 @@ void QContent::uninstall( QContentId id )
 
 void QContent::installBatch( const QList<QFileInfo> &batch )
 {
-    QList< QContent > content;
-    foreach(const QFileInfo &fi, batch)
-        content.append( QContentStore::instance()->contentFromFileName( fi.absoluteFilePath(), QContentStore::Construct ) );
+    if( documentSystemConnection() == DocumentSystemDirect && batch.count() >= MinThreadedInstallCount )
+    {
+        QContentInstaller installer( batch );
+
+        installer.install();
+    }
+    else
+    {
+        QList< QContent > content;
+        foreach(const QFileInfo &fi, batch)
+            content.append( QContentStore::instance()->contentFromFileName( fi.absoluteFilePath(), QContentStore::Construct ) );
+
+        QContentStore::instance()->batchCommitContent( content );
+    }
+}
+
+/*!
+    \class QContentInstaller
+    \inpublicgroup QtBaseModule
+    \internal
+
+    Installs a batch of files using a pool of threads to run the content plug-ins which extract the
+    files' meta-data.
+
+    Constructing a QContent from a file only reads the file so any number of files may be processed
+    concurrently, the constructed content is passed back to the thread which called install() which
+    commits it to the database in batches of InstallCommitCount items while the remaining files are
+    processed.
+*/
+
+class QContentInstallerThread : public QThread
+{
+public:
+    QContentInstallerThread( QContentInstaller *installer )
+        : m_installer( installer )
+    {
+    }
+
+protected:
+    void run()
+    {
+        m_installer->extract();
+    }
+
+private:
+    QContentInstaller *m_installer;
+};
+
+/*!
+    Constructs an installer for the files in \a batch.
+*/
+QContentInstaller::QContentInstaller( const QList<QFileInfo> &batch )
+    : m_batch( batch )
+    , m_nextIndex( 0 )
+    , m_extractedCount( 0 )
+{
+}
+
+/*!
+    Extracts the meta-data of all the files in the batch and commits the resulting content to the
+    database.  Returns once all the content has been committed.
+*/
+void QContentInstaller::install()
+{
+    // Ensure the plug-ins are loaded before they're accessed from multiple threads.
+    QContentFactory::loadPlugins();
+
+    int threadCount = qMin( qMax( QThread::idealThreadCount(), 2 ), MaxInstallThreads );
+
+    threadCount = qMin( threadCount, m_batch.count() / MinThreadedInstallCount + 1 );
+
+    QList< QContentInstallerThread * > threads;
+
+    for( int i = 0; i < threadCount; ++i )
+    {
+        QContentInstallerThread *thread = new QContentInstallerThread( this );
+
+        thread->start( QThread::LowPriority );
+
+        threads.append( thread );
+    }
+
+    int committedCount = 0;
+
+    while( committedCount < m_batch.count() )
+    {
+        QList< QContent > content;
+
+        {
+            QMutexLocker locker( &m_mutex );
+
+            while( m_extracted.count() < InstallCommitCount && m_extractedCount < m_batch.count() )
+                m_contentExtracted.wait( &m_mutex );
+
+            content = m_extracted;
+
+            m_extracted.clear();
+        }
+
+        QContentStore::instance()->batchCommitContent( content );
+
+        committedCount += content.count();
+    }
+
+    foreach( QContentInstallerThread *thread, threads )
+    {
+        thread->wait();
+
+        delete thread;
+    }
+}
+
+/*!
+    Extracts the meta-data of files in the batch until there are none remaining.  This is called
+    concurrently from each of the installer threads.
+*/
+void QContentInstaller::extract()
+{
+    forever
+    {
+        QString fileName;
+
+        {
+            QMutexLocker locker( &m_mutex );
 
-    QContentStore::instance()->batchCommitContent( content );
+            if( m_nextIndex == m_batch.count() )
+                return;
+
+            fileName = m_batch.at( m_nextIndex++ ).absoluteFilePath();
+        }
+
+        // Construct only content, the thread's content store won't touch the database.
+        QContent content = QContentStore::instance()->contentFromFileName(
+                fileName, QContentStore::Construct );
+
+        {
+            QMutexLocker locker( &m_mutex );
+
+            m_extracted.append( content );
+
+            if( ++m_extractedCount == m_batch.count() || m_extracted.count() >= InstallCommitCount )
+                m_contentExtracted.wakeOne();
+        }
+    }
 }
 
 /*!
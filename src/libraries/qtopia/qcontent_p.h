@@ -33,6 +33,8 @@
 #include <QObject>
 #include <QTimer>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QFileInfo>
 #include <qatomic.h>
 #include <qcontent.h>
 
@@ -96,4 +98,24 @@ class QContentUpdateManager : public QObject
         QValueSpaceProxyObject *vsoDocuments;
 };
 
+class QContentInstaller
+{
+    public:
+        QContentInstaller( const QList<QFileInfo> &batch );
+
+        void install();
+
+    private:
+        void extract();
+
+        const QList<QFileInfo> m_batch;
+        QList<QContent> m_extracted;
+        int m_nextIndex;
+        int m_extractedCount;
+        QMutex m_mutex;
+        QWaitCondition m_contentExtracted;
+
+        friend class QContentInstallerThread;
+};
+
 #endif
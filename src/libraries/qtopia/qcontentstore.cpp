@@ -434,6 +434,8 @@ Q_GLOBAL_STATIC(QContentCache,g_contentCache);
 
 QContentCache::QContentCache()
     : m_cache( 500 )
+    , m_mimeIdCache( 128 )
+    , m_locationIdCache( 1024 )
 {
 }
 
@@ -466,21 +468,21 @@ void QContentCache::remove( QContentId contentId )
 
 void QContentCache::cacheMimeTypeKey( QtopiaDatabaseId databaseId, const QString &mimeType, int key )
 {
-    QWriteLocker locker( &m_lock );
+    QMutexLocker locker( &m_keyLock );
 
     m_mimeIdCache.insert( qMakePair( mimeType, databaseId ), new int( key ) );
 }
 
 void QContentCache::cacheLocationKey( QtopiaDatabaseId databaseId, const QString &location, int key )
 {
-    QWriteLocker locker( &m_lock );
+    QMutexLocker locker( &m_keyLock );
 
     m_locationIdCache.insert( qMakePair( location, databaseId ), new int( key ) );
 }
 
 int QContentCache::lookupMimeTypeKey( QtopiaDatabaseId databaseId, const QString &mimeType )
 {
-    QReadLocker locker( &m_lock );
+    QMutexLocker locker( &m_keyLock );
 
     int *key = m_mimeIdCache.object( qMakePair( mimeType, databaseId ) );
 
@@ -489,7 +491,7 @@ int QContentCache::lookupMimeTypeKey( QtopiaDatabaseId databaseId, const QString
 
 int QContentCache::lookupLocationKey( QtopiaDatabaseId databaseId, const QString &location )
 {
-    QReadLocker locker( &m_lock );
+    QMutexLocker locker( &m_keyLock );
 
     int *key = m_locationIdCache.object( qMakePair( location, databaseId ) );
 
@@ -501,6 +503,9 @@ void QContentCache::clear()
     QWriteLocker locker( &m_lock );
 
     m_cache.clear();
+
+    QMutexLocker keyLocker( &m_keyLock );
+
     m_mimeIdCache.clear();
     m_locationIdCache.clear();
 }
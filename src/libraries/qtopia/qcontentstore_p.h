@@ -35,6 +35,7 @@
 #include <QThread>
 #include <QCache>
 #include <QReadWriteLock>
+#include <QMutex>
 
 #include "qcontentengine_p.h"
 
@@ -164,6 +165,7 @@ private:
     QCache< QPair<QString, QtopiaDatabaseId>, int> m_mimeIdCache;
     QCache< QPair<QString, QtopiaDatabaseId>, int> m_locationIdCache;
     QReadWriteLock m_lock;
+    QMutex m_keyLock;   // Lookups reorder the key caches so they can't share a read lock
 };
 
 #endif
@@ -281,6 +281,7 @@ void QExportedBackground::initExportedBackground(int width, int height, int scre
             qWarning() << "Could not store exported background in global cache";
             return;
         }
+        QGlobalPixmapCache::setPinned(stateKey, true);
 #ifdef USE_PIXMAP_QWS_BITS
         *((uchar*)expBg.bgState->qwsBits()) = 0; // Not set
 #endif
@@ -294,6 +295,8 @@ void QExportedBackground::initExportedBackground(int width, int height, int scre
             qWarning() << "Could not store exported background in global cache";
             return;
         }
+        // Every application draws the exported background, never evict it.
+        QGlobalPixmapCache::setPinned(bgKey, true);
     }
 
     expBg.exportedBackgroundAvailable = true;
@@ -18,34 +18,247 @@
 ****************************************************************************/
 
 #include <qperformancelog.h>
+#include "qperformancelog_p.h"
+#include <qtopialog.h>
 
-/*
-    The QPerformanceLog class is obsolete.
-    For equivalent functionality, please see the section "Customizing Log Output" in the
-    "Debugging Qt Extended Applications" document.
+#include <QApplication>
+#include <QDateTime>
+#include <QMutex>
+
+#include <unistd.h>
+
+/*!
+    \class QPerformanceLog
+    \inpublicgroup QtBaseModule
+    \brief The QPerformanceLog class writes time stamped performance events to the log.
+
+    Each QPerformanceLog instance collects a message and a set of events and
+    writes them, together with the application name, process id and the
+    current time, to the \c Performance log category when it is destroyed.
+
+    \code
+        QPerformanceLog() << QPerformanceLog::Begin << QPerformanceLog::LibraryLoading;
+    \endcode
+
+    Time stamps are milliseconds since midnight UTC as returned by
+    currentTime(), so events logged by different processes can be compared
+    directly.  Application launches are traced from the moment the server
+    receives the launch request until the application first paints; the
+    server writes the combined timeline of its own and the application's
+    events when the application reports them.
+
+    Nothing is written unless the \c Performance log category is enabled.
+    See the section "Customizing Log Output" in the "Debugging Qt Extended
+    Applications" document.
+*/
+
+/*!
+    \enum QPerformanceLog::EventType
+
+    \value NoEvent No event.
+    \value Begin The start of a phase.
+    \value End The end of a phase.
+    \value LibraryLoading Loading of a quicklaunched application plugin.
+    \value EventLoop The application event loop.
+    \value MainWindow Construction of the application main window.
+    \value Launch A complete application launch, as seen by the server.
+    \value Routing Selection of the launcher for an application.
+    \value ProcessStart Creation of an application process, or hand off to
+           a quicklauncher.
+    \value Translations Installation of the application translators.
+    \value FirstPaint The first paint of an application window.
 */
 
+// Bounds the trace of an application that never paints.
+static const int MAX_TRACE_EVENTS = 64;
+
 struct QPerformanceLogData
-{};
+{
+    QString applicationName;
+    QString message;
+    QPerformanceLog::Event events;
+};
+
+struct QPerformanceLaunchTrace
+{
+    QPerformanceLaunchTrace() : active(false) {}
+
+    QMutex lock;
+    bool active;
+    QList<int> times;
+    QStringList events;
+};
+Q_GLOBAL_STATIC(QPerformanceLaunchTrace, launchTrace);
+
+/*!
+    Constructs a log entry for \a applicationName.  If \a applicationName is
+    empty the name of the current application is used.
+*/
+QPerformanceLog::QPerformanceLog( QString const &applicationName )
+    : data( 0 )
+{
+    if ( !enabled() )
+        return;
 
-QPerformanceLog::QPerformanceLog(QString const&)
-{}
+    data = new QPerformanceLogData;
+    data->applicationName = applicationName;
+    if ( data->applicationName.isEmpty() && qApp )
+        data->applicationName = qApp->applicationName();
+}
 
+/*!
+    Writes the log entry and destroys it.
+*/
 QPerformanceLog::~QPerformanceLog()
-{}
+{
+    if ( !data )
+        return;
+
+    int now = currentTime();
+    QString text = data->message;
+    if ( data->events != NoEvent ) {
+        if ( !text.isEmpty() )
+            text += QLatin1Char(' ');
+        text += stringFromEvent( data->events );
+    }
+
+    qLog(Performance) << qPrintable(data->applicationName)
+                      << QString("[%1]").arg(::getpid()).toLatin1().constData()
+                      << now << ":" << qPrintable(text);
 
+    QPerformanceLaunchTrace *trace = launchTrace();
+    if ( trace ) {
+        QMutexLocker locker( &trace->lock );
+        if ( trace->active && trace->times.count() < MAX_TRACE_EVENTS ) {
+            trace->times.append( now );
+            trace->events.append( text );
+        }
+    }
+
+    delete data;
+}
+
+/*!
+    Appends \a string to the log message.
+*/
+QPerformanceLog &QPerformanceLog::operator<<(QString const &string)
+{
+    if ( data ) {
+        if ( !data->message.isEmpty() )
+            data->message += QLatin1Char(' ');
+        data->message += string;
+    }
+    return *this;
+}
+
+/*!
+    Adds \a event to the logged events.
+*/
+QPerformanceLog &QPerformanceLog::operator<<(Event const &event)
+{
+    if ( data )
+        data->events |= event;
+    return *this;
+}
+
+/*!
+    Returns true if performance logging is enabled.
+*/
 bool QPerformanceLog::enabled()
-{ return false; }
+{
+    return qLogEnabled(Performance);
+}
 
-QPerformanceLog &QPerformanceLog::operator<<(QString const&)
-{ return *this; }
+/*!
+    Returns a textual description of \a event.
+*/
+QString QPerformanceLog::stringFromEvent(Event const &event)
+{
+    static const struct {
+        EventType type;
+        const char *name;
+    } names[] = {
+        { Begin, "Begin" },
+        { End, "End" },
+        { LibraryLoading, "LibraryLoading" },
+        { EventLoop, "EventLoop" },
+        { MainWindow, "MainWindow" },
+        { Launch, "Launch" },
+        { Routing, "Routing" },
+        { ProcessStart, "ProcessStart" },
+        { Translations, "Translations" },
+        { FirstPaint, "FirstPaint" }
+    };
 
-QPerformanceLog &QPerformanceLog::operator<<(Event const&)
-{ return *this; }
+    QStringList parts;
+    for ( uint ii = 0; ii < sizeof(names) / sizeof(names[0]); ++ii ) {
+        if ( event & names[ii].type )
+            parts.append( QLatin1String(names[ii].name) );
+    }
+    return parts.join( QLatin1String(" ") );
+}
 
-QString QPerformanceLog::stringFromEvent(Event const&)
-{ return QString(); }
+/*!
+    Converts \a preAdjustTime from local time to UTC, so that times taken
+    by processes with different time zone settings can be compared.
+*/
+void QPerformanceLog::adjustTimezone(QTime &preAdjustTime)
+{
+    preAdjustTime = QDateTime( QDate::currentDate(), preAdjustTime ).toUTC().time();
+}
 
-void QPerformanceLog::adjustTimezone(QTime&)
-{}
+/*!
+    Returns the number of milliseconds since midnight UTC.  This is the
+    time stamp written with each log entry.
+*/
+int QPerformanceLog::currentTime()
+{
+    return QTime( 0, 0 ).msecsTo( QDateTime::currentDateTime().toUTC().time() );
+}
+
+/*!
+    \internal
+    Starts recording the performance events of this process so they can be
+    reported to the server as part of a launch trace.  Any previously
+    recorded events are discarded.
+*/
+void qtopia_beginLaunchTrace()
+{
+    QPerformanceLaunchTrace *trace = launchTrace();
+    if ( !trace )
+        return;
+
+    QMutexLocker locker( &trace->lock );
+    trace->active = QPerformanceLog::enabled();
+    trace->times.clear();
+    trace->events.clear();
+}
+
+/*!
+    \internal
+    Returns true if a launch trace is being recorded.
+*/
+bool qtopia_launchTraceActive()
+{
+    QPerformanceLaunchTrace *trace = launchTrace();
+    return trace && trace->active;
+}
+
+/*!
+    \internal
+    Stops recording the launch trace and returns the recorded event
+    \a times and descriptions in \a events.
+*/
+void qtopia_takeLaunchTrace( QList<int> *times, QStringList *events )
+{
+    QPerformanceLaunchTrace *trace = launchTrace();
+    if ( !trace )
+        return;
 
+    QMutexLocker locker( &trace->lock );
+    trace->active = false;
+    *times = trace->times;
+    *events = trace->events;
+    trace->times.clear();
+    trace->events.clear();
+}
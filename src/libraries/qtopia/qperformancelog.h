@@ -36,7 +36,12 @@ public:
 
         LibraryLoading = 0x04,
         EventLoop      = 0x08,
-        MainWindow     = 0x10
+        MainWindow     = 0x10,
+        Launch         = 0x20,
+        Routing        = 0x40,
+        ProcessStart   = 0x80,
+        Translations   = 0x100,
+        FirstPaint     = 0x200
     };
     Q_DECLARE_FLAGS(Event, EventType)
 
@@ -46,6 +51,7 @@ public:
     QPerformanceLog &operator<<(Event const &event);
 
     static void adjustTimezone( QTime &preAdjustTime );
+    static int currentTime();
     static bool enabled();
     static QString stringFromEvent(Event const &event);
 
@@ -24,6 +24,7 @@
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QSqlError>
+#include <QSqlDriver>
 #include <QFileSystem>
 #include <qtopialog.h>
 #ifndef QTOPIA_CONTENT_INSTALLER
@@ -41,6 +42,90 @@
 
 #include <string.h>
 
+// The maximum number of rows written by a single multi-row insert.  Keeps the
+// number of bound parameters well below SQLite's limit of 999.
+#define CONTENT_INSERT_BATCH_SIZE 32
+
+// The number of compiled filter queries and prepared system database
+// statements kept by each content store.
+#define CONTENT_QUERY_PLAN_CACHE_SIZE 32
+
+// The forms of comparison a filter argument compiles to.  Filters whose arguments
+// compile to the same forms share the same SQL and differ only in bound values.
+enum ArgumentForm
+{
+    InvalidArgument = 0,
+    EqualArgument = 'e',
+    LikeArgument = 'l',
+    GlobArgument = 'g',
+    RecursiveArgument = 'r',
+    NullArgument = 'n',
+    ProtectedArgument = 'p',
+    UnprotectedArgument = 'u'
+};
+
+static QString roleArgument( const QString &type )
+{
+    if ( type == QLatin1String("Document") )
+        return QLatin1String( "d" );
+    else if ( type == QLatin1String("Data") )
+        return QLatin1String( "b" );
+    else if( type == QLatin1String( "Folder" ) )
+        return QLatin1String( "f" );
+    else
+        return QLatin1String( "a" );
+}
+
+static ArgumentForm likeArgument( QString *argument )
+{
+    if( argument->contains( '*' ) )
+    {
+        argument->replace( '*', '%' );
+
+        return LikeArgument;
+    }
+    else
+        return EqualArgument;
+}
+
+static ArgumentForm pathArgument( QString *path, bool recursive )
+{
+    *path = QDir::cleanPath( *path );
+
+    if( path->contains( '*' ) )
+        return GlobArgument;
+
+    if( path->endsWith( '/' ) )
+        path->chop( 1 );
+
+    return recursive ? RecursiveArgument : EqualArgument;
+}
+
+static ArgumentForm categoryArgument( QString *category )
+{
+    return *category == QLatin1String( "Unfiled" ) ? NullArgument : likeArgument( category );
+}
+
+static ArgumentForm syntheticArgument( QString *value )
+{
+    return value->isEmpty() ? NullArgument : likeArgument( value );
+}
+
+static ArgumentForm drmArgument( const QString &drm )
+{
+    if( drm == QLatin1String( "Protected" ) )
+        return ProtectedArgument;
+    else if( drm == QLatin1String( "Unprotected" ) )
+        return UnprotectedArgument;
+    else
+        return InvalidArgument;
+}
+
+static bool parameterLessThan( const QPair< QString, QVariant > &parameter1, const QPair< QString, QVariant > &parameter2 )
+{
+    return parameter1.first < parameter2.first;
+}
+
 /*!
     \class QSqlContentStore
     \inpublicgroup QtBaseModule
@@ -54,6 +139,9 @@
     Constructs a new QSqlContentStore.
 */
 QSqlContentStore::QSqlContentStore()
+    : m_batchDepth( 0 )
+    , m_queryPlans( CONTENT_QUERY_PLAN_CACHE_SIZE )
+    , m_systemQueries( CONTENT_QUERY_PLAN_CACHE_SIZE )
 {
 }
 
@@ -62,6 +150,7 @@ QSqlContentStore::QSqlContentStore()
 */
 QSqlContentStore::~QSqlContentStore()
 {
+    qDeleteAll( m_preparedQueries );
 }
 
 /*!
@@ -220,6 +309,19 @@ bool QSqlContentStore::commitContent( QContent *content )
 {
     qLog(DocAPI) << __PRETTY_FUNCTION__ << *content;
 
+    Batch batch( this );
+
+    bool committed = commitBatchedContent( content );
+
+    // The content's category and property rows may only be written when the batch ends.
+    return batch.end() && committed;
+}
+
+/*!
+    Writes \a content to the database within the current batch.
+*/
+bool QSqlContentStore::commitBatchedContent( QContent *content )
+{
 #ifndef QTOPIA_CONTENT_INSTALLER
     if( !content->isValid( true ) )
     {
@@ -510,6 +612,10 @@ bool QSqlContentStore::uninstallContent( QContentId contentId )
     if( !db.isValid() )
         return false;
 
+    Batch batch( this );
+
+    flushPendingRows( contentId.first );
+
     QContent content(contentId);
 #ifndef QTOPIA_CONTENT_INSTALLER
     QFile::remove(thumbnailPath(content.fileName()));
@@ -521,19 +627,23 @@ bool QSqlContentStore::uninstallContent( QContentId contentId )
                 "delete from contentProps "
                 "where cid = :cid" );
 
-        QSqlQuery deletePropertyQuery( db );
-        deletePropertyQuery.prepare( deletePropertyString );
+        QSqlQuery *deletePropertyQuery = preparedQuery( contentId.first, deletePropertyString );
 
-        deletePropertyQuery.bindValue( QLatin1String( "cid" ), contentId.second );
+        if( deletePropertyQuery )
+        {
+            deletePropertyQuery->bindValue( QLatin1String( ":cid" ), contentId.second );
 
-        QtopiaSql::instance()->logQuery( deletePropertyQuery );
+            QtopiaSql::instance()->logQuery( *deletePropertyQuery );
 
-        if( !deletePropertyQuery.exec() )
-        {
-            logError( __PRETTY_FUNCTION__, "deletePropertyQuery", contentId.first, deletePropertyQuery.lastError() );
+            if( !deletePropertyQuery->exec() )
+            {
+                logError( __PRETTY_FUNCTION__, "deletePropertyQuery", contentId.first, deletePropertyQuery->lastError() );
 
-            succeeded = false;
+                succeeded = false;
+            }
         }
+        else
+            succeeded = false;
 
         if(content.role() == QContent::Application)
         {
@@ -551,19 +661,23 @@ bool QSqlContentStore::uninstallContent( QContentId contentId )
                 "delete from content "
                 "where cid = :cid" );
 
-        QSqlQuery deleteContentQuery( db );
-        deleteContentQuery.prepare( deleteContentString );
+        QSqlQuery *deleteContentQuery = preparedQuery( contentId.first, deleteContentString );
 
-        deleteContentQuery.bindValue( QLatin1String( "cid" ), contentId.second );
+        if( deleteContentQuery )
+        {
+            deleteContentQuery->bindValue( QLatin1String( ":cid" ), contentId.second );
 
-        QtopiaSql::instance()->logQuery( deleteContentQuery );
+            QtopiaSql::instance()->logQuery( *deleteContentQuery );
 
-        if( !deleteContentQuery.exec() )
-        {
-            logError( __PRETTY_FUNCTION__, "deleteContentQuery", contentId.first, deleteContentQuery.lastError() );
+            if( !deleteContentQuery->exec() )
+            {
+                logError( __PRETTY_FUNCTION__, "deleteContentQuery", contentId.first, deleteContentQuery->lastError() );
 
-            succeeded = false;
+                succeeded = false;
+            }
         }
+        else
+            succeeded = false;
     }
 
 #ifndef QTOPIA_CONTENT_INSTALLER
@@ -579,6 +693,8 @@ void QSqlContentStore::batchCommitContent( const QContentList &content )
 #ifndef QTOPIA_CONTENT_INSTALLER
     QContentUpdateManager::instance()->beginInstall();
 #endif
+    Batch batch( this );
+
     QMultiHash<QtopiaDatabaseId, QContent> list;
 
     foreach( const QContent &c, content )
@@ -602,6 +718,10 @@ void QSqlContentStore::batchCommitContent( const QContentList &content )
         foreach( QContent content, list.values( dbId ) )
             commitContent( &content );
 
+        // Write any queued category and property rows inside the transaction.
+        if( !flushPendingRows( dbId ) )
+            qWarning() << "QSqlContentStore::batchCommitContent: couldn't write categories and properties";
+
         if( !db.commit() ) {
             qWarning() << "QSqlContentStore::batchCommitContent: couldn't commit transaction" << db.lastError();
 
@@ -620,6 +740,8 @@ void QSqlContentStore::batchUninstallContent( const QContentIdList &content )
 #ifndef QTOPIA_CONTENT_INSTALLER
     QContentUpdateManager::instance()->beginInstall();
 #endif
+    Batch batch( this );
+
     QMultiHash<QtopiaDatabaseId, QContentId> list;
 
     foreach (const QContentId& id, content)
@@ -674,6 +796,8 @@ QStringList QSqlContentStore::contentCategories( QContentId contentId )
             "from mapCategoryToContent "
             "where cid = :cid" );
 
+    flushPendingRows( contentId.first );
+
     QSqlDatabase database = QtopiaSql::instance()->database( contentId.first );
 
     if( database.isValid() )
@@ -713,6 +837,8 @@ QContentEnginePropertyCache QSqlContentStore::contentProperties( QContentId cont
             "from contentProps "
             "where cid = :cid" );
 
+    flushPendingRows( contentId.first );
+
     QSqlDatabase database = QtopiaSql::instance()->database( contentId.first );
 
     if( database.isValid() )
@@ -771,42 +897,44 @@ bool QSqlContentStore::insertContent( QContentEngine *engine, QtopiaDatabaseId d
             "insert into content( uiName, uiNameSortOrder, mType, drmFlags, docStatus, path, location, icon, lastUpdated ) "
             "values( :uiName, :uiNameSortOrder, :mType, :drmFlags, :docStatus, :path, :location, :icon, :lastUpdated )" );
 
-    QSqlQuery insertQuery( QtopiaSql::instance()->database( dbId ) );
-    insertQuery.prepare( insertString );
+    QSqlQuery *insertQuery = preparedQuery( dbId, insertString );
+
+    if( !insertQuery )
+        return false;
 
-    insertQuery.bindValue( QLatin1String( ":uiName" ), engine->name() );
-    insertQuery.bindValue( QLatin1String( ":uiNameSortOrder" ), transformString( Qtopia::dehyphenate( engine->translatedName() ) ) );
-    insertQuery.bindValue( QLatin1String( ":mType" ), mimeId( engine->mimeType().id(), dbId ) );
-    insertQuery.bindValue( QLatin1String( ":drmFlags" ), convertDrmState( engine->drmState() ) );
-    insertQuery.bindValue( QLatin1String( ":docStatus" ), convertRole( engine->role() ) );
+    insertQuery->bindValue( QLatin1String( ":uiName" ), engine->name() );
+    insertQuery->bindValue( QLatin1String( ":uiNameSortOrder" ), transformString( Qtopia::dehyphenate( engine->translatedName() ) ) );
+    insertQuery->bindValue( QLatin1String( ":mType" ), mimeId( engine->mimeType().id(), dbId ) );
+    insertQuery->bindValue( QLatin1String( ":drmFlags" ), convertDrmState( engine->drmState() ) );
+    insertQuery->bindValue( QLatin1String( ":docStatus" ), convertRole( engine->role() ) );
 
     int slash = engine->fileName().lastIndexOf( '/' );
 
     if( slash == -1 )
     {
-        insertQuery.bindValue( QLatin1String( ":path" ), engine->fileName() );
-        insertQuery.bindValue( QLatin1String( ":location" ), 0 );
+        insertQuery->bindValue( QLatin1String( ":path" ), engine->fileName() );
+        insertQuery->bindValue( QLatin1String( ":location" ), 0 );
     }
     else
     {
-        insertQuery.bindValue( QLatin1String( ":path" ), engine->fileName().mid( slash + 1 ) );
-        insertQuery.bindValue( QLatin1String( ":location" ), locationId( engine->fileName().left( slash ), dbId ) );
+        insertQuery->bindValue( QLatin1String( ":path" ), engine->fileName().mid( slash + 1 ) );
+        insertQuery->bindValue( QLatin1String( ":location" ), locationId( engine->fileName().left( slash ), dbId ) );
     }
 
-    insertQuery.bindValue( QLatin1String( ":icon" ), engine->iconName() );
-    insertQuery.bindValue( QLatin1String( ":lastUpdated" ), engine->lastUpdated().toTime_t() );
+    insertQuery->bindValue( QLatin1String( ":icon" ), engine->iconName() );
+    insertQuery->bindValue( QLatin1String( ":lastUpdated" ), engine->lastUpdated().toTime_t() );
 
-    QtopiaSql::instance()->logQuery( insertQuery );
+    QtopiaSql::instance()->logQuery( *insertQuery );
 
-    if( !insertQuery.exec() )
+    if( !insertQuery->exec() )
     {
-        logError( __PRETTY_FUNCTION__, "insertQuery", *engine, dbId, insertQuery.lastError() );
+        logError( __PRETTY_FUNCTION__, "insertQuery", *engine, dbId, insertQuery->lastError() );
 
         return false;
     }
     else
     {
-        QContentId id = QContentId( dbId, insertQuery.lastInsertId().toULongLong() );
+        QContentId id = QContentId( dbId, insertQuery->lastInsertId().toULongLong() );
 
         insertCategories( id, engine->categories() );
         insertProperties( id, *engine );
@@ -844,37 +972,39 @@ bool QSqlContentStore::updateContent( QContentEngine *engine )
 
     setLastUpdated(QFileInfo(engine->fileName()).lastModified(), engine);
 
-    QSqlQuery updateQuery( database );
-    updateQuery.prepare( updateString );
+    QSqlQuery *updateQuery = preparedQuery( engine->id().first, updateString );
 
-    updateQuery.bindValue( QLatin1String( ":uiName" ), engine->name() );
-    updateQuery.bindValue( QLatin1String( ":uiNameSortOrder" ), transformString( Qtopia::dehyphenate( engine->translatedName() ) ) );
-    updateQuery.bindValue( QLatin1String( ":mType" ), mimeId( engine->mimeType().id(), engine->id().first ) );
-    updateQuery.bindValue( QLatin1String( ":drmFlags" ), convertDrmState( engine->drmState() ) );
-    updateQuery.bindValue( QLatin1String( ":docStatus" ), convertRole( engine->role() ) );
+    if( !updateQuery )
+        return false;
+
+    updateQuery->bindValue( QLatin1String( ":uiName" ), engine->name() );
+    updateQuery->bindValue( QLatin1String( ":uiNameSortOrder" ), transformString( Qtopia::dehyphenate( engine->translatedName() ) ) );
+    updateQuery->bindValue( QLatin1String( ":mType" ), mimeId( engine->mimeType().id(), engine->id().first ) );
+    updateQuery->bindValue( QLatin1String( ":drmFlags" ), convertDrmState( engine->drmState() ) );
+    updateQuery->bindValue( QLatin1String( ":docStatus" ), convertRole( engine->role() ) );
 
     int slash = engine->fileName().lastIndexOf( '/' );
 
     if( slash == -1 )
     {
-        updateQuery.bindValue( QLatin1String( ":path" ), engine->fileName() );
-        updateQuery.bindValue( QLatin1String( ":location" ), 0 );
+        updateQuery->bindValue( QLatin1String( ":path" ), engine->fileName() );
+        updateQuery->bindValue( QLatin1String( ":location" ), 0 );
     }
     else
     {
-        updateQuery.bindValue( QLatin1String( ":path" ), engine->fileName().mid( slash + 1 ) );
-        updateQuery.bindValue( QLatin1String( ":location" ), locationId( engine->fileName().left( slash ), engine->id().first ) );
+        updateQuery->bindValue( QLatin1String( ":path" ), engine->fileName().mid( slash + 1 ) );
+        updateQuery->bindValue( QLatin1String( ":location" ), locationId( engine->fileName().left( slash ), engine->id().first ) );
     }
 
-    updateQuery.bindValue( QLatin1String( ":icon" ), engine->iconName() );
-    updateQuery.bindValue( QLatin1String( ":lastUpdated" ), engine->lastUpdated().toTime_t() );
-    updateQuery.bindValue( QLatin1String( ":cid" ), engine->id().second  );
+    updateQuery->bindValue( QLatin1String( ":icon" ), engine->iconName() );
+    updateQuery->bindValue( QLatin1String( ":lastUpdated" ), engine->lastUpdated().toTime_t() );
+    updateQuery->bindValue( QLatin1String( ":cid" ), engine->id().second  );
 
-    QtopiaSql::instance()->logQuery( updateQuery );
+    QtopiaSql::instance()->logQuery( *updateQuery );
 
-    if( !updateQuery.exec() )
+    if( !updateQuery->exec() )
     {
-        logError( __PRETTY_FUNCTION__, "updateQuery", *engine, engine->id().first, updateQuery.lastError() );
+        logError( __PRETTY_FUNCTION__, "updateQuery", *engine, engine->id().first, updateQuery->lastError() );
 
         return false;
     }
@@ -1053,22 +1183,19 @@ int QSqlContentStore::contentCount( const QContentFilter &filter )
     if( !filter.isValid() )
         return count;
 
-    int insertAt = 0;
     QList< Parameter > parameters;
-    QStringList joins;
 
-    QString whereString = QLatin1String(" WHERE ")
-            + buildWhereClause( filter, &parameters, &insertAt, &joins );
+    QueryPlan plan = compileQuery( filter, 0, &parameters );
 
     QString selectString
             = QLatin1String( "SELECT count(DISTINCT content.cid) FROM " )
-            + buildFrom( filter, joins )
-            + whereString;
+            + plan.from
+            + QLatin1String(" WHERE ")
+            + plan.where;
 
     foreach(QtopiaDatabaseId dbid, QtopiaSql::instance()->databaseIds())
     {
-        QSqlQuery selectQuery( QtopiaSql::instance()->database(dbid) );
-        selectQuery.prepare( selectString );
+        QSqlQuery selectQuery = prepareSelect( dbid, selectString );
 
         bindParameters( &selectQuery, parameters );
 
@@ -1083,6 +1210,8 @@ int QSqlContentStore::contentCount( const QContentFilter &filter )
 
         if( selectQuery.first() )
             count += selectQuery.value( 0 ).toInt();
+
+        selectQuery.finish();
     }
 
     return count;
@@ -1098,24 +1227,20 @@ QContentIdList QSqlContentStore::matches( const QContentFilter &filter, const QC
     if( !filter.isValid() )
         return matches;
 
-    int insertAt = 0;
     QList< Parameter > parameters;
-    QStringList joins;
 
-    QString whereString = QLatin1String(" WHERE ")
-            + buildWhereClause( filter, &parameters, &insertAt, &joins );
+    QueryPlan plan = compileQuery( filter, &order, &parameters );
 
-    QString orderString = buildOrderBy( order, &parameters, &insertAt, &joins );
     QString selectString
             = QLatin1String( "SELECT DISTINCT content.cid FROM " )
-            + buildFrom( filter, joins )
-            + whereString
-            + orderString;
+            + plan.from
+            + QLatin1String(" WHERE ")
+            + plan.where
+            + plan.orderBy;
 
     foreach(QtopiaDatabaseId dbid, QtopiaSql::instance()->databaseIds())
     {
-        QSqlQuery selectQuery( QtopiaSql::instance()->database(dbid) );
-        selectQuery.prepare( selectString );
+        QSqlQuery selectQuery = prepareSelect( dbid, selectString );
 
         bindParameters( &selectQuery, parameters );
 
@@ -1130,6 +1255,8 @@ QContentIdList QSqlContentStore::matches( const QContentFilter &filter, const QC
 
         while ( selectQuery.next() )
             matches.append( QContentId( dbid, selectQuery.value( 0 ).toULongLong() ) );
+
+        selectQuery.finish();
     }
 
     return matches;
@@ -1142,21 +1269,18 @@ QContentIdList QSqlContentStore::matches( QtopiaDatabaseId databaseId, const QCo
     if( !filter.isValid() || !QtopiaSql::instance()->isValidDatabaseId( databaseId ) )
         return matches;
 
-    int insertAt = 0;
     QList< Parameter > parameters;
-    QStringList joins;
 
-    QString whereString = QLatin1String(" WHERE ")
-            + buildWhereClause( filter, &parameters, &insertAt, &joins );
-    QString orderString = buildOrderBy( order, &parameters, &insertAt, &joins );
+    QueryPlan plan = compileQuery( filter, &order, &parameters );
+
     QString selectString
             = QLatin1String( "SELECT DISTINCT content.cid FROM " )
-            + buildFrom( filter, joins )
-            + whereString
-            + orderString;
+            + plan.from
+            + QLatin1String(" WHERE ")
+            + plan.where
+            + plan.orderBy;
 
-    QSqlQuery selectQuery( QtopiaSql::instance()->database( databaseId ) );
-    selectQuery.prepare( selectString );
+    QSqlQuery selectQuery = prepareSelect( databaseId, selectString );
 
     bindParameters( &selectQuery, parameters );
 
@@ -1170,6 +1294,8 @@ QContentIdList QSqlContentStore::matches( QtopiaDatabaseId databaseId, const QCo
     {
         while ( selectQuery.next() )
             matches.append( QContentId( databaseId, selectQuery.value( 0 ).toULongLong() ) );
+
+        selectQuery.finish();
     }
 
     return matches;
@@ -1428,21 +1554,23 @@ int QSqlContentStore::mimeId( const QString &type, QtopiaDatabaseId dbId )
             "insert into mimeTypeLookup( mimeType ) "
             "values( :type )" );
 
-    QSqlQuery insertQuery( QtopiaSql::instance()->database( dbId ) );
-    insertQuery.prepare( insertString );
+    QSqlQuery *insertQuery = preparedQuery( dbId, insertString );
+
+    if( !insertQuery )
+        return 0;
 
-    insertQuery.bindValue( QLatin1String( ":type" ), type );
+    insertQuery->bindValue( QLatin1String( ":type" ), type );
 
-    QtopiaSql::instance()->logQuery( insertQuery );
+    QtopiaSql::instance()->logQuery( *insertQuery );
 
-    if( !insertQuery.exec() )
+    if( !insertQuery->exec() )
     {
-        logError( __PRETTY_FUNCTION__, "insertQuery", dbId, insertQuery.lastError() );
+        logError( __PRETTY_FUNCTION__, "insertQuery", dbId, insertQuery->lastError() );
 
         return 0;
     }
 
-    key = insertQuery.lastInsertId().toInt();
+    key = insertQuery->lastInsertId().toInt();
 
     QContentCache::instance()->cacheMimeTypeKey( dbId, type, key );
 
@@ -1461,30 +1589,34 @@ int QSqlContentStore::queryMimeId( const QString &type, QtopiaDatabaseId dbId )
             "from mimeTypeLookup "
             "where mimeType = :type" );
 
-    QSqlQuery selectQuery( QtopiaSql::instance()->database( dbId ) );
-    selectQuery.prepare( selectString );
+    QSqlQuery *selectQuery = preparedQuery( dbId, selectString );
 
-    selectQuery.bindValue( QLatin1String( ":type" ), type );
+    if( !selectQuery )
+        return -1;
 
-    QtopiaSql::instance()->logQuery( selectQuery );
+    selectQuery->bindValue( QLatin1String( ":type" ), type );
 
-    if( !selectQuery.exec() )
+    QtopiaSql::instance()->logQuery( *selectQuery );
+
+    if( !selectQuery->exec() )
     {
-        logError( __PRETTY_FUNCTION__, "selectQuery", dbId, selectQuery.lastError() );
+        logError( __PRETTY_FUNCTION__, "selectQuery", dbId, selectQuery->lastError() );
 
         return -1;
     }
 
-    if( selectQuery.first() )
+    int key = -1;
+
+    if( selectQuery->first() )
     {
-        int key = selectQuery.value( 0 ).toInt();
+        key = selectQuery->value( 0 ).toInt();
 
         QContentCache::instance()->cacheMimeTypeKey( dbId, type, key );
-
-        return key;
     }
 
-    return -1;
+    selectQuery->finish();
+
+    return key;
 }
 
 /*!
@@ -1506,21 +1638,23 @@ int QSqlContentStore::locationId( const QString &location, QtopiaDatabaseId dbId
             "insert into locationLookup( location ) "
             "values( :location )" );
 
-    QSqlQuery insertQuery( QtopiaSql::instance()->database( dbId ) );
-    insertQuery.prepare( insertString );
+    QSqlQuery *insertQuery = preparedQuery( dbId, insertString );
+
+    if( !insertQuery )
+        return -1;
 
-    insertQuery.bindValue( QLatin1String( ":location" ), location );
+    insertQuery->bindValue( QLatin1String( ":location" ), location );
 
-    QtopiaSql::instance()->logQuery( insertQuery );
+    QtopiaSql::instance()->logQuery( *insertQuery );
 
-    if( !insertQuery.exec() )
+    if( !insertQuery->exec() )
     {
-        logError( __PRETTY_FUNCTION__, "insertQuery", dbId, insertQuery.lastError() );
+        logError( __PRETTY_FUNCTION__, "insertQuery", dbId, insertQuery->lastError() );
 
         return -1;
     }
 
-    key = insertQuery.lastInsertId().toInt();
+    key = insertQuery->lastInsertId().toInt();
 
     QContentCache::instance()->cacheLocationKey( dbId, location, key );
 
@@ -1539,104 +1673,144 @@ int QSqlContentStore::queryLocationId( const QString &location, QtopiaDatabaseId
             "from locationLookup "
             "where location = :location" );
 
-    QSqlQuery selectQuery( QtopiaSql::instance()->database( dbId ) );
-    selectQuery.prepare( selectString );
+    QSqlQuery *selectQuery = preparedQuery( dbId, selectString );
 
-    selectQuery.bindValue( QLatin1String( ":location" ), location );
+    if( !selectQuery )
+        return -1;
 
-    QtopiaSql::instance()->logQuery( selectQuery );
+    selectQuery->bindValue( QLatin1String( ":location" ), location );
 
-    if( !selectQuery.exec() )
+    QtopiaSql::instance()->logQuery( *selectQuery );
+
+    if( !selectQuery->exec() )
     {
-        logError( __PRETTY_FUNCTION__, "selectQuery", dbId, selectQuery.lastError() );
+        logError( __PRETTY_FUNCTION__, "selectQuery", dbId, selectQuery->lastError() );
 
         return -1;
     }
 
-    if( selectQuery.first() )
+    int key = -1;
+
+    if( selectQuery->first() )
     {
-        int key = selectQuery.value( 0 ).toInt();
+        key = selectQuery->value( 0 ).toInt();
 
         QContentCache::instance()->cacheLocationKey( dbId, location, key );
-
-        return key;
     }
 
-    return -1;
+    selectQuery->finish();
+
+    return key;
 }
 
 /*!
     Associates the content with the id \a id with the category ids \a categories in the database.
+
+    The rows are queued and written with other queued rows when the current batch ends or enough
+    rows are queued to fill a multi-row insert.
 */
 bool QSqlContentStore::insertCategories( QContentId id, const QStringList &categories )
 {
-    static const QString insertString = QLatin1String(
-            "insert into mapCategoryToContent( cid, categoryid ) "
-            "values( :cid, :categoryid )" );
-
-    QSqlQuery insertQuery( QtopiaSql::instance()->database( id.first ) );
-    insertQuery.prepare( insertString );
-
-    bool success = true;
+    QVariantList &rows = m_pendingRows[ id.first ].categories;
 
     int i = -1;
 
     foreach( QString category, categories )
     {
         if( ( i == -1 || categories.lastIndexOf( category, i ) == -1 ) && syncCategory( id.first, category ) )
-        {
-            insertQuery.bindValue( QLatin1String( ":cid" ), id.second );
-            insertQuery.bindValue( QLatin1String( ":categoryid" ), category );
-
-            if( !insertQuery.exec() )
-            {
-                QtopiaSql::instance()->logQuery( insertQuery );
-
-                logError( __PRETTY_FUNCTION__, "insertQuery", id.first,
-                        insertQuery.lastError() );
-
-                success = false;
-            }
-        }
+            rows << id.second << category;
         i++;
     }
 
-    return success;
+    if( m_batchDepth == 0 || rows.count() >= 2 * CONTENT_INSERT_BATCH_SIZE )
+        return flushPendingRows( id.first );
+    else
+        return true;
 }
 
 /*!
     Writes the properties from the content engine \a engine to the database associated with the content with
     the id \a id.
+
+    The rows are queued and written with other queued rows when the current batch ends or enough
+    rows are queued to fill a multi-row insert.
 */
 bool QSqlContentStore::insertProperties( QContentId id, const QContentEngine &engine )
 {
-    static const QString insertString = QLatin1String(
-            "insert into contentProps( cid, grp, name, value ) "
-            "values( :cid, :grp, :name, :value )" );
+    QVariantList &rows = m_pendingRows[ id.first ].properties;
+
+    foreach( QString group, engine.propertyGroups() )
+        foreach( QString key, engine.propertyKeys( group ) )
+            rows << id.second << group << key << engine.property( group, key );
+
+    if( m_batchDepth == 0 || rows.count() >= 4 * CONTENT_INSERT_BATCH_SIZE )
+        return flushPendingRows( id.first );
+    else
+        return true;
+}
+
+/*!
+    Writes all queued category and property rows for the database with the id \a dbId.
 
-    QSqlQuery insertQuery( QtopiaSql::instance()->database( id.first ) );
-    insertQuery.prepare( insertString );
+    Returns true if all the rows were written successfully.
+*/
+bool QSqlContentStore::flushPendingRows( QtopiaDatabaseId dbId )
+{
+    if( !m_pendingRows.contains( dbId ) )
+        return true;
+
+    PendingRows rows = m_pendingRows.take( dbId );
 
     bool success = true;
 
-    foreach( QString group, engine.propertyGroups() )
+    success &= insertRows( dbId, QLatin1String( "mapCategoryToContent" ), QLatin1String( "cid, categoryid" ), 2, rows.categories );
+    success &= insertRows( dbId, QLatin1String( "contentProps" ), QLatin1String( "cid, grp, name, value" ), 4, rows.properties );
+
+    return success;
+}
+
+/*!
+    Inserts rows of \a columnCount \a values into the \a columns of \a table in the database with the id \a dbId.
+
+    Up to CONTENT_INSERT_BATCH_SIZE rows are written by each insert.
+
+    Returns true if all the rows were written successfully.
+*/
+bool QSqlContentStore::insertRows( QtopiaDatabaseId dbId, const QString &table, const QString &columns, int columnCount, const QVariantList &values )
+{
+    bool success = true;
+
+    int rowCount = values.count() / columnCount;
+
+    for( int row = 0; row < rowCount; row += CONTENT_INSERT_BATCH_SIZE )
     {
-        foreach( QString key, engine.propertyKeys( group ) )
-        {
-            insertQuery.bindValue( QLatin1String( ":cid" ), id.second );
-            insertQuery.bindValue( QLatin1String( ":grp" ), group );
-            insertQuery.bindValue( QLatin1String( ":name" ), key );
-            insertQuery.bindValue( QLatin1String( ":value" ), engine.property( group, key ) );
+        int count = qMin( rowCount - row, CONTENT_INSERT_BATCH_SIZE );
 
-            if( !insertQuery.exec() )
-            {
-                QtopiaSql::instance()->logQuery( insertQuery );
+        // insert into table( a, b ) select ?, ? union all select ?, ? ...
+        QString select = QLatin1String( "select ?" ) + QString( QLatin1String( ", ?" ) ).repeated( columnCount - 1 );
 
-                logError( __PRETTY_FUNCTION__, "insertQuery", id.first,
-                          insertQuery.lastError() );
+        QString insertString = QLatin1String( "insert into " ) + table + QLatin1String( "( " ) + columns + QLatin1String( " ) " ) + select;
 
-                success = false;
-            }
+        for( int i = 1; i < count; i++ )
+            insertString += QLatin1String( " union all " ) + select;
+
+        QSqlQuery *insertQuery = preparedQuery( dbId, insertString );
+
+        if( !insertQuery )
+            return false;
+
+        int offset = row * columnCount;
+
+        for( int i = 0; i < count * columnCount; i++ )
+            insertQuery->bindValue( i, values.at( offset + i ) );
+
+        if( !insertQuery->exec() )
+        {
+            QtopiaSql::instance()->logQuery( *insertQuery );
+
+            logError( __PRETTY_FUNCTION__, "insertQuery", dbId, insertQuery->lastError() );
+
+            success = false;
         }
     }
 
@@ -1652,16 +1826,20 @@ bool QSqlContentStore::removeCategories( QContentId id )
             "delete from mapCategoryToContent "
             "where cid = :cid" );
 
-    QSqlQuery deleteQuery( QtopiaSql::instance()->database(  id.first ) );
-    deleteQuery.prepare( deleteString );
+    flushPendingRows( id.first );
+
+    QSqlQuery *deleteQuery = preparedQuery( id.first, deleteString );
 
-    deleteQuery.bindValue( QLatin1String( "cid" ), id.second );
+    if( !deleteQuery )
+        return false;
+
+    deleteQuery->bindValue( QLatin1String( ":cid" ), id.second );
 
-    QtopiaSql::instance()->logQuery( deleteQuery );
+    QtopiaSql::instance()->logQuery( *deleteQuery );
 
-    if( !deleteQuery.exec() )
+    if( !deleteQuery->exec() )
     {
-        logError( __PRETTY_FUNCTION__, "deleteQuery", id.first, deleteQuery.lastError() );
+        logError( __PRETTY_FUNCTION__, "deleteQuery", id.first, deleteQuery->lastError() );
 
         return false;
     }
@@ -1678,16 +1856,20 @@ bool QSqlContentStore::removeProperties( QContentId id )
             "delete from contentProps "
             "where cid = :cid" );
 
-    QSqlQuery deleteQuery( QtopiaSql::instance()->database( id.first ) );
-    deleteQuery.prepare( deleteString );
+    flushPendingRows( id.first );
+
+    QSqlQuery *deleteQuery = preparedQuery( id.first, deleteString );
 
-    deleteQuery.bindValue( QLatin1String( ":cid" ), id.second );
+    if( !deleteQuery )
+        return false;
+
+    deleteQuery->bindValue( QLatin1String( ":cid" ), id.second );
 
-    QtopiaSql::instance()->logQuery( deleteQuery );
+    QtopiaSql::instance()->logQuery( *deleteQuery );
 
-    if( !deleteQuery.exec() )
+    if( !deleteQuery->exec() )
     {
-        logError( __PRETTY_FUNCTION__, "deleteQuery", id.first, deleteQuery.lastError() );
+        logError( __PRETTY_FUNCTION__, "deleteQuery", id.first, deleteQuery->lastError() );
 
         return false;
     }
@@ -1695,6 +1877,90 @@ bool QSqlContentStore::removeProperties( QContentId id )
         return true;
 }
 
+/*!
+    Starts a batch of database writes.  Prepared statements are kept for reuse and category and property
+    rows are queued for multi-row inserts until the outermost batch ends.
+*/
+void QSqlContentStore::beginBatch()
+{
+    m_batchDepth++;
+}
+
+/*!
+    Ends a batch of database writes started with beginBatch().  When the outermost batch ends any queued
+    rows are written and the prepared statements are released.
+
+    Returns false if any of the queued rows could not be written.
+*/
+bool QSqlContentStore::endBatch()
+{
+    if( m_batchDepth > 1 )
+    {
+        m_batchDepth--;
+
+        return true;
+    }
+
+    bool success = true;
+
+    // The queued rows are written while the batch still owns the prepared statements.
+    foreach( QtopiaDatabaseId dbId, m_pendingRows.keys() )
+        success &= flushPendingRows( dbId );
+
+    m_batchDepth = 0;
+
+    // Don't hold statements open between batches, they would keep a database from being detached.
+    qDeleteAll( m_preparedQueries );
+    m_preparedQueries.clear();
+    m_syncedCategories.clear();
+
+    return success;
+}
+
+/*!
+    Returns a query for \a queryString prepared against the database with the id \a dbId.
+
+    The same query is returned each time the statement is requested within a batch, and it is released
+    when the batch ends.  Returns 0 if the statement could not be prepared or if there is no batch
+    to own it.
+*/
+QSqlQuery *QSqlContentStore::preparedQuery( QtopiaDatabaseId dbId, const QString &queryString )
+{
+    if( m_batchDepth == 0 )
+    {
+        logError( __PRETTY_FUNCTION__, QLatin1String( "Prepared statement requested outside a batch: " ) + queryString );
+
+        return 0;
+    }
+
+    QPair< QtopiaDatabaseId, QString > key( dbId, queryString );
+
+    QSqlQuery *query = m_preparedQueries.value( key );
+
+    if( query )
+        return query;
+
+    QSqlDatabase database = QtopiaSql::instance()->database( dbId );
+
+    if( !database.isValid() )
+        return 0;
+
+    query = new QSqlQuery( database );
+
+    if( !query->prepare( queryString ) )
+    {
+        logError( __PRETTY_FUNCTION__, qPrintable( queryString ), dbId, query->lastError() );
+
+        delete query;
+
+        return 0;
+    }
+
+    m_preparedQueries.insert( key, query );
+
+    return query;
+}
+
 /*!
     Queries the database for a content record with the link file \a fileName.
 */
@@ -1834,22 +2100,39 @@ bool QSqlContentStore::syncCategory( QtopiaDatabaseId databaseId, const QString
             "from categories "
             "where categoryid = :categoryId" );
 
+    QPair< QtopiaDatabaseId, QString > syncedCategory( databaseId, categoryId );
+
+    if( m_syncedCategories.contains( syncedCategory ) )
+        return true;
+
     {
-        QSqlQuery selectQuery( QtopiaSql::instance()->database( databaseId ) );
+        QSqlQuery *selectQuery = preparedQuery( databaseId, selectString );
 
-        selectQuery.prepare( selectString );
-        selectQuery.bindValue( QLatin1String( ":categoryId" ), categoryId );
+        if( !selectQuery )
+            return false;
 
-        QtopiaSql::instance()->logQuery( selectQuery );
+        selectQuery->bindValue( QLatin1String( ":categoryId" ), categoryId );
 
-        if( !selectQuery.exec() )
+        QtopiaSql::instance()->logQuery( *selectQuery );
+
+        if( !selectQuery->exec() )
         {
-            logError( __PRETTY_FUNCTION__, "selectQuery", databaseId, selectQuery.lastError() );
+            logError( __PRETTY_FUNCTION__, "selectQuery", databaseId, selectQuery->lastError() );
 
             return false;
         }
-        else if( selectQuery.first() )
+
+        bool exists = selectQuery->first();
+
+        selectQuery->finish();
+
+        if( exists )
+        {
+            if( m_batchDepth > 0 )
+                m_syncedCategories.insert( syncedCategory );
+
             return true;
+        }
     }
 
     foreach( QtopiaDatabaseId dbId, QtopiaSql::instance()->databaseIds() )
@@ -1893,7 +2176,12 @@ bool QSqlContentStore::syncCategory( QtopiaDatabaseId databaseId, const QString
                 return false;
             }
             else
+            {
+                if( m_batchDepth > 0 )
+                    m_syncedCategories.insert( syncedCategory );
+
                 return true;
+            }
         }
     }
 
@@ -2015,18 +2303,7 @@ QString QSqlContentStore::buildQtopiaTypes( const QStringList &types, const QStr
 
     foreach( QString type, types )
     {
-        QString value;
-
-        if ( type == QLatin1String("Document") )
-            value = QLatin1String( "d" );
-        else if ( type == QLatin1String("Data") )
-            value = QLatin1String( "b" );
-        else if( type == QLatin1String( "Folder" ) )
-            value = QLatin1String( "f" );
-        else
-            value = QLatin1String( "a" );
-
-        expression += c + QString( "docStatus = %1" ).arg( addParameter( value, parameters ) );
+        expression += c + QString( "docStatus = %1" ).arg( addParameter( roleArgument( type ), parameters ) );
 
         c = conjunct;
     }
@@ -2056,20 +2333,13 @@ QString QSqlContentStore::buildPaths( const QStringList &locations, const QStrin
 
     foreach( QString location, locations )
     {
-        location = QDir::cleanPath( location );
-
-        if( location.contains( '*' ) )
+        if( pathArgument( &location, true ) == GlobArgument )
         {
             expression += c + QString( "locationLookup.location GLOB %1" )
                     .arg( addParameter( location, parameters ) );
-
-            c = bracketedConjunct;
         }
         else
         {
-            if( location.endsWith( '/' ) )
-                location.chop( 1 );
-
             QString likeParam = addParameter( location + QLatin1String( "/*" ), parameters );
             QString equalParam = addParameter( location, parameters );
 
@@ -2077,32 +2347,25 @@ QString QSqlContentStore::buildPaths( const QStringList &locations, const QStrin
                     "locationLookup.location GLOB %1 OR locationLookup.location = %2" )
                     .arg( likeParam  )
                     .arg( equalParam );
-
-            c = bracketedConjunct;
         }
+
+        c = bracketedConjunct;
     }
 
     foreach( QString directory, directories )
     {
-        directory = QDir::cleanPath( directory );
-
-        if( directory.contains( '*' ) )
+        if( pathArgument( &directory, false ) == GlobArgument )
         {
             expression += c + QString( "locationLookup.location GLOB %1" )
                     .arg( addParameter( directory, parameters ) );
-
-            c = bracketedConjunct;
         }
         else
         {
-            if( directory.endsWith( '/' ) )
-                directory.chop( 1 );
-
             expression += c + QString( "locationLookup.location = %1" )
                     .arg( addParameter( directory, parameters ) );
-
-            c = bracketedConjunct;
         }
+
+        c = bracketedConjunct;
     }
 
     return !expression.isEmpty() ? QString( "(%1)" ).arg( expression ) : QString();
@@ -2123,10 +2386,8 @@ QString QSqlContentStore::buildMimeTypes( const QStringList &mimes, const QStrin
 
     foreach( QString mime, mimes )
     {
-        if( mime.contains( '*' ) )
+        if( likeArgument( &mime ) == LikeArgument )
         {
-            mime.replace( '*', '%' );
-
             expression += c + QString( "mimeTypeLookup.mimeType LIKE %1" )
                     .arg( addParameter( mime, parameters ) );
         }
@@ -2158,24 +2419,21 @@ QString QSqlContentStore::buildCategories( const QStringList &categories, const
     {
         QString table = QString( "cat%1" ).arg( joins->count(), 3, 10, QLatin1Char( '0' ) );
 
-        if( category == QLatin1String( "Unfiled" ) )
+        switch( categoryArgument( &category ) )
         {
+        case NullArgument:
             joins->append( QString( " left join mapCategoryToContent as %1 on %1.cid = content.cid" ).arg( table ) );
 
             expression += c + QString( "%1.categoryid is NULL" ).arg( table );
-        }
-        else if( category.contains( "*" ) )
-        {
-            category.replace(QLatin1Char('*'), QLatin1Char('%'));
-
+            break;
+        case LikeArgument:
             joins->append( QString( " left join mapCategoryToContent as %1 on %1.cid = content.cid and %1.categoryid like %2" )
                     .arg( table )
                     .arg( addParameter( category, parameters, insertAt ) ) );
 
             expression += c + QString( "%1.categoryid is not NULL" ).arg( table );
-        }
-        else
-        {
+            break;
+        default:
             joins->append( QString( " left join mapCategoryToContent as %1 on %1.cid = content.cid and %1.categoryid = %2" )
                     .arg( table )
                     .arg( addParameter( category, parameters, insertAt ) ) );
@@ -2221,21 +2479,18 @@ QString QSqlContentStore::buildSynthetic( const QStringList &synthetic, const QS
 
         joins->append( join );
 
-        if( value.isEmpty() )
+        switch( syntheticArgument( &value ) )
         {
+        case NullArgument:
             expression += c + QString( "(%1.value is null)" )
                     .arg( table );
-        }
-        else if( value.contains( '*' ) )
-        {
-            value.replace( '*', '%' );
-
+            break;
+        case LikeArgument:
             expression += c + QString( "(%1.value like %2 and %1.value not null)" )
                     .arg( table )
                     .arg( addParameter( value, parameters ) );
-        }
-        else
-        {
+            break;
+        default:
             expression += c + QString( "(%1.value = %2 and %1.value not null)" )
                     .arg( table )
                     .arg( addParameter( value, parameters ) );
@@ -2259,19 +2514,22 @@ QString QSqlContentStore::buildDrm( const QStringList &drm, const QString &conju
 
     foreach( QString filter, drm )
     {
-        if( filter == QLatin1String( "Protected" ) )
+        switch( drmArgument( filter ) )
         {
+        case ProtectedArgument:
             expression += c + QString( "drmFlags != %1" )
                     .arg( addParameter( QVariant( 65536 ), parameters ) );
 
             c = conjunct;
-        }
-        else if( filter == QLatin1String( "Unprotected" ) )
-        {
+            break;
+        case UnprotectedArgument:
             expression += c + QString( "drmFlags == %1" )
                     .arg( addParameter( QVariant( 65536 ), parameters ) );
 
             c = conjunct;
+            break;
+        default:
+            break;
         }
     }
 
@@ -2291,22 +2549,18 @@ QString QSqlContentStore::buildFileNames( const QStringList &fileNames, const QS
 
     foreach( QString filter, fileNames )
     {
-        if( filter.contains( '*' ) )
+        if( likeArgument( &filter ) == LikeArgument )
         {
-            filter.replace( '*', '%' );
-
             expression += c + QString( "path like %1" )
                     .arg( addParameter( filter, parameters ) );
-
-            c = conjunct;
         }
         else
         {
             expression += c + QString( "path = %1" )
                     .arg( addParameter( filter, parameters ) );
-
-            c = conjunct;
         }
+
+        c = conjunct;
     }
 
     return expression;
@@ -2325,22 +2579,18 @@ QString QSqlContentStore::buildNames( const QStringList &names, const QString &c
 
     foreach( QString filter, names )
     {
-        if( filter.contains( '*' ) )
+        if( likeArgument( &filter ) == LikeArgument )
         {
-            filter.replace( '*', '%' );
-
             expression += c + QString( "uiName like %1" )
                     .arg( addParameter( filter, parameters ) );
-
-            c = conjunct;
         }
         else
         {
             expression += c + QString( "uiName = %1" )
                     .arg( addParameter( filter, parameters ) );
-
-            c = conjunct;
         }
+
+        c = conjunct;
     }
 
     return expression;
@@ -2445,13 +2695,9 @@ QString QSqlContentStore::buildQuery( const QString &queryTemplate, const QConte
     if( !filter.isValid() )
         return QString();
 
-    int insertAt = 0;
-    QStringList joins;
-
-    QString where = buildWhereClause( filter, parameters, &insertAt, &joins );
-    QString from = buildFrom( filter, joins );
+    QueryPlan plan = compileQuery( filter, 0, parameters );
 
-    return queryTemplate.arg( from ).arg( where );
+    return queryTemplate.arg( plan.from ).arg( plan.where );
 }
 
 /*!
@@ -2465,14 +2711,229 @@ QString QSqlContentStore::buildQuery( const QString &queryTemplate, const QConte
     if( !filter.isValid() )
         return QString();
 
-    int insertAt = 0;
-    QStringList joins;
+    QueryPlan plan = compileQuery( filter, &sortOrder, parameters );
+
+    return queryTemplate.arg( plan.from ).arg( plan.where );
+}
+
+/*!
+    Appends a description of the structure of a content \a filter to \a shape and the values of its arguments
+    to \a values.
+
+    Filters with the same shape compile to the same SQL.  The values are appended in the order buildWhereClause()
+    adds them as parameters so the nth value binds to the nth parameter of the compiled query.
+*/
+void QSqlContentStore::filterShape( const QContentFilter &filter, QString *shape, QVariantList *values )
+{
+    shape->append( filter.operand() == QContentFilter::Or ? QLatin1Char( '|' ) : QLatin1Char( '&' ) );
+
+    if( filter.negated() )
+        shape->append( QLatin1Char( '!' ) );
+
+    shape->append( QLatin1Char( 'R' ) );
+
+    foreach( QString type, filter.arguments( QContentFilter::Role ) )
+    {
+        shape->append( QLatin1Char( EqualArgument ) );
+
+        values->append( roleArgument( type ) );
+    }
+
+    shape->append( QLatin1Char( 'L' ) );
+
+    foreach( QString location, filter.arguments( QContentFilter::Location ) )
+    {
+        ArgumentForm form = pathArgument( &location, true );
+
+        shape->append( QLatin1Char( form ) );
+
+        if( form == RecursiveArgument )
+            values->append( location + QLatin1String( "/*" ) );
+
+        values->append( location );
+    }
+
+    shape->append( QLatin1Char( 'D' ) );
+
+    foreach( QString directory, filter.arguments( QContentFilter::Directory ) )
+    {
+        shape->append( QLatin1Char( pathArgument( &directory, false ) ) );
+
+        values->append( directory );
+    }
+
+    shape->append( QLatin1Char( 'M' ) );
+
+    foreach( QString mime, filter.arguments( QContentFilter::MimeType ) )
+    {
+        shape->append( QLatin1Char( likeArgument( &mime ) ) );
+
+        values->append( mime );
+    }
+
+    shape->append( QLatin1Char( 'C' ) );
+
+    foreach( QString category, filter.arguments( QContentFilter::Category ) )
+    {
+        ArgumentForm form = categoryArgument( &category );
+
+        shape->append( QLatin1Char( form ) );
+
+        if( form != NullArgument )
+            values->append( category );
+    }
+
+    shape->append( QLatin1Char( 'S' ) );
+
+    foreach( QString synthetic, filter.arguments( QContentFilter::Synthetic ) )
+    {
+        QString value = synthetic.section( '/', 2 );
+
+        ArgumentForm form = syntheticArgument( &value );
+
+        shape->append( QLatin1Char( form ) );
+
+        values->append( synthetic.section( '/', 0, 0 ) );
+        values->append( synthetic.section( '/', 1, 1 ) );
+
+        if( form != NullArgument )
+            values->append( value );
+    }
+
+    shape->append( QLatin1Char( 'F' ) );
+
+    foreach( QString fileName, filter.arguments( QContentFilter::FileName ) )
+    {
+        shape->append( QLatin1Char( likeArgument( &fileName ) ) );
+
+        values->append( fileName );
+    }
+
+    shape->append( QLatin1Char( 'N' ) );
+
+    foreach( QString name, filter.arguments( QContentFilter::Name ) )
+    {
+        shape->append( QLatin1Char( likeArgument( &name ) ) );
+
+        values->append( name );
+    }
+
+    shape->append( QLatin1Char( 'P' ) );
+
+    foreach( QString drm, filter.arguments( QContentFilter::DRM ) )
+    {
+        ArgumentForm form = drmArgument( drm );
+
+        if( form != InvalidArgument )
+        {
+            shape->append( QLatin1Char( form ) );
+
+            values->append( QVariant( 65536 ) );
+        }
+    }
+
+    foreach( QContentFilter subFilter, filter.subFilters() )
+    {
+        shape->append( QLatin1Char( '(' ) );
+
+        filterShape( subFilter, shape, values );
+
+        shape->append( QLatin1Char( ')' ) );
+    }
+}
+
+/*!
+    Returns the from, where and order by clauses of a query for content matching \a filter sorted in the given
+    \a order, or unsorted if \a order is null.
 
-    QString where = buildWhereClause( filter, parameters, &insertAt, &joins );
-    QString order = buildOrderBy( sortOrder, parameters, &insertAt, &joins );
-    QString from = buildFrom( filter, joins );
+    The parameters that should be bound when executing the query are added to \a parameters, which must be empty.
 
-    return queryTemplate.arg( from ).arg( where );
+    Compiled queries are cached by the shape of the filter, so filters which differ only in their argument values
+    reuse the same SQL with different parameters.
+*/
+QSqlContentStore::QueryPlan QSqlContentStore::compileQuery( const QContentFilter &filter, const QContentSortCriteria *order, QList< Parameter > *parameters )
+{
+    Q_ASSERT( parameters->isEmpty() );
+
+    QString shape;
+    QVariantList values;
+
+    filterShape( filter, &shape, &values );
+
+    if( order )
+    {
+        shape += QLatin1Char( '#' );
+
+        for( int i = 0; i < order->sortCount(); i++ )
+        {
+            shape += QString( "%1,%2,%3:%4;" )
+                    .arg( order->attribute( i ) )
+                    .arg( order->order( i ) )
+                    .arg( order->scope( i ).length() )
+                    .arg( order->scope( i ) );
+        }
+    }
+
+    QueryPlan plan;
+
+    if( QueryPlan *cachedPlan = m_queryPlans.object( shape ) )
+    {
+        plan = *cachedPlan;
+    }
+    else
+    {
+        int insertAt = 0;
+        QStringList joins;
+
+        plan.where = buildWhereClause( filter, &plan.parameters, &insertAt, &joins );
+
+        if( order )
+            plan.orderBy = buildOrderBy( *order, &plan.parameters, &insertAt, &joins );
+
+        plan.from = buildFrom( filter, joins );
+
+        // Parameters are numbered in the order they were added, sorting them by name puts them in the
+        // same order as the filter values.
+        qSort( plan.parameters.begin(), plan.parameters.end(), parameterLessThan );
+
+        m_queryPlans.insert( shape, new QueryPlan( plan ) );
+    }
+
+    Q_ASSERT( values.count() <= plan.parameters.count() );
+
+    for( int i = 0; i < plan.parameters.count(); i++ )
+    {
+        if( i < values.count() )
+            parameters->append( Parameter( plan.parameters.at( i ).first, values.at( i ) ) );
+        else
+            parameters->append( plan.parameters.at( i ) );
+    }
+
+    return plan;
+}
+
+/*!
+    Returns a select query for \a queryString prepared against the database with the id \a dbId.
+
+    The system database is never detached so statements prepared against it are kept for reuse.  The query
+    should be finished once its results have been read so the statement doesn't hold a lock on the database.
+*/
+QSqlQuery QSqlContentStore::prepareSelect( QtopiaDatabaseId dbId, const QString &queryString )
+{
+    if( dbId == 0 )
+    {
+        QSqlQuery *cachedQuery = m_systemQueries.object( queryString );
+
+        if( cachedQuery && cachedQuery->driver() && cachedQuery->driver()->isOpen() )
+            return *cachedQuery;
+    }
+
+    QSqlQuery query( QtopiaSql::instance()->database( dbId ) );
+
+    if( query.prepare( queryString ) && dbId == 0 )
+        m_systemQueries.insert( queryString, new QSqlQuery( query ) );
+
+    return query;
 }
 
 /*!
@@ -2587,8 +3048,7 @@ QStringList QSqlContentStore::mimeFilterMatches( const QContentFilter &filter, c
 
     foreach( QtopiaDatabaseId dbId, QtopiaSql::instance()->databaseIds() )
     {
-        QSqlQuery query( QtopiaSql::instance()->database( dbId ) );
-        query.prepare( queryString );
+        QSqlQuery query = prepareSelect( dbId, queryString );
 
         bindParameters( &query, parameters );
 
@@ -2609,6 +3069,8 @@ QStringList QSqlContentStore::mimeFilterMatches( const QContentFilter &filter, c
             qLog(DocAPI) << "mimeFilterMatches query failed";
             qLog(DocAPI) << queryString;
         }
+
+        query.finish();
     }
 
     return QStringList( filters.values() );
@@ -2644,8 +3106,7 @@ QStringList QSqlContentStore::syntheticFilterGroups( const QContentFilter &filte
 
     foreach( QtopiaDatabaseId dbId, QtopiaSql::instance()->databaseIds() )
     {
-        QSqlQuery query( QtopiaSql::instance()->database( dbId ) );
-        query.prepare( queryString );
+        QSqlQuery query = prepareSelect( dbId, queryString );
 
         bindParameters( &query, parameters );
 
@@ -2666,6 +3127,8 @@ QStringList QSqlContentStore::syntheticFilterGroups( const QContentFilter &filte
             qLog(DocAPI) << "syntheticFilterMatches query failed";
             qLog(DocAPI) << queryString;
         }
+
+        query.finish();
     }
 
     return QStringList( groups.values() );
@@ -2767,8 +3230,7 @@ QStringList QSqlContentStore::syntheticFilterMatches( const QContentFilter &filt
 
     foreach( QtopiaDatabaseId dbId, QtopiaSql::instance()->databaseIds() )
     {
-        QSqlQuery query( QtopiaSql::instance()->database( dbId ) );
-        query.prepare( queryString );
+        QSqlQuery query = prepareSelect( dbId, queryString );
 
         bindParameters( &query, parameters );
 
@@ -2788,6 +3250,8 @@ QStringList QSqlContentStore::syntheticFilterMatches( const QContentFilter &filt
             qLog(DocAPI) << "syntheticFilterMatches query failed";
             qLog(DocAPI) << queryString;
         }
+
+        query.finish();
     }
 
     return QStringList( filters.values() );
@@ -2836,8 +3300,7 @@ QStringList QSqlContentStore::categoryFilterMatches( const QContentFilter &filte
 
     foreach( QtopiaDatabaseId dbId, QtopiaSql::instance()->databaseIds() )
     {
-        QSqlQuery query( QtopiaSql::instance()->database( dbId ) );
-        query.prepare( queryString );
+        QSqlQuery query = prepareSelect( dbId, queryString );
 
         bindParameters( &query, parameters );
 
@@ -2857,6 +3320,8 @@ QStringList QSqlContentStore::categoryFilterMatches( const QContentFilter &filte
             qLog(DocAPI) << "categoryFilterMatches query failed";
             qLog(DocAPI) << queryString;
         }
+
+        query.finish();
     }
 
     return QStringList( filters.values() );
@@ -33,6 +33,8 @@
 #include "qcontentstore_p.h"
 #include <QtopiaSql>
 #include <QCache>
+#include <QHash>
+#include <QSet>
 
 class QSqlRecord;
 class QSqlError;
@@ -93,9 +95,38 @@ public:
 private:
     typedef QPair< QString, QVariant > Parameter;
 
+    class Batch
+    {
+    public:
+        Batch( QSqlContentStore *store ) : m_store( store ), m_ended( false ) { m_store->beginBatch(); }
+        ~Batch() { if( !m_ended ) m_store->endBatch(); }
+
+        bool end() { m_ended = true; return m_store->endBatch(); }
+
+    private:
+        QSqlContentStore *m_store;
+        bool m_ended;
+    };
+    friend class Batch;
+
+    struct PendingRows
+    {
+        QVariantList categories;
+        QVariantList properties;
+    };
+
+    void beginBatch();
+    bool endBatch();
+
+    QSqlQuery *preparedQuery( QtopiaDatabaseId dbId, const QString &queryString );
+
+    bool insertRows( QtopiaDatabaseId dbId, const QString &table, const QString &columns, int columnCount, const QVariantList &values );
+    bool flushPendingRows( QtopiaDatabaseId dbId );
+
     QContentEngine *installContent( QContent *content );
     QContentEngine *refreshContent( QContent *content );
 
+    bool commitBatchedContent( QContent *content );
     bool insertContent( QContentEngine *engine, QtopiaDatabaseId dbId );
     bool updateContent( QContentEngine *engine );
 
@@ -144,6 +175,18 @@ private:
     QString buildNames( const QStringList &names, const QString &conjunct, QList< Parameter > *parameters );
     QString buildOrderBy( const QContentSortCriteria &, QList< Parameter > *, int *, QStringList * );
 
+    struct QueryPlan
+    {
+        QString from;
+        QString where;
+        QString orderBy;
+        QList< Parameter > parameters;
+    };
+
+    void filterShape( const QContentFilter &filter, QString *shape, QVariantList *values );
+    QueryPlan compileQuery( const QContentFilter &filter, const QContentSortCriteria *order, QList< Parameter > *parameters );
+    QSqlQuery prepareSelect( QtopiaDatabaseId dbId, const QString &queryString );
+
     QString buildQuery( const QString &queryTemplate, const QContentFilter &filter, QList< Parameter > *parameters );
     QString buildQuery( const QString &queryTemplate, const QContentFilter &filter, const QContentSortCriteria &sortOrder, QList< Parameter > *parameters );
     void bindParameters( QSqlQuery *query, const QList< Parameter > &parameters );
@@ -161,6 +204,14 @@ private:
     QStringList directoryFilterMatches( const QContentFilter &filter, const QString &directory );
 
     QString deriveName( const QString &fileName, const QMimeType &type ) const;
+
+    QHash< QPair< QtopiaDatabaseId, QString >, QSqlQuery * > m_preparedQueries;
+    QHash< QtopiaDatabaseId, PendingRows > m_pendingRows;
+    QSet< QPair< QtopiaDatabaseId, QString > > m_syncedCategories;
+    int m_batchDepth;
+
+    QCache< QString, QueryPlan > m_queryPlans;
+    QCache< QString, QSqlQuery > m_systemQueries;
 };
 
 #endif
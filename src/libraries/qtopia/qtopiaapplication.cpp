@@ -49,6 +49,10 @@
 #include <QTextCursor>
 #include <qtopiaipcenvelope.h>
 #include <qtopiaservices.h>
+#include <private/qcopjournal_p.h>
+#include <private/qtopiaipcmarshal_p.h>
+#include <qperformancelog.h>
+#include "qperformancelog_p.h"
 #ifdef Q_WS_QWS
 #include <qwindowsystem_qws.h>
 #endif
@@ -85,6 +89,7 @@
 #include <QDateTimeEdit>
 #ifdef Q_WS_QWS
 #include <qwsdisplay_qws.h>
+#include <qwsevent_qws.h>
 #endif
 #include <qtopiaapplication.h>
 #include "qtopiaresource_p.h"
@@ -1686,46 +1691,10 @@ void QtopiaApplication::unregisterRunningTask(QObject *taskObj)
 
 void QtopiaApplication::processQCopFile()
 {
-    QString qcopfn = d->appName;
-    qcopfn.prepend( Qtopia::tempDir() + "qcop-msg-" );
-    QFile qcopfile(qcopfn);
-
-    if ( qcopfile.open(QIODevice::ReadWrite) ) {
-#ifdef QTOPIA_POSIX_LOCKS
-        struct flock fl;
-        fl.l_type = F_WRLCK;
-        fl.l_whence = SEEK_SET;
-        fl.l_start = 0;
-        fl.l_len = 0;
-        fl.l_pid = getpid();
-        if (fcntl(qcopfile.handle(), F_SETLKW, &fl) == -1) {
-            qWarning("Could not acquire lock: %d %s", errno, strerror(errno));
-        }
-#else
-        if (flock(qcopfile.handle(), LOCK_EX) == -1) {
-            qWarning("Could not acquire lock: %d %s", errno, strerror(errno));
-        }
-#endif
-        QDataStream ds( &qcopfile );
-        QString channel, message;
-        QByteArray data;
-        while(!ds.atEnd()) {
-            ds >> channel >> message >> data;
-            d->enqueueQCop(channel,message,data);
-        }
-        Qtopia::truncateFile(qcopfile, 0);
-        qcopfile.flush();
-#ifdef QTOPIA_POSIX_LOCKS
-        fl.l_type = F_UNLCK;
-        if (fcntl(qcopfile.handle(), F_SETLK, &fl) == -1) {
-            qWarning("Could not release lock: %d %s", errno, strerror(errno));
-        }
-#else
-        if (flock(qcopfile.handle(), LOCK_UN) == -1) {
-            qWarning("Could not release lock: %d %s", errno, strerror(errno));
-        }
-#endif
-    }
+    QCopJournal journal(d->appName);
+
+    foreach (const QCopJournal::Message &message, journal.takeMessages())
+        d->enqueueQCop(message.channel, message.message, message.data);
 }
 
 /*!
@@ -1891,7 +1860,9 @@ void QtopiaApplication::init(int argc, char **argv, Type t)
     qms << QLatin1String("libqtopia");
     qms << QLatin1String("libqtopiacomm");
 
+    QPerformanceLog() << QPerformanceLog::Begin << QPerformanceLog::Translations;
     loadTranslations(qms);
+    QPerformanceLog() << QPerformanceLog::End << QPerformanceLog::Translations;
 #endif
 
 #ifndef QTOPIA_HOST
@@ -1922,6 +1893,11 @@ void QtopiaApplication::initApp( int argc, char **argv )
     qApp->setApplicationName(d->appName);
     QtopiaMessageHandler::reloadApplicationName();
 
+    if(type() != GuiServer) {
+        qtopia_beginLaunchTrace();
+        QPerformanceLog() << QPerformanceLog::End << QPerformanceLog::ProcessStart;
+    }
+
     if(type() != GuiServer) {
         if(d->lifeCycle) {
             d->lifeCycle->reinit();
@@ -1939,7 +1915,9 @@ void QtopiaApplication::initApp( int argc, char **argv )
     //enforce update of image and sound dirs when started by quicklauncher
     d->fileengine->setIconPath( QStringList() );
 
+    QPerformanceLog() << QPerformanceLog::Begin << QPerformanceLog::Translations;
     loadTranslations(QStringList()<<channel);
+    QPerformanceLog() << QPerformanceLog::End << QPerformanceLog::Translations;
 
 #ifdef Q_WS_QWS
     qt_fbdpy->setIdentity( channel ); // In E 2.3.6
@@ -2333,6 +2311,25 @@ bool QtopiaApplication::qwsEventFilter( QWSEvent *e )
             if ( m == AlwaysOn )
                 QtopiaApplication::showInputMethod();
         }
+#ifndef QT_NO_COP
+    } else if ( e->type == QWSEvent::QCopMessage ) {
+        // Only QtopiaIpcAdaptor understands compact encoded arguments, so
+        // messages on channels no adaptor is listening on are converted back
+        // before a plain QCopChannel receiver sees them.
+        QWSQCopMessageEvent *qe = static_cast<QWSQCopMessageEvent *>( e );
+        QString msg = QString::fromLatin1( qe->message );
+        if ( qtopia_isCompactMessage( msg ) &&
+             !qtopia_isAdaptorChannel( QString::fromLatin1( qe->channel ) ) ) {
+            QString message;
+            QByteArray data;
+            if ( qtopia_compactToStandard( msg, qe->data, &message, &data ) ) {
+                qe->message = message.toLatin1();
+                qe->data = data;
+            } else {
+                qWarning() << "QtopiaApplication: could not decode the arguments of" << msg;
+            }
+        }
+#endif
     }
 
     return QApplication::qwsEventFilter( e );
@@ -3132,6 +3129,23 @@ void WeekStartsOnMondayUpdater::updateCalendarWidget(bool monday)
         cw->setFirstDayOfWeek(monday ? Qt::Monday : Qt::Sunday);
 }
 
+/*
+    Sends the performance events recorded since the application was
+    initialized to the server, which merges them into its launch timeline.
+*/
+static void reportLaunchTrace()
+{
+    QPerformanceLog() << QPerformanceLog::FirstPaint;
+
+    QList<int> times;
+    QStringList events;
+    qtopia_takeLaunchTrace( &times, &events );
+
+    QtopiaIpcEnvelope env( QLatin1String("QPE/QtopiaApplication"),
+                           QLatin1String("launchTrace(QString,int,QList<int>,QStringList)") );
+    env << QtopiaApplication::applicationName() << ::getpid() << times << events;
+}
+
 /*!
   \reimp
 */
@@ -3142,6 +3156,9 @@ bool QtopiaApplication::eventFilter( QObject *o, QEvent *e )
     QWidget* w = static_cast<QWidget*>(o);
 
     QEvent::Type type = e->type();
+    if ( type == QEvent::Paint && w->isWindow() && qtopia_launchTraceActive() )
+        reportLaunchTrace();
+
 #ifdef QT_NO_QWS_CURSOR
     if ( type == QEvent::ToolTip )
         // if we have no cursor, probably don't want tooltips
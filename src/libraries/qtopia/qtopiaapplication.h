@@ -221,6 +221,7 @@ private:
 */
 #include <qmap.h>
 #include <qapplicationplugin.h>
+#include <qperformancelog.h>
 #include <qmetaobject.h>
 
 // helper types/functions
@@ -325,10 +326,12 @@ extern void qtopia_registerMain(const char *name, qpeMainFunc mainFunc);
         QtopiaApplication a( argc, argv ); \
         QTOPIA_SET_DOCUMENT_SYSTEM_CONNECTION(); \
         QWidget *mw = 0; \
+        QPerformanceLog() << QPerformanceLog::Begin << QPerformanceLog::MainWindow; \
         if ( qpeAppMap()->contains(executableName) ) \
             mw = (*qpeAppMap())[executableName](0,0); \
         else if ( qpeAppMap()->count() ) \
             mw = qpeAppMap()->begin().value()(0,0); \
+        QPerformanceLog() << QPerformanceLog::End << QPerformanceLog::MainWindow; \
         if ( mw ) { \
             int rv = 0; \
             a.setMainWidget(mw); \
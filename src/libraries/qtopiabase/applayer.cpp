@@ -26,7 +26,9 @@
 #include <sys/shm.h>
 #include <sys/sem.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <QSet>
+#include <QVector>
 #include "qsystemlock.h"
 #include <sys/types.h>
 #include <unistd.h>
@@ -50,6 +52,8 @@
 #include "qpacketprotocol.h"
 #include <QMutex>
 #include <QWaitCondition>
+#include <QVarLengthArray>
+#include <QAtomicInt>
 #include <qtopialog.h>
 
 #define VERSION_TABLE_ENTRIES 8191
@@ -57,10 +61,17 @@
 
 #define MAX_PATH_SIZE 16384
 #define MAX_DATA_SIZE 16384
-#define INVALID_HANDLE 0xFFFF
+#define INVALID_HANDLE 0xFFFFFFFF
+
+// Space kept free in the layer, on top of that needed for the largest
+// possible write, before it is moved to a larger segment
+#define APPLAYER_HEADROOM 4096
 
 #define ALIGN4b(n) ((n) + (((n) % 4)?(4 - ((n) % 4)):0))
 
+// Number of times an unlocked read is retried before falling back to the lock
+#define LOCKLESS_READ_ATTEMPTS 4
+
 // #define QVALUESPACE_UPDATE_STATS
 
 static inline QDataStream& operator<<(QDataStream& stream, unsigned long v)
@@ -88,6 +99,16 @@ static inline QDataStream& operator>>(QDataStream& stream, unsigned long& v)
     return stream;
 }
 
+static inline void vsMemoryBarrier()
+{
+#if defined(Q_CC_GNU)
+    __sync_synchronize();
+#else
+    static QAtomicInt barrier(0);
+    barrier.fetchAndAddOrdered(0);
+#endif
+}
+
 static int vsmemcmp(const char * s1, int l1, const char * s2, int l2)
 {
     if(l1 < l2)
@@ -115,10 +136,30 @@ struct VersionTable {
 
     unsigned int nxtFreeBlk;
     unsigned int nextCreationId;
-
-    Entry entries[VERSION_TABLE_ENTRIES];
+    /* Incremented before and after each modification of the tree, so it is
+       odd while a write is in progress.  Lets readers detect that the tree
+       changed underneath them without taking the lock. */
+    unsigned int sequence;
+
+    /* Number of entries in the table, and how many of those are in use */
+    unsigned int entryCount;
+    unsigned int usedEntries;
+
+    /* The tree is moved to a new segment when it fills up or is mostly
+       empty.  generation counts these moves and is also updated in the
+       segment being left, so that clients notice they need to follow.  In
+       the segment created at startup, shmId and shmSize identify the segment
+       currently in use. */
+    unsigned int generation;
+    int shmId;
+    unsigned int shmSize;
+
+    Entry entries[0];
 };
 
+#define VERSION_TABLE_SIZE(entries) \
+    (sizeof(VersionTable) + (entries) * sizeof(VersionTable::Entry))
+
 
 // declare NodeOwner
 /*
@@ -184,10 +225,10 @@ struct NodeWatch {
    With multiple watch:
        <Node (watchCount >= 2)><char [] name><Rest of node...><unsigned int nodeWatchPtr>
 
-   Overhead: 16 bytes + name size
+   Overhead: 24 bytes + name size
  */
 struct Node {
-    unsigned short parent;    /* Id for my parent */
+    unsigned int parent;    /* Id for my parent */
     unsigned int creationId;  /* Unique id set when I was constructed */
 
     unsigned short subNodes;  /* Sub node count */
@@ -291,15 +332,33 @@ class FixedMemoryTree : public QObject
     Q_OBJECT
 public:
     FixedMemoryTree(void * mem, unsigned int size, bool initMem);
+    FixedMemoryTree(void * mem, unsigned int size, unsigned int entries,
+                    FixedMemoryTree * from);
+    virtual ~FixedMemoryTree();
+
+    inline unsigned int entryCount();
+    inline unsigned int generation();
+    inline bool isStale();
+    void setStale(unsigned int newGeneration);
+    inline bool isComplete();
+    bool hasSpace(unsigned int bytes, unsigned int nodes);
 
     // Returns the closest node to the specified path
-    unsigned short findClosest(const char * path,
-                               const char ** matched);
-    unsigned short findClosest(unsigned int from,
-                               const char * subPath,
-                               const char ** matched);
+    unsigned int findClosest(const char * path,
+                             const char ** matched);
+    unsigned int findClosest(unsigned int from,
+                             const char * subPath,
+                             const char ** matched);
+
+    NodeDatum * data(unsigned int node);
+
+    enum ReadResult { ReadOk, ReadNoData, ReadStale, ReadBusy };
+    typedef QVarLengthArray<quint64, 8> DatumBuffer;
+    ReadResult readData(unsigned int node, unsigned int creationId,
+                        DatumBuffer *buffer);
 
-    NodeDatum * data(unsigned short node);
+    inline void beginWrite();
+    inline void endWrite();
 
     bool addWatch(const char * path, NodeWatch owner);
     bool remWatch(const char * path, NodeWatch owner);
@@ -310,20 +369,20 @@ public:
                 unsigned int dataLen,
                 NodeOwner owner);
 
-    unsigned short offsetOfSubNode(unsigned short node,
-                                   unsigned short subNode);
+    unsigned int offsetOfSubNode(unsigned int node,
+                                 unsigned int subNode);
 
     bool remove(const char * path, NodeOwner owner);
 
     inline Node * getNode(unsigned int);
-    inline Node * subNode(unsigned int, unsigned short);
+    inline Node * subNode(unsigned int, unsigned int);
     inline unsigned int version(unsigned int);
 
     inline void * fromPtr(unsigned int ptr);
 
     inline QMallocPool *mallocPool() const { return pool; }
 
-    typedef void (*NodeChangeFunction)(unsigned short node, void *ctxt);
+    typedef void (*NodeChangeFunction)(unsigned int node, void *ctxt);
     void setNodeChangeFunction(NodeChangeFunction, void *);
 
 private:
@@ -331,50 +390,59 @@ private:
     static unsigned int shrunkListSize(unsigned int currentSize,
                                        unsigned int toSize);
 
-    bool setWatch(unsigned short node, NodeWatch owner);
-    bool remWatch(unsigned short node, NodeWatch owner);
-    bool setData(unsigned short node, NodeOwner owner,
+    bool setWatch(unsigned int node, NodeWatch owner);
+    bool remWatch(unsigned int node, NodeWatch owner);
+    bool setData(unsigned int node, NodeOwner owner,
                  NodeDatum::Type type,  const char * data,
                  unsigned int dataLen);
 
-    void removeFrom(unsigned short from, unsigned short subNodeNumber);
+    void removeFrom(unsigned int from, unsigned int subNodeNumber);
+    void freeNode(unsigned int node);
 
-    unsigned short findRecur(unsigned short node, const char * path,
-                             const char ** consumed);
+    void initTable(unsigned int entries);
+    bool copyNode(FixedMemoryTree * from, unsigned int node);
 
-    bool insertRecur(unsigned short node, const char * path,
+    unsigned int findRecur(unsigned int node, const char * path,
+                           const char ** consumed);
+
+    bool insertRecur(unsigned int node, const char * path,
                      NodeDatum::Type type, const char * data,
                      unsigned int dataLen, NodeOwner owner);
 
-    bool addWatchRecur(unsigned short node, const char * path,
+    bool addWatchRecur(unsigned int node, const char * path,
                        NodeWatch owner);
 
-    bool remWatchRecur(unsigned short node, const char * path,
+    bool remWatchRecur(unsigned int node, const char * path,
                        NodeWatch owner);
-    bool removeRecur(unsigned short node, const char * path,
+    bool removeRecur(unsigned int node, const char * path,
                      NodeOwner owner);
-    unsigned short removeRecur(unsigned short, NodeOwner owner);
+    unsigned int removeRecur(unsigned int, NodeOwner owner);
 
     unsigned int locateInNode(Node * node, const char * name,
                               unsigned int len, bool * match);
 
     inline unsigned int ptr(void * mem);
+    inline bool inPool(unsigned int ptr, unsigned int len) const;
     inline VersionTable * versionTable();
-    inline void bump(unsigned short node);
+    inline void bump(unsigned int node);
 
-    unsigned short newNode(const char * name, unsigned int len,
-                           NodeWatch owner);
-    unsigned short newNode(const char * name,
-                           unsigned int len,
-                           NodeOwner owner = INVALID_OWNER,
-                           NodeDatum::Type type = (NodeDatum::Type)0,
-                           const char * data = 0,
-                           unsigned int dataLen = 0);
+    unsigned int newNode(const char * name, unsigned int len,
+                         NodeWatch owner);
+    unsigned int newNode(const char * name,
+                         unsigned int len,
+                         NodeOwner owner = INVALID_OWNER,
+                         NodeDatum::Type type = (NodeDatum::Type)0,
+                         const char * data = 0,
+                         unsigned int dataLen = 0);
 
     inline Node * node(unsigned int);
 
     char * poolMem;
+    unsigned int poolSize;
+    unsigned int tableSize;
+    unsigned int treeGeneration;
     QMallocPool * pool;
+    bool complete;
     bool changed;
     NodeChangeFunction changeFunc;
     void * changeFuncContext;
@@ -385,7 +453,8 @@ private:
 ///////////////////////////////////////////////////////////////////////////////
 FixedMemoryTree::FixedMemoryTree(void * mem, unsigned int size,
                                  bool initMemory )
-: poolMem((char *)mem), pool(0), changed(false), changeFunc(0)
+: poolMem((char *)mem), poolSize(size), tableSize(0), treeGeneration(0),
+  pool(0), complete(true), changed(false), changeFunc(0)
 {
     Q_ASSERT(size);
     Q_ASSERT(poolMem);
@@ -394,17 +463,11 @@ FixedMemoryTree::FixedMemoryTree(void * mem, unsigned int size,
         /* Initialize layer version table - would be worth randomizing the
            nextFreeBlk chain to distribute entries across the 128-bit change
            notification. */
-        ::bzero(poolMem, sizeof(VersionTable));
+        initTable(VERSION_TABLE_ENTRIES);
         for(int ii = 0; ii < VERSION_TABLE_ENTRIES; ++ii)
             versionTable()->entries[ii].nxtFreeBlk =
                 (ii + 1) % VERSION_TABLE_ENTRIES;
 
-        /* Create malloc pool on the non-version table portion of the layer */
-        pool =
-            new QMallocPool(poolMem + sizeof(VersionTable),
-                            size - sizeof(VersionTable),
-                            QMallocPool::Owned, "FixedMemoryTree");
-
         /* Create root node and fixup free block pointer */
         versionTable()->nxtFreeBlk =
             versionTable()->entries[ROOT_VERSION_ENTRY].nxtFreeBlk;
@@ -415,11 +478,210 @@ FixedMemoryTree::FixedMemoryTree(void * mem, unsigned int size,
         Q_ASSERT((char *)root > poolMem);
         versionTable()->entries[ROOT_VERSION_ENTRY] =
             VersionTable::Entry(1, ptr(root));
+        versionTable()->usedEntries = 1;
+    }
+
+    tableSize = VERSION_TABLE_SIZE(versionTable()->entryCount);
+    treeGeneration = versionTable()->generation;
+}
+
+/*!
+  Creates a compacted copy of the tree \a from in \a mem, which is \a size
+  bytes long, with room for \a entries nodes.  Nodes keep their ids, versions
+  and creation ids so that handles to nodes in \a from remain valid.  The copy
+  is one generation newer than \a from.
+
+  If the table or the nodes of \a from do not fit in \a size bytes, the copy
+  is abandoned and isComplete() returns false.
+ */
+FixedMemoryTree::FixedMemoryTree(void * mem, unsigned int size,
+                                 unsigned int entries, FixedMemoryTree * from)
+: poolMem((char *)mem), poolSize(size), tableSize(0), treeGeneration(0),
+  pool(0), complete(true), changed(false), changeFunc(0)
+{
+    Q_ASSERT(size);
+    Q_ASSERT(poolMem);
+    Q_ASSERT(from);
+    Q_ASSERT(entries >= from->entryCount());
+
+    if(VERSION_TABLE_SIZE(entries) >= size) {
+        complete = false;
+        return;
+    }
+
+    initTable(entries);
+    tableSize = VERSION_TABLE_SIZE(entries);
+
+    VersionTable * const table = versionTable();
+    VersionTable * const fromTable = from->versionTable();
+    table->nextCreationId = fromTable->nextCreationId;
+    table->generation = fromTable->generation + 1;
+    treeGeneration = table->generation;
+
+    // Nodes are copied depth first, which also places them in the pool
+    // roughly in the order they are searched
+    if(!copyNode(from, ROOT_VERSION_ENTRY)) {
+        complete = false;
+        return;
+    }
+
+    // Chain the unused entries together, keeping the versions of entries
+    // freed in the old tree
+    unsigned int * nextFree = &table->nxtFreeBlk;
+    for(unsigned int ii = ROOT_VERSION_ENTRY + 1; ii < entries; ++ii) {
+        if(table->entries[ii].nodePtr)
+            continue;
+        if(ii < fromTable->entryCount)
+            table->entries[ii].version = fromTable->entries[ii].version;
+        *nextFree = ii;
+        nextFree = &table->entries[ii].nxtFreeBlk;
     }
+    *nextFree = 0;
 }
 
-unsigned short FixedMemoryTree::findClosest(const char * path,
-                                            const char ** matched)
+FixedMemoryTree::~FixedMemoryTree()
+{
+    delete pool;
+}
+
+/*!
+  Clears a version table of \a entries entries and creates the malloc pool
+  on the rest of the layer.
+ */
+void FixedMemoryTree::initTable(unsigned int entries)
+{
+    Q_ASSERT(VERSION_TABLE_SIZE(entries) < poolSize);
+
+    ::bzero(poolMem, VERSION_TABLE_SIZE(entries));
+    versionTable()->entryCount = entries;
+
+    /* Create malloc pool on the non-version table portion of the layer */
+    pool =
+        new QMallocPool(poolMem + VERSION_TABLE_SIZE(entries),
+                        poolSize - VERSION_TABLE_SIZE(entries),
+                        QMallocPool::Owned, "FixedMemoryTree");
+}
+
+/*!
+  Copies \a node, including its data, watches and all of its sub nodes, from
+  \a from into this tree.  Returns false if the pool ran out of space.
+ */
+bool FixedMemoryTree::copyNode(FixedMemoryTree * from, unsigned int node)
+{
+    Node * const source = from->node(node);
+    Node * const me = (Node *)pool->malloc(source->size());
+    if(!me)
+        return false;
+    ::memcpy(me, source, source->size());
+    versionTable()->entries[node] =
+        VersionTable::Entry(from->version(node), ptr(me));
+    ++versionTable()->usedEntries;
+
+    if(me->dataCount >= 2) {
+        unsigned int * const sourceList =
+            (unsigned int *)from->fromPtr(*(unsigned int *)source->dataBegin());
+        unsigned int * const list =
+            (unsigned int *)pool->malloc(me->dataCount * sizeof(unsigned int));
+        if(!list)
+            return false;
+        for(int ii = 0; ii < me->dataCount; ++ii) {
+            NodeDatum * const datum = (NodeDatum *)from->fromPtr(sourceList[ii]);
+            NodeDatum * const copy =
+                (NodeDatum *)pool->malloc(sizeof(NodeDatum) + datum->len);
+            if(!copy)
+                return false;
+            ::memcpy(copy, datum, sizeof(NodeDatum) + datum->len);
+            list[ii] = ptr(copy);
+        }
+        *(unsigned int *)me->dataBegin() = ptr(list);
+    }
+
+    if(me->watchCount >= 2) {
+        NodeWatch * const sourceList =
+            (NodeWatch *)from->fromPtr(*(unsigned int *)source->watchBegin());
+        NodeWatch * const list =
+            (NodeWatch *)pool->malloc(me->watchCount * sizeof(NodeWatch));
+        if(!list)
+            return false;
+        ::memcpy(list, sourceList, me->watchCount * sizeof(NodeWatch));
+        *(unsigned int *)me->watchBegin() = ptr(list);
+    }
+
+    me->subNodePtr = 0;
+    if(me->subNodes) {
+        unsigned int * const sourceSubNodes =
+            (unsigned int *)from->fromPtr(source->subNodePtr);
+        unsigned int * const subNodes =
+            (unsigned int *)pool->malloc(me->subNodes * sizeof(unsigned int));
+        if(!subNodes)
+            return false;
+        ::memcpy(subNodes, sourceSubNodes, me->subNodes * sizeof(unsigned int));
+        me->subNodePtr = ptr(subNodes);
+
+        for(unsigned int ii = 0; ii < me->subNodes; ++ii)
+            if(!copyNode(from, subNodes[ii]))
+                return false;
+    }
+
+    return true;
+}
+
+/*! Returns the number of nodes the tree has room for */
+unsigned int FixedMemoryTree::entryCount()
+{
+    return versionTable()->entryCount;
+}
+
+/*! Returns the generation of the tree when it was attached */
+unsigned int FixedMemoryTree::generation()
+{
+    return treeGeneration;
+}
+
+/*!
+  Returns true if the tree has since been moved to another segment.  A stale
+  tree remains readable, but is no longer updated.
+ */
+bool FixedMemoryTree::isStale()
+{
+    return versionTable()->generation != treeGeneration;
+}
+
+/*! Marks the tree as replaced by the tree of generation \a newGeneration */
+void FixedMemoryTree::setStale(unsigned int newGeneration)
+{
+    beginWrite();
+    versionTable()->generation = newGeneration;
+    endWrite();
+}
+
+/*!
+  Returns false if the tree was created as a copy that did not fit in its
+  segment.  An incomplete tree must not be used.
+ */
+bool FixedMemoryTree::isComplete()
+{
+    return complete;
+}
+
+/*!
+  Returns true if \a nodes nodes and \a bytes bytes of data can be added to
+  the tree without exhausting either the version table or the pool.
+ */
+bool FixedMemoryTree::hasSpace(unsigned int bytes, unsigned int nodes)
+{
+    Q_ASSERT(pool);
+    VersionTable * const table = versionTable();
+    if(table->usedEntries + nodes >= table->entryCount)
+        return false;
+
+    QMallocPool::MemoryStats stats = pool->memoryStatistics();
+    unsigned long available = poolSize - tableSize - stats.inuseBytes;
+    return available > 2 * bytes + APPLAYER_HEADROOM;
+}
+
+unsigned int FixedMemoryTree::findClosest(const char * path,
+                                          const char ** matched)
 {
     Q_ASSERT(path);
     Q_ASSERT(matched);
@@ -433,9 +695,9 @@ unsigned short FixedMemoryTree::findClosest(const char * path,
         return findRecur(ROOT_VERSION_ENTRY, path, matched);
 }
 
-unsigned short FixedMemoryTree::findClosest(unsigned int from,
-                                            const char * subPath,
-                                            const char ** matched)
+unsigned int FixedMemoryTree::findClosest(unsigned int from,
+                                          const char * subPath,
+                                          const char ** matched)
 {
     Q_ASSERT(subPath);
     Q_ASSERT(matched);
@@ -451,7 +713,7 @@ unsigned short FixedMemoryTree::findClosest(unsigned int from,
 /*!
   Returns the default datum for \a node, or NULL if one doesn't exist.
   */
-NodeDatum * FixedMemoryTree::data(unsigned short node)
+NodeDatum * FixedMemoryTree::data(unsigned int node)
 {
     Node * n = this->node(node);
     if(0 == n->dataCount) {
@@ -465,6 +727,88 @@ NodeDatum * FixedMemoryTree::data(unsigned short node)
     }
 }
 
+/*!
+  Copies the datum of \a node into \a buffer without requiring the layer to be
+  locked.  As the server may be modifying the tree concurrently, every offset
+  read is bounds checked and the copy is only trusted if the sequence number
+  did not change while it was taken.
+
+  Returns ReadStale if \a node no longer has the creation id \a creationId.
+  Returns ReadBusy if no consistent copy could be taken, in which case the
+  caller should lock the layer and read it with data() instead.
+ */
+FixedMemoryTree::ReadResult
+FixedMemoryTree::readData(unsigned int node, unsigned int creationId,
+                          DatumBuffer *buffer)
+{
+    Q_ASSERT(buffer);
+    if(node >= versionTable()->entryCount)
+        return ReadStale;
+
+    volatile unsigned int * const sequence = &versionTable()->sequence;
+    for(int attempt = 0; attempt < LOCKLESS_READ_ATTEMPTS; ++attempt) {
+        unsigned int seq = *sequence;
+        vsMemoryBarrier();
+        if(seq & 1)
+            continue;
+        if(isStale())
+            return ReadBusy;
+
+        ReadResult rv = ReadBusy;
+        unsigned int nodePtr = versionTable()->entries[node].nodePtr;
+        Node * n = (Node *)fromPtr(nodePtr);
+        if(!inPool(nodePtr, sizeof(Node)) || n->creationId != creationId) {
+            rv = ReadStale;
+        } else if(0 == n->dataCount) {
+            rv = ReadNoData;
+        } else {
+            unsigned int datumPtr = nodePtr + sizeof(Node) + ALIGN4b(n->nameLen);
+            if(n->dataCount >= 2) {
+                // Multiple data node - follow the data list to the first datum
+                unsigned int listPtr = 0;
+                if(inPool(datumPtr, sizeof(unsigned int)))
+                    listPtr = *(unsigned int *)fromPtr(datumPtr);
+                datumPtr = 0;
+                if(inPool(listPtr, sizeof(unsigned int)))
+                    datumPtr = *(unsigned int *)fromPtr(listPtr);
+            }
+
+            if(inPool(datumPtr, sizeof(NodeDatum))) {
+                NodeDatum * datum = (NodeDatum *)fromPtr(datumPtr);
+                unsigned int len = sizeof(NodeDatum) + datum->len;
+                if(inPool(datumPtr, len)) {
+                    buffer->resize((len + sizeof(quint64) - 1) / sizeof(quint64));
+                    ::memcpy(buffer->data(), datum, len);
+                    rv = ReadOk;
+                }
+            }
+        }
+
+        vsMemoryBarrier();
+        if(ReadBusy != rv && *sequence == seq)
+            return rv;
+    }
+
+    return ReadBusy;
+}
+
+/*!
+  Marks the start of a modification to the tree.  Must be called with the
+  layer locked for writing, and be followed by endWrite() before unlocking.
+ */
+void FixedMemoryTree::beginWrite()
+{
+    ++(versionTable()->sequence);
+    vsMemoryBarrier();
+}
+
+/*! Marks the end of a modification started with beginWrite() */
+void FixedMemoryTree::endWrite()
+{
+    vsMemoryBarrier();
+    ++(versionTable()->sequence);
+}
+
 /*!
   Inserts a watch for \a owner at the specified \a path
 */
@@ -494,7 +838,7 @@ bool FixedMemoryTree::remWatch(const char * path, NodeWatch owner)
     ++path; // Skip initial '/'
 
     if(*path == '\0')
-        return remWatch((unsigned short)ROOT_VERSION_ENTRY, owner);
+        return remWatch((unsigned int)ROOT_VERSION_ENTRY, owner);
     else
         return remWatchRecur(ROOT_VERSION_ENTRY, path, owner);
 }
@@ -527,16 +871,16 @@ bool FixedMemoryTree::insert(const char * path, NodeDatum::Type type,
   Returns the linear offset of \a subNode within \a node.  Asserts if not
   found.
  */
-unsigned short FixedMemoryTree::offsetOfSubNode(unsigned short node,
-                                                unsigned short subNode)
+unsigned int FixedMemoryTree::offsetOfSubNode(unsigned int node,
+                                              unsigned int subNode)
 {
     Node * me = getNode(node);
     if(!me)
         return INVALID_HANDLE;
 
-    unsigned short * const subNodes =
-        (unsigned short *)fromPtr(me->subNodePtr);
-    for(unsigned short ii = 0; ii < me->subNodes; ++ii) {
+    unsigned int * const subNodes =
+        (unsigned int *)fromPtr(me->subNodePtr);
+    for(unsigned int ii = 0; ii < me->subNodes; ++ii) {
         if(subNodes[ii] == subNode)
             return ii;
     }
@@ -616,8 +960,8 @@ unsigned int FixedMemoryTree::locateInNode(Node * node, const char * name,
     // This is a linear search.  It would be possible to replace this with a 
     // binary search, which may or may not improve performance depending on the
     // number of sub nodes.
-    unsigned short counter = 0;
-    unsigned short * subNodes = (unsigned short *)fromPtr(node->subNodePtr);
+    unsigned int counter = 0;
+    unsigned int * subNodes = (unsigned int *)fromPtr(node->subNodePtr);
 
     *match = false;
     for(counter = 0; counter < node->subNodes; ++counter) {
@@ -642,9 +986,9 @@ unsigned int FixedMemoryTree::locateInNode(Node * node, const char * name,
   \internal
   Recursive implementation of FixedMemoryTree::findClosest
  */
-unsigned short FixedMemoryTree::findRecur(unsigned short node,
-                                          const char * path,
-                                          const char ** consumed)
+unsigned int FixedMemoryTree::findRecur(unsigned int node,
+                                        const char * path,
+                                        const char ** consumed)
 {
     // Locate end of section
     const char * endOfSection = path;
@@ -662,8 +1006,8 @@ unsigned short FixedMemoryTree::findRecur(unsigned short node,
         return node;
     }
 
-    unsigned short * const subNodes =
-        (unsigned short *)fromPtr(me->subNodePtr);
+    unsigned int * const subNodes =
+        (unsigned int *)fromPtr(me->subNodePtr);
     if('\0' == *endOfSection) {
         *consumed = NULL;
         return subNodes[matchId];
@@ -679,22 +1023,22 @@ unsigned short FixedMemoryTree::findRecur(unsigned short node,
     be used by the parent to determine whether to increment the version
     number and whether to remove the sub node.
     */
-unsigned short FixedMemoryTree::removeRecur(unsigned short node,
-                                            NodeOwner owner)
+unsigned int FixedMemoryTree::removeRecur(unsigned int node,
+                                          NodeOwner owner)
 {
     Node * me = this->node(node);
 
-    unsigned short * const subNodes =
-        (unsigned short*)fromPtr(me->subNodePtr);
+    unsigned int * const subNodes =
+        (unsigned int *)fromPtr(me->subNodePtr);
 
-    unsigned short removedAny = INVALID_HANDLE;
+    unsigned int removedAny = INVALID_HANDLE;
     unsigned int removedSubNodes = 0;
 
-    for(unsigned short ii = 0; ii < me->subNodes; ++ii)  {
+    for(unsigned int ii = 0; ii < me->subNodes; ++ii)  {
 
-        unsigned short id = subNodes[ii];
+        unsigned int id = subNodes[ii];
         // Blank recur
-        unsigned short removedId = removeRecur(id, owner);
+        unsigned int removedId = removeRecur(id, owner);
 
         if(removedId != INVALID_HANDLE)
             removedAny = removedId;
@@ -864,12 +1208,7 @@ unsigned short FixedMemoryTree::removeRecur(unsigned short node,
 
     if(!me->valid() && node != ROOT_VERSION_ENTRY) {
         // Remove me :(
-        VersionTable::Entry * const entry =
-            &(versionTable()->entries[node]);
-        entry->nxtFreeBlk = versionTable()->nxtFreeBlk;
-        versionTable()->nxtFreeBlk = node;
-        pool->free(me);
-        bump(node);
+        freeNode(node);
         return node;
     } else if(removedAny != INVALID_HANDLE) {
         bump(node);
@@ -878,35 +1217,55 @@ unsigned short FixedMemoryTree::removeRecur(unsigned short node,
     return removedAny;
 }
 
+/*!
+  Frees \a node and returns its version table entry to the free list, so that
+  it can be reused.  The caller must remove \a node from its parent's sub node
+  list.
+ */
+void FixedMemoryTree::freeNode(unsigned int node)
+{
+    Q_ASSERT(node != ROOT_VERSION_ENTRY);
+    Node * const me = this->node(node);
+    if(me->subNodePtr)
+        pool->free(fromPtr(me->subNodePtr));
+    pool->free(me);
+
+    VersionTable::Entry * const entry = &(versionTable()->entries[node]);
+    entry->nxtFreeBlk = versionTable()->nxtFreeBlk;
+    versionTable()->nxtFreeBlk = node;
+    --versionTable()->usedEntries;
+    bump(node);
+}
+
 /*!
   Removes sub node number \a subNodeNumber from \a from's sub node list.  Does
   bump \a from's version number.  Does not touch removed sub node.
  */
-void FixedMemoryTree::removeFrom(unsigned short from,
-                                 unsigned short subNodeNumber)
+void FixedMemoryTree::removeFrom(unsigned int from,
+                                 unsigned int subNodeNumber)
 {
     Node * const me = node(from);
 
     Q_ASSERT(subNodeNumber < me->subNodes);
 
-    unsigned short * const subNodes =
-        (unsigned short *)fromPtr(me->subNodePtr);
+    unsigned int * const subNodes =
+        (unsigned int *)fromPtr(me->subNodePtr);
 
-    unsigned int currentSize = pool->size_of(subNodes) / sizeof(unsigned short);
+    unsigned int currentSize = pool->size_of(subNodes) / sizeof(unsigned int);
     unsigned int scaleSize = shrunkListSize(currentSize, me->subNodes - 1);
     if(scaleSize != currentSize) {
         // Resize
-        unsigned short * newSubNodes =
-            (unsigned short *)pool->malloc(scaleSize * sizeof(unsigned short));
-        ::memcpy(newSubNodes, subNodes, subNodeNumber * sizeof(unsigned short));
+        unsigned int * newSubNodes =
+            (unsigned int *)pool->malloc(scaleSize * sizeof(unsigned int));
+        ::memcpy(newSubNodes, subNodes, subNodeNumber * sizeof(unsigned int));
         ::memcpy(newSubNodes + subNodeNumber, subNodes + subNodeNumber + 1,
-                  (me->subNodes - subNodeNumber - 1) * sizeof(unsigned short));
+                  (me->subNodes - subNodeNumber - 1) * sizeof(unsigned int));
         me->subNodePtr = ptr(newSubNodes);
         pool->free(subNodes);
     } else {
         // Do not resize
         ::memmove(subNodes + subNodeNumber, subNodes + subNodeNumber + 1,
-                  (me->subNodes - subNodeNumber - 1) * sizeof(unsigned short));
+                  (me->subNodes - subNodeNumber - 1) * sizeof(unsigned int));
     }
     --me->subNodes;
 
@@ -914,7 +1273,7 @@ void FixedMemoryTree::removeFrom(unsigned short from,
     bump(from);
 }
 
-bool FixedMemoryTree::remWatchRecur(unsigned short node, const char * path,
+bool FixedMemoryTree::remWatchRecur(unsigned int node, const char * path,
                                     NodeWatch owner)
 {
     // Locate end of section
@@ -931,19 +1290,20 @@ bool FixedMemoryTree::remWatchRecur(unsigned short node, const char * path,
     if(!match)
         return false;
 
-    unsigned short * const subNodes =
-        (unsigned short *)fromPtr(me->subNodePtr);
+    unsigned int * const subNodes =
+        (unsigned int *)fromPtr(me->subNodePtr);
 
     if('\0' == *endOfSection) {
         unsigned int id = subNodes[matchId];
 
         // We must remove this node
-        if(remWatch((unsigned short)id, owner)) {
+        if(remWatch((unsigned int)id, owner)) {
             bump(node);
             Node * them = this->node(id);
             if(!them->valid()) {
                 // Remove from node list
                 removeFrom(node, matchId);
+                freeNode(id);
                 return true;
             }
             return false;
@@ -951,24 +1311,23 @@ bool FixedMemoryTree::remWatchRecur(unsigned short node, const char * path,
         return false;
     } else {
         ++endOfSection;
-        bool rv = remWatchRecur((unsigned short)subNodes[matchId], endOfSection, owner);
+        bool rv = remWatchRecur((unsigned int)subNodes[matchId], endOfSection, owner);
 
         if(rv) {
             bump(node);
-            Node * const subNode = this->node(subNodes[matchId]);
+            const unsigned int id = subNodes[matchId];
+            Node * const subNode = this->node(id);
             if(!subNode->valid()) {
                 // Remove this one too
-                if(subNode->subNodePtr)
-                    pool->free(fromPtr(subNode->subNodePtr));
-                pool->free(subNode);
                 removeFrom(node, matchId);
+                freeNode(id);
             }
         }
         return rv;
     }
 }
 
-bool FixedMemoryTree::removeRecur(unsigned short node, const char * path,
+bool FixedMemoryTree::removeRecur(unsigned int node, const char * path,
                                   NodeOwner owner)
 {
     // Locate end of section
@@ -985,15 +1344,15 @@ bool FixedMemoryTree::removeRecur(unsigned short node, const char * path,
     if(!match)
         return false;
 
-    unsigned short * const subNodes =
-        (unsigned short *)fromPtr(me->subNodePtr);
+    unsigned int * const subNodes =
+        (unsigned int *)fromPtr(me->subNodePtr);
 
     if('\0' == *endOfSection) {
 
         unsigned int id = subNodes[matchId];
 
         // We must remove this node
-        unsigned short removeId = removeRecur(id, owner);
+        unsigned int removeId = removeRecur(id, owner);
 
         if(removeId == id) {
             // Remove from node list
@@ -1013,13 +1372,12 @@ bool FixedMemoryTree::removeRecur(unsigned short node, const char * path,
         bool rv = removeRecur(subNodes[matchId], endOfSection, owner);
         if(rv) {
             bump(node);
-            Node * const subNode = this->node(subNodes[matchId]);
+            const unsigned int id = subNodes[matchId];
+            Node * const subNode = this->node(id);
             if(!subNode->valid()) {
                 // Remove this one too
-                if(subNode->subNodePtr)
-                    pool->free(fromPtr(subNode->subNodePtr));
-                pool->free(subNode);
                 removeFrom(node, matchId);
+                freeNode(id);
             }
         }
         return rv;
@@ -1030,7 +1388,7 @@ bool FixedMemoryTree::removeRecur(unsigned short node, const char * path,
   Removes \a owner as a watch on \a node.  Returns true if owner was removed,
   false if owner was not a watch.
  */
-bool FixedMemoryTree::remWatch(unsigned short node, NodeWatch owner)
+bool FixedMemoryTree::remWatch(unsigned int node, NodeWatch owner)
 {
     Node * me = this->node(node);
 
@@ -1059,7 +1417,7 @@ bool FixedMemoryTree::remWatch(unsigned short node, NodeWatch owner)
         return false;
     } else if(me->watchCount > 2) {
         NodeWatch * list = (NodeWatch *)fromPtr(*(unsigned int *)me->watchBegin());
-        for(unsigned short ii = 0; ii < me->watchCount; ++ii) {
+        for(unsigned int ii = 0; ii < me->watchCount; ++ii) {
             if(list[ii] == owner) {
                 // Found!
                 unsigned int currentListSize =
@@ -1090,7 +1448,7 @@ bool FixedMemoryTree::remWatch(unsigned short node, NodeWatch owner)
 /*!
   Inserts \a owner as a watch on \a node.
  */
-bool FixedMemoryTree::setWatch(unsigned short node,  NodeWatch owner)
+bool FixedMemoryTree::setWatch(unsigned int node,  NodeWatch owner)
 {
     Node * me = this->node(node);
 
@@ -1148,7 +1506,7 @@ bool FixedMemoryTree::setWatch(unsigned short node,  NodeWatch owner)
   Inserts \a data of length \a dataLen into \a node.  Returns true if the
   version number of \a node has increased to handle this set.
   */
-bool FixedMemoryTree::setData(unsigned short node,
+bool FixedMemoryTree::setData(unsigned int node,
                               NodeOwner owner,
                               NodeDatum::Type type,
                               const char * data,
@@ -1305,7 +1663,7 @@ bool FixedMemoryTree::setData(unsigned short node,
     }
 }
 
-bool FixedMemoryTree::addWatchRecur(unsigned short node, const char * path,
+bool FixedMemoryTree::addWatchRecur(unsigned int node, const char * path,
                                     NodeWatch owner)
 {
     // Locate end of section
@@ -1315,8 +1673,8 @@ bool FixedMemoryTree::addWatchRecur(unsigned short node, const char * path,
 
     // We operate on structures, not numbers
     Node * const me = this->node(node);
-    unsigned short * subNodes =
-        me->subNodePtr?(unsigned short *)fromPtr(me->subNodePtr):0;
+    unsigned int * subNodes =
+        me->subNodePtr?(unsigned int *)fromPtr(me->subNodePtr):0;
 
     // Attempt to locate the sub node within the current node
     bool match;
@@ -1327,7 +1685,7 @@ bool FixedMemoryTree::addWatchRecur(unsigned short node, const char * path,
     if(match) {
 
         // There is a sub node of the correct name
-        const unsigned short id = subNodes[matchId];
+        const unsigned int id = subNodes[matchId];
 
         if('\0' == *endOfSection) {
             // Update the node.  Bumps *their* version if necessary.
@@ -1344,8 +1702,8 @@ bool FixedMemoryTree::addWatchRecur(unsigned short node, const char * path,
     } else { /* !match */
 
         // We *may* need to lengthen our list
-        unsigned short maxSubNodesLen = subNodes?
-            pool->size_of(subNodes) / sizeof(unsigned short):0;
+        unsigned int maxSubNodesLen = subNodes?
+            pool->size_of(subNodes) / sizeof(unsigned int):0;
         unsigned int newSubNode = 0;
 
         if('\0' == *endOfSection)
@@ -1359,19 +1717,19 @@ bool FixedMemoryTree::addWatchRecur(unsigned short node, const char * path,
 
         if(maxSubNodesLen < me->subNodes + 1) {
             // Grow list
-            unsigned short * newSubNodes =
-                (unsigned short *)pool->malloc(growListSize(me->subNodes) *
-                                             sizeof(unsigned short));
-            ::memcpy(newSubNodes, subNodes, matchId * sizeof(unsigned short));
+            unsigned int * newSubNodes =
+                (unsigned int *)pool->malloc(growListSize(me->subNodes) *
+                                           sizeof(unsigned int));
+            ::memcpy(newSubNodes, subNodes, matchId * sizeof(unsigned int));
             ::memcpy(newSubNodes + matchId + 1, subNodes + matchId,
-                     (me->subNodes - matchId) * sizeof(unsigned short));
+                     (me->subNodes - matchId) * sizeof(unsigned int));
             pool->free(fromPtr(me->subNodePtr));
             me->subNodePtr = ptr(newSubNodes);
             subNodes = newSubNodes;
         } else {
             // Split list
             ::memmove(subNodes + matchId + 1, subNodes + matchId,
-                      (me->subNodes - matchId) * sizeof(unsigned short));
+                      (me->subNodes - matchId) * sizeof(unsigned int));
         }
         subNodes[matchId] = newSubNode;
         ++me->subNodes;
@@ -1390,7 +1748,7 @@ bool FixedMemoryTree::addWatchRecur(unsigned short node, const char * path,
 /*!
   Returns true if the insert should force a version bump.
   */
-bool FixedMemoryTree::insertRecur(unsigned short node,
+bool FixedMemoryTree::insertRecur(unsigned int node,
                                   const char * path,
                                   NodeDatum::Type type,
                                   const char * data,
@@ -1404,8 +1762,8 @@ bool FixedMemoryTree::insertRecur(unsigned short node,
 
     // We operate on structures, not numbers
     Node * const me = this->node(node);
-    unsigned short * subNodes =
-        me->subNodePtr?(unsigned short *)fromPtr(me->subNodePtr):0;
+    unsigned int * subNodes =
+        me->subNodePtr?(unsigned int *)fromPtr(me->subNodePtr):0;
 
     // Attempt to locate the sub node within the current node
     bool match;
@@ -1416,7 +1774,7 @@ bool FixedMemoryTree::insertRecur(unsigned short node,
     if(match) {
 
         // There is a sub node of the correct name
-        const unsigned short id = subNodes[matchId];
+        const unsigned int id = subNodes[matchId];
 
         if('\0' == *endOfSection) {
             // Update the node.  Bumps *their* version if necessary.
@@ -1433,8 +1791,8 @@ bool FixedMemoryTree::insertRecur(unsigned short node,
     } else { /* !match */
 
         // We *may* need to lengthen our list
-        unsigned short maxSubNodesLen = subNodes?
-            pool->size_of(subNodes) / sizeof(unsigned short):0;
+        unsigned int maxSubNodesLen = subNodes?
+            pool->size_of(subNodes) / sizeof(unsigned int):0;
         unsigned int newSubNode = 0;
 
         if('\0' == *endOfSection)
@@ -1448,19 +1806,19 @@ bool FixedMemoryTree::insertRecur(unsigned short node,
 
         if(maxSubNodesLen < me->subNodes + 1) {
             // Grow list
-            unsigned short * newSubNodes =
-                (unsigned short *)pool->malloc(growListSize(me->subNodes) *
-                                             sizeof(unsigned short));
-            ::memcpy(newSubNodes, subNodes, matchId * sizeof(unsigned short));
+            unsigned int * newSubNodes =
+                (unsigned int *)pool->malloc(growListSize(me->subNodes) *
+                                           sizeof(unsigned int));
+            ::memcpy(newSubNodes, subNodes, matchId * sizeof(unsigned int));
             ::memcpy(newSubNodes + matchId + 1, subNodes + matchId,
-                     (me->subNodes - matchId) * sizeof(unsigned short));
+                     (me->subNodes - matchId) * sizeof(unsigned int));
             pool->free(fromPtr(me->subNodePtr));
             me->subNodePtr = ptr(newSubNodes);
             subNodes = newSubNodes;
         } else {
             // Split list
             ::memmove(subNodes + matchId + 1, subNodes + matchId,
-                      (me->subNodes - matchId) * sizeof(unsigned short));
+                      (me->subNodes - matchId) * sizeof(unsigned int));
         }
         subNodes[matchId] = newSubNode;
         ++me->subNodes;
@@ -1494,6 +1852,16 @@ void FixedMemoryTree::setNodeChangeFunction(NodeChangeFunction func, void *ctxt)
     changeFuncContext = ctxt;
 }
 
+/*!
+  Returns true if the \a len bytes at \a ptr lie entirely within the malloc
+  pool.
+ */
+bool FixedMemoryTree::inPool(unsigned int ptr, unsigned int len) const
+{
+    return ptr >= tableSize && ptr < poolSize &&
+           len <= poolSize - ptr;
+}
+
 unsigned int FixedMemoryTree::ptr(void * mem)
 {
     Q_ASSERT(mem > poolMem);
@@ -1501,7 +1869,7 @@ unsigned int FixedMemoryTree::ptr(void * mem)
 }
 
 /*! Increment \a node's version number */
-void FixedMemoryTree::bump(unsigned short node)
+void FixedMemoryTree::bump(unsigned int node)
 {
     ++(versionTable()->entries[node].version);
     if(changeFunc)
@@ -1510,7 +1878,7 @@ void FixedMemoryTree::bump(unsigned short node)
 
 Node * FixedMemoryTree::node(unsigned int entry)
 {
-    Q_ASSERT(entry < VERSION_TABLE_ENTRIES);
+    Q_ASSERT(entry < versionTable()->entryCount);
     return (Node *)fromPtr(versionTable()->entries[entry].nodePtr);
 }
 
@@ -1520,28 +1888,28 @@ Node * FixedMemoryTree::node(unsigned int entry)
  */
 Node * FixedMemoryTree::getNode(unsigned int entry)
 {
-    Q_ASSERT(entry < VERSION_TABLE_ENTRIES);
+    Q_ASSERT(entry < versionTable()->entryCount);
     void * rv = fromPtr(versionTable()->entries[entry].nodePtr);
-    if(rv < poolMem + sizeof(VersionTable)) {
+    if(rv < poolMem + tableSize) {
         return 0;
     } else {
         return (Node *)rv;
     }
 }
 
-Node * FixedMemoryTree::subNode(unsigned int node, unsigned short sub)
+Node * FixedMemoryTree::subNode(unsigned int node, unsigned int sub)
 {
-    Q_ASSERT(node < VERSION_TABLE_ENTRIES);
+    Q_ASSERT(node < versionTable()->entryCount);
     Node * me = this->node(node);
     Q_ASSERT(sub < me->subNodes);
-    unsigned short * const subNodes =
-        (unsigned short *)fromPtr(me->subNodePtr);
+    unsigned int * const subNodes =
+        (unsigned int *)fromPtr(me->subNodePtr);
     return this->node(subNodes[sub]);
 }
 
 unsigned int FixedMemoryTree::version(unsigned int entry)
 {
-    Q_ASSERT(entry < VERSION_TABLE_ENTRIES);
+    Q_ASSERT(entry < versionTable()->entryCount);
     return versionTable()->entries[entry].version;
 }
 
@@ -1549,8 +1917,8 @@ unsigned int FixedMemoryTree::version(unsigned int entry)
   Creates a new ndoe of \a name (name length \a len) and sets a single \a watch
   on it.
  */
-unsigned short FixedMemoryTree::newNode(const char * name, unsigned int len,
-                                        NodeWatch owner)
+unsigned int FixedMemoryTree::newNode(const char * name, unsigned int len,
+                                      NodeWatch owner)
 {
     Q_ASSERT(owner != INVALID_WATCH);
 
@@ -1577,6 +1945,7 @@ unsigned short FixedMemoryTree::newNode(const char * name, unsigned int len,
 
     // Enter node
     versionTable()->entries[node] = VersionTable::Entry(1, ptr(nodePtr));
+    ++versionTable()->usedEntries;
     // Bump version
     bump(node);
 
@@ -1590,9 +1959,9 @@ unsigned short FixedMemoryTree::newNode(const char * name, unsigned int len,
   \a data of length \a dataLen owned by \a owner.  If \a owner is an invalid
   owner, the node is a virtual node and not prefilled with data.
  */
-unsigned short FixedMemoryTree::newNode(const char * name, unsigned int len,
-                                        NodeOwner owner, NodeDatum::Type type,
-                                        const char * data, unsigned int dataLen)
+unsigned int FixedMemoryTree::newNode(const char * name, unsigned int len,
+                                      NodeOwner owner, NodeDatum::Type type,
+                                      const char * data, unsigned int dataLen)
 {
     Q_ASSERT(owner != INVALID_OWNER || (!data && 0 == dataLen));
 
@@ -1628,6 +1997,7 @@ unsigned short FixedMemoryTree::newNode(const char * name, unsigned int len,
 
     // Enter node
     versionTable()->entries[node] = VersionTable::Entry(1, ptr(nodePtr));
+    ++versionTable()->usedEntries;
     // Bump version
     bump(node);
 
@@ -1704,11 +2074,14 @@ public:
     QByteArray socket() const;
     void sync();
 
+    int notificationInterval() const;
+    void setNotificationInterval(int);
+
     static QVariant fromDatum(const NodeDatum * data);
 
     static ApplicationLayer * instance();
 
-    void nodeChanged(unsigned short);
+    void nodeChanged(unsigned int);
 
 private slots:
     void disconnected();
@@ -1747,7 +2120,7 @@ private:
            means we point to the full path (saves path.size() call) */
         unsigned int currentPath;
         /* Node we are currently pointing to. */
-        unsigned short currentNode;
+        unsigned int currentNode;
         /* Last version of current node */
         unsigned int version;
         /* Last creation Id of current node */
@@ -1775,6 +2148,11 @@ private:
     void triggerTodo();
     int todoTimer;
     QPacket todo;
+
+    void triggerNotify();
+    int notifyInterval;
+    int notifyTimer;
+    bool clientEmitPending;
     QSet<QPacketProtocol *> connections;
 
     unsigned int newPackId() {
@@ -1793,13 +2171,22 @@ private:
 
     int clientIndexShmId;
     uchar *clientIndex;
-    void incNode(unsigned short);
-    void decNode(unsigned short);
-    QHash<unsigned short, unsigned int> m_nodeInterest;
+    void incNode(unsigned int);
+    void decNode(unsigned int);
+    QHash<unsigned int, unsigned int> m_nodeInterest;
+
 
+    QVector<unsigned int> changedNodes;
+    QVector<uchar> changedNodesIndex;
 
-    unsigned int changedNodesCount;
-    unsigned short changedNodes[VERSION_TABLE_ENTRIES];
+    void lockForRead();
+    void attachLayer();
+    void reserve(unsigned int bytes, unsigned int nodes);
+    void compact();
+    bool moveLayer(unsigned int size, unsigned int entries);
+    void * baseShm;
+    void * layerShm;
+    unsigned int layerSize;
 
     // Stats memory
     unsigned long *m_statPoolSize;
@@ -1815,6 +2202,8 @@ QVALUESPACE_AUTO_INSTALL_LAYER(ApplicationLayer);
 // define ApplicationLayer
 ///////////////////////////////////////////////////////////////////////////////
 #define APPLAYER_SIZE 1000000
+#define APPLAYER_MAX_SIZE (64 * APPLAYER_SIZE)
+#define APPLAYER_INDEX_SIZE ((VERSION_TABLE_ENTRIES + 7) / 8)
 #define APPLAYER_ADD 0
 #define APPLAYER_REM 1
 #define APPLAYER_DONE 2
@@ -1828,19 +2217,25 @@ QVALUESPACE_AUTO_INSTALL_LAYER(ApplicationLayer);
 struct ApplicationLayerClient : public QPacketProtocol
 {
     ApplicationLayerClient(QIODevice *dev, QObject *parent = 0)
-        : QPacketProtocol(dev, parent), index(0) {}
+        : QPacketProtocol(dev, parent), index(0), indexSize(0) {}
 
     uchar *index;
+    unsigned int indexSize;
 };
 
 ApplicationLayer::ApplicationLayer()
 : type(Client), layer(0), lock(0), todoTimer(0),
+  notifyInterval(-1), notifyTimer(0), clientEmitPending(false),
   nextPackId(1), lastSentId(0), lastRecvId(0), valid(false),
   forceChangeCount(0), clientIndexShmId(0), clientIndex(0),
-  changedNodesCount(0),
+  baseShm(0), layerShm(0), layerSize(0),
   m_statPoolSize(0), m_statMaxSystemBytes(0), m_statSystemBytes(0),
   m_statInuseBytes(0), m_statKeepCost(0)
 {
+    const char *interval = ::getenv("QVALUESPACE_NOTIFY_INTERVAL");
+    if(interval && *interval)
+        notifyInterval = ::atoi(interval);
+
     sserver = new ALServerImpl( this );
 }
 
@@ -1855,7 +2250,7 @@ QString ApplicationLayer::name()
     return "Application Layer";
 }
 
-static void AppLayerNodeChanged(unsigned short, void *);
+static void AppLayerNodeChanged(unsigned int, void *);
 bool ApplicationLayer::startup(Type type)
 {
     int shmId = 0;
@@ -1916,7 +2311,7 @@ bool ApplicationLayer::startup(Type type)
     } else {
         shmId = ::shmget(key, APPLAYER_SIZE, 0);
         shmptr = ::shmat(shmId, 0, SHM_RDONLY);
-        subShmId = ::shmget(IPC_PRIVATE, (VERSION_TABLE_ENTRIES + 7) / 8, IPC_CREAT | 00644);
+        subShmId = ::shmget(IPC_PRIVATE, APPLAYER_INDEX_SIZE, IPC_CREAT | 00644);
         subShmptr = ::shmat(subShmId, 0, 0);
         struct shmid_ds sds;
         ::shmctl(subShmId, IPC_RMID, &sds);
@@ -1941,11 +2336,21 @@ bool ApplicationLayer::startup(Type type)
         (*connections.begin())->send(mem);
     }
 
-    layer = new FixedMemoryTree((char *)shmptr,
-                                APPLAYER_SIZE,
-                                (Server == type));
-    if(Server == type)
+    baseShm = shmptr;
+    if(Server == type) {
+        layer = new FixedMemoryTree((char *)shmptr, APPLAYER_SIZE, true);
         layer->setNodeChangeFunction(&AppLayerNodeChanged, (void *)this);
+        layerShm = shmptr;
+        layerSize = APPLAYER_SIZE;
+
+        VersionTable * const base = (VersionTable *)baseShm;
+        base->shmId = shmId;
+        base->shmSize = APPLAYER_SIZE;
+    } else {
+        lock->lockForRead(-1);
+        attachLayer();
+        lock->unlock();
+    }
 
     this->type = type;
 
@@ -2209,12 +2614,24 @@ void ALServerImpl::incomingConnection(int socketDescriptor)
     al->connections.insert(protocol);
 }
 
-void ApplicationLayer::timerEvent(QTimerEvent *)
+void ApplicationLayer::timerEvent(QTimerEvent *e)
 {
-    if(Client == type)
+    if(e->timerId() == notifyTimer) {
+        killTimer(notifyTimer);
+        notifyTimer = 0;
+        if(Client == type) {
+            if(clientEmitPending) {
+                clientEmitPending = false;
+                doClientEmit();
+            }
+        } else {
+            doServerTransmit();
+        }
+    } else if(Client == type) {
         doClientTransmit();
-    else
+    } else {
         doServerTransmit();
+    }
 }
 
 void ApplicationLayer::doServerTransmit()
@@ -2224,6 +2641,10 @@ void ApplicationLayer::doServerTransmit()
         killTimer(todoTimer);
         todoTimer = 0;
     }
+    if(notifyTimer) {
+        killTimer(notifyTimer);
+        notifyTimer = 0;
+    }
 
     QPacket others;
     others << (quint8)APPLAYER_SYNC << (unsigned int)0;
@@ -2238,8 +2659,12 @@ void ApplicationLayer::doServerTransmit()
             (*iter)->send(others);
         } else {
             bool found = false;
-            for(unsigned int ii = 0;!found && ii < changedNodesCount; ++ii) {
-                if(client->index[changedNodes[ii] >> 3] & (1 << (changedNodes[ii] & 0x7)))
+            for(int ii = 0;!found && ii < changedNodes.count(); ++ii) {
+                // The index only covers the nodes that existed when the
+                // client started, so any newer node may be of interest
+                unsigned int byte = changedNodes.at(ii) >> 3;
+                if(byte >= client->indexSize ||
+                   client->index[byte] & (1 << (changedNodes.at(ii) & 0x7)))
                     found = true;
             }
             if(found) {
@@ -2249,7 +2674,9 @@ void ApplicationLayer::doServerTransmit()
 
     }
 
-    changedNodesCount = 0;
+    for(int ii = 0; ii < changedNodes.count(); ++ii)
+        changedNodesIndex[changedNodes.at(ii) >> 3] &= ~(1 << (changedNodes.at(ii) & 0x7));
+    changedNodes.clear();
     doClientEmit();
 }
 
@@ -2287,7 +2714,15 @@ void ApplicationLayer::disconnected()
         owner.data2 = 0xFFFFFFFF;
 
         connections.remove(protocol);
-        if(layer->remove("/", owner)) {
+
+        lock->lockForWrite(-1);
+        layer->beginWrite();
+        bool removed = layer->remove("/", owner);
+        layer->endWrite();
+        compact();
+        lock->unlock();
+
+        if(removed) {
             QPacket others;
             others << (quint8)APPLAYER_SYNC << (unsigned int)0;
             for(QSet<QPacketProtocol *>::ConstIterator iter = connections.begin();
@@ -2299,16 +2734,24 @@ void ApplicationLayer::disconnected()
     }
 }
 
-static void AppLayerNodeChanged(unsigned short node, void *ctxt)
+static void AppLayerNodeChanged(unsigned int node, void *ctxt)
 {
     ApplicationLayer *layer = (ApplicationLayer *)ctxt;
     layer->nodeChanged(node);
 }
 
-void ApplicationLayer::nodeChanged(unsigned short node)
+void ApplicationLayer::nodeChanged(unsigned int node)
 {
-    if(changedNodesCount != VERSION_TABLE_ENTRIES)
-        changedNodes[changedNodesCount++] = node;
+    // Each node is only recorded once, no matter how many times it changes
+    // before the next transmit
+    if((int)(node >> 3) >= changedNodesIndex.count())
+        changedNodesIndex.resize((layer->entryCount() + 7) / 8);
+
+    uchar &byte = changedNodesIndex[node >> 3];
+    if(!(byte & (1 << (node & 0x7)))) {
+        byte |= (1 << (node & 0x7));
+        changedNodes.append(node);
+    }
 }
 
 void ApplicationLayer::readyRead()
@@ -2331,7 +2774,12 @@ void ApplicationLayer::readyRead()
                     pack >> recvId;
                     if(0 != recvId)
                         lastRecvId = recvId;
-                    doClientEmit();
+                    if(notifyInterval < 0) {
+                        doClientEmit();
+                    } else {
+                        clientEmitPending = true;
+                        triggerNotify();
+                    }
                 }
                 break;
             case APPLAYER_REMOVE:
@@ -2362,8 +2810,6 @@ void ApplicationLayer::readyRead()
         bool changed = false;
         bool done = false;
 
-        changedNodesCount = 0;
-
         while(!done && !pack.isEmpty()) {
             quint8 op;
             pack >> op;
@@ -2452,7 +2898,13 @@ void ApplicationLayer::readyRead()
                                 qWarning() << "ApplicationLayer: Unable to shmat with id:" << id << "error:" << ::strerror(errno);
                             }
                         } else {
-                            static_cast<ApplicationLayerClient *>(protocol)->index = reinterpret_cast<uchar *>(shmatRV);
+                            ApplicationLayerClient *client =
+                                static_cast<ApplicationLayerClient *>(protocol);
+                            struct shmid_ds sds;
+                            client->index = reinterpret_cast<uchar *>(shmatRV);
+                            client->indexSize = 0;
+                            if(0 == ::shmctl(id, IPC_STAT, &sds))
+                                client->indexSize = sds.shm_segsz;
                         }
                     }
                     break;
@@ -2470,13 +2922,22 @@ void ApplicationLayer::readyRead()
         causal << (quint8)APPLAYER_SYNC << packId;
         protocol->send(causal);
 
-        if(changed)
-            doServerTransmit();
+        if(changed) {
+            if(notifyInterval < 0)
+                doServerTransmit();
+            else
+                triggerNotify();
+        }
     }
 }
 
 void ApplicationLayer::doClientEmit()
 {
+    if(layer->isStale()) {
+        lockForRead();
+        lock->unlock();
+    }
+
     QMap<QByteArray, ReadHandle *> cpy = handles;
     for(QMap<QByteArray, ReadHandle *>::ConstIterator iter = cpy.begin();
             iter != cpy.end();
@@ -2651,7 +3112,24 @@ bool ApplicationLayer::value(HANDLE handle, QVariant *data)
 
     ReadHandle * rhandle = rh(handle);
 
-    lock->lockForRead(-1);
+    // A handle that already points to its full path can usually be read
+    // without taking the lock.  Anything else requires the handle to be
+    // refreshed, which must be done under the lock.
+    if(0xFFFFFFFF == rhandle->currentPath) {
+        FixedMemoryTree::DatumBuffer buffer;
+        switch(layer->readData(rhandle->currentNode, rhandle->creationId,
+                               &buffer)) {
+            case FixedMemoryTree::ReadOk:
+                *data = fromDatum((const NodeDatum *)buffer.constData());
+                return true;
+            case FixedMemoryTree::ReadNoData:
+                return false;
+            default:
+                break;
+        }
+    }
+
+    lockForRead();
 
     if(0xFFFFFFFF != rhandle->currentPath)
         if(refreshHandle(rhandle)) {
@@ -2699,7 +3177,7 @@ bool ApplicationLayer::value(HANDLE handle, const QByteArray &subPath,
 
     ReadHandle * rhandle = rh(handle);
 
-    lock->lockForRead(-1);
+    lockForRead();
 
     if(0xFFFFFFFF != rhandle->currentPath)
         if(refreshHandle(rhandle)) {
@@ -2735,7 +3213,7 @@ QSet<QByteArray> ApplicationLayer::children(HANDLE handle)
     ReadHandle * rhandle = rh(handle);
 
     QSet<QByteArray> rv;
-    lock->lockForRead(-1);
+    lockForRead();
 
     if(0xFFFFFFFF != rhandle->currentPath)
         if(refreshHandle(rhandle)) {
@@ -2764,7 +3242,7 @@ QSet<QByteArray> ApplicationLayer::children(HANDLE handle)
 
     if(0xFFFFFFFF == rhandle->currentPath) {
         Q_ASSERT(node);
-        for(unsigned short ii = 0; ii < node->subNodes; ++ii) {
+        for(unsigned int ii = 0; ii < node->subNodes; ++ii) {
             Node * n = layer->subNode(rhandle->currentNode, ii);
             QByteArray name(n->name, n->nameLen);
             rv.insert(name);
@@ -2789,7 +3267,7 @@ ApplicationLayer::HANDLE ApplicationLayer::item(HANDLE parent,
     } else {
         ReadHandle * handle = new ReadHandle(key);
         clearHandle(handle);
-        lock->lockForRead(-1);
+        lockForRead();
         refreshHandle(handle);
         lock->unlock();
         handles.insert(key, handle);
@@ -2817,7 +3295,7 @@ bool ApplicationLayer::refreshHandle(ReadHandle * handle)
     Q_ASSERT(handle);
 
     ReadHandle old = *handle;
-    unsigned short oldNode = handle->currentNode;
+    unsigned int oldNode = handle->currentNode;
 
     // Refresh handle
     if(0xFFFFFFFF == handle->currentPath) {
@@ -2904,8 +3382,163 @@ void ApplicationLayer::clearHandle(ReadHandle *handle)
     handle->creationId = 0;
 }
 
+/*!
+  Locks the layer for reading, first following it to a new segment if the
+  server has moved it.
+ */
+void ApplicationLayer::lockForRead()
+{
+    lock->lockForRead(-1);
+    if(Client == type && layer->isStale())
+        attachLayer();
+}
+
+/*!
+  Attaches to the segment currently holding the layer, as recorded in the
+  segment created at startup.  The layer must be locked.
+ */
+void ApplicationLayer::attachLayer()
+{
+    Q_ASSERT(Client == type);
+    VersionTable * const base = (VersionTable *)baseShm;
+
+    void * shmptr = baseShm;
+    unsigned int size = APPLAYER_SIZE;
+    if(base->generation) {
+        shmptr = ::shmat(base->shmId, 0, SHM_RDONLY);
+        size = base->shmSize;
+        if(shmptr == reinterpret_cast<void*>(-1))
+            qFatal("ApplicationLayer: Unable to attach to value space segment "
+                   "%d: %s", base->shmId, ::strerror(errno));
+    }
+
+    delete layer;
+    if(layerShm && layerShm != baseShm)
+        ::shmdt(layerShm);
+
+    layer = new FixedMemoryTree((char *)shmptr, size, false);
+    layerShm = shmptr;
+    layerSize = size;
+    qLog(ApplicationLayer) << "Attached to generation" << layer->generation()
+                           << "of the layer," << size << "bytes";
+}
+
+/*!
+  Ensures that a change adding up to \a nodes nodes and \a bytes bytes of
+  data will fit in the layer, moving it to a larger segment if necessary.
+  The layer must be locked for writing.
+ */
+void ApplicationLayer::reserve(unsigned int bytes, unsigned int nodes)
+{
+    Q_ASSERT(Server == type);
+    if(layer->hasSpace(bytes, nodes))
+        return;
+
+    unsigned int size = qMin(layerSize * 2, (unsigned int)APPLAYER_MAX_SIZE);
+    unsigned int entries = layer->entryCount() * 2;
+    if(size == layerSize || !moveLayer(size, entries))
+        qWarning("ApplicationLayer: Value space is full.");
+}
+
+/*!
+  Moves the layer back into a smaller segment once most of it is unused.  The
+  layer must be locked for writing.
+ */
+void ApplicationLayer::compact()
+{
+    Q_ASSERT(Server == type);
+    if(layerSize <= APPLAYER_SIZE)
+        return;
+
+    QMallocPool::MemoryStats stats = layer->mallocPool()->memoryStatistics();
+    if(stats.inuseBytes >= layerSize / 8)
+        return;
+
+    // Node ids are preserved, so the version table cannot shrink.  Only
+    // compact if the table and the live data, with the same headroom the
+    // usage check allows, fit in the smaller segment.
+    unsigned int size = qMax(layerSize / 2, (unsigned int)APPLAYER_SIZE);
+    unsigned int entries = layer->entryCount();
+    if(VERSION_TABLE_SIZE(entries) + 2 * stats.inuseBytes >= size)
+        return;
+
+    moveLayer(size, entries);
+}
+
+/*!
+  Copies the layer into a new segment of \a size bytes with room for
+  \a entries nodes.  Node ids are preserved, so clients only need to attach
+  the new segment to continue.  The layer must be locked for writing.
+ */
+bool ApplicationLayer::moveLayer(unsigned int size, unsigned int entries)
+{
+    Q_ASSERT(Server == type);
+
+    int shmId = ::shmget(IPC_PRIVATE, size, IPC_CREAT | 00644);
+    void * shmptr = reinterpret_cast<void*>(-1);
+    if(-1 != shmId)
+        shmptr = ::shmat(shmId, 0, 0);
+    if(shmptr == reinterpret_cast<void*>(-1)) {
+        qWarning() << "ApplicationLayer: Unable to create" << size
+                   << "byte segment:" << ::strerror(errno);
+        if(-1 != shmId)
+            ::shmctl(shmId, IPC_RMID, 0);
+        return false;
+    }
+    // Clients attach by id, so the segment can be destroyed as soon as the
+    // last process detaches
+    struct shmid_ds sds;
+    ::shmctl(shmId, IPC_RMID, &sds);
+
+    FixedMemoryTree * newLayer =
+        new FixedMemoryTree((char *)shmptr, size, entries, layer);
+    if(!newLayer->isComplete()) {
+        qWarning() << "ApplicationLayer: Layer does not fit in a" << size
+                   << "byte segment with" << entries << "entries";
+        delete newLayer;
+        ::shmdt(shmptr);
+        return false;
+    }
+    newLayer->setNodeChangeFunction(&AppLayerNodeChanged, (void *)this);
+
+    // Direct new clients to the new segment, and mark the old one stale
+    VersionTable * const base = (VersionTable *)baseShm;
+    base->shmId = shmId;
+    base->shmSize = size;
+    layer->setStale(newLayer->generation());
+    base->generation = newLayer->generation();
+
+    delete layer;
+    if(layerShm != baseShm)
+        ::shmdt(layerShm);
+    layer = newLayer;
+    layerShm = shmptr;
+    layerSize = size;
+
+    // Statistics point into the old segment
+    m_statPoolSize = 0;
+
+    qLog(ApplicationLayer) << "Moved layer to a" << size << "byte segment"
+                           << "with" << entries << "entries";
+
+    // Wake the clients so that they follow
+    QPacket others;
+    others << (quint8)APPLAYER_SYNC << (unsigned int)0;
+    for(QSet<QPacketProtocol *>::ConstIterator iter = connections.begin();
+            iter != connections.end();
+            ++iter)
+        (*iter)->send(others);
+
+    return true;
+}
+
 void ApplicationLayer::triggerTodo()
 {
+    if(Server == type && notifyInterval > 0) {
+        // Local changes are merged along with everyone else's
+        triggerNotify();
+        return;
+    }
     if(todoTimer || !valid)
         return;
     qLog(ApplicationLayer) << "Trigger todo";
@@ -2959,8 +3592,8 @@ void ApplicationLayer::updateStats()
                       owner);
 
         const char * out;
-        unsigned short node;
-        unsigned short baseNode =
+        unsigned int node;
+        unsigned int baseNode =
             layer->findClosest("/.ValueSpace/AppLayer/Memory", &out);
 
         node = layer->findClosest(baseNode, "/PoolSize", &out);
@@ -2989,10 +3622,10 @@ QList<NodeWatch> ApplicationLayer::watchers(const QByteArray &path)
 {
     Q_ASSERT(layer);
 
-    lock->lockForRead(-1);
+    lockForRead();
 
     const char * matched = 0;
-    unsigned short node = layer->findClosest(path.constData(), &matched);
+    unsigned int node = layer->findClosest(path.constData(), &matched);
     QList<NodeWatch> owners;
     while(INVALID_HANDLE != node) {
         Node * n = layer->getNode(node);
@@ -3093,8 +3726,11 @@ bool ApplicationLayer::doSetWatch(NodeWatch watch, const QByteArray &path)
     Q_ASSERT(layer);
 
     lock->lockForWrite(-1);
+    reserve(path.count(), path.count('/'));
+    layer->beginWrite();
     bool rv = layer->addWatch(path.constData(), watch);
     updateStats();
+    layer->endWrite();
     lock->unlock();
 
     return rv;
@@ -3125,8 +3761,10 @@ bool ApplicationLayer::doRemWatch(NodeWatch watch, const QByteArray &path)
     Q_ASSERT(layer);
 
     lock->lockForWrite(-1);
+    layer->beginWrite();
     bool rv = layer->remWatch(path.constData(), watch);
     updateStats();
+    layer->endWrite();
     lock->unlock();
 
     return rv;
@@ -3166,6 +3804,8 @@ bool ApplicationLayer::doSetItem(NodeOwner owner, const QByteArray &path,
     bool rv = false;
 
     lock->lockForWrite(-1);
+    reserve(path.count() + MAX_DATA_SIZE, path.count('/'));
+    layer->beginWrite();
 
     switch(val.type()) {
         case QVariant::Bool:
@@ -3243,6 +3883,7 @@ bool ApplicationLayer::doSetItem(NodeOwner owner, const QByteArray &path,
     }
 
     updateStats();
+    layer->endWrite();
     lock->unlock();
 
     return rv;
@@ -3284,8 +3925,11 @@ bool ApplicationLayer::doRemItems(NodeOwner owner, const QByteArray &path)
     } else {
         Q_ASSERT(layer);
         lock->lockForWrite(-1);
+        layer->beginWrite();
         rv = layer->remove(path.constData(), owner);
         updateStats();
+        layer->endWrite();
+        compact();
         lock->unlock();
     }
 
@@ -3303,6 +3947,48 @@ static QString qtopiaTempDir()
     return result;
 }
 
+/*!
+  Schedules the pending change notifications to be sent once the notification
+  interval has passed.  Further changes made in the meantime are merged into
+  the same notification.
+ */
+void ApplicationLayer::triggerNotify()
+{
+    if(notifyTimer || !valid)
+        return;
+    notifyTimer = startTimer(notifyInterval);
+}
+
+int ApplicationLayer::notificationInterval() const
+{
+    return notifyInterval;
+}
+
+void ApplicationLayer::setNotificationInterval(int interval)
+{
+    if(interval == notifyInterval)
+        return;
+
+    notifyInterval = interval;
+    if(!notifyTimer)
+        return;
+
+    killTimer(notifyTimer);
+    notifyTimer = 0;
+    if(notifyInterval < 0) {
+        // Flush anything waiting on the old interval
+        if(Server == type) {
+            doServerTransmit();
+        } else if(clientEmitPending) {
+            clientEmitPending = false;
+            doClientEmit();
+        }
+    } else {
+        // Wait for the new interval instead of the old one
+        notifyTimer = startTimer(notifyInterval);
+    }
+}
+
 QByteArray ApplicationLayer::socket() const
 {
     QString socketPath = qtopiaTempDir() + QLatin1String("valuespace_applayer");
@@ -3380,32 +4066,35 @@ QVariant ApplicationLayer::fromDatum(const NodeDatum * data)
     };
 }
 
-void ApplicationLayer::incNode(unsigned short node)
+void ApplicationLayer::incNode(unsigned int node)
 {
     if(type == Server || node == INVALID_HANDLE)
         return;
 
-    QHash<unsigned short, unsigned int>::Iterator iter =
+    QHash<unsigned int, unsigned int>::Iterator iter =
         m_nodeInterest.find(node);
     if(iter == m_nodeInterest.end()) {
-        clientIndex[node >> 3] |= (1 << (node & 0x7));
+        // The server assumes interest in nodes beyond the end of the index
+        if((node >> 3) < APPLAYER_INDEX_SIZE)
+            clientIndex[node >> 3] |= (1 << (node & 0x7));
         m_nodeInterest.insert(node, 1);
     } else {
         (*iter)++;
     }
 }
 
-void ApplicationLayer::decNode(unsigned short node)
+void ApplicationLayer::decNode(unsigned int node)
 {
     if(type == Server || node == INVALID_HANDLE)
         return;
 
-    QHash<unsigned short, unsigned int>::Iterator iter =
+    QHash<unsigned int, unsigned int>::Iterator iter =
         m_nodeInterest.find(node);
     Q_ASSERT(iter != m_nodeInterest.end());
     (*iter)--;
     if(!*iter) {
-        clientIndex[node >> 3] &= ~(1 << (node & 0x7));
+        if((node >> 3) < APPLAYER_INDEX_SIZE)
+            clientIndex[node >> 3] &= ~(1 << (node & 0x7));
         m_nodeInterest.erase(iter);
     }
 }
@@ -3676,6 +4365,50 @@ void QValueSpaceObject::sync()
     appLayer->sync();
 }
 
+/*!
+  Sets the interval in milliseconds over which change notifications are merged
+  to \a msecs.
+
+  By default each batch of attribute changes received by the Value Space
+  manager is immediately announced to every interested process, which then
+  emits the QValueSpaceItem::contentsChanged() signals.  Publishers that
+  update many attributes in quick succession can cause a burst of wakeups in
+  every subscribing process.  When \a msecs is zero or greater, changes made
+  within that interval are instead merged into a single notification per
+  subscriber.  An interval of zero merges all changes made in one iteration of
+  the event loop.  A negative interval restores the default behavior.
+
+  Changes already waiting to be announced are announced once the new interval
+  has passed, or immediately if the new interval is negative.
+
+  The interval applies to notifications sent and received by the calling
+  process.  The initial interval may be set with the
+  \c QVALUESPACE_NOTIFY_INTERVAL environment variable.
+
+  \sa notificationInterval()
+ */
+void QValueSpaceObject::setNotificationInterval(int msecs)
+{
+    VS_CALL_ASSERT;
+    ApplicationLayer *appLayer = applicationLayer();
+    if(!appLayer) return;
+    appLayer->setNotificationInterval(msecs);
+}
+
+/*!
+  Returns the interval in milliseconds over which change notifications are
+  merged, or a negative value if they are not merged.
+
+  \sa setNotificationInterval()
+ */
+int QValueSpaceObject::notificationInterval()
+{
+    VS_CALL_ASSERT;
+    ApplicationLayer *appLayer = applicationLayer();
+    if(!appLayer) return -1;
+    return appLayer->notificationInterval();
+}
+
 /*!
   \fn void QValueSpaceObject::itemRemove(const QByteArray &attribute)
 
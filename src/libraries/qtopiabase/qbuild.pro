@@ -72,13 +72,18 @@ PRIVATE_HEADERS=\
 
 SEMI_PRIVATE_HEADERS=\
     testslaveinterface_p.h\
-    qcopenvelope_p.h
+    qcopenvelope_p.h\
+    qcopjournal_p.h\
+    qtopiachannel_p.h\
+    qtopiaipcmarshal_p.h\
+    qtopiaipcprofile_p.h
 
 SOURCES=\
     qactionconfirm.cpp\
     qabstractipcinterfacegroup.cpp\
     qabstractipcinterfacegroupmanager.cpp\
     qcopenvelope.cpp\
+    qcopjournal.cpp\
     qdawg.cpp\
     qlog.cpp\
     qmemoryfile.cpp\
@@ -92,6 +97,7 @@ SOURCES=\
     qtopiaipcadaptor.cpp\
     qtopiaipcenvelope.cpp\
     qtopiaipcmarshal.cpp\
+    qtopiaipcprofile.cpp\
     qtopialog.cpp\
     qtopianamespace.cpp\
     qtopiaservices.cpp\
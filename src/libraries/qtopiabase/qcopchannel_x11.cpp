@@ -33,6 +33,7 @@
 #include "qdebug.h"
 #include "qtimer.h"
 #include "qtopianamespace.h"
+#include "qtopiaipcmarshal_p.h"
 #ifndef QT_NO_SXE
 #include "qtransportauth_qws.h"
 #include "qtransportauthdefs_qws.h"
@@ -272,6 +273,18 @@ QString QCopChannel::channel() const
  */
 void QCopChannel::receive(const QString& msg, const QByteArray &data)
 {
+    // Only QtopiaIpcAdaptor understands compact encoded arguments, so they
+    // are converted back for plain receivers.
+    if (qtopia_isCompactMessage(msg)) {
+        QString message;
+        QByteArray standardData;
+        if (qtopia_compactToStandard(msg, data, &message, &standardData))
+            emit received(message, standardData);
+        else
+            qWarning() << "QCopChannel: could not decode the arguments of" << msg;
+        return;
+    }
+
     emit received(msg, data);
 }
 
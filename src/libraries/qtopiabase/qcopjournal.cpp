@@ -0,0 +1,370 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#include "qcopjournal_p.h"
+#include <qtopianamespace.h>
+#include <QDir>
+#include <QFile>
+#include <QDataStream>
+#include <QAtomicInt>
+#include <QThread>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define QCOP_JOURNAL_MAGIC          0x51434a4c  // "QCJL"
+#define QCOP_JOURNAL_VERSION        1
+#define QCOP_JOURNAL_HEADER_SIZE    64
+#define QCOP_JOURNAL_INITIAL_SIZE   16384
+#define QCOP_JOURNAL_MAX_SIZE       (16 * 1024 * 1024)
+
+// Number of times a reader retries while the writer is rewinding the journal
+#define QCOP_JOURNAL_READ_RETRIES   100
+
+/*
+   The journal header is shared between the server, which appends messages,
+   and the application, which takes them.  Messages are stored between
+   readOffset and writeOffset, each as a 32 bit length followed by the
+   serialized channel, message and data, padded to a multiple of 4 bytes.
+
+   The writer publishes a message by advancing writeOffset once it has been
+   written and the reader consumes messages by advancing readOffset, so
+   neither needs to lock the file.  Once every message has been taken the
+   writer rewinds both offsets to the start of the journal, incrementing
+   generation before and after so a reader can detect it has read the
+   offsets of different generations.
+ */
+struct QCopJournalHeader
+{
+    quint32 magic;
+    quint32 version;
+    QBasicAtomicInt generation;
+    QBasicAtomicInt readOffset;
+    QBasicAtomicInt writeOffset;
+};
+
+/*
+   Both processes can write the header, so offsets read from it are checked
+   before they are used to address the mapping.
+ */
+static inline bool validOffsets(int readOffset, int writeOffset, int size)
+{
+    return QCOP_JOURNAL_HEADER_SIZE <= readOffset && readOffset <= writeOffset &&
+           writeOffset <= size && !(readOffset & 3) && !(writeOffset & 3);
+}
+
+static void rewind(QCopJournalHeader *h)
+{
+    h->generation.fetchAndAddOrdered(1);
+    h->writeOffset.fetchAndStoreOrdered(QCOP_JOURNAL_HEADER_SIZE);
+    h->readOffset.fetchAndStoreOrdered(QCOP_JOURNAL_HEADER_SIZE);
+    h->generation.fetchAndAddOrdered(1);
+}
+
+/*!
+  \class QCopJournal
+    \inpublicgroup QtBaseModule
+  \internal
+
+  \brief The QCopJournal class queues QCop messages for an application which
+  is not yet running.
+
+  Messages are appended to a memory mapped file by the server, using
+  append(), and are taken by the application when it starts, using
+  takeMessages().  Appending and taking messages only touch the messages
+  being added or removed, and neither requires a file lock.
+
+  Only a single process may append to the journal of an application at a
+  time, and only a single process may take messages from it.
+*/
+
+/*!
+  Constructs a journal for the application \a app.  The journal file is not
+  opened until it is first accessed.
+*/
+QCopJournal::QCopJournal(const QString &app)
+    : fn(fileName(app)), fd(-1), block(0), blockSize(0)
+{
+}
+
+/*!
+  Destroys the journal, closing the journal file.
+*/
+QCopJournal::~QCopJournal()
+{
+    close();
+}
+
+/*!
+  Returns the name of the journal file of application \a app.
+*/
+QString QCopJournal::fileName(const QString &app)
+{
+    QString qcopfn(app);
+    // if the appname is a path with slashes, convert to underscores
+    // note: this assumes that the PATH variable is not used to launch the binary
+    // so that argv[0] contains the full path as well.  Otherwise the similar
+    // code in QtopiaApplication will not have the app name.
+    qcopfn.replace(QDir::separator(), "_");
+    qcopfn.prepend(Qtopia::tempDir() + "qcop-msg-");
+    return qcopfn;
+}
+
+/*!
+  Appends the message \a message on \a channel with parameters \a data to the
+  journal.  Returns true if the message was queued.
+*/
+bool QCopJournal::append(const QString &channel, const QString &message, const QByteArray &data)
+{
+    if(!openForWriting())
+        return false;
+
+    QByteArray record;
+    {
+        QDataStream ds(&record, QIODevice::WriteOnly);
+        ds << channel << message << data;
+    }
+
+    QCopJournalHeader *h = header();
+
+    int writeOffset = h->writeOffset.fetchAndAddAcquire(0);
+    int readOffset = h->readOffset.fetchAndAddAcquire(0);
+
+    if(!validOffsets(readOffset, writeOffset, blockSize)) {
+        qWarning("QCopJournal: %s is corrupt, discarding queued messages", fn.toLocal8Bit().constData());
+        rewind(h);
+        writeOffset = QCOP_JOURNAL_HEADER_SIZE;
+    } else if(writeOffset != QCOP_JOURNAL_HEADER_SIZE && readOffset == writeOffset) {
+        // Rewind once the application has taken every message.
+        rewind(h);
+        writeOffset = QCOP_JOURNAL_HEADER_SIZE;
+    }
+
+    const int recordSize = (sizeof(quint32) + record.size() + 3) & ~3;
+
+    if(writeOffset + recordSize > blockSize) {
+        int size = blockSize;
+        while(size < writeOffset + recordSize)
+            size *= 2;
+
+        if(size > QCOP_JOURNAL_MAX_SIZE) {
+            qWarning("QCopJournal: %s is full", fn.toLocal8Bit().constData());
+            return false;
+        }
+
+        if(::ftruncate(fd, size) == -1 || !map(size)) {
+            qWarning("QCopJournal: Failed to grow %s (%d)", fn.toLocal8Bit().constData(), errno);
+            return false;
+        }
+        h = header();
+    }
+
+    quint32 length = record.size();
+    ::memcpy(block + writeOffset, &length, sizeof(quint32));
+    ::memcpy(block + writeOffset + sizeof(quint32), record.constData(), record.size());
+
+    h->writeOffset.fetchAndStoreRelease(writeOffset + recordSize);
+
+    return true;
+}
+
+/*!
+  Removes all the messages from the journal and returns them.
+*/
+QList<QCopJournal::Message> QCopJournal::takeMessages()
+{
+    QList<Message> messages;
+
+    if(!openForReading())
+        return messages;
+
+    QCopJournalHeader *h = header();
+
+    int readOffset = 0;
+    int writeOffset = 0;
+    int retries = 0;
+
+    forever {
+        int generation = h->generation.fetchAndAddAcquire(0);
+        if(!(generation & 1)) {
+            readOffset = h->readOffset.fetchAndAddAcquire(0);
+            writeOffset = h->writeOffset.fetchAndAddAcquire(0);
+            if(h->generation.fetchAndAddAcquire(0) == generation)
+                break;
+        }
+
+        if(++retries == QCOP_JOURNAL_READ_RETRIES) {
+            qWarning("QCopJournal: %s is being rewritten", fn.toLocal8Bit().constData());
+            return messages;
+        }
+        QThread::yieldCurrentThread();
+    }
+
+    if(!validOffsets(readOffset, writeOffset, QCOP_JOURNAL_MAX_SIZE)) {
+        qWarning("QCopJournal: %s is corrupt", fn.toLocal8Bit().constData());
+        return messages;
+    }
+
+    if(readOffset == writeOffset)
+        return messages;
+
+    if(writeOffset > blockSize) {
+        // Only map what the file holds, touching pages beyond it would fault.
+        struct stat st;
+        if(::fstat(fd, &st) == -1 || st.st_size < writeOffset || !map(st.st_size))
+            return messages;
+        h = header();
+    }
+
+    for(int offset = readOffset; offset < writeOffset;) {
+        quint32 length;
+        ::memcpy(&length, block + offset, sizeof(quint32));
+
+        // Offsets are aligned, so at least the length fits before writeOffset.
+        if(length > writeOffset - offset - sizeof(quint32)) {
+            qWarning("QCopJournal: %s is corrupt", fn.toLocal8Bit().constData());
+            break;
+        }
+
+        QByteArray record = QByteArray::fromRawData(block + offset + sizeof(quint32), length);
+        QDataStream ds(record);
+
+        Message message;
+        ds >> message.channel >> message.message >> message.data;
+
+        messages.append(message);
+
+        offset += (sizeof(quint32) + length + 3) & ~3;
+    }
+
+    h->readOffset.testAndSetOrdered(readOffset, writeOffset);
+
+    return messages;
+}
+
+/*!
+  \internal
+  Opens the journal file for appending, creating or reinitializing it if it
+  doesn't contain a valid journal.
+*/
+bool QCopJournal::openForWriting()
+{
+    // The file may have been removed while it was open.
+    if(fd != -1) {
+        struct stat fileStat;
+        struct stat openStat;
+        if(::stat(QFile::encodeName(fn).constData(), &fileStat) == 0 &&
+           ::fstat(fd, &openStat) == 0 &&
+           fileStat.st_ino == openStat.st_ino && fileStat.st_dev == openStat.st_dev)
+            return true;
+        close();
+    }
+
+    fd = ::open(QFile::encodeName(fn).constData(), O_RDWR | O_CREAT, 0666);
+    if(fd == -1) {
+        qWarning("QCopJournal: Failed to open file %s (%d)", fn.toLocal8Bit().constData(), errno);
+        return false;
+    }
+
+    struct stat st;
+    if(::fstat(fd, &st) == 0 && st.st_size >= QCOP_JOURNAL_HEADER_SIZE && map(st.st_size) &&
+       header()->magic == QCOP_JOURNAL_MAGIC && header()->version == QCOP_JOURNAL_VERSION)
+        return true;
+
+    // The file is new, or was written by an older version, so start afresh.
+    if(::ftruncate(fd, 0) == -1 || ::ftruncate(fd, QCOP_JOURNAL_INITIAL_SIZE) == -1 ||
+       !map(QCOP_JOURNAL_INITIAL_SIZE)) {
+        qWarning("QCopJournal: Failed to initialize %s (%d)", fn.toLocal8Bit().constData(), errno);
+        close();
+        return false;
+    }
+
+    QCopJournalHeader *h = header();
+    h->version = QCOP_JOURNAL_VERSION;
+    h->generation.fetchAndStoreOrdered(0);
+    h->readOffset.fetchAndStoreOrdered(QCOP_JOURNAL_HEADER_SIZE);
+    h->writeOffset.fetchAndStoreOrdered(QCOP_JOURNAL_HEADER_SIZE);
+    h->magic = QCOP_JOURNAL_MAGIC;
+
+    return true;
+}
+
+/*!
+  \internal
+  Opens an existing journal file for taking messages.
+*/
+bool QCopJournal::openForReading()
+{
+    if(fd != -1)
+        return true;
+
+    fd = ::open(QFile::encodeName(fn).constData(), O_RDWR);
+    if(fd == -1)
+        return false;
+
+    struct stat st;
+    if(::fstat(fd, &st) == 0 && st.st_size >= QCOP_JOURNAL_HEADER_SIZE && map(st.st_size) &&
+       header()->magic == QCOP_JOURNAL_MAGIC && header()->version == QCOP_JOURNAL_VERSION)
+        return true;
+
+    close();
+    return false;
+}
+
+/*!
+  \internal
+  Maps the first \a size bytes of the journal file, replacing any existing
+  mapping.
+*/
+bool QCopJournal::map(int size)
+{
+    if(block)
+        ::munmap(block, blockSize);
+
+    block = (char *)::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(block == MAP_FAILED) {
+        block = 0;
+        blockSize = 0;
+        return false;
+    }
+
+    blockSize = size;
+    return true;
+}
+
+/*!
+  \internal
+  Unmaps and closes the journal file.
+*/
+void QCopJournal::close()
+{
+    if(block)
+        ::munmap(block, blockSize);
+    block = 0;
+    blockSize = 0;
+
+    if(fd != -1)
+        ::close(fd);
+    fd = -1;
+}
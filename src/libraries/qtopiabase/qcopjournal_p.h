@@ -0,0 +1,74 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+#ifndef QCOPJOURNAL_P_H
+#define QCOPJOURNAL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt Extended API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <qtopiaglobal.h>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+
+struct QCopJournalHeader;
+
+class QTOPIABASE_EXPORT QCopJournal
+{
+public:
+    struct Message
+    {
+        QString channel;
+        QString message;
+        QByteArray data;
+    };
+
+    explicit QCopJournal(const QString &app);
+    ~QCopJournal();
+
+    bool append(const QString &channel, const QString &message, const QByteArray &data);
+    QList<Message> takeMessages();
+
+    static QString fileName(const QString &app);
+
+private:
+    Q_DISABLE_COPY(QCopJournal)
+
+    bool openForWriting();
+    bool openForReading();
+    bool map(int size);
+    void close();
+
+    QCopJournalHeader *header() const { return (QCopJournalHeader *)block; }
+
+    QString fn;
+    int fd;
+    char *block;
+    int blockSize;
+};
+
+#endif
@@ -20,6 +20,9 @@
 #include "qdawg.h"
 #include <QHash>
 #include <qlist.h>
+#include <qvector.h>
+#include <qpair.h>
+#include <qalgorithms.h>
 #include <qtextstream.h>
 #include <qfile.h>
 #include <qiodevice.h>
@@ -243,6 +246,15 @@ QTrie* TrieList::findAdd(QChar c,bool last,int value)
     return p.p;
 }
 
+// Orders indexes into a list of words by the words they refer to.
+class QDawgWordOrder {
+public:
+    QDawgWordOrder(const QStringList& w) : words(w) {}
+    bool operator()(int a, int b) const { return words.at(a) < words.at(b); }
+private:
+    const QStringList& words;
+};
+
 static const char* dawg_sig = "QDWG";
 static const quint32 dawg_ver = 0x00000300;
 
@@ -419,6 +431,95 @@ public:
         } while (!node[nid+i++].isLast());
     }
 
+    // Returns the index of the node for the last letter of the non-empty
+    // string s, or -1 if no word starts with s.
+    int findNode(const QString& s) const
+    {
+        int found = -1;
+        for (int index = 0; index < (int)s.length(); ++index) {
+            int nid = 0;
+            if ( found != -1 ) {
+                if ( !node[found].offset )
+                    return -1;
+                nid = found + node[found].offset;
+            }
+            found = findChild(nid, s[index]);
+            if ( found == -1 )
+                return -1;
+        }
+        return found;
+    }
+
+    // Returns the index of the first child of node n, or -1 if it has none.
+    int firstChild(int n) const
+    {
+        return node[n].offset ? n + node[n].offset : -1;
+    }
+
+    // Returns the index of the node with letter c in the child list starting
+    // at nid, or -1.
+    int findChild(int nid, QChar c) const
+    {
+        int i=0;
+        do {
+            if ( node[nid+i].let == c.unicode() )
+                return nid+i;
+        } while (!node[nid+i++].isLast());
+        return -1;
+    }
+
+    // As appendAllWords(), but stops once list holds maximum words.  Returns
+    // false if it stopped early.
+    bool appendWords(QStringList& list, int maximum, int nid, QString& s) const
+    {
+        int i=0;
+        int next = s.length();
+        s.append(QChar());
+        do {
+            QDawg::Node& n = node[nid+i];
+            s[next] = QChar((ushort)n.let);
+            if ( n.isWord() ) {
+                if ( maximum >= 0 && list.count() >= maximum )
+                    return false;
+                list.append(s);
+            }
+            if ( n.offset && !appendWords(list, maximum, n.offset+nid+i, s) )
+                return false;
+        } while (!node[nid+i++].isLast());
+        s.truncate(next);
+        return true;
+    }
+
+    // Keeps the count words with the highest values in best, in descending
+    // order of value.  Words with equal values are kept in alphabetical order.
+    void appendTopWords(QList<QPair<int, QString> >& best, int count, int nid, QString& s) const
+    {
+        int i=0;
+        int next = s.length();
+        s.append(QChar());
+        do {
+            QDawg::Node& n = node[nid+i];
+            s[next] = QChar((ushort)n.let);
+            if ( n.isWord() )
+                insertTopWord(best, count, n.value(), s);
+            if ( n.offset )
+                appendTopWords(best, count, n.offset+nid+i, s);
+        } while (!node[nid+i++].isLast());
+        s.truncate(next);
+    }
+
+    static void insertTopWord(QList<QPair<int, QString> >& best, int count, int value, const QString& s)
+    {
+        if ( best.count() == count && best.last().first >= value )
+            return;
+        int pos = best.count();
+        while ( pos > 0 && best.at(pos-1).first < value )
+            --pos;
+        best.insert(pos, qMakePair(value, s));
+        if ( best.count() > count )
+            best.removeLast();
+    }
+
     const QDawg::Node* root() { return node; }
 
 private:
@@ -542,6 +643,11 @@ private:
   The QDawg graph can have a value() stored at each node. This can be used
   for example for tagging words with frequency information.
 
+  Common searches are provided directly: prefixedWords() lists the words
+  starting with a prefix, topWords() finds the words with the highest values
+  for a prefix, and contains() can look up many words in a single call.  They
+  operate on the memory-mapped file when the QDawg was read with readFile().
+
   \ingroup userinput
 */
 
@@ -735,6 +841,120 @@ bool QDawg::contains(const QString& s) const
     return d ? d->contains(s) : false;
 }
 
+/*!
+  Returns a list with an entry for each word in \a words, which is true if
+  the QDawg contains that word; otherwise false.
+
+  This is faster than calling contains() for each word, as the words are
+  looked up in alphabetical order and the traversal of each common prefix
+  is shared.
+*/
+QList<bool> QDawg::contains(const QStringList& words) const
+{
+    QList<bool> result;
+    for (int ii = 0; ii < words.count(); ++ii)
+        result.append(false);
+    if ( !d )
+        return result;
+
+    QVector<int> order(words.count());
+    for (int ii = 0; ii < order.count(); ++ii)
+        order[ii] = ii;
+    qSort(order.begin(), order.end(), QDawgWordOrder(words));
+
+    // path[k] is the node matching letter k of the previous word.
+    QVector<int> path;
+    const QString* previous = 0;
+    const QDawg::Node* node = d->root();
+    foreach (int index, order) {
+        const QString& word = words.at(index);
+        int common = 0;
+        if ( previous ) {
+            int limit = qMin(path.count(), qMin(word.length(), previous->length()));
+            while ( common < limit && word.at(common) == previous->at(common) )
+                ++common;
+        }
+        path.resize(common);
+        previous = &word;
+
+        bool found = !word.isEmpty();
+        for (int k = common; found && k < word.length(); ++k) {
+            int nid = k ? d->firstChild(path.at(k-1)) : 0;
+            int match = nid == -1 ? -1 : d->findChild(nid, word.at(k));
+            if ( match == -1 )
+                found = false;
+            else
+                path.append(match);
+        }
+        result[index] = found && node[path.last()].isWord();
+    }
+    return result;
+}
+
+/*!
+  Returns the words in the QDawg that start with \a prefix, in alphabetical
+  order.  If \a prefix is itself a word it is included.  If \a maximum is not
+  negative, at most \a maximum words are returned and the traversal stops as
+  soon as they have been found.
+
+  \sa topWords(), allWords()
+*/
+QStringList QDawg::prefixedWords(const QString& prefix, int maximum) const
+{
+    QStringList result;
+    if ( !d || !maximum )
+        return result;
+
+    QString s = prefix;
+    if ( prefix.isEmpty() ) {
+        d->appendWords(result, maximum, 0, s);
+        return result;
+    }
+
+    int n = d->findNode(prefix);
+    if ( n == -1 )
+        return result;
+    if ( d->root()[n].isWord() )
+        result.append(prefix);
+    if ( d->firstChild(n) != -1 )
+        d->appendWords(result, maximum, d->firstChild(n), s);
+    return result;
+}
+
+/*!
+  Returns the \a count words starting with \a prefix that have the highest
+  Node::value(), in descending order of value.  Words with equal values are
+  returned in alphabetical order.  This is intended for QDawgs whose values
+  hold word frequencies, as created by createFromWords().
+
+  \sa prefixedWords()
+*/
+QStringList QDawg::topWords(const QString& prefix, int count) const
+{
+    QStringList result;
+    if ( !d || count <= 0 )
+        return result;
+
+    QList<QPair<int, QString> > best;
+    QString s = prefix;
+    if ( prefix.isEmpty() ) {
+        d->appendTopWords(best, count, 0, s);
+    } else {
+        int n = d->findNode(prefix);
+        if ( n == -1 )
+            return result;
+        const QDawg::Node& node = d->root()[n];
+        if ( node.isWord() )
+            QDawgPrivate::insertTopWord(best, count, node.value(), prefix);
+        if ( d->firstChild(n) != -1 )
+            d->appendTopWords(best, count, d->firstChild(n), s);
+    }
+
+    for (int ii = 0; ii < best.count(); ++ii)
+        result.append(best.at(ii).second);
+    return result;
+}
+
 /*!
   \internal
 
@@ -21,6 +21,7 @@
 
 #include <qtopiaglobal.h>
 #include <qstringlist.h>
+#include <qlist.h>
 #include <cstdio>
 
 class QIODevice;
@@ -40,8 +41,12 @@ public:
     QStringList allWords() const;
 
     bool contains(const QString&) const;
+    QList<bool> contains(const QStringList&) const;
     int countWords() const;
 
+    QStringList prefixedWords(const QString& prefix, int maximum = -1) const;
+    QStringList topWords(const QString& prefix, int count) const;
+
     class QTOPIABASE_EXPORT Node {
         friend class QDawgPrivate;
         quint16 let;
@@ -171,6 +171,20 @@ static bool qualifiedToFilePath(const QByteArray &qualified,
     return true;
 }
 
+// A file name of "*" monitors the entries of a directory.  Without INotify
+// these are tracked through the directory's own modification time, which
+// changes whenever an entry is created, removed or renamed.
+static time_t modificationTime(const QByteArray &fileName)
+{
+    struct stat buf;
+    memset(&buf, 0, sizeof(struct stat));
+    if(fileName.endsWith("/*"))
+        ::stat(fileName.left(fileName.length() - 2).constData(), &buf);
+    else
+        ::stat(fileName.constData(), &buf);
+    return buf.st_mtime;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // declare IMonitorContainer
 ///////////////////////////////////////////////////////////////////////////////
@@ -231,6 +245,8 @@ private slots:
     void directoryChanged(const QString &);
 
 private:
+    void processEvent(const inotify_event &);
+
     int m_fd;
 
     struct Directory {
@@ -545,6 +561,12 @@ void QFileMonitorPrivate::fileChanged()
 
   \endlist
 
+  To monitor all the entries of a directory rather than a single file,
+  construct the QFileMonitor with the directory path followed by \c {/*}.  The
+  fileChanged() signal is then emitted, with that name, whenever an entry in the
+  directory is created, removed or renamed.  The INotify strategy also reports
+  changes to the contents of the entries.
+
   To avoid race conditions when using QFileMonitor to trigger re-reading of file
   contents, you should always construct QFileMonitor and \i {only then} read the
   initial file contents.
@@ -789,13 +811,12 @@ void DNotifyFileMonitor::refresh(int fd)
     for(int ii = 0; ii < directory.files.count(); ++ii) {
 
         QByteArray fileName = path + "/" + directory.files.at(ii).name;
-        memset(&buf, 0, sizeof(struct stat));
-        ::stat(fileName.constData(), &buf);
+        time_t lastWrite = modificationTime(fileName);
 
-        if(buf.st_mtime != directory.files.at(ii).lastWrite) {
-            directory.files[ii].lastWrite = buf.st_mtime;
+        if(lastWrite != directory.files.at(ii).lastWrite) {
+            directory.files[ii].lastWrite = lastWrite;
 
-            if(currentTime == buf.st_mtime)
+            if(currentTime == lastWrite)
                 delayedChanges.append(&directory.files[ii]);
             else
                 immediateChanges.append(&directory.files[ii]);
@@ -862,10 +883,7 @@ bool DNotifyFileMonitor::install(QFileMonitorPrivate * p)
         file.monitors.append(p);
 
         if(d) {
-            struct stat buf;
-            memset(&buf, 0, sizeof(struct stat));
-            ::stat(qPath.constData(), &buf);
-            file.lastWrite = buf.st_mtime;
+            file.lastWrite = modificationTime(qPath);
         } else {
             file.lastWrite = 0;
 
@@ -904,10 +922,7 @@ bool DNotifyFileMonitor::install(QFileMonitorPrivate * p)
         Directory::File file;
         file.name = fileName;
         file.monitors.append(p);
-        struct stat buf;
-        memset(&buf, 0, sizeof(struct stat));
-        ::stat(qPath.constData(), &buf);
-        file.lastWrite = buf.st_mtime;
+        file.lastWrite = modificationTime(qPath);
         iter->files.append(file);
     }
 
@@ -1037,11 +1052,42 @@ INotifyFileMonitor::INotifyFileMonitor()
 void INotifyFileMonitor::activated()
 {
     char buffer[INOTIFY_BUFSIZE];
-    inotify_event & event = *((inotify_event *)buffer);
 
-    int readrv = ::read(m_fd, &event, INOTIFY_BUFSIZE);
+    int readrv = ::read(m_fd, buffer, INOTIFY_BUFSIZE);
     Q_ASSERT(readrv >= (int)sizeof(inotify_event));
-    Q_UNUSED(readrv);
+
+    // A single read returns as many queued events as fit in the buffer
+    int offset = 0;
+    while(offset + (int)sizeof(inotify_event) <= readrv) {
+        inotify_event & event = *((inotify_event *)(buffer + offset));
+        offset += sizeof(inotify_event) + event.len;
+
+        processEvent(event);
+    }
+}
+
+void INotifyFileMonitor::processEvent(const inotify_event &event)
+{
+    if(IN_Q_OVERFLOW & event.mask) {
+        // Events have been lost, so anything may have changed
+        QList<QFileMonitorPrivate *> monitors;
+        for(QMap<int, Directory>::ConstIterator diter =
+                m_monitoredPaths.begin();
+                diter != m_monitoredPaths.end();
+                ++diter) {
+            for(QMap<QByteArray, Directory::File>::ConstIterator fiter =
+                    diter->files.begin();
+                    fiter != diter->files.end();
+                    ++fiter)
+                monitors += fiter->monitors;
+        }
+        for(int ii = 0; ii < monitors.count(); ++ii)
+            monitors[ii]->AddRef();
+        doFileChanged(monitors);
+        for(int ii = 0; ii < monitors.count(); ++ii)
+            monitors[ii]->Release();
+        return;
+    }
 
     // Locate the directory this wd was for
     QMap<int, Directory>::Iterator diter = m_monitoredPaths.find(event.wd);
@@ -1072,18 +1118,29 @@ void INotifyFileMonitor::activated()
             monitors[ii]->Release();
 
     } else {
-        // Regular run-of-the-mill change
-        QByteArray file(event.name, event.len);
+        // Regular run-of-the-mill change.  The name is null padded to len.
+        QByteArray file = event.len ? QByteArray(event.name) : QByteArray();
+
+        QList<QFileMonitorPrivate *> monitors;
 
         QMap<QByteArray, Directory::File>::ConstIterator fiter =
             dir.files.find(file);
-        if(fiter == dir.files.end()) return;
+        if(fiter != dir.files.end())
+            monitors += fiter->monitors;
+
+        // Monitors of all the entries in the directory
+        fiter = dir.files.find("*");
+        if(!file.isEmpty() && file != "*" && fiter != dir.files.end())
+            monitors += fiter->monitors;
+
+        if(monitors.isEmpty()) return;
 
         // Emit!
-        Directory::File f= *fiter;
-        f.AddRef();
-        doFileChanged(f.monitors);
-        f.Release();
+        for(int ii = 0; ii < monitors.count(); ++ii)
+            monitors[ii]->AddRef();
+        doFileChanged(monitors);
+        for(int ii = 0; ii < monitors.count(); ++ii)
+            monitors[ii]->Release();
     }
 }
 
@@ -1307,10 +1364,7 @@ bool PollFileMonitor::install(QFileMonitorPrivate *p)
     QMap<QByteArray, File>::Iterator iter = m_monitoredFiles.find(qPath);
     if(iter == m_monitoredFiles.end()) {
         File f;
-        struct stat buf;
-        memset(&buf, 0, sizeof(struct stat));
-        ::stat(qPath.constData(), &buf);
-        f.lastModified = buf.st_mtime;
+        f.lastModified = modificationTime(qPath);
         f.monitors += p;
         m_monitoredFiles.insert(qPath, f);
     } else {
@@ -1349,14 +1403,12 @@ void PollFileMonitor::timerEvent(QTimerEvent *e)
                 iter != m_monitoredFiles.end();
                 ++iter) {
 
-            struct stat buf;
-            memset(&buf, 0, sizeof(struct stat));
-            ::stat(iter.key().constData(), &buf);
+            time_t lastModified = modificationTime(iter.key());
 
-            if(buf.st_mtime != iter->lastModified) {
-                iter->lastModified = buf.st_mtime;
+            if(lastModified != iter->lastModified) {
+                iter->lastModified = lastModified;
 
-                if(buf.st_mtime >= currentTime)
+                if(lastModified >= currentTime)
                     delayedChanges += (*iter).monitors;
                 else
                     immediateChanges += (*iter).monitors;
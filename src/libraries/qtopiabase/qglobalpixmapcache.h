@@ -32,12 +32,18 @@
 #define QGLOBAL_PIXMAP_CACHE_LIMIT 1048576     // 1 Mb
 #endif
 
+// The share of the cache a single process may use for unpinned pixmaps
+#ifndef QGLOBAL_PIXMAP_CACHE_OWNER_LIMIT
+#define QGLOBAL_PIXMAP_CACHE_OWNER_LIMIT (QGLOBAL_PIXMAP_CACHE_LIMIT / 2)
+#endif
+
 class QTOPIABASE_EXPORT QGlobalPixmapCache
 {
 public:
     static bool find( const QString &key, QPixmap &pixmap );
     static bool insert( const QString &key, const QPixmap &pixmap );
     static void remove( const QString &key );
+    static bool setPinned( const QString &key, bool pinned );
 };
 
 
@@ -40,4 +40,11 @@ void QGlobalPixmapCache::remove( const QString &key )
     Q_UNUSED(key);
 }
 
+bool QGlobalPixmapCache::setPinned( const QString &key, bool pinned )
+{
+    Q_UNUSED(key);
+    Q_UNUSED(pinned);
+    return false;
+}
+
 #endif // Q_WS_X11
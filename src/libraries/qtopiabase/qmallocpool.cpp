@@ -36,12 +36,53 @@ static struct malloc_state * qmallocpool_state(QMallocPoolPrivate *);
 #include "dlmalloc.c"
 #include <strings.h>
 
+/*
+   Small allocations are served from slabs.  A slab is a SLAB_SIZE aligned block
+   allocated from dlmalloc and divided into objects of a single size class.
+   Each size class keeps a list of the slabs with free objects, and each slab
+   keeps a list of its free objects, so allocating or freeing an object is
+   O(1).  Whether a pointer belongs to a slab is recorded in a bitmap with a
+   bit for each SLAB_SIZE block of the pool.
+ */
+#define SLAB_SIZE 4096
+#define SLAB_MAX_OBJECT_SIZE 256
+#define SLAB_CLASS_COUNT 10
+#define SLAB_MAP_BYTES(poolLength) (((poolLength) / SLAB_SIZE + 2 + 7) / 8)
+
+static const unsigned short slabClassSizes[SLAB_CLASS_COUNT] =
+    { 8, 16, 24, 32, 48, 64, 96, 128, 192, 256 };
+
+// Size class for each multiple of 8 bytes up to SLAB_MAX_OBJECT_SIZE
+static const unsigned char slabClassIndex[SLAB_MAX_OBJECT_SIZE / 8 + 1] =
+    { 0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+      8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9 };
+
+struct QMallocSlab
+{
+    QMallocSlab *next;
+    QMallocSlab *prev;
+    void *freeList;
+    unsigned short sizeClass;
+    unsigned short inuse;
+    unsigned short capacity;
+};
+
+#define SLAB_HEADER_SIZE ((sizeof(QMallocSlab) + 7) & ~7)
+
+struct QMallocSlabState
+{
+    QMallocSlab *partial[SLAB_CLASS_COUNT];
+    unsigned long slabCount;
+    unsigned long inuseBytes;
+};
+
 class QMallocPoolPrivate
 {
 public:
     QMallocPoolPrivate(void * _pool, unsigned int _poolLen,
                        QMallocPool::PoolType type, const QString &_name)
-        : name(_name), pool((char *)_pool), poolLength(_poolLen), poolPtr(0)
+        : name(_name), pool((char *)_pool), poolLength(_poolLen), poolPtr(0),
+          ownedSlabMap(0)
     {
         Q_ASSERT(pool);
         Q_ASSERT(poolLength > 0);
@@ -49,28 +90,171 @@ public:
         if(QMallocPool::Owned == type) {
             ::bzero(&owned_mstate, sizeof(struct malloc_state));
             mstate = &owned_mstate;
-        } else if(QMallocPool::NewShared == type) {
-            Q_ASSERT(poolLength >= sizeof(struct malloc_state));
-            ::bzero(pool, sizeof(struct malloc_state));
-            mstate = (struct malloc_state *)pool;
-            pool += sizeof(struct malloc_state);
-            poolLength -= sizeof(struct malloc_state);
-        } else if(QMallocPool::Shared == type) {
-            Q_ASSERT(poolLength >= sizeof(struct malloc_state));
+            ::bzero(&owned_slabs, sizeof(QMallocSlabState));
+            slabs = &owned_slabs;
+            ownedSlabMap = new unsigned char[SLAB_MAP_BYTES(poolLength)];
+            ::bzero(ownedSlabMap, SLAB_MAP_BYTES(poolLength));
+            slabMap = ownedSlabMap;
+        } else {
+            // The slab state and map are stored after the malloc state so
+            // they are shared along with it.
+            const unsigned int headerLength = sharedHeaderLength(poolLength);
+            Q_ASSERT(poolLength >= headerLength);
+            if(QMallocPool::NewShared == type)
+                ::bzero(pool, headerLength);
             mstate = (struct malloc_state *)pool;
-            pool += sizeof(struct malloc_state);
-            poolLength -= sizeof(struct malloc_state);
+            slabs = (QMallocSlabState *)(pool + sizeof(struct malloc_state));
+            slabMap = (unsigned char *)(slabs + 1);
+            pool += headerLength;
+            poolLength -= headerLength;
         }
+
+        slabBase = (unsigned long)pool & ~(unsigned long)(SLAB_SIZE - 1);
+    }
+
+    ~QMallocPoolPrivate()
+    {
+        delete [] ownedSlabMap;
+    }
+
+    static unsigned int sharedHeaderLength(unsigned int poolLength)
+    {
+        unsigned int length = sizeof(struct malloc_state) +
+                              sizeof(QMallocSlabState) +
+                              SLAB_MAP_BYTES(poolLength);
+        return (length + 7) & ~7;
+    }
+
+    inline bool isSlabObject(void *ptr) const
+    {
+        unsigned long index = ((unsigned long)ptr - slabBase) / SLAB_SIZE;
+        return (unsigned long)ptr >= slabBase &&
+               index < (unsigned long)(SLAB_MAP_BYTES(poolLength) * 8) &&
+               (slabMap[index / 8] & (1 << (index % 8)));
+    }
+
+    inline QMallocSlab *slabFor(void *ptr) const
+    {
+        return (QMallocSlab *)((unsigned long)ptr & ~(unsigned long)(SLAB_SIZE - 1));
     }
 
+    inline void markSlab(QMallocSlab *slab, bool used)
+    {
+        unsigned long index = ((unsigned long)slab - slabBase) / SLAB_SIZE;
+        if(used)
+            slabMap[index / 8] |= (1 << (index % 8));
+        else
+            slabMap[index / 8] &= ~(1 << (index % 8));
+    }
+
+    void *slabAlloc(size_t size);
+    void slabFree(void *ptr);
+
     QString name;
     char * pool;
     unsigned int poolLength;
     unsigned int poolPtr;
     struct malloc_state *mstate;
     struct malloc_state owned_mstate;
+    QMallocSlabState *slabs;
+    QMallocSlabState owned_slabs;
+    unsigned char *slabMap;
+    unsigned char *ownedSlabMap;
+    unsigned long slabBase;
 };
 
+/*
+   Allocates an object of at least \a size bytes from a slab, or returns 0 if
+   a new slab is needed and can't be allocated.  The pool must be current.
+ */
+void *QMallocPoolPrivate::slabAlloc(size_t size)
+{
+    const int sizeClass = slabClassIndex[(size + 7) / 8];
+
+    QMallocSlab *slab = slabs->partial[sizeClass];
+    if(!slab) {
+        slab = (QMallocSlab *)dlmemalign(SLAB_SIZE, SLAB_SIZE - SIZE_SZ * 2);
+        if(!slab)
+            return 0;
+
+        const unsigned int objectSize = slabClassSizes[sizeClass];
+
+        slab->next = 0;
+        slab->prev = 0;
+        slab->sizeClass = sizeClass;
+        slab->inuse = 0;
+        // Objects must lie within the slab's SLAB_SIZE block for slabFor() to
+        // find their slab, even if dlmalloc returned a larger chunk.
+        const size_t usable = qMin((size_t)dlmalloc_usable_size(slab), (size_t)SLAB_SIZE);
+        slab->capacity = (usable - SLAB_HEADER_SIZE) / objectSize;
+        slab->freeList = 0;
+
+        char *object = (char *)slab + SLAB_HEADER_SIZE +
+                       (slab->capacity - 1) * objectSize;
+        for(int ii = 0; ii < slab->capacity; ++ii, object -= objectSize) {
+            *(void **)object = slab->freeList;
+            slab->freeList = object;
+        }
+
+        markSlab(slab, true);
+        slabs->partial[sizeClass] = slab;
+        ++slabs->slabCount;
+    }
+
+    void *object = slab->freeList;
+    slab->freeList = *(void **)object;
+    ++slab->inuse;
+    slabs->inuseBytes += slabClassSizes[sizeClass];
+
+    if(!slab->freeList) {
+        // Full slabs are removed from the partial list until an object is freed
+        slabs->partial[sizeClass] = slab->next;
+        if(slab->next)
+            slab->next->prev = 0;
+        slab->next = 0;
+    }
+
+    return object;
+}
+
+/*
+   Returns \a ptr to its slab, releasing the slab if it is no longer used and
+   there is another slab with free objects of the same size.  The pool must be
+   current.
+ */
+void QMallocPoolPrivate::slabFree(void *ptr)
+{
+    QMallocSlab *slab = slabFor(ptr);
+    const int sizeClass = slab->sizeClass;
+
+    const bool wasFull = !slab->freeList;
+    *(void **)ptr = slab->freeList;
+    slab->freeList = ptr;
+    --slab->inuse;
+    slabs->inuseBytes -= slabClassSizes[sizeClass];
+
+    if(wasFull) {
+        slab->prev = 0;
+        slab->next = slabs->partial[sizeClass];
+        if(slab->next)
+            slab->next->prev = slab;
+        slabs->partial[sizeClass] = slab;
+    }
+
+    if(0 == slab->inuse && (slab->prev || slab->next)) {
+        if(slab->prev)
+            slab->prev->next = slab->next;
+        else
+            slabs->partial[sizeClass] = slab->next;
+        if(slab->next)
+            slab->next->prev = slab->prev;
+
+        markSlab(slab, false);
+        --slabs->slabCount;
+        dlfree(slab);
+    }
+}
+
 static struct malloc_state * qmallocpool_state(QMallocPoolPrivate *d)
 {
     Q_ASSERT(d);
@@ -134,6 +318,11 @@ struct QMallocPtr
   written by Doug Lea.  dlmalloc is used as the default allocator in many
   projects, including several versions of Linux libc.
 
+  Allocations of up to 256 bytes are made from slabs, blocks of the pool
+  divided into objects of a single size, which are allocated and freed in
+  constant time and avoid fragmenting the pool with many small free blocks.
+  Larger allocations are made directly by dlmalloc.
+
   QMallocPool is not thread safe.
 
   \ingroup misc
@@ -191,7 +380,7 @@ QMallocPool::QMallocPool(void * poolBase, unsigned int poolLength,
 : d(0)
 {
     if((type == NewShared || Shared == type) &&
-            poolLength < sizeof(struct malloc_state))
+            poolLength < QMallocPoolPrivate::sharedHeaderLength(poolLength))
         return;
 
     d = new QMallocPoolPrivate(poolBase, poolLength, type, name);
@@ -213,6 +402,9 @@ QMallocPool::~QMallocPool()
   */
 size_t QMallocPool::size_of(void *mem)
 {
+    Q_ASSERT(d && "Cannot operate on a null malloc pool");
+    if(d->isSlabObject(mem))
+        return slabClassSizes[d->slabFor(mem)->sizeClass];
     return chunksize(mem2chunk(mem)) - sizeof(mchunkptr);
 }
 
@@ -225,6 +417,16 @@ void *QMallocPool::calloc(size_t nmemb, size_t size)
 {
     Q_ASSERT(d && "Cannot operate on a null malloc pool");
     QMallocPtr p(d);
+    if(size && nmemb <= SLAB_MAX_OBJECT_SIZE / size) {
+        const size_t bytes = nmemb * size;
+        if(bytes) {
+            void *rv = d->slabAlloc(bytes);
+            if(rv) {
+                ::memset(rv, 0, bytes);
+                return rv;
+            }
+        }
+    }
     return dlcalloc(nmemb, size);
 }
 
@@ -236,6 +438,11 @@ void *QMallocPool::malloc(size_t size)
 {
     Q_ASSERT(d && "Cannot operate on a null malloc pool");
     QMallocPtr p(d);
+    if(size && size <= SLAB_MAX_OBJECT_SIZE) {
+        void *rv = d->slabAlloc(size);
+        if(rv)
+            return rv;
+    }
     return dlmalloc(size);
 }
 
@@ -249,7 +456,10 @@ void QMallocPool::free(void *ptr)
 {
     Q_ASSERT(d && "Cannot operate on a null malloc pool");
     QMallocPtr p(d);
-    dlfree(ptr);
+    if(ptr && d->isSlabObject(ptr))
+        d->slabFree(ptr);
+    else
+        dlfree(ptr);
 }
 
 /*!
@@ -265,7 +475,28 @@ void *QMallocPool::realloc(void *ptr, size_t size)
 {
     Q_ASSERT(d && "Cannot operate on a null malloc pool");
     QMallocPtr p(d);
-    return dlrealloc(ptr, size);
+    if(!ptr || !d->isSlabObject(ptr))
+        return dlrealloc(ptr, size);
+
+    if(!size) {
+        d->slabFree(ptr);
+        return 0;
+    }
+
+    const size_t oldSize = slabClassSizes[d->slabFor(ptr)->sizeClass];
+    if(size <= oldSize && size > oldSize / 2)
+        return ptr;
+
+    void *rv = 0;
+    if(size <= SLAB_MAX_OBJECT_SIZE)
+        rv = d->slabAlloc(size);
+    if(!rv)
+        rv = dlmalloc(size);
+    if(rv) {
+        ::memcpy(rv, ptr, qMin(oldSize, size));
+        d->slabFree(ptr);
+    }
+    return rv;
 }
 
 /*!
@@ -294,8 +525,25 @@ void QMallocPool::dumpStats() const
     qLog(ILFramework) << "    System Bytes     =" << (unsigned long)info.arena;
     qLog(ILFramework) << "    In use bytes     =" << (unsigned long)info.uordblks;
     qLog(ILFramework) << "    Keep cost        =" << (unsigned long)info.keepcost;
+    qLog(ILFramework) << "    Free bytes       =" << (unsigned long)info.fordblks;
+    qLog(ILFramework) << "    Free chunks      =" << (unsigned long)info.ordblks;
+    qLog(ILFramework) << "    Slab bytes       =" << d->slabs->slabCount * SLAB_SIZE;
+    qLog(ILFramework) << "    Slab in use bytes=" << d->slabs->inuseBytes;
 }
 
+/*!
+  \class QMallocPool::MemoryStats
+    \inpublicgroup QtBaseModule
+  \brief The MemoryStats structure describes the memory use of a QMallocPool.
+
+  \c poolSize is the size of the managed region, \c maxSystemBytes and
+  \c systemBytes are the largest and current amounts of the region claimed
+  for allocations, \c inuseBytes is the amount allocated and \c keepCost is
+  the amount that could be released from the end of the claimed region.
+
+  \sa AllocationStats
+ */
+
 /*!
   Returns a MemoryStats structure containing information about the memory use
   of this pool.
@@ -315,3 +563,36 @@ QMallocPool::MemoryStats QMallocPool::memoryStatistics() const
     return rv;
 }
 
+/*!
+  \class QMallocPool::AllocationStats
+    \inpublicgroup QtBaseModule
+  \brief The AllocationStats structure describes how the memory of a QMallocPool is divided.
+
+  \c freeBytes and \c freeChunks are the total size and number of the free
+  blocks within the claimed region.  Many free chunks holding few bytes
+  indicates the pool is fragmented.  Allocations of up to 256 bytes are made
+  from slabs of same sized objects, \c slabBytes is the memory held by
+  slabs and \c slabInuseBytes the amount allocated from them.  Slab memory
+  is counted as in use in MemoryStats::inuseBytes.
+
+  \sa MemoryStats
+ */
+
+/*!
+  Returns an AllocationStats structure describing the free blocks and slabs
+  of this pool.
+ */
+QMallocPool::AllocationStats QMallocPool::allocationStatistics() const
+{
+    Q_ASSERT(d && "Cannot operate on a null malloc pool");
+    QMallocPtr p(d);
+
+    struct mallinfo info = dlmallinfo();
+
+    AllocationStats rv = { (unsigned long)info.fordblks,
+                           (unsigned long)info.ordblks,
+                           d->slabs->slabCount * SLAB_SIZE,
+                           d->slabs->inuseBytes };
+    return rv;
+}
+
@@ -52,6 +52,14 @@ public:
         unsigned long keepCost;
     };
     MemoryStats memoryStatistics() const;
+
+    struct AllocationStats {
+        unsigned long freeBytes;
+        unsigned long freeChunks;
+        unsigned long slabBytes;
+        unsigned long slabInuseBytes;
+    };
+    AllocationStats allocationStatistics() const;
     void dumpStats() const;
 
 private:
@@ -79,6 +79,44 @@
   p >> a >> b;
   \endcode
 
+  \section1 Large packets
+
+  By default each packet is buffered in memory until it has been received
+  completely.  For packets carrying large amounts of data, such as files, a
+  streaming threshold can be set with setStreamingThreshold().  Packets at
+  least that large are not buffered; instead their data is delivered through
+  the packetChunk() signal as it arrives.  Smaller packets are still read with
+  read().
+
+  \code
+  protocol.setStreamingThreshold(64 * 1024);
+  connect(&protocol, SIGNAL(packetChunk(QByteArray,qint32,qint32)),
+          this, SLOT(writeToFile(QByteArray,qint32,qint32)));
+  \endcode
+
+  Streamed packets are sent like any other packet, but the data of a streamed
+  packet is raw bytes rather than QDataStream encoded values, so senders of
+  large data should write it with QPacket::writeRawData().
+
+  On the sending side, send() never blocks and queues the data in the
+  device.  To avoid queuing unbounded amounts of data, senders can set a
+  high water mark with setSendHighWaterMark().  Once more than that many
+  bytes are waiting to be written isWritable() returns false, and the
+  writable() signal is emitted when the queue has drained to half the
+  high water mark.
+
+  \code
+  void Sender::sendMore()
+  {
+      while (protocol.isWritable() && !file.atEnd()) {
+          QPacket packet;
+          QByteArray data = file.read(64 * 1024);
+          packet.writeRawData(data.constData(), data.size());
+          protocol.send(packet);
+      }
+  }
+  \endcode
+
   \ingroup io
   \sa QPacket
 */
@@ -89,7 +127,8 @@ Q_OBJECT
 public:
     QPacketProtocolPrivate(QPacketProtocol * parent, QIODevice * _dev)
     : QObject(parent), inProgressSize(-1), maxPacketSize(MAX_PACKET_SIZE),
-      dev(_dev)
+      streamThreshold(-1), streaming(false), streamedBytes(0), pendingBytes(0),
+      highWaterMark(0), aboveHighWater(false), dev(_dev)
     {
         Q_ASSERT(4 == sizeof(qint32));
 
@@ -99,6 +138,10 @@ public:
                          parent, SIGNAL(packetWritten()));
         QObject::connect(this, SIGNAL(invalidPacket()),
                          parent, SIGNAL(invalidPacket()));
+        QObject::connect(this, SIGNAL(packetChunk(QByteArray,qint32,qint32)),
+                         parent, SIGNAL(packetChunk(QByteArray,qint32,qint32)));
+        QObject::connect(this, SIGNAL(writable()),
+                         parent, SIGNAL(writable()));
         QObject::connect(dev, SIGNAL(readyRead()),
                          this, SLOT(readyToRead()));
         QObject::connect(dev, SIGNAL(aboutToClose()),
@@ -111,6 +154,8 @@ signals:
     void readyRead();
     void packetWritten();
     void invalidPacket();
+    void packetChunk(const QByteArray &, qint32, qint32);
+    void writable();
 
 public slots:
     void aboutToClose()
@@ -118,12 +163,22 @@ public slots:
         inProgress.clear();
         sendingPackets.clear();
         inProgressSize = -1;
+        streaming = false;
+        streamedBytes = 0;
+        pendingBytes = 0;
+        aboveHighWater = false;
     }
 
     void bytesWritten(qint64 bytes)
     {
         Q_ASSERT(!sendingPackets.isEmpty());
 
+        pendingBytes -= bytes;
+        if(aboveHighWater && pendingBytes <= highWaterMark / 2) {
+            aboveHighWater = false;
+            emit writable();
+        }
+
         while(bytes) {
             if(sendingPackets.at(0) > bytes) {
                 sendingPackets[0] -= bytes;
@@ -148,8 +203,10 @@ public slots:
             Q_ASSERT(read == sizeof(qint32));
             Q_UNUSED(read);
 
-            // Check sizing constraints
-            if(inProgressSize > maxPacketSize) {
+            // Check sizing constraints.  Streamed packets are never buffered,
+            // so the maximum packet size does not apply to them.
+            if(inProgressSize > maxPacketSize &&
+               !isStreamed(inProgressSize - sizeof(qint32))) {
                 QObject::disconnect(dev, SIGNAL(readyRead()),
                                     this, SLOT(readyToRead()));
                 QObject::disconnect(dev, SIGNAL(aboutToClose()),
@@ -163,8 +220,32 @@ public slots:
 
             inProgressSize -= sizeof(qint32);
 
+            // Threshold changes take effect from the next packet header, as
+            // a packet is either entirely streamed or entirely buffered
+            streaming = inProgressSize > 0 && isStreamed(inProgressSize);
+
             // Need to get trailing data
             readyToRead();
+        } else if(streaming) {
+            // Deliver the data as it arrives instead of buffering it
+            QByteArray chunk = dev->read(inProgressSize - streamedBytes);
+            if(chunk.isEmpty())
+                return;
+
+            qint32 offset = streamedBytes;
+            qint32 size = inProgressSize;
+            streamedBytes += chunk.size();
+            if(streamedBytes == inProgressSize) {
+                inProgressSize = -1;
+                streaming = false;
+                streamedBytes = 0;
+            }
+
+            emit packetChunk(chunk, offset, size);
+
+            // Need to get trailing data
+            if(-1 == inProgressSize)
+                readyToRead();
         } else {
             inProgress.append(dev->read(inProgressSize - inProgress.size()));
 
@@ -183,11 +264,22 @@ public slots:
     }
 
 public:
+    bool isStreamed(qint32 size) const
+    {
+        return -1 != streamThreshold && size >= streamThreshold;
+    }
+
     QList<qint64> sendingPackets;
     QList<QByteArray> packets;
     QByteArray inProgress;
     qint32 inProgressSize;
     qint32 maxPacketSize;
+    qint32 streamThreshold;
+    bool streaming;
+    qint32 streamedBytes;
+    qint64 pendingBytes;
+    qint64 highWaterMark;
+    bool aboveHighWater;
     QIODevice * dev;
 };
 
@@ -234,6 +326,85 @@ qint32 QPacketProtocol::setMaximumPacketSize(qint32 max)
     return d->maxPacketSize;
 }
 
+/*!
+  Returns the size from which received packets are delivered through the
+  packetChunk() signal instead of being buffered, or -1 if all packets are
+  buffered.  By default all packets are buffered.
+
+  \sa setStreamingThreshold()
+ */
+qint32 QPacketProtocol::streamingThreshold() const
+{
+    return d->streamThreshold;
+}
+
+/*!
+  Sets the size from which received packets are streamed to \a size bytes
+  of packet data.  Packets of at least \a size bytes are delivered in pieces
+  through the packetChunk() signal as their data arrives, and are not
+  returned by read().  If \a size is -1, all packets are buffered.
+
+  As streamed packets are not held in memory, they may be larger than
+  maximumPacketSize().
+
+  The new threshold applies from the next packet received.  A packet that
+  is partially received when the threshold is changed is delivered in the
+  same way as its earlier data.
+
+  \sa streamingThreshold(), packetChunk()
+ */
+void QPacketProtocol::setStreamingThreshold(qint32 size)
+{
+    d->streamThreshold = size < 0 ? -1 : size;
+}
+
+/*!
+  Returns the number of queued bytes above which isWritable() returns
+  false, or 0 if there is no limit.  By default there is no limit.
+
+  \sa setSendHighWaterMark()
+ */
+qint64 QPacketProtocol::sendHighWaterMark() const
+{
+    return d->highWaterMark;
+}
+
+/*!
+  Sets the number of bytes that may be waiting to be written to the device
+  before isWritable() returns false to \a bytes.  Once the queue has drained
+  to half of \a bytes the writable() signal is emitted.  If \a bytes is 0
+  there is no limit.
+
+  The high water mark is advisory; send() always queues the packet.
+
+  \sa sendHighWaterMark(), isWritable(), writable()
+ */
+void QPacketProtocol::setSendHighWaterMark(qint64 bytes)
+{
+    d->highWaterMark = qMax(qint64(0), bytes);
+    d->aboveHighWater = d->highWaterMark && d->pendingBytes > d->highWaterMark;
+}
+
+/*!
+  Returns the number of bytes sent with send() that have not yet been
+  written to the device.
+ */
+qint64 QPacketProtocol::bytesToWrite() const
+{
+    return d->pendingBytes;
+}
+
+/*!
+  Returns true if no more than sendHighWaterMark() bytes are waiting to be
+  written, or if there is no high water mark.
+
+  \sa setSendHighWaterMark(), writable()
+ */
+bool QPacketProtocol::isWritable() const
+{
+    return !d->highWaterMark || d->pendingBytes <= d->highWaterMark;
+}
+
 /*!
   Returns a streamable object that is transmitted on destruction.  For example
 
@@ -262,6 +433,9 @@ void QPacketProtocol::send(const QPacket & p)
     qint64 sendSize = p.b.size() + sizeof(qint32);
 
     d->sendingPackets.append(sendSize);
+    d->pendingBytes += sendSize;
+    if(d->highWaterMark && d->pendingBytes > d->highWaterMark)
+        d->aboveHighWater = true;
     qint32 sendSize32 = sendSize;
     qint64 writeBytes = d->dev->write((char *)&sendSize32, sizeof(qint32));
     Q_ASSERT(writeBytes == sizeof(qint32));
@@ -329,6 +503,26 @@ QIODevice * QPacketProtocol::device()
   may be used for communications flow control.
  */
 
+/*!
+  \fn void QPacketProtocol::packetChunk(const QByteArray &data, qint32 offset, qint32 size)
+
+  Emitted when \a data of a packet at least streamingThreshold() bytes large
+  has been received.  \a offset is the position of \a data within the
+  packet and \a size is the total size of the packet.  The packet is
+  complete when \c {offset + data.size() == size}.
+
+  \sa setStreamingThreshold()
+ */
+
+/*!
+  \fn void QPacketProtocol::writable()
+
+  Emitted when the data waiting to be written has drained to half of the
+  sendHighWaterMark() after isWritable() returned false.
+
+  \sa setSendHighWaterMark(), isWritable()
+ */
+
 /*!
   \class QPacket
     \inpublicgroup QtBaseModule
@@ -41,6 +41,14 @@ public:
     qint32 maximumPacketSize() const;
     qint32 setMaximumPacketSize(qint32);
 
+    qint32 streamingThreshold() const;
+    void setStreamingThreshold(qint32);
+
+    qint64 sendHighWaterMark() const;
+    void setSendHighWaterMark(qint64);
+    qint64 bytesToWrite() const;
+    bool isWritable() const;
+
     QPacketAutoSend send();
     void send(const QPacket &);
 
@@ -55,6 +63,8 @@ signals:
     void readyRead();
     void invalidPacket();
     void packetWritten();
+    void packetChunk(const QByteArray &, qint32, qint32);
+    void writable();
 
 private:
     QPacketProtocolPrivate * d;
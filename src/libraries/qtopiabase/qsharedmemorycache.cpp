@@ -58,6 +58,8 @@
 #include <time.h>
 #include <stdio.h>
 #include <signal.h>
+#include <errno.h>
+#include <unistd.h>
 
 #ifdef THROW_AWAY_UNUSED_PAGES
 # include <sys/mman.h> // madvise
@@ -116,7 +118,7 @@ private:
 #define SHM_ITEMS               1537        // 1537 entries
 #define MAX_SHM_ITEMS           1200        // only add 1200 entries,
                                             // don't fill so hash has spaces so it works
-#define MAX_SHM_FREE_ITEMS      100         // 100 entries
+#define MAX_SHM_OWNERS          32          // processes with a memory budget
 
 #define MAGIC_HASH_DELETED_VAL  -2
 
@@ -141,6 +143,17 @@ public:
 };
 */
 
+/*
+  Memory used by the items inserted by one process.  Once a process uses
+  more than QGLOBAL_PIXMAP_CACHE_OWNER_LIMIT bytes, not counting pinned
+  items, its own unreferenced items are evicted before anyone else's, so a
+  single application can't push everything else out of the cache.
+*/
+struct QSharedMemoryCacheOwner {
+    int pid;
+    int bytes;
+};
+
 class QSharedMemoryCacheData {
 public:
     // Cache version
@@ -151,24 +164,20 @@ public:
     int dataSize;
     int offsetsOffset;
     int offsetsSize;    // Size of the hash table
-    int freeItemsOffset;
-    int freeItemsSize;
 
     // Counts
     int maxItems;       // Max items allowed in the hash table
     int items;          // Current number of items in the hash table
-    int freeItemCount;  // Current number of items marked for deletion
+    int ownerLimit;     // Max bytes for the unpinned items of one process
+    int pinnedBytes;    // Bytes used by pinned items
+
+    // Position of the CLOCK hand in the hash table
+    int clockHand;
 
-    // Profiling data
-    int cacheFindHits;
-    int cacheFindMisses;
-    int cacheFindStrcmps;
-    int cacheInsertHits;
-    int cacheInsertMisses;
-    int cacheInsertStrcmps;
+    QSharedMemoryCacheStatistics stats;
 
     QSMemPtr offsets[SHM_ITEMS];                // Hash table
-    QSMemPtr freeItems[MAX_SHM_FREE_ITEMS+1];   // List of items marked for deletion
+    QSharedMemoryCacheOwner owners[MAX_SHM_OWNERS];
 };
 
 
@@ -178,70 +187,54 @@ public:
     ~QSharedMemoryCache() { }
 
     void init() {
-        d->version = 100;
+        d->version = 101;
         d->dataOffset = sizeof(QSharedMemoryCacheData) + 2*sizeof(QSMemNode);
         d->dataSize = QGLOBAL_PIXMAP_CACHE_LIMIT;
         d->offsetsOffset = (int)((char*)&d->offsets[0] - (char*)d);
         d->offsetsSize = SHM_ITEMS;
-        d->freeItemsOffset = (int)((char*)&d->freeItems[0] - (char*)d);
-        d->freeItemsSize = MAX_SHM_FREE_ITEMS;
         d->maxItems = MAX_SHM_ITEMS;
         d->items = 0;
-        d->freeItemCount = 0;
-        d->cacheFindHits = 0;
-        d->cacheFindMisses = 0;
-        d->cacheFindStrcmps = 0;
-        d->cacheInsertHits = 0;
-        d->cacheInsertMisses = 0;
-        d->cacheInsertStrcmps = 0;
+        d->ownerLimit = QGLOBAL_PIXMAP_CACHE_OWNER_LIMIT;
+        d->pinnedBytes = 0;
+        d->clockHand = 0;
+        memset(&d->stats, 0, sizeof(d->stats));
         for (int i = 0; i < SHM_ITEMS; i++)
             d->offsets[i] = -1;
         //memset(offsets,-1,SHM_ITEMS*sizeof(QSMemPtr));
+        memset(d->owners, 0, sizeof(d->owners));
     }
 
     QSMCacheItemPtr newItem(const char *key, int size, int type);
     QSMCacheItemPtr findItem(const char *key, bool ref, int type);
-    void freeItem(QSMCacheItem *item) {
-
-        CHECK_CONSISTENCY("Pre free item");
-        CHECK_CACHE_CONSISTENCY();
-        {
-            QLockHandle lh(qt_getSMManager()->lock(),QLock::Write);
-            if ( d->freeItemCount >= d->freeItemsSize )
-                if ( !cleanUp(false) )
-                    // all the items have been referenced again, clear the list
-                    d->freeItemCount = 0;
-#ifdef DEBUG_SHARED_MEMORY_CACHE
-            for (int i = 0; i < d->freeItemCount; i++) {
-                QSMemPtr ptr = d->freeItems[i];
-                QSMCacheItemPtr ptr2 = (QSMCacheItemPtr)ptr;
-                if ( ptr2.count() )
-                    qFatal("found item with references in free list: %s", ptr2.key() );
-                if ((char*)ptr == (char*)item)
-                    qFatal("found item already in free list: %s", ptr2.key() );
-            }
-#endif // DEBUG_SHARED_MEMORY_CACHE
-            d->freeItems[d->freeItemCount] = QSMemPtr((char*)item);
-            d->freeItemCount++;
-        }
-        CHECK_CACHE_CONSISTENCY();
-        CHECK_CONSISTENCY("Post free item");
-    }
+    void freeItem(QSMCacheItem *item);
+    void removeItem(const char *key);
+    bool setPinned(const char *key, bool pinned);
 
     bool cleanUp(bool needLock=true);
 
+    QSharedMemoryCacheStatistics statistics() const { return d->stats; }
+
 #ifdef DEBUG_SHARED_MEMORY_CACHE
     bool checkCacheConsistency();
 #endif
 
 private:
     void hash(const char *key, int &hash, int &inc);
-    bool cleanUp_internal();
+    int find_internal(const char *key) const;
+    int slotOf(QSMCacheItem *item) const;
+    void unlink(int slot);
+    void release(QSMCacheItem *item);
+    bool evict(int owner);
+    int ownerSlot(int pid);
 
     QSharedMemoryCacheData *d;
 };
 
 
+/*
+  Evicts one unreferenced, unpinned item from the cache, returns false if
+  there is none.
+*/
 bool QSharedMemoryCache::cleanUp(bool needLock)
 {
     CHECK_CONSISTENCY("Pre CleanUp");
@@ -249,9 +242,9 @@ bool QSharedMemoryCache::cleanUp(bool needLock)
     bool ret = false;
     if ( needLock ) {
         QLockHandle lh(qt_getSMManager()->lock(),QLock::Write);
-        ret = cleanUp_internal();
+        ret = evict(-1);
     } else {
-        ret = cleanUp_internal();
+        ret = evict(-1);
     }
     CHECK_CACHE_CONSISTENCY();
     CHECK_CONSISTENCY("Post CleanUp");
@@ -259,45 +252,242 @@ bool QSharedMemoryCache::cleanUp(bool needLock)
 }
 
 
-bool QSharedMemoryCache::cleanUp_internal()
+/*
+  Evicts one item using the CLOCK algorithm.  The hand sweeps the hash
+  table; unreferenced items that have been used since the hand last
+  passed them get a second chance, the first one that hasn't is evicted.
+  Items still referenced by a process or pinned are never evicted.  If
+  \a owner is not -1 only items inserted by that owner are considered.
+  Must be called with the write lock held.
+*/
+bool QSharedMemoryCache::evict(int owner)
+{
+    // Two sweeps clear all the second chances and visit every item again.
+    for ( int n = 0; n < 2 * SHM_ITEMS; n++ ) {
+        int slot = d->clockHand;
+        d->clockHand = (d->clockHand + 1) % SHM_ITEMS;
+
+        QSMemPtr memPtr = d->offsets[slot];
+        if ( !memPtr || (int)memPtr == MAGIC_HASH_DELETED_VAL )
+            continue;
+
+        QSMCacheItem *item = (QSMCacheItem*)(char*)memPtr;
+        if ( item->count || (item->flags & QSMCacheItem::Pinned) )
+            continue;
+        if ( owner != -1 && item->owner != owner )
+            continue;
+        if ( item->flags & QSMCacheItem::Referenced ) {
+            item->flags &= ~QSMCacheItem::Referenced;
+            continue;
+        }
+
+        qLog(SharedMemCache) << "evicting" << (char*)item->key << item->size << "bytes";
+        unlink(slot);
+        release(item);
+        d->stats.evictions++;
+        return true;
+    }
+    return false;
+}
+
+
+/*
+  Returns the hash table slot of \a key, or -1 if it is not in the cache.
+*/
+int QSharedMemoryCache::find_internal(const char *key) const
+{
+    int hashIndex, hashInc;
+    const_cast<QSharedMemoryCache*>(this)->hash(key, hashIndex, hashInc);
+    QSMemPtr memPtr = d->offsets[hashIndex];
+    while (memPtr) {
+        if ( (int)memPtr != MAGIC_HASH_DELETED_VAL ) {
+            QSMCacheItemPtr item(memPtr);
+            if ( !qstrcmp(key, item.key()) )
+                return hashIndex;
+        }
+        hashIndex = (hashIndex + hashInc) % SHM_ITEMS;
+        memPtr = d->offsets[hashIndex];
+    }
+    return -1;
+}
+
+
+/*
+  Returns the hash table slot holding \a item, or -1 if it has been
+  removed from the cache.
+*/
+int QSharedMemoryCache::slotOf(QSMCacheItem *item) const
+{
+    int hashIndex, hashInc;
+    const_cast<QSharedMemoryCache*>(this)->hash((char*)item->key, hashIndex, hashInc);
+    QSMemPtr memPtr = d->offsets[hashIndex];
+    while (memPtr) {
+        if ( (char*)memPtr == (char*)item )
+            return hashIndex;
+        hashIndex = (hashIndex + hashInc) % SHM_ITEMS;
+        memPtr = d->offsets[hashIndex];
+    }
+    return -1;
+}
+
+
+/*
+  Removes the item at \a slot from the hash table.  The item itself is
+  left alone.
+*/
+void QSharedMemoryCache::unlink(int slot)
+{
+    // See if next in hash table is null
+    int hashIndex, hashInc;
+    QSMCacheItemPtr delItem(d->offsets[slot]);
+    hash(delItem.key(), hashIndex, hashInc);
+    hashIndex = (slot + hashInc) % SHM_ITEMS;
+
+    if ( d->offsets[hashIndex] )
+        d->offsets[slot] = MAGIC_HASH_DELETED_VAL;
+    else
+        d->offsets[slot] = -1;
+
+    d->items--;
+}
+
+
+/*
+  Frees the memory of \a item, which must no longer be in the hash table
+  and must have no references.
+*/
+void QSharedMemoryCache::release(QSMCacheItem *item)
+{
+    if ( item->flags & QSMCacheItem::Pinned )
+        d->pinnedBytes -= item->size;
+    else if ( item->owner >= 0 && item->owner < MAX_SHM_OWNERS )
+        d->owners[item->owner].bytes -= item->size;
+
+    QSMCacheItemPtr(item).free();
+}
+
+
+/*
+  Returns the owner slot for process \a pid, or -1 if the owner table is
+  full.  Slots of processes that have exited are reused.
+*/
+int QSharedMemoryCache::ownerSlot(int pid)
 {
-    if ( !d->freeItemCount )
-       return false;
-
-    int releasedItems = 0;
-    for ( int i = 0; i < d->freeItemCount; i++ ) {
-       QSMCacheItemPtr item(d->freeItems[i]);
-        if (!item.count()) {
-           bool found = false;
-           for ( int j = 0; j < SHM_ITEMS; j++ ) {
-                if ( (char*)d->freeItems[i] == (char*)d->offsets[j] ) {
-                    // See if next in hash table is null
-                    int hashIndex, hashInc;
+    int unused = -1;
+    for ( int i = 0; i < MAX_SHM_OWNERS; i++ ) {
+        if ( d->owners[i].pid == pid )
+            return i;
+        if ( unused == -1 && d->owners[i].pid == 0 )
+            unused = i;
+    }
+
+    if ( unused == -1 ) {
+        for ( int i = 0; i < MAX_SHM_OWNERS; i++ ) {
+            if ( ::kill(d->owners[i].pid, 0) == -1 && errno == ESRCH ) {
+                // The remaining items of the exited process are no longer
+                // charged to anyone.
+                for ( int j = 0; j < SHM_ITEMS; j++ ) {
                     QSMemPtr memPtr = d->offsets[j];
-                    QSMCacheItemPtr delItem(memPtr);
-                    hash(delItem.key(), hashIndex, hashInc);
-                    hashIndex = (j + hashInc) % SHM_ITEMS;
-                    memPtr = d->offsets[hashIndex];
-
-                    if ( memPtr )
-                        d->offsets[j] = MAGIC_HASH_DELETED_VAL;
-                    else
-                        d->offsets[j] = -1;
-
-                    d->items--;
-                    found = true;
+                    if ( memPtr && (int)memPtr != MAGIC_HASH_DELETED_VAL ) {
+                        QSMCacheItem *item = (QSMCacheItem*)(char*)memPtr;
+                        if ( item->owner == i )
+                            item->owner = -1;
+                    }
                 }
-           }
-           item.free();
-           memmove(&d->freeItems[i],&d->freeItems[i+1],(d->freeItemCount-i)*sizeof(QSMemPtr));
-           d->freeItemCount--;
-           releasedItems++;
-           if ( releasedItems >= 3 )
-               break;
+                unused = i;
+                break;
+            }
         }
-     }
+        if ( unused == -1 )
+            return -1;
+    }
 
-    return (releasedItems >= 1);
+    d->owners[unused].pid = pid;
+    d->owners[unused].bytes = 0;
+    return unused;
+}
+
+
+/*
+  Called when the last reference to \a item is released.  Pixmaps stay in
+  the cache so they can be found again, and are evicted when the space is
+  needed.  Other items, and items that were removed from the cache while
+  they were still referenced, are freed.
+*/
+void QSharedMemoryCache::freeItem(QSMCacheItem *item)
+{
+    CHECK_CONSISTENCY("Pre free item");
+    CHECK_CACHE_CONSISTENCY();
+    {
+        QLockHandle lh(qt_getSMManager()->lock(),QLock::Write);
+        if ( item->count )
+            return; // referenced again meanwhile
+
+        if ( item->flags & QSMCacheItem::Orphaned ) {
+            release(item);
+        } else if ( item->type == QSMCacheItem::Pixmap ) {
+            item->flags |= QSMCacheItem::Referenced;
+        } else {
+            int slot = slotOf(item);
+            if ( slot != -1 )
+                unlink(slot);
+            release(item);
+        }
+    }
+    CHECK_CACHE_CONSISTENCY();
+    CHECK_CONSISTENCY("Post free item");
+}
+
+
+/*
+  Removes \a key from the cache.  The memory is freed immediately if no
+  process references it, otherwise when the last reference is released.
+*/
+void QSharedMemoryCache::removeItem(const char *key)
+{
+    QLockHandle lh(qt_getSMManager()->lock(),QLock::Write);
+
+    int slot = find_internal(key);
+    if ( slot == -1 )
+        return;
+
+    QSMCacheItem *item = (QSMCacheItem*)(char*)d->offsets[slot];
+    unlink(slot);
+    if ( item->count )
+        item->flags |= QSMCacheItem::Orphaned;
+    else
+        release(item);
+}
+
+
+/*
+  Sets whether the item for \a key is \a pinned.  Pinned items are never
+  evicted and don't count towards the budget of their owner.  Returns
+  false if \a key is not in the cache.
+*/
+bool QSharedMemoryCache::setPinned(const char *key, bool pinned)
+{
+    QLockHandle lh(qt_getSMManager()->lock(),QLock::Write);
+
+    int slot = find_internal(key);
+    if ( slot == -1 )
+        return false;
+
+    QSMCacheItem *item = (QSMCacheItem*)(char*)d->offsets[slot];
+    if ( pinned == bool(item->flags & QSMCacheItem::Pinned) )
+        return true;
+
+    int ownerBytes = pinned ? -item->size : item->size;
+    if ( item->owner >= 0 && item->owner < MAX_SHM_OWNERS )
+        d->owners[item->owner].bytes += ownerBytes;
+    d->pinnedBytes -= ownerBytes;
+
+    if ( pinned )
+        item->flags |= QSMCacheItem::Pinned;
+    else
+        item->flags &= ~QSMCacheItem::Pinned;
+
+    return true;
 }
 
 
@@ -519,6 +709,14 @@ QSharedMemoryManager::QSharedMemoryManager()
 
 QSharedMemoryManager::~QSharedMemoryManager()
 {
+    if ( qLogEnabled(SharedMemCache) ) {
+        QSharedMemoryCacheStatistics stats = statistics();
+        qLog(SharedMemCache) << "hits" << stats.hits << "misses" << stats.misses
+                             << "insertions" << stats.insertions
+                             << "failed insertions" << stats.insertFailures
+                             << "evictions" << stats.evictions;
+    }
+
     delete cache;
     // Detach from shared memory
     if ( qApp->type() == QApplication::GuiServer )
@@ -645,7 +843,7 @@ QSMemPtr QSharedMemoryManager::internal_alloc(int size)
         node = node->nextFree();
     }
 
-    qWarning("no free holes in shm");
+    qLog(SharedMemCache) << "no free holes in shm";
     return QSMemPtr();
 }
 
@@ -801,97 +999,100 @@ QSMCacheItemPtr QSharedMemoryCache::newItem(const char *key, int size, int type)
     CHECK_CACHE_CONSISTENCY();
 
     qLog(SharedMemCache) << "allocate for" <<  key;
-    bool retry = true;
-    while ( retry ) {
-        if ( d->items + 1 < d->maxItems ) {
-            QSMemPtr memPtr = qt_getSMManager()->alloc(size + sizeof(QSMCacheItem));
-            if ( memPtr ) {
-                qLog(SharedMemCache) << "Alloc mem at" << (uchar*)memPtr;
-                int strLen = strlen(key);
-                QSMCacheItem *item = (QSMCacheItem*)(char*)memPtr;
-                item->count = 1;
-                item->type = (QSMCacheItem::QSMCacheItemType)type;
-                item->key = qt_getSMManager()->alloc(strLen+1);
-                qLog(SharedMemCache) << "key at" << (uchar*)item->key << (int)item->key;
-                if (!item->key) {
-                    cleanUp();
-                    item->key = qt_getSMManager()->alloc(strLen+1);
-                    if (!item->key) {
-                        qt_getSMManager()->free(memPtr);
-#ifdef PROFILE_SHARED_MEMORY_CACHE
-                        d->cacheInsertMisses++;
-#endif
-                        return QSMCacheItemPtr();
-                    }
-                }
-                d->items++;
-                memcpy((char*)item->key, key, strLen+1);
-                QLockHandle lh(qt_getSMManager()->lock(),QLock::Write);
-                int hashIndex, hashInc;
-                hash(key, hashIndex, hashInc);
-                qLog(SharedMemCache) << "hash for"<< key << "is" <<hashIndex;
-                QSMemPtr memPtr2 = d->offsets[hashIndex];
-                qLog(SharedMemCache) << "new: starting item" << hashIndex << "has value"<<(int)memPtr2;
-                int firstReplaceHashIndex = -1;
-                while (memPtr2 && (int)memPtr2 != MAGIC_HASH_DELETED_VAL) {
-#ifdef PROFILE_SHARED_MEMORY_CACHE
-                    if ( firstReplaceHashIndex == -1 )
-                        d->cacheInsertStrcmps++;
-#endif
-                    QSMCacheItemPtr item(memPtr2);
-                    if ( firstReplaceHashIndex == -1 && !qstrcmp(key, item.key()) ) {
-                        // Well actually, can't just remove it because other processess may
-                        // have references to it, they perhaps have active pixmap data connected
-                        // to this shared memory, but it will go away when they release it and
-                        // it's refcount reaches 0. What we can do instead is make sure when
-                        // we look up in the cache we hit this new one first instead of the
-                        // old one, so we insert it earlier, ie swap the positions around in the
-                        // hash table to where we would put it otherwise.
-                        firstReplaceHashIndex = hashIndex;
-
-                        // As we are replacing the old pixmap, deference it as there should
-                        // only be one reference for both pixmaps after an
-                        // QGlobalPixmapCache::insert(), as QGlobalPixmapCache::remove()
-                        // must remove it from the cache.
-                        item.deref();
-                    }
 
-                    hashIndex = (hashIndex + hashInc) % SHM_ITEMS;
-                    memPtr2 = d->offsets[hashIndex];
-                    qLog(SharedMemCache) << "new: next item" << hashIndex << "has value" << (int)memPtr2;
-                }
-                qLog(SharedMemCache) << "new: using item" << hashIndex << "with value" << (int)memPtr2;
-                if ( firstReplaceHashIndex != -1 ) {
-                    d->offsets[hashIndex] = d->offsets[firstReplaceHashIndex];
-                    d->offsets[firstReplaceHashIndex] = memPtr;
-                } else {
-                    d->offsets[hashIndex] = memPtr;
-                }
+    QLockHandle lh(qt_getSMManager()->lock(),QLock::Write);
 
-                CHECK_CACHE_CONSISTENCY();
-#ifdef PROFILE_SHARED_MEMORY_CACHE
-                d->cacheInsertHits++;
-#endif
-                qLog(SharedMemCache) << "allocated" << key << "to index" <<hashIndex;
-                return QSMCacheItemPtr(item);
-            }
+    // If two items are inserted with the same key the last one replaces
+    // the first.  Processes using the old one keep it until they release it.
+    int slot = find_internal(key);
+    if ( slot != -1 ) {
+        QSMCacheItem *old = (QSMCacheItem*)(char*)d->offsets[slot];
+        unlink(slot);
+        if ( old->count )
+            old->flags |= QSMCacheItem::Orphaned;
+        else
+            release(old);
+    }
+
+    int strLen = strlen(key);
+    int itemSize = size + sizeof(QSMCacheItem) + strLen + 1;
+
+    // Make room within the budget of this process first.  The new item is
+    // referenced by its creator, so it can't be evicted until released; an
+    // item larger than the budget is still placed if the cache has room.
+    // It may be pinned afterwards, which takes it out of the budget.
+    int owner = ownerSlot(::getpid());
+    if ( owner != -1 ) {
+        while ( d->owners[owner].bytes + itemSize > d->ownerLimit && evict(owner) )
+            ;
+        if ( d->owners[owner].bytes + itemSize > d->ownerLimit )
+            qLog(SharedMemCache) << "budget of" << d->ownerLimit << "bytes exceeded for" << key;
+    }
+
+    while ( d->items + 1 >= d->maxItems && evict(-1) )
+        ;
+
+    QSMemPtr memPtr;
+    QSMemPtr keyPtr;
+    if ( d->items + 1 < d->maxItems ) {
+        forever {
+            if ( !memPtr )
+                memPtr = qt_getSMManager()->alloc(size + sizeof(QSMCacheItem), false);
+            if ( memPtr && !keyPtr )
+                keyPtr = qt_getSMManager()->alloc(strLen+1, false);
+            if ( (memPtr && keyPtr) || !evict(-1) )
+                break;
         }
+    }
+
+    if ( !memPtr || !keyPtr ) {
         qWarning("error allocing %i bytes", size);
-        retry = cleanUp();
+        if ( memPtr )
+            qt_getSMManager()->free(memPtr, false);
+        d->stats.insertFailures++;
+        CHECK_CACHE_CONSISTENCY();
+        return QSMCacheItemPtr();
+    }
+
+    qLog(SharedMemCache) << "Alloc mem at" << (uchar*)memPtr;
+    QSMCacheItem *item = (QSMCacheItem*)(char*)memPtr;
+    item->count = 1;
+    item->type = (QSMCacheItem::QSMCacheItemType)type;
+    item->flags = 0;
+    item->owner = owner;
+    item->size = itemSize;
+    item->key = keyPtr;
+    qLog(SharedMemCache) << "key at" << (uchar*)item->key << (int)item->key;
+    memcpy((char*)item->key, key, strLen+1);
+
+    if ( owner != -1 )
+        d->owners[owner].bytes += itemSize;
+
+    int hashIndex, hashInc;
+    hash(key, hashIndex, hashInc);
+    qLog(SharedMemCache) << "hash for"<< key << "is" <<hashIndex;
+    QSMemPtr memPtr2 = d->offsets[hashIndex];
+    while (memPtr2 && (int)memPtr2 != MAGIC_HASH_DELETED_VAL) {
+        hashIndex = (hashIndex + hashInc) % SHM_ITEMS;
+        memPtr2 = d->offsets[hashIndex];
+        qLog(SharedMemCache) << "new: next item" << hashIndex << "has value" << (int)memPtr2;
     }
+    d->offsets[hashIndex] = memPtr;
+    d->items++;
+    d->stats.insertions++;
 
     CHECK_CACHE_CONSISTENCY();
-#ifdef PROFILE_SHARED_MEMORY_CACHE
-    d->cacheInsertMisses++;
-#endif
-    return QSMCacheItemPtr();
+    qLog(SharedMemCache) << "allocated" << key << "to index" <<hashIndex;
+    return QSMCacheItemPtr(item);
 }
 
 
 // Optimization: "type" is currently ignored, but could be used to find the hash table to look in
 QSMCacheItemPtr QSharedMemoryCache::findItem(const char *keyStr, bool ref, int /*type*/)
 {
-    QLockHandle lh(qt_getSMManager()->lock(),QLock::Read);
+    // A hit updates the reference count, the eviction flag and the
+    // statistics in shared memory, so lookups can't share the lock.
+    QLockHandle lh(qt_getSMManager()->lock(),QLock::Write);
 
     CHECK_CACHE_CONSISTENCY();
 
@@ -906,31 +1107,14 @@ QSMCacheItemPtr QSharedMemoryCache::findItem(const char *keyStr, bool ref, int /
             QSMCacheItemPtr item(memPtr);
             qLog(SharedMemCache) << "key" << keyStr << "index:"<< hashIndex << "item" << (int)memPtr << "mem" << (uchar*)memPtr;
             qLog(SharedMemCache) << "comparing" << keyStr << "with" << item.key() << "(" << (int)((QSMCacheItem*)item)->key << (uchar*)((QSMCacheItem*)item)->key << ") (hash:" << hashIndex << ")";
-#ifdef PROFILE_SHARED_MEMORY_CACHE
-            d->cacheFindStrcmps++;
-#endif
             if ( !qstrcmp(keyStr, item.key()) ) {
-                // Item was deref'd and put in free list, remove from free list
-                if ( item.count() == 0 ) {
-                    for ( int i = 0; i < d->freeItemCount; i++ ) {
-                        if ((int)d->freeItems[i] == (int)memPtr) {
-#ifdef DEBUG_SHARED_MEMORY_CACHE
-                            qWarning("found %s in the free list, fixing up the free list", item.key());
-#endif
-                            memmove(&d->freeItems[i],&d->freeItems[i+1],(d->freeItemCount-i)*sizeof(QSMemPtr));
-                            d->freeItemCount--;
-                            break;
-                        }
-                    }
-                }
                 if ( ref )
                     item.ref();
+                ((QSMCacheItem*)item)->flags |= QSMCacheItem::Referenced;
                 qLog(SharedMemCache) << "using: using item " << hashIndex << " with value " << (int)memPtr;
                 qLog(SharedMemCache) << "found " << item.key() << " (hash: " << hashIndex << " refcount: " << item.count();
                 CHECK_CACHE_CONSISTENCY();
-#ifdef PROFILE_SHARED_MEMORY_CACHE
-                d->cacheFindHits++;
-#endif
+                d->stats.hits++;
                 return item;
             }
         }
@@ -940,9 +1124,7 @@ QSMCacheItemPtr QSharedMemoryCache::findItem(const char *keyStr, bool ref, int /
     }
 
     CHECK_CACHE_CONSISTENCY();
-#ifdef PROFILE_SHARED_MEMORY_CACHE
-    d->cacheFindMisses++;
-#endif
+    d->stats.misses++;
     qLog(SharedMemCache) << "didn't find" << keyStr << "(hash:" << hashIndex << ")";
     return QSMCacheItemPtr();
 }
@@ -1060,19 +1242,25 @@ bool QSharedMemoryManager::insertPixmap(const QString& k, const QPixmap &pm)
 // removes a pixmap from the shared memory cache
 void QSharedMemoryManager::removePixmap(const QString &k)
 {
-    qLog(SharedMemCache) << "search for" << k;
+    qLog(SharedMemCache) << "remove" << k;
 
-    if ( isGlobalPixmap(k) ) {
-        // Get the cache item, but don't increment the reference count
-        QSMCacheItemPtr cacheItem = cache->findItem(k.toLatin1().data(),
-                                                    false,
-                                                    QSMCacheItem::Pixmap);
-        if ( (QSMCacheItem*)cacheItem == 0 ) {
-            qLog(SharedMemCache) << "trying to remove non-global pixmap";
-            return;
-        }
-        cacheItem.deref();
-    }
+    if ( isGlobalPixmap(k) )
+        cache->removeItem(k.toLatin1().data());
+}
+
+bool QSharedMemoryManager::setPixmapPinned(const QString &k, bool pinned)
+{
+    qLog(SharedMemCache) << (pinned ? "pin" : "unpin") << k;
+
+    if ( isGlobalPixmap(k) )
+        return cache->setPinned(k.toLatin1().data(), pinned);
+    return false;
+}
+
+QSharedMemoryCacheStatistics QSharedMemoryManager::statistics() const
+{
+    QLockHandle lh(l,QLock::Read);
+    return cache->statistics();
 }
 
 // ============================================================================
@@ -1103,11 +1291,17 @@ void QSharedMemoryManager::removePixmap(const QString &k)
     are inserted into the global cache using equal keys, then the last pixmap
     will hide the first pixmap.
 
-    When the global cache becomes full, insert() will fail until adequate
-    space is made available by removing unneeded pixmaps from the global
-    cache, or by deleting all references to the global pixmap's data.
-
-    \sa QPixmapCache, QPixmap, QGLOBAL_PIXMAP_CACHE_LIMIT
+    Pixmaps that are no longer referenced by any process stay in the global
+    cache so they can be found again.  When space is needed they are evicted,
+    least recently used first, unless they have been pinned with setPinned().
+    Each process may use at most QGLOBAL_PIXMAP_CACHE_OWNER_LIMIT bytes of
+    the global cache for unpinned pixmaps; when that is reached the process's
+    own unreferenced pixmaps are evicted first.  A pixmap larger than the
+    remaining budget is still inserted if the cache has room for it.
+    insert() fails if the pixmap can't be placed even after eviction,
+    because the space is used by referenced or pinned pixmaps.
+
+    \sa QPixmapCache, QPixmap, QGLOBAL_PIXMAP_CACHE_LIMIT, QGLOBAL_PIXMAP_CACHE_OWNER_LIMIT
     \ingroup multimedia
 */
 
@@ -1180,18 +1374,8 @@ bool QGlobalPixmapCache::find( const QString &key, QPixmap &pixmap)
 */
 bool QGlobalPixmapCache::insert( const QString &key, const QPixmap &pixmap)
 {
-    if ( qt_getSMManager()->insertPixmap( key, pixmap ) ) {
-        return true;
-    } else {
-        // Cache might be full of unreferenced pixmaps, so try doing
-        // a cleanup first
-        while ( qt_getSMManager()->pixmapCache()->cleanUp() );
-        if ( qt_getSMManager()->insertPixmap( key, pixmap ) ) {
-            return true;
-        }
-    }
-
-    return false;
+    // Unreferenced pixmaps are evicted as needed to make room.
+    return qt_getSMManager()->insertPixmap( key, pixmap );
 }
 
 /*!
@@ -1212,4 +1396,26 @@ void QGlobalPixmapCache::remove( const QString &key )
     qt_getSMManager()->removePixmap( key );
 }
 
+/*!
+    Sets whether the pixmap associated with the \a key in the global cache
+    is \a pinned.  Returns true if the pixmap is in the global cache;
+    otherwise returns false.
+
+    Pixmaps that are no longer referenced by any process stay in the global
+    cache until the space is needed for other pixmaps, at which point the
+    least recently used ones are evicted.  Pinned pixmaps are never evicted,
+    and don't count towards the share of the global cache each process may
+    use.  Pin only pixmaps that are needed by most applications, such as
+    theme backgrounds, as pinned pixmaps reduce the space available to
+    everything else.
+
+    Calling remove() removes a pinned pixmap.
+
+    \sa insert(), remove()
+*/
+bool QGlobalPixmapCache::setPinned( const QString &key, bool pinned )
+{
+    return qt_getSMManager()->setPixmapPinned( key, pinned );
+}
+
 #endif // QT_NO_QWS_SHARED_MEMORY_CACHE
@@ -85,7 +85,7 @@ private:
 */
 class QSMCacheItem {
 public:
-    QSMCacheItem() { count = 1; }
+    QSMCacheItem() : count(1), flags(0), owner(-1), size(0) {}
     void ref() { count++; }
     bool deref() { return !--count; }
     QSMemPtr key;
@@ -106,6 +106,26 @@ public:
     */
     QSMCacheItemType type;
     uint count;
+
+    enum QSMCacheItemFlag {
+        Referenced = 0x01,  // used since the eviction hand last passed
+        Pinned = 0x02,      // never evicted
+        Orphaned = 0x04     // removed from the cache, freed on last deref
+    };
+    uint flags;
+    int owner;  // index of the owning process in the cache's owner table
+    int size;   // bytes used by the item and its key
+};
+
+/*
+  Counters describing how well the shared memory cache is working.
+*/
+struct QSharedMemoryCacheStatistics {
+    int hits;
+    int misses;
+    int insertions;
+    int insertFailures;
+    int evictions;
 };
 
 class QSMCacheItemPtr {
@@ -156,6 +176,10 @@ public:
     bool insertPixmap(const QString &key, const QPixmap &pm);
     // removes a pixmap from the shared memory cache
     void removePixmap(const QString &key);
+    // pins or unpins a pixmap in the shared memory cache
+    bool setPixmapPinned(const QString &key, bool pinned);
+
+    QSharedMemoryCacheStatistics statistics() const;
 
     // creates a new item in the cache
     static QSMCacheItemPtr newItem(const char *key, int size, int type = QSMCacheItem::Global);
@@ -37,10 +37,35 @@
 #define MAX_FRAGMENT_SIZE       4096
 #endif
 
+#if defined(Q_WS_QWS) && defined(QTOPIA_REGULAR_QCOP)
+#include "qsharedmemorycache_p.h"
+#include "qglobalpixmapcache.h"
+#ifndef QT_NO_QWS_SHARED_MEMORY_CACHE
+#define QTOPIA_SHARED_MESSAGES
+
+// Messages between these sizes are passed through shared memory rather than
+// being fragmented.  The upper limit stops a single message from evicting
+// most of the shared pixmap cache.
+#define MIN_SHARED_MESSAGE_SIZE     (4 * MAX_FRAGMENT_SIZE)
+#define MAX_SHARED_MESSAGE_SIZE     (QGLOBAL_PIXMAP_CACHE_LIMIT / 4)
+
+// Milliseconds the sender keeps shared message data alive for receivers.
+#define SHARED_MESSAGE_LIFETIME     20000
+#endif
+#endif
+
+#include "qtopiachannel_p.h"
+#include "qtopiaipcmarshal_p.h"
+#include "qtopiaipcprofile_p.h"
+
 #include <qdebug.h>
 
 #include <QString>
 #include <QTimer>
+#include <QTime>
+#include <QCoreApplication>
+
+#include <string.h>
 
 class QtopiaChannel_Private
 #if defined(QTOPIA_REGULAR_QCOP)
@@ -58,6 +83,7 @@ public:
     QTimer *m_cleanupTimer;
 
     void receive(const QString& msg, const QByteArray &data);
+    void deliver(const QString& msg, const QByteArray &data);
 
     struct Fragment
     {
@@ -77,6 +103,187 @@ private slots:
 
 };
 
+#if defined(QTOPIA_SHARED_MESSAGES)
+
+/*
+  Holds a reference to the shared memory of each large message sent by this
+  process until its receivers have had a chance to copy it.
+ */
+class QtopiaSharedMessages : public QObject
+{
+    Q_OBJECT
+
+public:
+    QtopiaSharedMessages();
+    ~QtopiaSharedMessages();
+
+    static bool send(const QString &channel, const QString &msg, const QByteArray &data);
+
+private slots:
+    void release();
+
+private:
+    struct Message
+    {
+        QSMCacheItem *item;
+        QTime sent;
+    };
+
+    QList<Message> m_messages;
+    QTimer m_releaseTimer;
+};
+
+static QtopiaSharedMessages *qtopia_sharedMessages = 0;
+
+static void qtopia_cleanupSharedMessages()
+{
+    delete qtopia_sharedMessages;
+    qtopia_sharedMessages = 0;
+}
+
+QtopiaSharedMessages::QtopiaSharedMessages()
+{
+    m_releaseTimer.setSingleShot(true);
+    connect(&m_releaseTimer, SIGNAL(timeout()), this, SLOT(release()));
+}
+
+QtopiaSharedMessages::~QtopiaSharedMessages()
+{
+    foreach (const Message &message, m_messages)
+        QSMCacheItemPtr(message.item).deref();
+}
+
+/*
+  Copies \a data into shared memory and sends \a msg on \a channel with a
+  handle to it.  Returns false if the data could not be placed in shared
+  memory or the message could not be sent.
+
+  Messages to applications and services are routed by the server, which may
+  have to launch the receiver first.  The router copies the data out as soon
+  as it receives the message and then releases the reference, so for those
+  channels the sender does not keep one.
+ */
+bool QtopiaSharedMessages::send(const QString &channel, const QString &msg, const QByteArray &data)
+{
+    bool routed = channel.startsWith(QLatin1String("QPE/Application/")) ||
+                  channel.startsWith(QLatin1String("QPE/Service/"));
+
+    // The key records whether the reference is handed over to the router.
+    QByteArray key = (routed ? QTOPIA_ROUTED_MESSAGE_PREFIX : QTOPIA_SHARED_MESSAGE_PREFIX)
+                     + QUuid::createUuid().toString().toLatin1();
+
+    QSMCacheItemPtr item = QSharedMemoryManager::newItem(key.constData(), data.size());
+    if (!(QSMCacheItem *)item)
+        return false;
+
+    memcpy((char *)item, data.constData(), data.size());
+
+    QByteArray handle;
+    {
+        QDataStream stream(&handle, QIODevice::WriteOnly);
+        stream << key;
+        stream << data.size();
+    }
+
+    if (!QCopChannel::send(channel, msg + QLatin1String(QTOPIA_SHARED_MESSAGE_SUFFIX), handle)) {
+        item.deref();
+        return false;
+    }
+
+    if (routed)
+        return true;
+
+    if (!qtopia_sharedMessages) {
+        qtopia_sharedMessages = new QtopiaSharedMessages;
+        qAddPostRoutine(qtopia_cleanupSharedMessages);
+    }
+
+    Message message;
+    message.item = item;
+    message.sent.start();
+
+    qtopia_sharedMessages->m_messages.append(message);
+
+    if (!qtopia_sharedMessages->m_releaseTimer.isActive())
+        qtopia_sharedMessages->m_releaseTimer.start(SHARED_MESSAGE_LIFETIME);
+
+    return true;
+}
+
+void QtopiaSharedMessages::release()
+{
+    while (!m_messages.isEmpty() && m_messages.first().sent.elapsed() >= SHARED_MESSAGE_LIFETIME)
+        QSMCacheItemPtr(m_messages.takeFirst().item).deref();
+
+    if (!m_messages.isEmpty())
+        m_releaseTimer.start(SHARED_MESSAGE_LIFETIME - m_messages.first().sent.elapsed());
+}
+
+#endif
+
+/*
+  Returns true if \a msg refers to message data held in shared memory.
+ */
+bool qtopia_isSharedMessage(const QString &msg)
+{
+    return msg.endsWith(QLatin1String(QTOPIA_SHARED_MESSAGE_SUFFIX));
+}
+
+/*
+  Reads the data of the shared message \a msg with the shared memory \a handle
+  into \a data, and its real name into \a message.  If \a release is true and
+  the sender handed its reference over, that reference is dropped as well.
+  Returns false if the data is no longer available or the handle doesn't
+  refer to valid message data.
+ */
+bool qtopia_readSharedMessage(const QString &msg, const QByteArray &handle,
+                              QString *message, QByteArray *data, bool release)
+{
+#if defined(QTOPIA_SHARED_MESSAGES)
+    QDataStream stream(handle);
+    QByteArray key;
+    int size;
+    stream >> key;
+    stream >> size;
+
+    // The handle comes from another process, so only message data may be
+    // named by it, and only as much of it as was allocated.
+    if (stream.status() != QDataStream::Ok || !key.startsWith(QTOPIA_SHARED_MESSAGE_PREFIX)) {
+        qWarning() << "QtopiaChannel: message" << msg << "has an invalid handle";
+        return false;
+    }
+
+    QSMCacheItemPtr item = QSharedMemoryManager::findItem(key.constData(), true);
+    if (!(QSMCacheItem *)item) {
+        qWarning() << "QtopiaChannel: the data of message" << msg << "is no longer available";
+        return false;
+    }
+
+    int capacity = ((QSMCacheItem *)item)->size - int(sizeof(QSMCacheItem)) - int(qstrlen(item.key())) - 1;
+    if (size < 0 || size > capacity) {
+        qWarning() << "QtopiaChannel: message" << msg << "has an invalid handle";
+        item.deref();
+        return false;
+    }
+
+    *data = QByteArray((char *)item, size);
+    *message = msg.left(msg.length() - (sizeof(QTOPIA_SHARED_MESSAGE_SUFFIX) - 1));
+
+    item.deref();
+    if (release && key.startsWith(QTOPIA_ROUTED_MESSAGE_PREFIX))
+        item.deref();
+
+    return true;
+#else
+    Q_UNUSED(handle);
+    Q_UNUSED(message);
+    Q_UNUSED(data);
+    Q_UNUSED(release);
+    qWarning() << "QtopiaChannel: shared message" << msg << "is not supported";
+    return false;
+#endif
+}
+
 QtopiaChannel_Private::QtopiaChannel_Private(const QString &channel, QtopiaChannel *parent) :
 #if defined(QTOPIA_REGULAR_QCOP)
         QCopChannel(channel, parent), m_fragments(0),
@@ -207,6 +414,9 @@ bool QtopiaChannel::isRegistered(const QString &channel)
 bool QtopiaChannel::send(const QString &channel, const QString &msg)
 {
 #if defined(QTOPIA_REGULAR_QCOP)
+    // Profiled messages always carry data, for the send time.
+    if ( QtopiaIpcProfile::isEnabled() )
+        return send(channel, msg, QByteArray());
     return QCopChannel::send(channel, msg);
 #else
     Q_UNUSED(channel);
@@ -215,6 +425,11 @@ bool QtopiaChannel::send(const QString &channel, const QString &msg)
 #endif
 }
 
+#if defined(QTOPIA_REGULAR_QCOP)
+static bool sendData(const QString &channel, const QString &msg,
+                     const QByteArray &data);
+#endif
+
 /*!
     Sends a message \a msg on channel \a channel with the parameter
     data given by \a data.  Returns true if able to send the message;
@@ -225,12 +440,39 @@ bool QtopiaChannel::send(const QString &channel, const QString &msg)
 bool QtopiaChannel::send(const QString &channel, const QString &msg,
                          const QByteArray &data)
 {
+#if defined(QTOPIA_REGULAR_QCOP)
+    if ( QtopiaIpcProfile::isEnabled() ) {
+        QByteArray profiled( data );
+        QtopiaIpcProfile::recordSend( channel, msg, &profiled );
+        return sendData( channel, msg, profiled );
+    }
+    return sendData( channel, msg, data );
+#else
+    Q_UNUSED(channel);
+    Q_UNUSED(msg);
+    Q_UNUSED(data);
+    return false;
+#endif
+}
+
 #if defined(QTOPIA_REGULAR_QCOP)
 
+static bool sendData(const QString &channel, const QString &msg,
+                     const QByteArray &data)
+{
     // Send the message as-is if it is smaller than the fragment size.
     if ( data.size() <= MAX_FRAGMENT_SIZE )
         return QCopChannel::send(channel, msg, data);
 
+#if defined(QTOPIA_SHARED_MESSAGES)
+    // Pass large messages through shared memory so only a handle is copied
+    // through the server, falling back to fragments if there isn't room.
+    if ( data.size() >= MIN_SHARED_MESSAGE_SIZE && data.size() <= MAX_SHARED_MESSAGE_SIZE
+         && QtopiaSharedMessages::send( channel, msg, data ) ) {
+        return true;
+    }
+#endif
+
     // Compose the individual fragments and send them.
     QString uuid = QUuid::createUuid().toString();
     for ( int posn = 0; posn < data.size(); posn += MAX_FRAGMENT_SIZE ) {
@@ -254,14 +496,9 @@ bool QtopiaChannel::send(const QString &channel, const QString &msg,
         }
     }
     return true;
+}
 
-#else
-    Q_UNUSED(channel);
-    Q_UNUSED(msg);
-    Q_UNUSED(data);
-    return false;
 #endif
-}
 
 /*!
     Flushes all pending messages destined from this channel, causing them to be
@@ -280,9 +517,18 @@ bool QtopiaChannel::flush()
 
 void QtopiaChannel_Private::receive(const QString& msg, const QByteArray &data)
 {
+    // Read the data of messages passed through shared memory.
+    if ( qtopia_isSharedMessage( msg ) ) {
+        QString message;
+        QByteArray sharedData;
+        if ( qtopia_readSharedMessage( msg, data, &message, &sharedData ) )
+            deliver( message, sharedData );
+        return;
+    }
+
     // If this is not a fragmented message, then pass it on as-is.
     if ( !msg.endsWith( "_fragment_" ) ) {
-        emit m_parent->received( msg, data );
+        deliver( msg, data );
         return;
     }
 
@@ -330,7 +576,7 @@ void QtopiaChannel_Private::receive(const QString& msg, const QByteArray &data)
             if ( !m_fragments )
                 m_cleanupTimer->stop();
         }
-        emit m_parent->received( msg.left( msg.length() - 10 ), frag->data );
+        deliver( msg.left( msg.length() - 10 ), frag->data );
         delete frag;
     } else {
         // Delete fragments that are still hanging around after 20 seconds.
@@ -338,6 +584,25 @@ void QtopiaChannel_Private::receive(const QString& msg, const QByteArray &data)
     }
 }
 
+void QtopiaChannel_Private::deliver(const QString& msg, const QByteArray &data)
+{
+    QtopiaIpcProfile::recordReceive( channel(), msg, data );
+
+    // Users of QtopiaChannel decode arguments themselves, so messages sent
+    // by QtopiaIpcAdaptor with compact encoded arguments are converted back.
+    if ( qtopia_isCompactMessage( msg ) ) {
+        QString message;
+        QByteArray standardData;
+        if ( qtopia_compactToStandard( msg, data, &message, &standardData ) )
+            emit m_parent->received( message, standardData );
+        else
+            qWarning() << "QtopiaChannel: could not decode the arguments of" << msg;
+        return;
+    }
+
+    emit m_parent->received( msg, data );
+}
+
 /*!
     \fn void QtopiaChannel::received(const QString& message, const QByteArray &data)
 
@@ -0,0 +1,55 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#ifndef QTOPIACHANNEL_P_H
+#define QTOPIACHANNEL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt Extended API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <qtopiaglobal.h>
+#include <QString>
+#include <QByteArray>
+
+// Messages sent through shared memory have this suffix appended to their name
+// and carry a handle to the shared message data.  On the QPE/Application/*
+// and QPE/Service/* channels the server's router is the only reader, so the
+// sender hands its reference to the data over, and the router releases it
+// once the data has been read.
+#define QTOPIA_SHARED_MESSAGE_SUFFIX "_shared_"
+
+// Shared memory cache keys of message data.  Data whose reference is handed
+// over to the router has the longer prefix.
+#define QTOPIA_SHARED_MESSAGE_PREFIX "QtopiaChannel:"
+#define QTOPIA_ROUTED_MESSAGE_PREFIX "QtopiaChannel:routed:"
+
+QTOPIABASE_EXPORT bool qtopia_isSharedMessage(const QString &msg);
+QTOPIABASE_EXPORT bool qtopia_readSharedMessage(const QString &msg, const QByteArray &handle,
+                                                QString *message, QByteArray *data,
+                                                bool release = false);
+
+#endif
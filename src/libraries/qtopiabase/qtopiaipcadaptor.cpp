@@ -24,10 +24,15 @@
 #include <qsignalintercepter.h>
 #include <qslotinvoker.h>
 #include <qtopiachannel.h>
+#include "qtopiachannel_p.h"
+#include "qtopiaipcmarshal_p.h"
+#include "qtopiaipcprofile_p.h"
 #include <qapplication.h>
 #include <qmap.h>
 #include <qset.h>
 #include <qtimer.h>
+#include <qdatetime.h>
+#include <qmutex.h>
 #include <qmetaobject.h>
 #include <qdatastream.h>
 #include <QDebug>
@@ -104,6 +109,27 @@
            instances of QtopiaIpcAdaptor.
 */
 
+class QtopiaIpcAdaptorChannels
+{
+public:
+    QMutex lock;
+    QHash<QString, int> channels;
+};
+
+Q_GLOBAL_STATIC(QtopiaIpcAdaptorChannels, adaptorChannels);
+
+/*
+    Returns true if a QtopiaIpcAdaptor in this process is listening on
+    \a channel.  Messages with compact encoded arguments on such channels
+    must reach it unchanged, because it decodes them itself.
+*/
+bool qtopia_isAdaptorChannel(const QString &channel)
+{
+    QtopiaIpcAdaptorChannels *registry = adaptorChannels();
+    QMutexLocker locker( &registry->lock );
+    return registry->channels.contains( channel );
+}
+
 #ifdef QTOPIA_REGULAR_QCOP
 
 class QtopiaIpcAdaptorChannel : public QCopChannel
@@ -141,10 +167,22 @@ QtopiaIpcAdaptorChannel::QtopiaIpcAdaptorChannel
     m_cleanupTimer = new QTimer();
     m_cleanupTimer->setSingleShot(true);
     connect(m_cleanupTimer, SIGNAL(timeout()), this, SLOT(cleanup()) );
+
+    QtopiaIpcAdaptorChannels *registry = adaptorChannels();
+    QMutexLocker locker( &registry->lock );
+    ++registry->channels[channel];
 }
 
 QtopiaIpcAdaptorChannel::~QtopiaIpcAdaptorChannel()
 {
+    QtopiaIpcAdaptorChannels *registry = adaptorChannels();
+    if ( registry ) {
+        QMutexLocker locker( &registry->lock );
+        QHash<QString, int>::Iterator it = registry->channels.find( channel() );
+        if ( it != registry->channels.end() && --(*it) <= 0 )
+            registry->channels.erase( it );
+    }
+
     if (m_cleanupTimer)
         delete m_cleanupTimer;
     cleanup();
@@ -152,6 +190,15 @@ QtopiaIpcAdaptorChannel::~QtopiaIpcAdaptorChannel()
 
 void QtopiaIpcAdaptorChannel::receive( const QString& msg, const QByteArray &data )
 {
+    // Read the data of messages passed through shared memory.
+    if ( qtopia_isSharedMessage( msg ) ) {
+        QString message;
+        QByteArray sharedData;
+        if ( qtopia_readSharedMessage( msg, data, &message, &sharedData ) )
+            m_adaptor->received( message, sharedData );
+        return;
+    }
+
     // If this is not a fragmented message, then pass it on as-is.
     if ( !msg.endsWith( "_fragment_" ) ) {
         m_adaptor->received( msg, data );
@@ -548,8 +595,17 @@ QString QtopiaIpcAdaptor::receiveChannel( const QString& channel )
     return channel;
 }
 
-void QtopiaIpcAdaptor::received( const QString& msg, const QByteArray& data )
+void QtopiaIpcAdaptor::received( const QString& message, const QByteArray& data )
 {
+    // Messages with compact encoded QVariant arguments are otherwise
+    // delivered like any other message.
+    QString msg = message;
+    bool compact = qtopia_isCompactMessage( message );
+    if ( compact )
+        msg.chop( qstrlen(QTOPIA_COMPACT_MESSAGE_SUFFIX) );
+
+    QtopiaIpcProfile::recordReceive( d->channelName, msg, data );
+
     QtopiaIpcAdaptorPrivate *priv = d;
     priv->AddRef();
     QMultiMap< QString, QSlotInvoker * >::ConstIterator iter;
@@ -560,11 +616,18 @@ void QtopiaIpcAdaptor::received( const QString& msg, const QByteArray& data )
         int numParams = invoker->parameterTypesCount();
         QDataStream stream( data );
         QList<QVariant> args;
+        bool valid = true;
         for ( int param = 0; param < numParams; ++param ) {
             if ( params[param] != QSignalIntercepter::QVariantId ) {
                 QtopiaIpcAdaptorVariant temp;
                 temp.load( stream, params[param] );
                 args.append( temp );
+            } else if ( compact ) {
+                QVariant temp;
+                valid = qtopia_loadCompactVariant( stream, &temp );
+                if ( !valid )
+                    break;
+                args.append( temp );
             } else {
                 // We need to handle QVariant specially because we actually
                 // need the type header in this case.
@@ -573,6 +636,10 @@ void QtopiaIpcAdaptor::received( const QString& msg, const QByteArray& data )
                 args.append( temp );
             }
         }
+        if ( !valid ) {
+            qWarning() << "QtopiaIpcAdaptor: could not decode the arguments of" << msg;
+            continue;
+        }
     #if !defined(QT_NO_EXCEPTIONS)
         try {
     #endif
@@ -647,6 +714,9 @@ bool QtopiaIpcAdaptor::connectRemoteToLocal
             // Short-cut the signal emits in QCopChannel and QtopiaChannel,
             // for greater performance when dispatching incoming messages.
             new QtopiaIpcAdaptorChannel( chan, this );
+
+            // Tell senders that we understand compact encoded arguments.
+            new QCopChannel( chan + QTOPIA_COMPACT_CAPABILITY_SUFFIX, this );
 #else
             QtopiaChannel *channel = new QtopiaChannel( chan, this );
             QObject::connect
@@ -673,44 +743,128 @@ void QtopiaIpcAdaptor::sendMessage
     send( sendChannels( d->channelName ), msg, args );
 }
 
-void QtopiaIpcAdaptor::send( const QStringList& channels,
-                             const QString& msg, const QList<QVariant>& args )
-{
-    QByteArray array;
-    {
-        QDataStream stream
-            ( &array, QIODevice::WriteOnly | QIODevice::Append );
-        QList<QVariant>::ConstIterator iter;
-        if ( !msg.contains( "QVariant" ) ) {
-            for ( iter = args.begin(); iter != args.end(); ++iter ) {
-                QtopiaIpcAdaptorVariant copy( *iter );
-                copy.save( stream );
-            }
+// Write \a args in the regular encoding, where QVariant arguments carry
+// a QVariant header.  \a params are the message's parameter types, which are
+// only needed if the message has QVariant parameters.
+static void encodeArguments( QByteArray *array, const QVector<int>& params,
+                             const QList<QVariant>& args )
+{
+    QDataStream stream( array, QIODevice::WriteOnly | QIODevice::Append );
+    QList<QVariant>::ConstIterator iter;
+    int index = 0;
+    for ( iter = args.begin(); iter != args.end(); ++iter, ++index ) {
+        if ( index < params.size() &&
+             params[index] == QSignalIntercepter::QVariantId ) {
+            // We need to handle QVariant specially because we actually
+            // need the type header in this case.
+            stream << *iter;
         } else {
-            QByteArray name = msg.toLatin1();
-            name = QMetaObject::normalizedSignature( name.constData() );
-            int numParams = 0;
-            int *params = QSignalIntercepter::connectionTypes
-                    ( name, numParams );
-            int index = 0;
-            for ( iter = args.begin(); iter != args.end(); ++iter, ++index ) {
-                if ( index < numParams &&
-                     params[index] == QSignalIntercepter::QVariantId ) {
-                    // We need to handle QVariant specially because we actually
-                    // need the type header in this case.
-                    stream << *iter;
-                } else {
-                    QtopiaIpcAdaptorVariant copy( *iter );
-                    copy.save( stream );
-                }
+            QtopiaIpcAdaptorVariant copy( *iter );
+            copy.save( stream );
+        }
+    }
+}
+
+#ifdef QTOPIA_REGULAR_QCOP
+
+// Write \a args with QVariant arguments in the compact encoding.  Returns
+// false if the compact encoding would not gain anything because no QVariant
+// argument holds a user type, or if an argument can't be compact encoded.
+static bool encodeCompactArguments( QByteArray *array, const QVector<int>& params,
+                                    const QList<QVariant>& args )
+{
+    bool userTypes = false;
+    QDataStream stream( array, QIODevice::WriteOnly | QIODevice::Append );
+    QList<QVariant>::ConstIterator iter;
+    int index = 0;
+    for ( iter = args.begin(); iter != args.end(); ++iter, ++index ) {
+        if ( index < params.size() &&
+             params[index] == QSignalIntercepter::QVariantId ) {
+            if ( iter->userType() >= QMetaType::User ) {
+                if ( !qtopia_ipcTypeId( iter->userType() ) )
+                    return false;
+                userTypes = true;
             }
-            if ( params )
-                qFree( params );
+            if ( !qtopia_saveCompactVariant( stream, *iter ) )
+                return false;
+        } else {
+            QtopiaIpcAdaptorVariant copy( *iter );
+            copy.save( stream );
         }
-        // Stream is flushed and closed at this point.
     }
+    return userTypes;
+}
+
+struct QtopiaIpcCompactChannel
+{
+    bool capable;
+    QTime checked;
+};
+
+class QtopiaIpcCompactChannels
+{
+public:
+    QMutex lock;
+    QHash<QString, QtopiaIpcCompactChannel> channels;
+};
+
+Q_GLOBAL_STATIC(QtopiaIpcCompactChannels, compactChannels);
+
+// Determine if the receivers on \a channel understand compact encoded
+// arguments.  Asking the server is a round trip, so the answer is
+// remembered for a few seconds.
+static bool isCompactChannel( const QString& channel )
+{
+    // Messages to applications and services are routed by the server and
+    // reach QtopiaApplication::appMessage(), whose listeners decode the
+    // arguments themselves.
+    if ( channel.startsWith( QLatin1String("QPE/Application/") ) ||
+         channel.startsWith( QLatin1String("QPE/Service/") ) )
+        return false;
+
+    QtopiaIpcCompactChannels *cache = compactChannels();
+    QMutexLocker locker( &cache->lock );
+    QHash<QString, QtopiaIpcCompactChannel>::Iterator it = cache->channels.find( channel );
+    if ( it == cache->channels.end() ) {
+        it = cache->channels.insert( channel, QtopiaIpcCompactChannel() );
+    } else if ( it->checked.elapsed() < 10000 ) {
+        return it->capable;
+    }
+    it->capable = QCopChannel::isRegistered( channel + QTOPIA_COMPACT_CAPABILITY_SUFFIX );
+    it->checked.start();
+    return it->capable;
+}
+
+#endif
+
+void QtopiaIpcAdaptor::send( const QStringList& channels,
+                             const QString& msg, const QList<QVariant>& args )
+{
+    // Only messages with QVariant parameters need their parameter types,
+    // which are parsed from the message once and then cached.
+    QVector<int> params;
+    if ( msg.contains( "QVariant" ) )
+        params = qtopia_ipcParameterTypes( msg );
+
+    QByteArray array;
+    bool encoded = false;
+#ifdef QTOPIA_REGULAR_QCOP
+    QByteArray compact;
+    bool useCompact = !params.isEmpty() &&
+                      encodeCompactArguments( &compact, params, args );
+#endif
     QStringList::ConstIterator iter;
     for ( iter = channels.begin(); iter != channels.end(); ++iter ) {
+#ifdef QTOPIA_REGULAR_QCOP
+        if ( useCompact && isCompactChannel( *iter ) ) {
+            QtopiaChannel::send( *iter, msg + QTOPIA_COMPACT_MESSAGE_SUFFIX, compact );
+            continue;
+        }
+#endif
+        if ( !encoded ) {
+            encodeArguments( &array, params, args );
+            encoded = true;
+        }
         QtopiaChannel::send( *iter, msg, array );
     }
 }
@@ -18,6 +18,12 @@
 ****************************************************************************/
 
 #include "qtopiaipcmarshal.h"
+#include "qtopiaipcmarshal_p.h"
+#include <qsignalintercepter.h>
+#include <QMetaObject>
+#include <QHash>
+#include <QMutex>
+#include <QDebug>
 
 /*!
     \macro Q_DECLARE_USER_METATYPE(TYPE)
@@ -183,3 +189,231 @@ const QDBusArgument &operator>>(const QDBusArgument &a, QUuid &v)
     return a;
 }
 #endif
+
+/*
+    Compact marshalling of QVariant arguments.
+
+    A QVariant argument normally carries the name of its type when the type
+    is user defined, and the receiver looks the name up in the metatype
+    registry to decode it.  The compact encoding replaces the name with an
+    integer id that every process derives from the name in the same way, so
+    no names are sent and the receiver finds the type with a hash lookup.
+
+    Collisions between ids are only detected among the types registered in
+    one process, so each id is followed by a check word, a second hash of the
+    name computed differently.  The receiver rejects a value whose check word
+    doesn't match the type it resolved the id to.
+*/
+
+// Ids with this bit set identify user types.  Built-in types are never
+// compact encoded.
+#define QTOPIA_IPC_USER_TYPE_BIT 0x80000000
+
+// FNV-1a, which is unrelated to the qHash() the ids are derived from.
+static quint32 typeNameCheck(const char *name)
+{
+    quint32 check = 2166136261u;
+    for ( ; *name; ++name ) {
+        check ^= (uchar)*name;
+        check *= 16777619u;
+    }
+    return check;
+}
+
+class QtopiaIpcTypeTable
+{
+public:
+    QtopiaIpcTypeTable() : scanned(QMetaType::User) {}
+
+    void update();
+
+    QMutex lock;
+    QHash<quint32, int> types;      // Compact id to metatype, -1 if ambiguous
+    QHash<int, quint32> ids;        // Metatype to compact id
+    QHash<int, quint32> checks;     // Metatype to type name check word
+    int scanned;
+};
+
+Q_GLOBAL_STATIC(QtopiaIpcTypeTable, ipcTypeTable);
+
+// Add any types registered since the last update.  Must be called with the
+// lock held.
+void QtopiaIpcTypeTable::update()
+{
+    for ( ; QMetaType::isRegistered( scanned ); ++scanned ) {
+        const char *name = QMetaType::typeName( scanned );
+        if ( !name )
+            continue;
+        quint32 id = qHash( QByteArray( name ) ) | QTOPIA_IPC_USER_TYPE_BIT;
+        checks.insert( scanned, typeNameCheck( name ) );
+        QHash<quint32, int>::Iterator it = types.find( id );
+        if ( it == types.end() ) {
+            types.insert( id, scanned );
+            ids.insert( scanned, id );
+        } else if ( *it != -1 ) {
+            qWarning() << "QtopiaIpcAdaptor: types" << QMetaType::typeName( *it )
+                       << "and" << name << "share a compact id";
+            ids.remove( *it );
+            *it = -1;
+        }
+    }
+}
+
+/*
+    Returns the compact id of the user defined metatype \a type, or 0 if it
+    can't be compact encoded.
+*/
+quint32 qtopia_ipcTypeId(int type)
+{
+    if ( type < QMetaType::User )
+        return 0;
+
+    QtopiaIpcTypeTable *table = ipcTypeTable();
+    QMutexLocker locker( &table->lock );
+    if ( type >= table->scanned )
+        table->update();
+    return table->ids.value( type, 0 );
+}
+
+/*
+    Returns the metatype with the compact id \a id, or 0 if no such type is
+    registered in this process.
+*/
+int qtopia_metaTypeFromIpcId(quint32 id)
+{
+    QtopiaIpcTypeTable *table = ipcTypeTable();
+    QMutexLocker locker( &table->lock );
+    QHash<quint32, int>::ConstIterator it = table->types.find( id );
+    if ( it == table->types.constEnd() ) {
+        table->update();
+        it = table->types.find( id );
+        if ( it == table->types.constEnd() )
+            return 0;
+    }
+    return *it == -1 ? 0 : *it;
+}
+
+/*
+    Returns the check word written after the compact id of the user defined
+    metatype \a type.
+*/
+static quint32 ipcTypeCheck(int type)
+{
+    QtopiaIpcTypeTable *table = ipcTypeTable();
+    QMutexLocker locker( &table->lock );
+    if ( type >= table->scanned )
+        table->update();
+    return table->checks.value( type, 0 );
+}
+
+class QtopiaIpcParameterTypes
+{
+public:
+    QMutex lock;
+    QHash<QString, QVector<int> > types;
+};
+
+Q_GLOBAL_STATIC(QtopiaIpcParameterTypes, ipcParameterTypes);
+
+/*
+    Returns the metatypes of the parameters of the IPC message \a msg.
+    QVariant parameters are returned as QSignalIntercepter::QVariantId.
+    Messages are only parsed the first time they are seen.
+*/
+QVector<int> qtopia_ipcParameterTypes(const QString &msg)
+{
+    QtopiaIpcParameterTypes *cache = ipcParameterTypes();
+    QMutexLocker locker( &cache->lock );
+    QHash<QString, QVector<int> >::ConstIterator it = cache->types.find( msg );
+    if ( it != cache->types.constEnd() )
+        return *it;
+
+    QByteArray name = QMetaObject::normalizedSignature( msg.toLatin1().constData() );
+    int numParams = 0;
+    int *params = QSignalIntercepter::connectionTypes( name, numParams );
+    QVector<int> types( numParams );
+    for ( int index = 0; index < numParams; ++index )
+        types[index] = params[index];
+    if ( params )
+        qFree( params );
+    cache->types.insert( msg, types );
+    return types;
+}
+
+/*
+    Writes \a value to \a stream in the compact encoding.  Values of user
+    defined types are written as their compact id and check word followed by
+    their data.
+    Any other value is written as 0 followed by the regular QVariant encoding.
+    Returns false if the value could not be written.
+*/
+bool qtopia_saveCompactVariant(QDataStream &stream, const QVariant &value)
+{
+    quint32 id = qtopia_ipcTypeId( value.userType() );
+    stream << id;
+    if ( id ) {
+        stream << ipcTypeCheck( value.userType() );
+        return QMetaType::save( stream, value.userType(), value.constData() );
+    }
+    stream << value;
+    return stream.status() == QDataStream::Ok;
+}
+
+/*
+    Reads a value written by qtopia_saveCompactVariant() from \a stream into
+    \a value.  Returns false if the type of the value is not known in this
+    process or the data could not be read.
+*/
+bool qtopia_loadCompactVariant(QDataStream &stream, QVariant *value)
+{
+    quint32 id;
+    stream >> id;
+    if ( !id ) {
+        stream >> *value;
+        return stream.status() == QDataStream::Ok;
+    }
+
+    quint32 check;
+    stream >> check;
+    if ( stream.status() != QDataStream::Ok )
+        return false;
+
+    // A different type with the same id would be loaded from the wrong data.
+    int type = qtopia_metaTypeFromIpcId( id );
+    if ( !type || check != ipcTypeCheck( type ) )
+        return false;
+    *value = QVariant( type, static_cast<const void *>(0) );
+    return QMetaType::load( stream, type, value->data() );
+}
+
+bool qtopia_isCompactMessage(const QString &msg)
+{
+    return msg.endsWith( QLatin1String(QTOPIA_COMPACT_MESSAGE_SUFFIX) );
+}
+
+/*
+    Converts the compact encoded message \a msg with arguments \a compact to
+    its regular form, for receivers that decode the arguments themselves.
+*/
+bool qtopia_compactToStandard(const QString &msg, const QByteArray &compact,
+                              QString *message, QByteArray *data)
+{
+    *message = msg.left( msg.length() - qstrlen(QTOPIA_COMPACT_MESSAGE_SUFFIX) );
+    QVector<int> params = qtopia_ipcParameterTypes( *message );
+
+    QDataStream in( compact );
+    QDataStream out( data, QIODevice::WriteOnly );
+    for ( int index = 0; index < params.size(); ++index ) {
+        if ( params[index] == QSignalIntercepter::QVariantId ) {
+            QVariant value;
+            if ( !qtopia_loadCompactVariant( in, &value ) )
+                return false;
+            out << value;
+        } else {
+            QtopiaIpcAdaptorVariant value;
+            value.load( in, params[index] );
+            value.save( out );
+        }
+    }
+    return in.status() == QDataStream::Ok;
+}
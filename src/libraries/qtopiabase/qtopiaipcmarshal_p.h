@@ -0,0 +1,63 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#ifndef QTOPIAIPCMARSHAL_P_H
+#define QTOPIAIPCMARSHAL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt Extended API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <qtopiaglobal.h>
+#include <QString>
+#include <QByteArray>
+#include <QVariant>
+#include <QVector>
+
+class QDataStream;
+
+// Messages whose QVariant arguments use the compact encoding have this
+// suffix appended to their name.  Receivers listening on a channel register
+// the capability channel "<channel>/_compact_" so senders know they
+// understand it.
+#define QTOPIA_COMPACT_MESSAGE_SUFFIX "_compact_"
+#define QTOPIA_COMPACT_CAPABILITY_SUFFIX "/_compact_"
+
+quint32 qtopia_ipcTypeId(int type);
+int qtopia_metaTypeFromIpcId(quint32 id);
+
+QVector<int> qtopia_ipcParameterTypes(const QString &msg);
+
+QTOPIABASE_EXPORT bool qtopia_saveCompactVariant(QDataStream &stream, const QVariant &value);
+QTOPIABASE_EXPORT bool qtopia_loadCompactVariant(QDataStream &stream, QVariant *value);
+
+QTOPIABASE_EXPORT bool qtopia_isCompactMessage(const QString &msg);
+QTOPIABASE_EXPORT bool qtopia_compactToStandard(const QString &msg, const QByteArray &compact,
+                                                QString *message, QByteArray *data);
+
+QTOPIABASE_EXPORT bool qtopia_isAdaptorChannel(const QString &channel);
+
+#endif
@@ -0,0 +1,304 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#include "qtopiaipcprofile_p.h"
+#include <qtopiachannel.h>
+
+#if !defined(QTOPIA_HOST)
+#if defined(Q_WS_QWS)
+#include <qcopchannel_qws.h>
+#define QTOPIA_REGULAR_QCOP
+#elif defined(Q_WS_X11)
+#include <qcopchannel_x11.h>
+#define QTOPIA_REGULAR_QCOP
+#endif
+#endif
+
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QThread>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QCoreApplication>
+
+#include <sys/time.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+/*
+    Messages sent by a profiling process carry a trailer of this magic number
+    and the time the message was sent, so that profiling receivers can measure
+    the delivery latency.  Receivers read their arguments from the front of the
+    data, so the trailer is ignored by everything else.
+*/
+#define QTOPIA_IPC_PROFILE_MAGIC    0x51495046
+#define QTOPIA_IPC_PROFILE_TRAILER  int(sizeof(quint32) + sizeof(qint64))
+
+static const int latencyLimits[QtopiaIpcProfile::LatencyBuckets - 1] =
+    { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+
+static qint64 currentMSecs()
+{
+    struct timeval tv;
+    ::gettimeofday(&tv, 0);
+    return qint64(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
+
+class QtopiaIpcProfileListener;
+
+class QtopiaIpcProfileData
+{
+public:
+    QtopiaIpcProfileData() : listener(0) {}
+
+    QtopiaIpcProfile::Record &record(const QString &channel, const QString &message)
+    {
+        QHash<QPair<QString, QString>, QtopiaIpcProfile::Record>::Iterator iter
+            = records.find(qMakePair(channel, message));
+        if(iter == records.end()) {
+            iter = records.insert(qMakePair(channel, message), QtopiaIpcProfile::Record());
+            iter->channel = channel;
+            iter->message = message;
+        }
+        return *iter;
+    }
+
+    void ensureListener();
+
+    QMutex lock;
+    QHash<QPair<QString, QString>, QtopiaIpcProfile::Record> records;
+    QtopiaIpcProfileListener *listener;
+};
+
+Q_GLOBAL_STATIC(QtopiaIpcProfileData, profileData);
+
+#if defined(QTOPIA_REGULAR_QCOP)
+
+// Answers requests for the records of this process.
+class QtopiaIpcProfileListener : public QCopChannel
+{
+public:
+    QtopiaIpcProfileListener(QObject *parent)
+        : QCopChannel(QTOPIA_IPC_PROFILE_CHANNEL, parent)
+    {
+    }
+
+    void receive(const QString &msg, const QByteArray &data)
+    {
+        if(msg == QLatin1String("dump(QString)")) {
+            QDataStream stream(data);
+            QString responseChannel;
+            stream >> responseChannel;
+
+            QByteArray records;
+            {
+                QDataStream out(&records, QIODevice::WriteOnly);
+                out << QtopiaIpcProfile::records();
+            }
+
+            QString name = QCoreApplication::applicationName();
+            if(name.isEmpty())
+                name = QFileInfo(QCoreApplication::applicationFilePath()).fileName();
+
+            QByteArray response;
+            {
+                QDataStream out(&response, QIODevice::WriteOnly);
+                out << name << int(::getpid()) << records;
+            }
+            QtopiaChannel::send(responseChannel,
+                                QLatin1String("profile(QString,int,QByteArray)"),
+                                response);
+        } else if(msg == QLatin1String("reset()")) {
+            QtopiaIpcProfile::reset();
+        }
+    }
+};
+
+#endif
+
+// The listener can only be created once the application exists, and must
+// live in its thread.  Must be called with the lock held.
+void QtopiaIpcProfileData::ensureListener()
+{
+#if defined(QTOPIA_REGULAR_QCOP)
+    if(listener)
+        return;
+    QCoreApplication *app = QCoreApplication::instance();
+    if(app && QThread::currentThread() == app->thread())
+        listener = new QtopiaIpcProfileListener(app);
+#endif
+}
+
+/*!
+  \class QtopiaIpcProfile
+  \internal
+
+  \brief The QtopiaIpcProfile class records the IPC traffic of a process.
+
+  Profiling is enabled by setting \c QTOPIA_IPC_PROFILE in the environment
+  before a process is started.  Starting the server with it set profiles
+  every application it launches.  QtopiaChannel, QtopiaIpcAdaptor and the
+  server's QCopRouter then count the messages and bytes sent and received
+  for each channel and message, and record a histogram of the time between
+  a message being sent and being received.
+
+  The records are retrieved with the \c {qcop profile} command.
+*/
+
+/*!
+  \internal
+  Returns the upper bound in milliseconds of the latency histogram bucket
+  \a bucket, or -1 for the last bucket, which has no bound.
+*/
+int QtopiaIpcProfile::latencyLimit(int bucket)
+{
+    if(bucket < 0 || bucket >= LatencyBuckets - 1)
+        return -1;
+    return latencyLimits[bucket];
+}
+
+/*!
+  \internal
+  Constructs an empty record.
+*/
+QtopiaIpcProfile::Record::Record()
+    : sent(0), received(0), sentBytes(0), receivedBytes(0)
+{
+    for(int ii = 0; ii < LatencyBuckets; ++ii)
+        latency[ii] = 0;
+}
+
+/*!
+  \internal
+  Returns true if this process records its IPC traffic.
+*/
+bool QtopiaIpcProfile::isEnabled()
+{
+    static int enabled = -1;
+    if(-1 == enabled) {
+        const char *env = ::getenv("QTOPIA_IPC_PROFILE");
+        enabled = (env && *env && qstrcmp(env, "0") != 0) ? 1 : 0;
+    }
+    return 1 == enabled;
+}
+
+/*!
+  \internal
+  Records that \a message with \a data is being sent on \a channel, and
+  appends the send time to \a data.
+*/
+void QtopiaIpcProfile::recordSend(const QString &channel, const QString &message,
+                                  QByteArray *data)
+{
+    if(!isEnabled())
+        return;
+
+    {
+        QtopiaIpcProfileData *d = profileData();
+        QMutexLocker locker(&d->lock);
+        d->ensureListener();
+        Record &record = d->record(channel, message);
+        ++record.sent;
+        record.sentBytes += data->size();
+    }
+
+    QDataStream stream(data, QIODevice::WriteOnly | QIODevice::Append);
+    stream << quint32(QTOPIA_IPC_PROFILE_MAGIC) << currentMSecs();
+}
+
+/*!
+  \internal
+  Records that \a message with \a data has been received on \a channel.  If
+  the sender was profiling too, the delivery latency is recorded.
+*/
+void QtopiaIpcProfile::recordReceive(const QString &channel, const QString &message,
+                                     const QByteArray &data)
+{
+    if(!isEnabled())
+        return;
+
+    int size = data.size();
+    qint64 latency = -1;
+    if(size >= QTOPIA_IPC_PROFILE_TRAILER) {
+        QDataStream stream(data.right(QTOPIA_IPC_PROFILE_TRAILER));
+        quint32 magic;
+        qint64 sent;
+        stream >> magic >> sent;
+        if(QTOPIA_IPC_PROFILE_MAGIC == magic) {
+            size -= QTOPIA_IPC_PROFILE_TRAILER;
+            latency = qMax(qint64(0), currentMSecs() - sent);
+        }
+    }
+
+    QtopiaIpcProfileData *d = profileData();
+    QMutexLocker locker(&d->lock);
+    d->ensureListener();
+    Record &record = d->record(channel, message);
+    ++record.received;
+    record.receivedBytes += size;
+    if(-1 != latency) {
+        int bucket = 0;
+        while(bucket < LatencyBuckets - 1 && latency > latencyLimits[bucket])
+            ++bucket;
+        ++record.latency[bucket];
+    }
+}
+
+/*!
+  \internal
+  Returns the records of this process.
+*/
+QList<QtopiaIpcProfile::Record> QtopiaIpcProfile::records()
+{
+    QtopiaIpcProfileData *d = profileData();
+    QMutexLocker locker(&d->lock);
+    return d->records.values();
+}
+
+/*!
+  \internal
+  Clears the records of this process.
+*/
+void QtopiaIpcProfile::reset()
+{
+    QtopiaIpcProfileData *d = profileData();
+    QMutexLocker locker(&d->lock);
+    d->records.clear();
+}
+
+QDataStream &operator<<(QDataStream &stream, const QtopiaIpcProfile::Record &record)
+{
+    stream << record.channel << record.message
+           << record.sent << record.received
+           << record.sentBytes << record.receivedBytes;
+    for(int ii = 0; ii < QtopiaIpcProfile::LatencyBuckets; ++ii)
+        stream << record.latency[ii];
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, QtopiaIpcProfile::Record &record)
+{
+    stream >> record.channel >> record.message
+           >> record.sent >> record.received
+           >> record.sentBytes >> record.receivedBytes;
+    for(int ii = 0; ii < QtopiaIpcProfile::LatencyBuckets; ++ii)
+        stream >> record.latency[ii];
+    return stream;
+}
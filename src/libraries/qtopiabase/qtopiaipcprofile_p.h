@@ -0,0 +1,83 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#ifndef QTOPIAIPCPROFILE_P_H
+#define QTOPIAIPCPROFILE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt Extended API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <qtopiaglobal.h>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+
+class QDataStream;
+
+// Processes started with QTOPIA_IPC_PROFILE set in their environment record
+// the IPC traffic they send and receive.  Sending "dump(QString)" on
+// QTOPIA_IPC_PROFILE_CHANNEL makes each of them reply on the given channel
+// with "profile(QString,int,QByteArray)", carrying the process name, pid and
+// its records.  "reset()" clears the records.
+#define QTOPIA_IPC_PROFILE_CHANNEL "QPE/IpcProfile"
+
+class QTOPIABASE_EXPORT QtopiaIpcProfile
+{
+public:
+    // Upper bounds in milliseconds of the latency histogram buckets.  The
+    // last bucket holds everything slower.
+    enum { LatencyBuckets = 10 };
+    static int latencyLimit(int bucket);
+
+    struct Record
+    {
+        Record();
+
+        QString channel;
+        QString message;
+        quint32 sent;
+        quint32 received;
+        quint64 sentBytes;
+        quint64 receivedBytes;
+        quint32 latency[LatencyBuckets];
+    };
+
+    static bool isEnabled();
+
+    static void recordSend(const QString &channel, const QString &message,
+                           QByteArray *data);
+    static void recordReceive(const QString &channel, const QString &message,
+                              const QByteArray &data);
+
+    static QList<Record> records();
+    static void reset();
+};
+
+QTOPIABASE_EXPORT QDataStream &operator<<(QDataStream &stream, const QtopiaIpcProfile::Record &record);
+QTOPIABASE_EXPORT QDataStream &operator>>(QDataStream &stream, QtopiaIpcProfile::Record &record);
+
+#endif
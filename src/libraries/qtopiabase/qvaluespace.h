@@ -179,6 +179,8 @@ public:
 
     QString objectPath() const;
     static void sync();
+    static void setNotificationInterval(int msecs);
+    static int notificationInterval();
 
 signals:
     void itemRemove(const QByteArray &attribute);
@@ -160,6 +160,47 @@ private slots:
             dataPath.rmpath(dataPath.absolutePath());
     }
 
+    void tst_prefixedWords() {
+        QDawg dawg;
+        dawg.createFromWords(QString("ban band can cane cans pan pane pans").split(' '));
+
+        QCOMPARE( dawg.prefixedWords("ca"), QString("can cane cans").split(' ') );
+        QCOMPARE( dawg.prefixedWords("can"), QString("can cane cans").split(' ') );
+        QCOMPARE( dawg.prefixedWords("cane"), QStringList("cane") );
+        QCOMPARE( dawg.prefixedWords("pa", 2), QString("pan pane").split(' ') );
+        QCOMPARE( dawg.prefixedWords("", 3), QString("ban band can").split(' ') );
+        QCOMPARE( dawg.prefixedWords(""), dawg.allWords() );
+        QVERIFY( dawg.prefixedWords("x").isEmpty() );
+        QVERIFY( dawg.prefixedWords("bandx").isEmpty() );
+        QVERIFY( dawg.prefixedWords("ca", 0).isEmpty() );
+    }
+
+    void tst_topWords() {
+        QDawg dawg;
+        dawg.createFromWords(QString("ban 3,band 9,can 4,cane 1,cans 7,pan 2,pane 7,pans 5").split(','));
+
+        QCOMPARE( dawg.topWords("", 3), QString("band cans pane").split(' ') );
+        QCOMPARE( dawg.topWords("ca", 2), QString("cans can").split(' ') );
+        QCOMPARE( dawg.topWords("pan", 10), QString("pane pans pan").split(' ') );
+        QVERIFY( dawg.topWords("x", 3).isEmpty() );
+        QVERIFY( dawg.topWords("ca", 0).isEmpty() );
+    }
+
+    void tst_containsList() {
+        QDawg dawg;
+        dawg.createFromWords(QString("ban band can cane cans pan pane pans").split(' '));
+
+        QStringList words = QString("pans ca band can x cane bandx can pa").split(' ');
+        words << QString();
+        QList<bool> found = dawg.contains(words);
+        QCOMPARE( found.count(), words.count() );
+        for (int ii = 0; ii < words.count(); ++ii)
+            QCOMPARE( found.at(ii), dawg.contains(words.at(ii)) );
+
+        QDawg empty;
+        QCOMPARE( empty.contains(words), QVector<bool>(words.count(), false).toList() );
+    }
+
     // Called after each test is executed
     void cleanup()
     { 
@@ -0,0 +1,4 @@
+TEMPLATE=app
+CONFIG+=qtopia unittest
+TARGET=tst_qfilemonitor
+SOURCES=tst_qfilemonitor.cpp
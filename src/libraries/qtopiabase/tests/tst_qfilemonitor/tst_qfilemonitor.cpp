@@ -0,0 +1,165 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+#include <qfilemonitor.h>
+#include <QObject>
+#include <QTest>
+#include <QSignalSpy>
+#include <QDir>
+#include <QFile>
+#include <QTime>
+#include <QPair>
+#include <QtopiaApplication>
+
+#include <shared/qtopiaunittest.h>
+
+//TESTED_CLASS=QFileMonitor
+//TESTED_FILES=src/libraries/qtopiabase/qfilemonitor.h
+
+/*
+    The tst_QFileMonitor class provides unit tests for the QFileMonitor class.
+*/
+class tst_QFileMonitor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void directoryEntries_data();
+    void directoryEntries();
+    void directoryContents();
+
+private:
+    static bool waitForChange(QSignalSpy &spy, int timeout);
+    static void writeFile(const QString &fileName, const QByteArray &data);
+
+    QString dir;
+};
+
+QTEST_APP_MAIN( tst_QFileMonitor, QtopiaApplication )
+#include "tst_qfilemonitor.moc"
+
+void tst_QFileMonitor::init()
+{
+    dir = QDir::tempPath() + "/tst_qfilemonitor";
+    QDir().mkpath(dir);
+    writeFile(dir + "/existing", "existing");
+
+    // Without INotify, changes are seen through the directory's modification
+    // time, which has a resolution of one second.
+    QTest::qWait(1100);
+}
+
+void tst_QFileMonitor::cleanup()
+{
+    QDir d(dir);
+    foreach (const QString &entry, d.entryList(QDir::Files))
+        d.remove(entry);
+    QDir().rmdir(dir);
+}
+
+// Waits up to \a timeout milliseconds for \a spy to record a signal.
+bool tst_QFileMonitor::waitForChange(QSignalSpy &spy, int timeout)
+{
+    QTime timer;
+    timer.start();
+    while (spy.isEmpty() && timer.elapsed() < timeout)
+        QTest::qWait(50);
+    return !spy.isEmpty();
+}
+
+void tst_QFileMonitor::writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    QVERIFY( file.open(QIODevice::WriteOnly | QIODevice::Truncate) );
+    QCOMPARE( file.write(data), qint64(data.size()) );
+}
+
+void tst_QFileMonitor::directoryEntries_data()
+{
+    QTest::addColumn<int>("strategy");
+    QTest::addColumn<QString>("operation");
+
+    QList<QPair<QFileMonitor::Strategy, QString> > strategies;
+    strategies << qMakePair(QFileMonitor::INotify, QString("inotify"))
+               << qMakePair(QFileMonitor::DNotify, QString("dnotify"))
+               << qMakePair(QFileMonitor::Poll, QString("poll"));
+
+    QStringList operations;
+    operations << "create" << "remove" << "rename";
+
+    typedef QPair<QFileMonitor::Strategy, QString> Strategy;
+    foreach (const Strategy &strategy, strategies) {
+        foreach (const QString &operation, operations) {
+            QTest::newRow(QString("%1 %2").arg(strategy.second).arg(operation).toLatin1().constData())
+                << int(strategy.first) << operation;
+        }
+    }
+}
+
+/*?
+    Test that monitoring "dir/*" reports entries being created, removed and
+    renamed in dir, with every monitoring strategy.
+*/
+void tst_QFileMonitor::directoryEntries()
+{
+    QFETCH(int, strategy);
+    QFETCH(QString, operation);
+
+    QString fileName = dir + "/*";
+    QFileMonitor monitor(fileName, QFileMonitor::Strategy(strategy));
+    if (monitor.strategy() != QFileMonitor::Strategy(strategy))
+        QSKIP("Monitoring strategy not available on this system", SkipSingle);
+    QVERIFY( monitor.isValid() );
+    QCOMPARE( monitor.fileName(), fileName );
+
+    QSignalSpy spy(&monitor, SIGNAL(fileChanged(QString)));
+
+    if (operation == "create")
+        writeFile(dir + "/created", "created");
+    else if (operation == "remove")
+        QVERIFY( QFile::remove(dir + "/existing") );
+    else if (operation == "rename")
+        QVERIFY( QFile::rename(dir + "/existing", dir + "/renamed") );
+
+    // The poll strategy checks every five seconds, and changes may be
+    // reported after a further delay.
+    QVERIFY( waitForChange(spy, 12000) );
+    QCOMPARE( spy.first().at(0).toString(), fileName );
+}
+
+/*?
+    Test that monitoring "dir/*" with INotify also reports changes to the
+    contents of the entries.
+*/
+void tst_QFileMonitor::directoryContents()
+{
+    QString fileName = dir + "/*";
+    QFileMonitor monitor(fileName, QFileMonitor::INotify);
+    if (monitor.strategy() != QFileMonitor::INotify)
+        QSKIP("INotify not available on this system", SkipAll);
+
+    QSignalSpy spy(&monitor, SIGNAL(fileChanged(QString)));
+
+    writeFile(dir + "/existing", "changed");
+
+    QVERIFY( waitForChange(spy, 5000) );
+    QCOMPARE( spy.first().at(0).toString(), fileName );
+}
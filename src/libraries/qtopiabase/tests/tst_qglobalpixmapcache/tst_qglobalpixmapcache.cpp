@@ -49,6 +49,9 @@ private slots:
     void insert_remove();
     void insert_remove_data();
 
+    void pinned();
+    void overBudget();
+
 /* These tests are disabled until the bug related to insert_remove_bug is
    fixed - until then, these cause the test to hang. */
 private:
@@ -192,8 +195,6 @@ void tst_QGlobalPixmapCache::insert_find()
     QFETCH( bool, overwrite );
     QFETCH( bool, remove );
 
-    QEXPECT_FAIL("simple2", "Task 143439", Abort);
-
     // Verify key is or is not already used in cache, depending on what we
     // expect.
     {
@@ -233,8 +234,7 @@ void tst_QGlobalPixmapCache::insert_remove_data()
 /*?
     Test function for inserting and removing pixmaps from cache.
     This function:
-        * Checks that a pixmap either is or is not in cache, depending on
-          what the test data says should be the case.
+        * Checks that the pixmap is not in the cache.
         * Inserts a pixmap into the cache many times using a specified key.
           This overwrites the pixmap every time after the initial addition,
           so at the end, only one pixmap should be in the cache for the
@@ -248,19 +248,12 @@ void tst_QGlobalPixmapCache::insert_remove()
 {
     QFETCH( QString, key );
     QFETCH( QPixmap, pixmap );
-    QFETCH( bool, overwrite );
-
-    QEXPECT_FAIL("empty key", "Task 143439", Abort);
-    QEXPECT_FAIL("simple1", "Task 143439", Abort);
-    QEXPECT_FAIL("simple2", "Task 143439", Abort);
-    QEXPECT_FAIL("empty pixmap", "Task 143439", Abort);
 
-    // Verify key is or is not already used in cache, depending on what we
-    // expect.
+    // Every previous test case removed its pixmap, so the key must not be
+    // in the cache.
     {
         QPixmap check;
-        QVERIFY( overwrite && QGlobalPixmapCache::find( key, check )
-                 || !overwrite && !QGlobalPixmapCache::find( key, check ) );
+        QVERIFY( !QGlobalPixmapCache::find( key, check ) );
     }
 
     // Add the pixmap many times...
@@ -279,8 +272,6 @@ void tst_QGlobalPixmapCache::insert_remove()
     // Remove the pixmap once
     QGlobalPixmapCache::remove( key );
 
-    QEXPECT_FAIL("overwrite", "Task 143439", Abort);
-
     // Ensure it is really gone
     {
         QPixmap check;
@@ -289,6 +280,94 @@ void tst_QGlobalPixmapCache::insert_remove()
     }
 }
 
+/*?
+    Test function for pinning pixmaps in the cache.
+    This function:
+        * Inserts a pixmap and pins it.
+        * Inserts more unreferenced pixmaps than fit in the cache, so
+          that unpinned pixmaps have to be evicted.
+        * Checks that the pinned pixmap can still be found.
+        * Removes the pinned pixmap and checks that it is gone.
+*/
+void tst_QGlobalPixmapCache::pinned()
+{
+    QString key = "pinned_picture";
+    QPixmap pixmap(Qtopia::qtopiaDir() + QString( "/pics/callbutton.png"));
+
+    QVERIFY( !QGlobalPixmapCache::setPinned(key, true) );
+
+    {
+        QPixmap add = pixmap.copy();
+        QVERIFY( QGlobalPixmapCache::insert(key, add) );
+    }
+    QVERIFY( QGlobalPixmapCache::setPinned(key, true) );
+
+    // Every filler is unreferenced as soon as it is inserted, so inserting
+    // must keep succeeding by evicting the older ones.
+    QPixmap filler(64, 64);
+    filler.fill(Qt::red);
+    int fillers = 2 * QGLOBAL_PIXMAP_CACHE_LIMIT / (64 * 64);
+    for (int ii = 0; ii < fillers; ++ii) {
+        QPixmap add = filler.copy();
+        QVERIFY( QGlobalPixmapCache::insert("pinned_filler_" + QString::number(ii), add) );
+    }
+
+    {
+        QPixmap check;
+        QVERIFY( QGlobalPixmapCache::find(key, check) );
+        QCOMPARE( check, pixmap );
+    }
+
+    QGlobalPixmapCache::remove(key);
+    {
+        QPixmap check;
+        QVERIFY( !QGlobalPixmapCache::find(key, check) );
+    }
+
+    for (int ii = 0; ii < fillers; ++ii)
+        QGlobalPixmapCache::remove("pinned_filler_" + QString::number(ii));
+}
+
+/*?
+    Test function for pixmaps larger than the budget of one process.
+    This function:
+        * Inserts a pixmap larger than QGLOBAL_PIXMAP_CACHE_OWNER_LIMIT
+          but smaller than the cache.
+        * Checks that it can be found and pinned.
+        * Removes the pixmap and checks that it is gone.
+*/
+void tst_QGlobalPixmapCache::overBudget()
+{
+    QString key = "over_budget_picture";
+
+    // Size the pixmap by the bytes per line of the format the cache stores
+    int bytesPerLine = QPixmap(256, 1).toImage().bytesPerLine();
+    int rows = QGLOBAL_PIXMAP_CACHE_OWNER_LIMIT / bytesPerLine + 16;
+    if (rows * bytesPerLine >= QGLOBAL_PIXMAP_CACHE_LIMIT * 3 / 4)
+        QSKIP("The cache is too small for a pixmap over the process budget", SkipAll);
+
+    QPixmap pixmap(256, rows);
+    pixmap.fill(Qt::blue);
+
+    {
+        QPixmap add = pixmap.copy();
+        QVERIFY( QGlobalPixmapCache::insert(key, add) );
+    }
+    QVERIFY( QGlobalPixmapCache::setPinned(key, true) );
+
+    {
+        QPixmap check;
+        QVERIFY( QGlobalPixmapCache::find(key, check) );
+        QCOMPARE( check, pixmap );
+    }
+
+    QGlobalPixmapCache::remove(key);
+    {
+        QPixmap check;
+        QVERIFY( !QGlobalPixmapCache::find(key, check) );
+    }
+}
+
 /*?
     Test function to ensure the pixmap cache functions correctly even after
     being filled.
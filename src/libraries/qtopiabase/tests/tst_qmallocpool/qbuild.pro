@@ -0,0 +1,4 @@
+TEMPLATE=app
+CONFIG+=qtopia unittest
+TARGET=tst_qmallocpool
+SOURCES=tst_qmallocpool.cpp
@@ -0,0 +1,234 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+#include <qmallocpool.h>
+#include <QObject>
+#include <QTest>
+#include <QList>
+#include <QtopiaApplication>
+#include <string.h>
+
+#include <shared/qtopiaunittest.h>
+
+//TESTED_CLASS=QMallocPool
+//TESTED_FILES=src/libraries/qtopiabase/qmallocpool.h
+
+/*
+    The tst_QMallocPool class provides unit tests for the QMallocPool class.
+*/
+class tst_QMallocPool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void sizeClasses_data();
+    void sizeClasses();
+    void largeAllocation();
+    void objectsDontOverlap();
+    void reallocAcrossClasses();
+    void callocClears();
+    void slabFallback();
+
+private:
+    char *region;
+    QMallocPool *pool;
+};
+
+QTEST_APP_MAIN( tst_QMallocPool, QtopiaApplication )
+#include "tst_qmallocpool.moc"
+
+static const unsigned int PoolSize = 256 * 1024;
+
+void tst_QMallocPool::init()
+{
+    region = new char[PoolSize];
+    pool = new QMallocPool(region, PoolSize, QMallocPool::Owned, "tst_qmallocpool");
+    QVERIFY( pool->isValid() );
+}
+
+void tst_QMallocPool::cleanup()
+{
+    delete pool;
+    delete [] region;
+}
+
+void tst_QMallocPool::sizeClasses_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("allocated");
+
+    QTest::newRow("1") << 1 << 8;
+    QTest::newRow("8") << 8 << 8;
+    QTest::newRow("9") << 9 << 16;
+    QTest::newRow("24") << 24 << 24;
+    QTest::newRow("33") << 33 << 48;
+    QTest::newRow("48") << 48 << 48;
+    QTest::newRow("49") << 49 << 64;
+    QTest::newRow("65") << 65 << 96;
+    QTest::newRow("97") << 97 << 128;
+    QTest::newRow("128") << 128 << 128;
+    QTest::newRow("129") << 129 << 192;
+    QTest::newRow("193") << 193 << 256;
+    QTest::newRow("256") << 256 << 256;
+}
+
+/*?
+    Test that small allocations are made from a slab of the smallest size
+    class that fits them.
+*/
+void tst_QMallocPool::sizeClasses()
+{
+    QFETCH(int, size);
+    QFETCH(int, allocated);
+
+    QMallocPool::AllocationStats before = pool->allocationStatistics();
+    QCOMPARE( before.slabInuseBytes, 0ul );
+
+    void *ptr = pool->malloc(size);
+    QVERIFY( ptr );
+    QCOMPARE( int(pool->size_of(ptr)), allocated );
+
+    QMallocPool::AllocationStats after = pool->allocationStatistics();
+    QCOMPARE( after.slabInuseBytes, (unsigned long)allocated );
+    QVERIFY( after.slabBytes > 0 );
+
+    pool->free(ptr);
+    QCOMPARE( pool->allocationStatistics().slabInuseBytes, 0ul );
+}
+
+/*?
+    Test that allocations larger than the largest size class are made by
+    dlmalloc rather than from a slab.
+*/
+void tst_QMallocPool::largeAllocation()
+{
+    void *ptr = pool->malloc(257);
+    QVERIFY( ptr );
+    QVERIFY( pool->size_of(ptr) >= 257 );
+
+    QMallocPool::AllocationStats stats = pool->allocationStatistics();
+    QCOMPARE( stats.slabInuseBytes, 0ul );
+    QCOMPARE( stats.slabBytes, 0ul );
+
+    pool->free(ptr);
+}
+
+/*?
+    Test that objects allocated from slabs, including objects spanning
+    several slabs of one size class, don't overlap.
+*/
+void tst_QMallocPool::objectsDontOverlap()
+{
+    QList<unsigned char *> objects;
+    for (int ii = 0; ii < 1000; ++ii) {
+        int size = 1 + (ii * 37) % 256;
+        unsigned char *ptr = (unsigned char *)pool->malloc(size);
+        QVERIFY( ptr );
+        ::memset(ptr, ii & 0xFF, size);
+        objects.append(ptr);
+    }
+
+    for (int ii = 0; ii < objects.count(); ++ii) {
+        int size = 1 + (ii * 37) % 256;
+        for (int jj = 0; jj < size; ++jj)
+            QCOMPARE( int(objects.at(ii)[jj]), ii & 0xFF );
+    }
+
+    foreach (unsigned char *ptr, objects)
+        pool->free(ptr);
+    QCOMPARE( pool->allocationStatistics().slabInuseBytes, 0ul );
+}
+
+/*?
+    Test that realloc() keeps the contents when an object moves between size
+    classes and between a slab and dlmalloc.
+*/
+void tst_QMallocPool::reallocAcrossClasses()
+{
+    char *ptr = (char *)pool->malloc(16);
+    QVERIFY( ptr );
+    ::memcpy(ptr, "0123456789abcde", 16);
+
+    // Shrinking within the class keeps the object
+    QCOMPARE( (char *)pool->realloc(ptr, 12), ptr );
+
+    ptr = (char *)pool->realloc(ptr, 200);
+    QVERIFY( ptr );
+    QCOMPARE( int(pool->size_of(ptr)), 256 );
+    QCOMPARE( QByteArray(ptr), QByteArray("0123456789abcde") );
+
+    ptr = (char *)pool->realloc(ptr, 1000);
+    QVERIFY( ptr );
+    QVERIFY( pool->size_of(ptr) >= 1000 );
+    QCOMPARE( QByteArray(ptr), QByteArray("0123456789abcde") );
+    QCOMPARE( pool->allocationStatistics().slabInuseBytes, 0ul );
+
+    ptr = (char *)pool->realloc(ptr, 16);
+    QVERIFY( ptr );
+    QCOMPARE( QByteArray(ptr), QByteArray("0123456789abcde") );
+
+    QCOMPARE( pool->allocationStatistics().slabInuseBytes, 16ul );
+
+    pool->free(ptr);
+    QCOMPARE( pool->allocationStatistics().slabInuseBytes, 0ul );
+}
+
+/*?
+    Test that calloc() clears objects allocated from a reused slab.
+*/
+void tst_QMallocPool::callocClears()
+{
+    void *dirty = pool->malloc(64);
+    QVERIFY( dirty );
+    ::memset(dirty, 0xAA, 64);
+    pool->free(dirty);
+
+    unsigned char *ptr = (unsigned char *)pool->calloc(8, 8);
+    QVERIFY( ptr );
+    for (int ii = 0; ii < 64; ++ii)
+        QCOMPARE( int(ptr[ii]), 0 );
+    pool->free(ptr);
+}
+
+/*?
+    Test that small allocations fall back to dlmalloc when the pool has no
+    room for a new slab.
+*/
+void tst_QMallocPool::slabFallback()
+{
+    // Fill the pool with blocks too large for slabs
+    QList<void *> blocks;
+    while (void *ptr = pool->malloc(1024))
+        blocks.append(ptr);
+    QVERIFY( blocks.count() > 2 );
+
+    // Free a block between two others, leaving a hole too small for a slab
+    pool->free(blocks.takeAt(blocks.count() / 2));
+
+    void *ptr = pool->malloc(32);
+    QVERIFY( ptr );
+    QCOMPARE( pool->allocationStatistics().slabBytes, 0ul );
+    QVERIFY( pool->size_of(ptr) >= 32 );
+
+    pool->free(ptr);
+    foreach (void *block, blocks)
+        pool->free(block);
+}
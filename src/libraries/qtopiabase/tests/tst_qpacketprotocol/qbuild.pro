@@ -0,0 +1,4 @@
+TEMPLATE=app
+CONFIG+=qtopia unittest
+TARGET=tst_qpacketprotocol
+SOURCES=tst_qpacketprotocol.cpp
@@ -0,0 +1,232 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#include <qpacketprotocol.h>
+#include <QObject>
+#include <QTest>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtopiaApplication>
+
+#include <shared/qtopiaunittest.h>
+#include <shared/util.h>    // QTRY_VERIFY
+
+//TESTED_CLASS=QPacketProtocol
+//TESTED_FILES=src/libraries/qtopiabase/qpacketprotocol.h
+
+/*
+    The tst_QPacketProtocol class provides unit tests for the QPacketProtocol class.
+*/
+class tst_QPacketProtocol : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void streamedPacket();
+    void thresholdChange();
+    void highWaterMark();
+
+private:
+    static QByteArray payload(int size);
+    static void writePacket(QIODevice *device, const QByteArray &data);
+    static QByteArray reassemble(const QSignalSpy &spy);
+
+    QTcpServer *server;
+    QTcpSocket *sending;
+    QTcpSocket *receiving;
+};
+
+QTEST_APP_MAIN( tst_QPacketProtocol, QtopiaApplication )
+#include "tst_qpacketprotocol.moc"
+
+/*?
+    Connects a pair of local sockets to carry packets between two protocols.
+*/
+void tst_QPacketProtocol::init()
+{
+    server = new QTcpServer(this);
+    QVERIFY( server->listen(QHostAddress::LocalHost) );
+
+    sending = new QTcpSocket(this);
+    sending->connectToHost(QHostAddress::LocalHost, server->serverPort());
+    QVERIFY( server->waitForNewConnection(5000) );
+    receiving = server->nextPendingConnection();
+    QVERIFY( receiving );
+    QVERIFY( sending->waitForConnected(5000) );
+}
+
+void tst_QPacketProtocol::cleanup()
+{
+    delete sending;
+    delete server;
+}
+
+QByteArray tst_QPacketProtocol::payload(int size)
+{
+    QByteArray data(size, '\0');
+    for (int ii = 0; ii < size; ++ii)
+        data[ii] = char(ii % 251);
+    return data;
+}
+
+/*
+    Writes \a data to \a device in the packet format, without a QPacketProtocol.
+*/
+void tst_QPacketProtocol::writePacket(QIODevice *device, const QByteArray &data)
+{
+    qint32 size = data.size() + sizeof(qint32);
+    device->write((char *)&size, sizeof(qint32));
+    device->write(data);
+}
+
+/*
+    Joins the data delivered through packetChunk(), verifying that each piece
+    follows the previous one and belongs to a packet of the same size.
+*/
+QByteArray tst_QPacketProtocol::reassemble(const QSignalSpy &spy)
+{
+    QByteArray data;
+    for (int ii = 0; ii < spy.count(); ++ii) {
+        QList<QVariant> args = spy.at(ii);
+        if (args.at(1).toInt() != data.size())
+            return QByteArray();
+        if (args.at(2).toInt() != spy.at(0).at(2).toInt())
+            return QByteArray();
+        data += args.at(0).toByteArray();
+    }
+    return data;
+}
+
+/*?
+    Test function for receiving a packet through packetChunk().
+    This test:
+        * Sends a packet larger than the streaming threshold, followed by
+          a small packet.
+        * Checks that the large packet is delivered only in pieces, which
+          reassemble to the packet data.
+        * Checks that the small packet following it is read normally.
+*/
+void tst_QPacketProtocol::streamedPacket()
+{
+    QPacketProtocol sender(sending);
+    QPacketProtocol receiver(receiving);
+    receiver.setStreamingThreshold(1024);
+
+    QSignalSpy chunkSpy(&receiver, SIGNAL(packetChunk(QByteArray,qint32,qint32)));
+    QSignalSpy readySpy(&receiver, SIGNAL(readyRead()));
+
+    QByteArray large = payload(256 * 1024);
+    QPacket packet;
+    packet << large;
+    sender.send(packet);
+    sender.send() << QString("after");
+
+    QTRY_VERIFY( readySpy.count() == 1 );
+    QCOMPARE( receiver.packetsAvailable(), qint64(1) );
+
+    QByteArray expected;
+    {
+        QDataStream stream(&expected, QIODevice::WriteOnly);
+        stream << large;
+    }
+    QVERIFY( chunkSpy.count() > 0 );
+    QCOMPARE( chunkSpy.at(0).at(2).toInt(), expected.size() );
+    QCOMPARE( reassemble(chunkSpy), expected );
+
+    QString text;
+    receiver.read() >> text;
+    QCOMPARE( text, QString("after") );
+}
+
+/*?
+    Test function for changing the streaming threshold while a packet is
+    being received.
+    This test:
+        * Writes the header and the first half of a streamed packet.
+        * Disables streaming once the first piece has been delivered.
+        * Checks that the rest of the packet is still streamed, and that
+          the packet which follows it is buffered and read intact.
+*/
+void tst_QPacketProtocol::thresholdChange()
+{
+    QPacketProtocol receiver(receiving);
+    receiver.setStreamingThreshold(1024);
+
+    QSignalSpy chunkSpy(&receiver, SIGNAL(packetChunk(QByteArray,qint32,qint32)));
+    QSignalSpy readySpy(&receiver, SIGNAL(readyRead()));
+
+    QByteArray data = payload(8192);
+    qint32 size = data.size() + sizeof(qint32);
+    sending->write((char *)&size, sizeof(qint32));
+    sending->write(data.left(4096));
+    QTRY_VERIFY( chunkSpy.count() > 0 );
+
+    receiver.setStreamingThreshold(-1);
+    sending->write(data.mid(4096));
+
+    QByteArray after;
+    {
+        QDataStream stream(&after, QIODevice::WriteOnly);
+        stream << QString("after");
+    }
+    writePacket(sending, after);
+
+    QTRY_VERIFY( readySpy.count() == 1 );
+    QCOMPARE( reassemble(chunkSpy), data );
+
+    QString text;
+    receiver.read() >> text;
+    QCOMPARE( text, QString("after") );
+}
+
+/*?
+    Test function for send backpressure.
+    This test:
+        * Sends a packet larger than the send high water mark.
+        * Checks that the protocol reports it is not writable.
+        * Checks that writable() is emitted once the queue drains, and that
+          the protocol is then writable again.
+*/
+void tst_QPacketProtocol::highWaterMark()
+{
+    QPacketProtocol sender(sending);
+    QPacketProtocol receiver(receiving);
+    sender.setSendHighWaterMark(16 * 1024);
+    QCOMPARE( sender.sendHighWaterMark(), qint64(16 * 1024) );
+
+    QSignalSpy writableSpy(&sender, SIGNAL(writable()));
+    QSignalSpy readySpy(&receiver, SIGNAL(readyRead()));
+
+    QPacket packet;
+    packet << payload(512 * 1024);
+    sender.send(packet);
+    QVERIFY( sender.bytesToWrite() > sender.sendHighWaterMark() );
+    QVERIFY( !sender.isWritable() );
+
+    QTRY_VERIFY( writableSpy.count() == 1 );
+    QVERIFY( sender.isWritable() );
+    QVERIFY( sender.bytesToWrite() <= sender.sendHighWaterMark() / 2 );
+
+    QTRY_VERIFY( readySpy.count() == 1 );
+    QTRY_COMPARE( sender.bytesToWrite(), qint64(0) );
+}
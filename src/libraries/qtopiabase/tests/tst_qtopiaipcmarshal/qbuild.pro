@@ -0,0 +1,4 @@
+TEMPLATE=app
+CONFIG+=qtopia unittest
+TARGET=tst_qtopiaipcmarshal
+SOURCES=tst_qtopiaipcmarshal.cpp
@@ -0,0 +1,176 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+#include <qtopiaipcmarshal.h>
+#include <private/qtopiaipcmarshal_p.h>
+#include <QObject>
+#include <QTest>
+#include <QDataStream>
+#include <QtopiaApplication>
+
+#include <shared/qtopiaunittest.h>
+
+//TESTED_CLASS=
+//TESTED_FILES=src/libraries/qtopiabase/qtopiaipcmarshal.cpp
+
+class TestPoint
+{
+public:
+    TestPoint() : x(0), y(0) {}
+    TestPoint(int x, int y) : x(x), y(y) {}
+
+    bool operator==(const TestPoint &other) const
+        { return x == other.x && y == other.y; }
+
+    template <typename Stream> void serialize(Stream &stream) const
+        { stream << x << y; }
+    template <typename Stream> void deserialize(Stream &stream)
+        { stream >> x >> y; }
+
+    int x;
+    int y;
+};
+
+Q_DECLARE_USER_METATYPE(TestPoint)
+Q_IMPLEMENT_USER_METATYPE(TestPoint)
+
+/*
+    The tst_QtopiaIpcMarshal class provides unit tests for the compact
+    encoding of QVariant arguments in IPC messages.
+*/
+class tst_QtopiaIpcMarshal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void compactRoundTrip();
+    void compactBuiltinType();
+    void compactToStandard();
+    void corruptedCheck();
+};
+
+QTEST_APP_MAIN( tst_QtopiaIpcMarshal, QtopiaApplication )
+#include "tst_qtopiaipcmarshal.moc"
+
+void tst_QtopiaIpcMarshal::initTestCase()
+{
+    Q_REGISTER_USER_METATYPE(TestPoint);
+}
+
+/*?
+    Test that a value of a user defined type survives being written and
+    read back in the compact encoding.
+*/
+void tst_QtopiaIpcMarshal::compactRoundTrip()
+{
+    QVariant value = qVariantFromValue( TestPoint(3, -7) );
+
+    QByteArray data;
+    {
+        QDataStream out( &data, QIODevice::WriteOnly );
+        QVERIFY( qtopia_saveCompactVariant( out, value ) );
+    }
+
+    QDataStream in( data );
+    QVariant result;
+    QVERIFY( qtopia_loadCompactVariant( in, &result ) );
+    QCOMPARE( result.userType(), value.userType() );
+    QVERIFY( qVariantValue<TestPoint>( result ) == TestPoint(3, -7) );
+    QVERIFY( in.atEnd() );
+}
+
+/*?
+    Test that values of built-in types, which have no compact id, fall back
+    to the regular QVariant encoding.
+*/
+void tst_QtopiaIpcMarshal::compactBuiltinType()
+{
+    QVariant value( QString("compact") );
+
+    QByteArray data;
+    {
+        QDataStream out( &data, QIODevice::WriteOnly );
+        QVERIFY( qtopia_saveCompactVariant( out, value ) );
+    }
+
+    QDataStream in( data );
+    QVariant result;
+    QVERIFY( qtopia_loadCompactVariant( in, &result ) );
+    QCOMPARE( result, value );
+}
+
+/*?
+    Test that converting a compact message gives exactly the message name
+    and arguments a sender using the regular encoding would have produced.
+*/
+void tst_QtopiaIpcMarshal::compactToStandard()
+{
+    QVariant value = qVariantFromValue( TestPoint(12, 34) );
+
+    QByteArray compact;
+    {
+        QDataStream out( &compact, QIODevice::WriteOnly );
+        QVERIFY( qtopia_saveCompactVariant( out, value ) );
+        out << 56 << QString("tail");
+    }
+
+    QByteArray expected;
+    {
+        QDataStream out( &expected, QIODevice::WriteOnly );
+        out << value << 56 << QString("tail");
+    }
+
+    QString msg = QString("update(QVariant,int,QString)") + QTOPIA_COMPACT_MESSAGE_SUFFIX;
+    QVERIFY( qtopia_isCompactMessage( msg ) );
+
+    QString message;
+    QByteArray data;
+    QVERIFY( qtopia_compactToStandard( msg, compact, &message, &data ) );
+    QCOMPARE( message, QString("update(QVariant,int,QString)") );
+    QCOMPARE( data, expected );
+}
+
+/*?
+    Test that a value whose check word doesn't match the type its id
+    resolves to is rejected rather than decoded as the wrong type.
+*/
+void tst_QtopiaIpcMarshal::corruptedCheck()
+{
+    QVariant value = qVariantFromValue( TestPoint(1, 2) );
+
+    QByteArray data;
+    {
+        QDataStream out( &data, QIODevice::WriteOnly );
+        QVERIFY( qtopia_saveCompactVariant( out, value ) );
+    }
+
+    // The check word follows the 32-bit id.
+    QVERIFY( data.size() > 8 );
+    data[4] = data[4] ^ 0x5a;
+
+    QDataStream in( data );
+    QVariant result;
+    QVERIFY( !qtopia_loadCompactVariant( in, &result ) );
+
+    QString message;
+    QByteArray standard;
+    QVERIFY( !qtopia_compactToStandard( QString("update(QVariant)") + QTOPIA_COMPACT_MESSAGE_SUFFIX,
+                                        data, &message, &standard ) );
+}
@@ -11,9 +11,10 @@ VPATH += ../
 SOURCES += routines.cpp gfx.cpp def_blur.cpp def_color.cpp def_blend.cpp \
            def_memory.cpp gfxpainter.cpp gfxparticles.cpp gfximage.cpp \
            def_transform.cpp \
-           gfxtimeline.cpp
+           gfxtimeline.cpp simd_sse2.cpp simd_neon.cpp gfxthreadpool.cpp
 HEADERS += routines.h gfx.h def_blur.h def_color.h def_blend.h gfxpainter.h \
-           def_memory.h gfxparticles.h gfximage.h def_transform.h gfxtimeline.h
+           def_memory.h gfxparticles.h gfximage.h def_transform.h gfxtimeline.h \
+           simd.h gfxthreadpool.h
 
 # Input
 SOURCES += main.cpp
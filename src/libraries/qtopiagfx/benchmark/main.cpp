@@ -33,6 +33,8 @@
 GfxPainter *gfxPainter = 0;
 QString benchmark;
 bool includeSmall = false;
+bool compareSimd = false;
+QString prefix;
 QImage::Format srcFormat = QImage::Format_RGB16;
 
 class GfxBenchmarks : public QObject
@@ -46,16 +48,38 @@ public:
 public slots:
     void runBenchmarks()
     {
-        if(benchmark.isEmpty() || "blit" == benchmark) blitBenchmark();
-        if(benchmark.isEmpty() || "blur" == benchmark) blurBenchmark();
+        if(benchmark.isEmpty() || "blit" == benchmark) run(&GfxBenchmarks::blitBenchmark);
+        if(benchmark.isEmpty() || "blur" == benchmark) run(&GfxBenchmarks::blurBenchmark);
         if(benchmark.isEmpty() || "memcpy" == benchmark) memcpyBenchmark();
-        if(benchmark.isEmpty() || "transformedBlit" == benchmark) rotateBenchmark();
-        if(benchmark.isEmpty() || "fill" == benchmark) fillBenchmark();
-        if(benchmark.isEmpty() || "transformedFill" == benchmark) fillTransformedBenchmark();
+        if(benchmark.isEmpty() || "transformedBlit" == benchmark) run(&GfxBenchmarks::rotateBenchmark);
+        if(benchmark.isEmpty() || "fill" == benchmark) run(&GfxBenchmarks::fillBenchmark);
+        if(benchmark.isEmpty() || "transformedFill" == benchmark) run(&GfxBenchmarks::fillTransformedBenchmark);
     }
 
 private:
 
+    // Runs test once with the default C++ routines and once with the SIMD
+    // routines when comparing, otherwise with whatever Gfx::init() selected.
+    void run(void (GfxBenchmarks::*test)())
+    {
+        if(!compareSimd || !Gfx::simd()) {
+            (this->*test)();
+            return;
+        }
+
+        QString simd = Gfx::simd();
+
+        Gfx::setSimdEnabled(false);
+        prefix = "c++: ";
+        (this->*test)();
+
+        Gfx::setSimdEnabled(true);
+        prefix = simd + ": ";
+        (this->*test)();
+
+        prefix.clear();
+    }
+
     void rotateBenchmark()
     {
         struct {
@@ -280,7 +304,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " copy/sec, " << 1000. * (((qreal)(len * frames)) / (qreal)(1024 * 1024)) / (qreal)e << " MB/sec";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " copy/sec, " << 1000. * (((qreal)(len * frames)) / (qreal)(1024 * 1024)) / (qreal)e << " MB/sec";
                return;
             }
         }
@@ -298,7 +322,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -317,7 +341,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -335,7 +359,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -354,7 +378,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -372,7 +396,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -390,7 +414,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -408,7 +432,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -427,7 +451,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -445,7 +469,7 @@ private:
             if(t.elapsed() >= BENCHMARK_TIME) {
                int e = t.elapsed(); 
 
-               qWarning().nospace() << name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
+               qWarning().nospace() << prefix + name << ": " << 1000. * (qreal)frames / (qreal)e << " fps, " << (qreal)e / (qreal)frames << " ms/frame";
                return;
             }
         }
@@ -455,7 +479,7 @@ private:
 
 void help(char *name)
 {
-    qWarning() << name << ": [-32] [-16] [-src32] [-src16] [-src32p] [-small] [test]";
+    qWarning() << name << ": [-32] [-16] [-src32] [-src16] [-src32p] [-small] [-compare] [-threads <count>] [test]";
     qWarning() << "     blit";
     qWarning() << "     blur";
     qWarning() << "     memcpy";
@@ -487,6 +511,10 @@ int main(int argc, char ** argv)
             srcFormat = QImage::Format_ARGB32_Premultiplied;
         else if(0 == ::strcmp(argv[ii], "-small")) 
             includeSmall = true;
+        else if(0 == ::strcmp(argv[ii], "-compare")) 
+            compareSimd = true;
+        else if(0 == ::strcmp(argv[ii], "-threads") && ii + 1 < argc)
+            Gfx::setThreadCount(::atoi(argv[++ii]));
         else
             benchmark = argv[ii];
     }
@@ -494,6 +522,12 @@ int main(int argc, char ** argv)
     QImage img(240, 320, depth32?QImage::Format_RGB32:QImage::Format_RGB16);
     gfxPainter = new GfxPainter(img);;
 
+    if(Gfx::simd())
+        qWarning() << "Using" << Gfx::simd() << "routines";
+    else
+        qWarning() << "Using c++ routines";
+    qWarning() << "Painting on" << Gfx::threadCount() << "thread(s)";
+
     GfxBenchmarks benchmarks;
     benchmarks.runBenchmarks();
 }
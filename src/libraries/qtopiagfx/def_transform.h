@@ -20,14 +20,23 @@
 #ifndef DEF_TRANSFORM_H
 #define DEF_TRANSFORM_H
 
+#include <limits.h>
+
 class QImage;
 class QMatrix;
 class QSize;
 class GfxImageRef;
-void def_transform(GfxImageRef &out, const QImage &in, const QMatrix &m, unsigned char op);
-void def_transform_bilinear(GfxImageRef &out, const QImage &in, const QMatrix &m, unsigned char op);
 
-void def_transform_fill(GfxImageRef &out, const QMatrix &m, const QSize &, unsigned int color, unsigned char op);
-void def_transform_fill_bilinear(GfxImageRef &out, const QMatrix &m, const QSize &, unsigned int color, unsigned char op);
+// Only rows firstRow to lastRow (inclusive) of out are painted.  Painting an
+// image in several bands gives the same result as painting it in one go.
+void def_transform(GfxImageRef &out, const QImage &in, const QMatrix &m, unsigned char op,
+                   int firstRow = 0, int lastRow = INT_MAX);
+void def_transform_bilinear(GfxImageRef &out, const QImage &in, const QMatrix &m, unsigned char op,
+                            int firstRow = 0, int lastRow = INT_MAX);
+
+void def_transform_fill(GfxImageRef &out, const QMatrix &m, const QSize &, unsigned int color, unsigned char op,
+                        int firstRow = 0, int lastRow = INT_MAX);
+void def_transform_fill_bilinear(GfxImageRef &out, const QMatrix &m, const QSize &, unsigned int color, unsigned char op,
+                                 int firstRow = 0, int lastRow = INT_MAX);
 
 #endif
@@ -19,15 +19,44 @@
 
 #include "gfx.h"
 #include "routines.h"
+#include "simd.h"
 #include <QDebug>
 #include <QImage>
 #include <math.h>
 #include <dlfcn.h>
 #include "gfximage.h"
+#include "gfxthreadpool.h"
 
 bool gfx_use_qt = false;
 bool gfx_report_hazards = false;
 
+static const char *gfx_simd = 0;
+static struct BlurRoutines gfx_def_blurroutines;
+static struct BlendRoutines gfx_def_blendroutines;
+static struct ColorRoutines gfx_def_colorroutines;
+
+static PluginRoutines gfx_routines()
+{
+    PluginRoutines plug = {
+        &q_blurroutines,
+        &q_blendroutines,
+        &q_grayscaleroutines,
+        &q_memoryroutines,
+        &q_scaleroutines,
+        &q_colorroutines
+    };
+    return plug;
+}
+
+static void gfx_init_simd()
+{
+    PluginRoutines plug = gfx_routines();
+
+    gfx_simd = simd_sse2_init(&plug);
+    if(!gfx_simd)
+        gfx_simd = simd_neon_init(&plug);
+}
+
 static const char *QImage_formatToString(QImage::Format f)
 {
     switch(f) {
@@ -64,6 +93,15 @@ void Gfx::init(const char *_arch)
     if(!QString(getenv("GFX_REPORT_HAZARDS")).isEmpty())
         gfx_report_hazards = true;
 
+    gfx_def_blurroutines = q_blurroutines;
+    gfx_def_blendroutines = q_blendroutines;
+    gfx_def_colorroutines = q_colorroutines;
+    if(QString(getenv("GFX_NO_SIMD")).isEmpty())
+        gfx_init_simd();
+    int threads = QString(getenv("GFX_THREADS")).toInt();
+    if(threads > 1)
+        setThreadCount(threads);
+
     QByteArray arch;
     if(_arch) {
         arch = _arch;
@@ -91,17 +129,53 @@ void Gfx::init(const char *_arch)
         return;
     }
 
-    PluginRoutines plug = {
-        &q_blurroutines,
-        &q_blendroutines,
-        &q_grayscaleroutines,
-        &q_memoryroutines,
-        &q_scaleroutines
-    };
-
+    PluginRoutines plug = gfx_routines();
     init(&plug);
 }
 
+/*
+  Returns the name of the SIMD instruction set used by the blend, color and
+  blur routines, or 0 if only the default C++ routines are in use.
+ */
+const char *Gfx::simd()
+{
+    return gfx_simd;
+}
+
+/*
+  Switches the blend, color and blur routines between the default C++
+  implementations and the vectorized ones selected by init().  Any routines
+  installed by a GFX_PLUGIN are replaced.  This is intended for comparing the
+  two implementations, such as in the qtopiagfx benchmark.
+ */
+void Gfx::setSimdEnabled(bool enabled)
+{
+    init();
+
+    q_blurroutines = gfx_def_blurroutines;
+    q_blendroutines = gfx_def_blendroutines;
+    q_colorroutines = gfx_def_colorroutines;
+    gfx_simd = 0;
+
+    if(enabled)
+        gfx_init_simd();
+}
+
+/*
+  Returns the number of threads GfxPainter splits large operations across,
+  including the painting thread.  The default is 1 unless the GFX_THREADS
+  environment variable is set.
+ */
+int Gfx::threadCount()
+{
+    return GfxThreadPool::instance()->threadCount();
+}
+
+void Gfx::setThreadCount(int count)
+{
+    GfxThreadPool::instance()->setThreadCount(count);
+}
+
 void Gfx::blur(GfxImageRef &img, qreal radius)
 {
     if(radius <= -1.0f)
@@ -35,6 +35,10 @@ class GfxImageRef;
 namespace Gfx
 {
     QTOPIAGFX_EXPORT void init(const char *arch = 0);
+    QTOPIAGFX_EXPORT const char *simd();
+    QTOPIAGFX_EXPORT void setSimdEnabled(bool enabled);
+    QTOPIAGFX_EXPORT int threadCount();
+    QTOPIAGFX_EXPORT void setThreadCount(int count);
     QTOPIAGFX_EXPORT void blur(GfxImageRef &img, qreal radius);
     QTOPIAGFX_EXPORT void blur(QImage &img, qreal radius);
 };
@@ -38,6 +38,9 @@
 #include <private/qwidget_p.h>
 #include <QPaintEvent>
 #include "def_transform.h"
+#include "gfxthreadpool.h"
+#include <QVarLengthArray>
+#include <QSet>
 #include <unistd.h>
 
 // XXX - needed until QRegion::isRect() is in build by default
@@ -267,12 +270,88 @@ static const SimpleBlendFunc simpleBlendFuncs[RGB32 + 1][ARGB32p + 1] = {
     }
 };
 
+// Operations covering fewer pixels than this are painted on a single thread
+#define GFX_THREAD_THRESHOLD (128 * 128)
+
+class GfxBlitJob : public GfxBandJob
+{
+public:
+    virtual void run(int firstRow, int lastRow)
+    {
+        for(int ii = firstRow; ii <= lastRow; ++ii)
+            sbf((uchar *)srcBits + ii * srcStep, destBits + ii * destStep,
+                width, opacities?opacities[ii]:opacity);
+    }
+
+    SimpleBlendFunc sbf;
+    const uchar *srcBits;
+    int srcStep;
+    uchar *destBits;
+    int destStep;
+    int width;
+    uchar opacity;
+    const uchar *opacities;
+};
+
+class GfxFillJob : public GfxBandJob
+{
+public:
+    virtual void run(int firstRow, int lastRow)
+    {
+        for(int ii = firstRow; ii <= lastRow; ++ii) {
+            uchar *dest = destBits + ii * destStep;
+            if(depth == 2 && opaque)
+                q_memoryroutines.memset_16((ushort *)dest, color, width);
+            else if(depth == 2)
+                q_blendroutines.blend_color_rgb16((ushort *)dest, color, width, (ushort *)dest);
+            else if(opaque)
+                q_memoryroutines.memset_32((uint *)dest, color, width);
+            else
+                q_blendroutines.blend_color_rgb32((uint *)dest, color, width, (uint *)dest);
+        }
+    }
+
+    uchar *destBits;
+    int destStep;
+    int depth;
+    int width;
+    uint color;
+    bool opaque;
+};
+
+class GfxTransformJob : public GfxBandJob
+{
+public:
+    virtual void run(int firstRow, int lastRow)
+    {
+        if(img && smooth)
+            def_transform_bilinear(out, *img, matrix, opacity, firstRow, lastRow);
+        else if(img)
+            def_transform(out, *img, matrix, opacity, firstRow, lastRow);
+        else if(smooth)
+            def_transform_fill_bilinear(out, matrix, size, color, opacity, firstRow, lastRow);
+        else
+            def_transform_fill(out, matrix, size, color, opacity, firstRow, lastRow);
+    }
+
+    GfxImageRef out;
+    const QImage *img;
+    QMatrix matrix;
+    QSize size;
+    uint color;
+    uchar opacity;
+    bool smooth;
+};
+
+
+// Painters that have opted out of threaded painting with setThreaded(false)
+static QMutex unthreadedPaintersLock;
+static QSet<const GfxPainter *> unthreadedPainters;
 
 GfxPainter::GfxPainter()
 : fBuffer(0), buffer(0), _opacity(0xFF), realOpacity(1.0f),
   mainThreadProxy(0), dp(0),  p(0), pImg(0), useQt(false), depth(Depth_16),
-  opacityFunc(0), opacityFuncData(0)
-{
+  opacityFunc(0), opacityFuncData(0){
     Gfx::init();
     useQt = gfx_use_qt;
     mainThreadProxy = new MainThreadProxy(this);
@@ -284,8 +363,7 @@ GfxPainter::GfxPainter()
 GfxPainter::GfxPainter(QImage &img, const QRegion &reg)
 : fBuffer(0), buffer(0), _opacity(0xFF), realOpacity(1.0f),
   mainThreadProxy(0), dp(0),  p(0), pImg(0), useQt(false), depth(Depth_16),
-  opacityFunc(0), opacityFuncData(0)
-{
+  opacityFunc(0), opacityFuncData(0){
     Gfx::init();
     QImage::Format format = img.format();
 
@@ -326,8 +404,7 @@ GfxPainter::GfxPainter(QImage &img, const QRegion &reg)
 GfxPainter::GfxPainter(QWidget *wid, QPaintEvent *e)
 : fBuffer(0), buffer(0), _opacity(0xFF), realOpacity(1.0f),
   mainThreadProxy(0), dp(0),  p(0), pImg(0), useQt(false), depth(Depth_16),
-  opacityFunc(0), opacityFuncData(0)
-{
+  opacityFunc(0), opacityFuncData(0){
     Gfx::init();
 #ifdef Q_WS_QWS
     if(!gfx_use_qt) {
@@ -380,6 +457,7 @@ GfxPainter::GfxPainter(QWidget *wid, QPaintEvent *e)
 
 GfxPainter::~GfxPainter()
 {
+    setThreaded(true);
     delete mainThreadProxy; mainThreadProxy = 0;
     if(p)
         delete p;
@@ -491,6 +569,38 @@ QRect GfxPainter::userClipRect() const
     return _userClipRect;
 }
 
+/*!
+  Sets whether large operations may be split into horizontal bands and
+  painted concurrently on the threads configured with Gfx::setThreadCount().
+  The output is identical either way.  Threaded painting is enabled by
+  default, but has no effect unless more than one thread is configured.
+
+  Any horizontal opacity function is always called on the painting thread.
+ */
+void GfxPainter::setThreaded(bool t)
+{
+    // Kept out of the class so that its layout doesn't change
+    QMutexLocker locker(&unthreadedPaintersLock);
+    if(t)
+        unthreadedPainters.remove(this);
+    else
+        unthreadedPainters.insert(this);
+}
+
+bool GfxPainter::isThreaded() const
+{
+    QMutexLocker locker(&unthreadedPaintersLock);
+    return !unthreadedPainters.contains(this);
+}
+
+void GfxPainter::runBands(GfxBandJob *job, int rows, int columns)
+{
+    if(rows * columns >= GFX_THREAD_THRESHOLD && isThreaded())
+        GfxThreadPool::instance()->run(job, 0, rows - 1);
+    else
+        job->run(0, rows - 1);
+}
+
 void GfxPainter::mainThreadProxyFunc()
 {
 #if defined(Q_WS_QWS)
@@ -774,8 +884,16 @@ void GfxPainter::drawImage(int x, int y, const GfxImageRef &img, bool flipped)
     if(origImgRect.isEmpty())
         return;
 
-    if(qt_region_is_rect(clipRegion)) {
-        QRect imgRect = origImgRect.intersected(clipRegion.boundingRect());
+    QVector<QRect> rects;
+    if(qt_region_is_rect(clipRegion))
+        rects.append(origImgRect.intersected(clipRegion.boundingRect()));
+    else
+        rects = clipRects;
+
+    for(int ii = 0; ii < rects.count(); ++ii) {
+        QRect imgRect = origImgRect & rects.at(ii);
+        if(imgRect.isEmpty())
+            continue;
         QRect baseRect = imgRect.translated(-x, -y);
 
         const uchar *srcBits = img.bits();
@@ -793,58 +911,28 @@ void GfxPainter::drawImage(int x, int y, const GfxImageRef &img, bool flipped)
             srcStep *= -1;
         }
 
+        GfxBlitJob job;
+        job.sbf = sbf;
+        job.srcBits = srcBits;
+        job.srcStep = srcStep;
+        job.destBits = destBits;
+        job.destStep = step * depth;
+        job.width = width;
+        job.opacity = _opacity;
+        job.opacities = 0;
+
+        // The opacity function is not required to be thread safe
+        QVarLengthArray<uchar, 256> opacities;
         if(opacityFunc) {
-            for(int ii = 0; ii < height; ++ii) {
-                uchar opacity = opacityFunc(ii + imgRect.y(), opacityFuncData);
-                opacity = opacity_mul(opacity, _opacity);
-                sbf((uchar *)srcBits, destBits, width, opacity);
-                destBits += step * depth;
-                srcBits += srcStep;
-            }
-        } else {
-            for(int ii = 0; ii < height; ++ii) {
-                sbf((uchar *)srcBits, destBits, width, _opacity);
-                destBits += step * depth;
-                srcBits += srcStep;
+            opacities.resize(height);
+            for(int jj = 0; jj < height; ++jj) {
+                uchar opacity = opacityFunc(jj + imgRect.y(), opacityFuncData);
+                opacities[jj] = opacity_mul(opacity, _opacity);
             }
+            job.opacities = opacities.constData();
         }
-    } else {
-        for(int ii = 0; ii < clipRects.count(); ++ii) {
-            QRect imgRect = origImgRect & clipRects.at(ii);
-            if(imgRect.isEmpty())
-                continue;
-            QRect baseRect = imgRect.translated(-x, -y);
-
-            const uchar *srcBits = img.bits();
-            int srcStep = img.bytesPerLine();
-            srcBits += baseRect.y() * srcStep + src_depth * baseRect.x();
 
-            int width = baseRect.width();
-            int height = baseRect.height();
-
-            uchar *destBits = buffer;
-            destBits += imgRect.y() * step * depth + imgRect.x() * depth;
-
-            if(flipped) {
-                srcBits += (height - 1) * srcStep;
-                srcStep *= -1;
-            }
-            if(opacityFunc) {
-                for(int ii = 0; ii < height; ++ii) {
-                    uchar opacity = opacityFunc(ii + imgRect.y(), opacityFuncData);
-                    opacity = opacity_mul(opacity, _opacity);
-                    sbf((uchar *)srcBits, destBits, width, opacity);
-                    destBits += step * depth;
-                    srcBits += srcStep;
-                }
-            } else {
-                for(int ii = 0; ii < height; ++ii) {
-                    sbf((uchar *)srcBits, destBits, width, _opacity);
-                    destBits += step * depth;
-                    srcBits += srcStep;
-                }
-            }
-        }
+        runBands(&job, height, width);
     }
 }
 
@@ -859,60 +947,31 @@ void GfxPainter::fillOpaque(const QRect &r, const QRgb &rgb)
         color = rgb;
     }
 
-    if(qt_region_is_rect(clipRegion)) {
-        QRect fillRect = r.intersected(clipRegion.boundingRect());
-
-        int width = fillRect.width();
-        int height = fillRect.height();
-
-        if(depth == Depth_16) {
-            ushort *destBits = (ushort *)buffer;
-            uint destStep = step;
-            destBits += fillRect.y() * destStep + fillRect.x();
-
-            for(int ii = 0; ii < height; ++ii) {
-                q_memoryroutines.memset_16(destBits, color, width);
-                destBits += destStep;
-            }
-        } else {
-            uint *destBits = (uint *)buffer;
-            uint destStep = step;
-            destBits += fillRect.y() * destStep + fillRect.x();
-
-            for(int ii = 0; ii < height; ++ii) {
-                q_memoryroutines.memset_32(destBits, color, width);
-                destBits += destStep;
-            }
-        }
-    } else {
-        QRect p;
-        for(int ii = 0; ii < clipRects.count(); ++ii) {
-            QRect fillRect = r.intersected(clipRects.at(ii));
-
-            int width = fillRect.width();
-            int height = fillRect.height();
-
-            if(depth == Depth_16) {
-                ushort *destBits = (ushort *)buffer;
-                uint destStep = step;
-                destBits += fillRect.y() * destStep + fillRect.x();
-
-                for(int ii = 0; ii < height; ++ii) {
-                    q_memoryroutines.memset_16(destBits, color, width);
-                    destBits += destStep;
-                }
-            } else {
-                uint *destBits = (uint *)buffer;
-                uint destStep = step;
-                destBits += fillRect.y() * destStep + fillRect.x();
-
-                for(int ii = 0; ii < height; ++ii) {
-                    q_memoryroutines.memset_32(destBits, color, width);
-                    destBits += destStep;
-                }
-            }
+    fill(r, color, true);
+}
 
-        }
+void GfxPainter::fill(const QRect &r, uint color, bool opaque)
+{
+    QVector<QRect> rects;
+    if(qt_region_is_rect(clipRegion))
+        rects.append(clipRegion.boundingRect());
+    else
+        rects = clipRects;
+
+    for(int ii = 0; ii < rects.count(); ++ii) {
+        QRect fillRect = r.intersected(rects.at(ii));
+        if(fillRect.isEmpty())
+            continue;
+
+        GfxFillJob job;
+        job.destBits = buffer + (fillRect.y() * step + fillRect.x()) * depth;
+        job.destStep = step * depth;
+        job.depth = depth;
+        job.width = fillRect.width();
+        job.color = color;
+        job.opaque = opaque;
+
+        runBands(&job, fillRect.height(), fillRect.width());
     }
 }
 
@@ -996,61 +1055,7 @@ void GfxPainter::fillRect(const QRect &_r, const QColor &c)
                (rgba & 0xFF000000);
     }
 
-    if(qt_region_is_rect(clipRegion)) {
-        QRect fillRect = r.intersected(clipRegion.boundingRect());
-
-        int width = fillRect.width();
-        int height = fillRect.height();
-
-        if(depth == Depth_16) {
-            ushort *destBits = (ushort *)buffer;
-            uint destStep = step;
-            destBits += fillRect.y() * destStep + fillRect.x();
-
-            for(int ii = 0; ii < height; ++ii) {
-                q_blendroutines.blend_color_rgb16(destBits, rgba, width, destBits);
-                destBits += destStep;
-            }
-        } else {
-            uint *destBits = (uint *)buffer;
-            uint destStep = step;
-            destBits += fillRect.y() * destStep + fillRect.x();
-
-            for(int ii = 0; ii < height; ++ii) {
-                q_blendroutines.blend_color_rgb32(destBits, rgba, width, destBits);
-                destBits += destStep;
-            }
-        }
-    } else {
-        QRect p;
-        for(int ii = 0; ii < clipRects.count(); ++ii) {
-            QRect fillRect = r.intersected(clipRects.at(ii));
-
-            int width = fillRect.width();
-            int height = fillRect.height();
-
-            if(depth == Depth_16) {
-                ushort *destBits = (ushort *)buffer;
-                uint destStep = step;
-                destBits += fillRect.y() * destStep + fillRect.x();
-
-                for(int ii = 0; ii < height; ++ii) {
-                    q_blendroutines.blend_color_rgb16(destBits, rgba, width, destBits);
-                    destBits += destStep;
-                }
-            } else {
-                uint *destBits = (uint *)buffer;
-                uint destStep = step;
-                destBits += fillRect.y() * destStep + fillRect.x();
-
-                for(int ii = 0; ii < height; ++ii) {
-                    q_blendroutines.blend_color_rgb32(destBits, rgba, width, destBits);
-                    destBits += destStep;
-                }
-            }
-
-        }
-    }
+    fill(r, rgba, false);
 }
 
 void GfxPainter::drawImage(const QPoint &p, const QImage &i)
@@ -1126,11 +1131,15 @@ void GfxPainter::fillRectTransformed(const QMatrix &m, const QSize &s, const QCo
                     ((((color & 0xFF00) * alpha) >> 8) & 0xFF00);
 
         }
-        GfxImageRef img = imgRef(cr);
-        if(smooth)
-            def_transform_fill_bilinear(img, m2, s, color, _opacity);
-        else
-            def_transform_fill(img, m2, s, color, _opacity);
+        GfxTransformJob job;
+        job.out = imgRef(cr);
+        job.img = 0;
+        job.matrix = m2;
+        job.size = s;
+        job.color = color;
+        job.opacity = _opacity;
+        job.smooth = smooth;
+        runBands(&job, cr.height(), cr.width());
     }
 }
 
@@ -1158,11 +1167,14 @@ void GfxPainter::drawImageTransformed(const QMatrix &m, const QImage &img, bool
         m2.translate(-cr.x(), -cr.y());
         m2 = m * m2;
 
-        GfxImageRef out = imgRef(cr);
-        if(smooth)
-            def_transform_bilinear(out, img, m2, _opacity);
-        else
-            def_transform(out, img, m2, _opacity);
+        GfxTransformJob job;
+        job.out = imgRef(cr);
+        job.img = &img;
+        job.matrix = m2;
+        job.color = 0;
+        job.opacity = _opacity;
+        job.smooth = smooth;
+        runBands(&job, cr.height(), cr.width());
     }
 }
 
@@ -30,6 +30,7 @@ class GfxImageRef;
 class MainThreadProxy;
 class QPaintEvent;
 class GfxDirectPainter;
+class GfxBandJob;
 class QTOPIAGFX_EXPORT GfxPainter
 {
 public:
@@ -51,6 +52,9 @@ public:
     void setUserClipRect(const QRect &);
     QRect userClipRect() const;
 
+    void setThreaded(bool);
+    bool isThreaded() const;
+
     typedef uchar (*HorizontalOpacityFunction)(int, void *);
     void setHorizontalOpacityFunction(HorizontalOpacityFunction, void *);
 
@@ -91,6 +95,8 @@ public:
 private:
     void drawImage(int x, int y, const GfxImageRef &, bool);
     void fillOpaque(const QRect &, const QRgb &c);
+    void fill(const QRect &, uint color, bool opaque);
+    void runBands(GfxBandJob *, int rows, int columns);
     void flipUnclipped(const QRect &);
     QRect fRect;
     uchar *fBuffer;
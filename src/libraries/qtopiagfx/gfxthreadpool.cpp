@@ -0,0 +1,172 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#include "gfxthreadpool.h"
+#include <QThread>
+
+// Bands shorter than this aren't worth waking a worker for
+#define GFX_MIN_BAND_HEIGHT 8
+
+class GfxWorkerThread : public QThread
+{
+public:
+    GfxWorkerThread(GfxThreadPool *pool)
+        : _pool(pool) {}
+
+protected:
+    virtual void run() { _pool->work(); }
+
+private:
+    GfxThreadPool *_pool;
+};
+
+/*
+  GfxThreadPool splits a GfxBandJob into horizontal bands and paints them
+  concurrently on a set of worker threads and the calling thread.  run() does
+  not return until every band is complete.
+
+  Only one job runs at a time.  If run() is called while another thread's job
+  is in progress, the job is painted serially on the calling thread instead.
+ */
+GfxThreadPool::GfxThreadPool()
+: quit(false), job(0), firstRow(0), lastRow(0), bandHeight(0), nextBand(0),
+  bandCount(0), bandsDone(0)
+{
+}
+
+GfxThreadPool::~GfxThreadPool()
+{
+    setThreadCount(0);
+}
+
+GfxThreadPool *GfxThreadPool::instance()
+{
+    static GfxThreadPool pool;
+    return &pool;
+}
+
+/*
+  Returns the number of threads jobs are painted on, including the calling
+  thread.
+ */
+int GfxThreadPool::threadCount() const
+{
+    QMutexLocker runLocker(&runLock);
+    return workers.count() + 1;
+}
+
+void GfxThreadPool::setThreadCount(int count)
+{
+    QMutexLocker runLocker(&runLock);
+
+    count = qMax(count - 1, 0);
+    if(count == workers.count())
+        return;
+
+    // Stop the current workers and start over
+    lock.lock();
+    quit = true;
+    workAvailable.wakeAll();
+    lock.unlock();
+    for(int ii = 0; ii < workers.count(); ++ii) {
+        workers.at(ii)->wait();
+        delete workers.at(ii);
+    }
+    workers.clear();
+    quit = false;
+
+    for(int ii = 0; ii < count; ++ii) {
+        GfxWorkerThread *worker = new GfxWorkerThread(this);
+        workers.append(worker);
+        worker->start();
+    }
+}
+
+void GfxThreadPool::run(GfxBandJob *j, int first, int last)
+{
+    if(last < first)
+        return;
+
+    int rows = last - first + 1;
+    if(rows < 2 * GFX_MIN_BAND_HEIGHT || !runLock.tryLock()) {
+        j->run(first, last);
+        return;
+    }
+
+    // runLock guards workers against setThreadCount()
+    if(workers.isEmpty()) {
+        runLock.unlock();
+        j->run(first, last);
+        return;
+    }
+
+    // Use more bands than threads so that uneven bands (eg. the corners of
+    // a rotated image) balance out.
+    int bands = qMin((workers.count() + 1) * 2, rows / GFX_MIN_BAND_HEIGHT);
+
+    lock.lock();
+    job = j;
+    firstRow = first;
+    lastRow = last;
+    bandHeight = (rows + bands - 1) / bands;
+    bandCount = (rows + bandHeight - 1) / bandHeight;
+    nextBand = 0;
+    bandsDone = 0;
+    workAvailable.wakeAll();
+
+    while(runBand()) {}
+    while(bandsDone < bandCount)
+        workDone.wait(&lock);
+
+    job = 0;
+    lock.unlock();
+
+    runLock.unlock();
+}
+
+// Paints the next band of the current job, if any.  Must be called with lock
+// held.
+bool GfxThreadPool::runBand()
+{
+    if(!job || nextBand >= bandCount)
+        return false;
+
+    GfxBandJob *j = job;
+    int first = firstRow + nextBand * bandHeight;
+    int last = qMin(first + bandHeight - 1, lastRow);
+    ++nextBand;
+
+    lock.unlock();
+    j->run(first, last);
+    lock.lock();
+
+    if(++bandsDone == bandCount)
+        workDone.wakeAll();
+    return true;
+}
+
+void GfxThreadPool::work()
+{
+    lock.lock();
+    while(!quit) {
+        if(!runBand())
+            workAvailable.wait(&lock);
+    }
+    lock.unlock();
+}
@@ -0,0 +1,72 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#ifndef GFXTHREADPOOL_H
+#define GFXTHREADPOOL_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+
+// A unit of work that can be split into independent horizontal bands.  Each
+// row must be painted identically regardless of how the rows are banded.
+class GfxBandJob
+{
+public:
+    virtual ~GfxBandJob() {}
+    virtual void run(int firstRow, int lastRow) = 0;
+};
+
+class GfxWorkerThread;
+class GfxThreadPool
+{
+public:
+    GfxThreadPool();
+    ~GfxThreadPool();
+
+    static GfxThreadPool *instance();
+
+    int threadCount() const;
+    void setThreadCount(int);
+
+    void run(GfxBandJob *, int firstRow, int lastRow);
+
+private:
+    friend class GfxWorkerThread;
+    void work();
+    bool runBand();
+
+    mutable QMutex runLock;
+
+    QMutex lock;
+    QWaitCondition workAvailable;
+    QWaitCondition workDone;
+    QList<GfxWorkerThread *> workers;
+    bool quit;
+
+    GfxBandJob *job;
+    int firstRow;
+    int lastRow;
+    int bandHeight;
+    int nextBand;
+    int bandCount;
+    int bandsDone;
+};
+
+#endif
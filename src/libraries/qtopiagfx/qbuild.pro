@@ -16,6 +16,12 @@ pkg [
 
 #DEFINES+=QT_GREENPHONE_OPT
 
+# The SSE2 and NEON routines are only built when the compiler targets the
+# instruction set (eg. -msse2 or -mfpu=neon) and are only used at runtime
+# when the CPU supports them.  Set GFX_NO_SIMD in the environment to disable.
+# Set GFX_THREADS in the environment to paint large operations on that many
+# threads.
+
 HEADERS=\
     routines.h\
     gfx.h\
@@ -30,7 +36,9 @@ HEADERS=\
     def_blendhelper.h\
     gfxtimeline.h\
     gfxmipimage.h\
-    gfxeasing.h
+    gfxeasing.h\
+    simd.h\
+    gfxthreadpool.h
 
 SOURCES=\
     routines.cpp\
@@ -45,5 +53,8 @@ SOURCES=\
     def_transform.cpp\
     gfxtimeline.cpp\
     gfxmipimage.cpp\
-    gfxeasing.cpp
+    gfxeasing.cpp\
+    simd_sse2.cpp\
+    simd_neon.cpp\
+    gfxthreadpool.cpp
 
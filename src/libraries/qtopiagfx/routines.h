@@ -152,6 +152,7 @@ extern "C" {
         struct GrayscaleRoutines *gray;
         struct MemoryRoutines *memory;
         struct ScaleRoutines *scale;
+        struct ColorRoutines *color;
     };
 #ifdef __cplusplus
 };
@@ -0,0 +1,32 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#ifndef SIMD_H
+#define SIMD_H
+
+struct PluginRoutines;
+
+// Each of these checks whether the running CPU supports the instruction set,
+// and if so installs the vectorized routines into p and returns the name of
+// the instruction set.  Returns 0, leaving p untouched, if the CPU (or the
+// compiler used to build the library) does not support it.
+const char *simd_sse2_init(PluginRoutines *p);
+const char *simd_neon_init(PluginRoutines *p);
+
+#endif
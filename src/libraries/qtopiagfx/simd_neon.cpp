@@ -0,0 +1,369 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#include "simd.h"
+#include "routines.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#include "def_blend.h"
+#include "def_color.h"
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <elf.h>
+#endif
+
+/*
+   All routines in this file produce bit-identical output to their def_*
+   counterparts.  Spans that are too short to fill a vector, and the tail of
+   longer spans, are handed to the def_* routines.
+*/
+
+// Multiplies each 8-bit channel of the four pixels in px by the factor in
+// the corresponding 32-bit lane of f (0 - 255), and divides by 256.
+static inline uint32x4_t neon_mulChannels(uint32x4_t px, uint32x4_t f)
+{
+    uint8x16_t p8 = vreinterpretq_u8_u32(px);
+    uint8x16_t f8 = vreinterpretq_u8_u32(vmulq_n_u32(f, 0x01010101));
+
+    uint8x8_t lo = vshrn_n_u16(vmull_u8(vget_low_u8(p8), vget_low_u8(f8)), 8);
+    uint8x8_t hi = vshrn_n_u16(vmull_u8(vget_high_u8(p8), vget_high_u8(f8)), 8);
+    return vreinterpretq_u32_u8(vcombine_u8(lo, hi));
+}
+
+static inline uint16x8_t neon_pack565(uint16x8_t r, uint16x8_t g, uint16x8_t b)
+{
+    return vorrq_u16(vorrq_u16(vshlq_n_u16(vandq_u16(r, vdupq_n_u16(0xF8)), 8),
+                               vshlq_n_u16(vandq_u16(g, vdupq_n_u16(0xFC)), 3)),
+                     vshrq_n_u16(b, 3));
+}
+
+static inline uint32x4_t neon_blend_argb32p_rgb32(uint32x4_t d, uint32x4_t s)
+{
+    const uint32x4_t ff = vdupq_n_u32(0xFF);
+
+    uint32x4_t alpha = vshrq_n_u32(s, 24);
+    uint32x4_t result = neon_mulChannels(d, vsubq_u32(ff, alpha));
+    result = vandq_u32(result, vdupq_n_u32(0x00FFFFFF));
+    result = vorrq_u32(vaddq_u32(result, s), vdupq_n_u32(0xFF000000));
+
+    result = vbslq_u32(vceqq_u32(alpha, ff), s, result);
+    return vbslq_u32(vceqq_u32(alpha, vdupq_n_u32(0)), d, result);
+}
+
+static void neon_blend_argb32p_rgb32(unsigned int *dest,
+                                     unsigned int *src,
+                                     unsigned char opacity,
+                                     int width,
+                                     unsigned int *output)
+{
+    const uint8x8_t op = vdup_n_u8(opacity + 1);
+    const bool useOpacity = (opacity != 0xFF && opacity != 0xFE);
+
+    int ii = 0;
+    for(; ii + 4 <= width; ii += 4) {
+        uint32x4_t s = vld1q_u32(src + ii);
+        if(useOpacity) {
+            uint8x16_t s8 = vreinterpretq_u8_u32(s);
+            s = vreinterpretq_u32_u8(
+                    vcombine_u8(vshrn_n_u16(vmull_u8(vget_low_u8(s8), op), 8),
+                                vshrn_n_u16(vmull_u8(vget_high_u8(s8), op), 8)));
+        }
+
+        uint64x2_t a64 = vreinterpretq_u64_u32(vshrq_n_u32(s, 24));
+        if((vgetq_lane_u64(a64, 0) | vgetq_lane_u64(a64, 1)) == 0 &&
+           dest == output)
+            continue;
+
+        uint32x4_t d = vld1q_u32(dest + ii);
+        vst1q_u32(output + ii, neon_blend_argb32p_rgb32(d, s));
+    }
+
+    if(ii < width)
+        def_blend_argb32p_rgb32(dest + ii, src + ii, opacity,
+                                width - ii, output + ii);
+}
+
+static void neon_blend_color_rgb32(unsigned int *dest,
+                                   unsigned int src,
+                                   int width,
+                                   unsigned int *output)
+{
+    unsigned int inv_alpha = 0xFF - (src >> 24);
+    if(inv_alpha == 0xFF) {
+        // premul_nozero() leaves the destination untouched
+        def_blend_color_rgb32(dest, src, width, output);
+        return;
+    }
+
+    const uint32x4_t f = vdupq_n_u32(inv_alpha);
+    const uint32x4_t s = vdupq_n_u32(src);
+
+    int ii = 0;
+    for(; ii + 4 <= width; ii += 4) {
+        uint32x4_t d = neon_mulChannels(vld1q_u32(dest + ii), f);
+        d = vaddq_u32(vandq_u32(d, vdupq_n_u32(0x00FFFFFF)), s);
+        vst1q_u32(output + ii, vorrq_u32(d, vdupq_n_u32(0xFF000000)));
+    }
+
+    if(ii < width)
+        def_blend_color_rgb32(dest + ii, src, width - ii, output + ii);
+}
+
+static void neon_blend_argb32p_rgb16(unsigned short *dest,
+                                     unsigned int *src,
+                                     unsigned char opacity,
+                                     int width,
+                                     unsigned short *output)
+{
+    const uint16x8_t ff = vdupq_n_u16(0xFF);
+    const uint16x8_t op = vdupq_n_u16(opacity + 1);
+    const bool useOpacity = (opacity != 0xFF && opacity != 0xFE);
+
+    int ii = 0;
+    for(; ii + 8 <= width; ii += 8) {
+        // val[0] = blue, val[1] = green, val[2] = red, val[3] = alpha
+        uint8x8x4_t s = vld4_u8((const uint8_t *)(src + ii));
+        uint16x8_t sb = vmovl_u8(s.val[0]);
+        uint16x8_t sg = vmovl_u8(s.val[1]);
+        uint16x8_t sr = vmovl_u8(s.val[2]);
+        uint16x8_t sa = vmovl_u8(s.val[3]);
+        if(useOpacity) {
+            sa = vshrq_n_u16(vmulq_u16(sa, op), 8);
+            sr = vshrq_n_u16(vmulq_u16(sr, op), 8);
+            sg = vshrq_n_u16(vmulq_u16(sg, op), 8);
+            sb = vshrq_n_u16(vmulq_u16(sb, op), 8);
+        }
+
+        uint16x8_t zero_mask = vceqq_u16(sa, vdupq_n_u16(0));
+        uint64x2_t z64 = vreinterpretq_u64_u16(zero_mask);
+        if(vgetq_lane_u64(z64, 0) == ~0ULL && vgetq_lane_u64(z64, 1) == ~0ULL &&
+           dest == output)
+            continue;
+
+        uint16x8_t d = vld1q_u16(dest + ii);
+        uint16x8_t inv = vsubq_u16(ff, sa);
+
+        // qConvertRgb16To32()
+        uint16x8_t dr = vorrq_u16(vandq_u16(vshrq_n_u16(d, 8), vdupq_n_u16(0xF8)), vdupq_n_u16(0x07));
+        uint16x8_t dg = vorrq_u16(vandq_u16(vshrq_n_u16(d, 3), vdupq_n_u16(0xFC)), vdupq_n_u16(0x03));
+        uint16x8_t db = vorrq_u16(vandq_u16(vshlq_n_u16(d, 3), vdupq_n_u16(0xF8)), vdupq_n_u16(0x07));
+
+        uint16x8_t b = vaddq_u16(vshrq_n_u16(vmulq_u16(db, inv), 8), sb);
+        uint16x8_t g = vaddq_u16(vshrq_n_u16(vmulq_u16(dg, inv), 8), sg);
+        uint16x8_t r = vaddq_u16(vshrq_n_u16(vmulq_u16(dr, inv), 8), sr);
+        // Carry between channels as the packed 32-bit addition would
+        g = vaddq_u16(g, vshrq_n_u16(b, 8));
+        r = vaddq_u16(r, vshrq_n_u16(g, 8));
+        b = vandq_u16(b, ff);
+        g = vandq_u16(g, ff);
+
+        uint16x8_t result = neon_pack565(r, g, b);
+        result = vbslq_u16(vceqq_u16(sa, ff), neon_pack565(sr, sg, sb), result);
+        result = vbslq_u16(zero_mask, d, result);
+        vst1q_u16(output + ii, result);
+    }
+
+    if(ii < width)
+        def_blend_argb32p_rgb16(dest + ii, src + ii, opacity,
+                                width - ii, output + ii);
+}
+
+static void neon_blend_rgba16_rgb16(unsigned short *dest,
+                                    unsigned short *src,
+                                    unsigned char *alpha,
+                                    unsigned char opacity,
+                                    int width,
+                                    unsigned short *output)
+{
+    const uint16x8_t ff = vdupq_n_u16(0xFF);
+    const uint16x8_t op = vdupq_n_u16(opacity + 1);
+    const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+    const uint16x8_t mask6 = vdupq_n_u16(0x3F);
+
+    int ii = 0;
+    for(; ii + 8 <= width; ii += 8) {
+        uint16x8_t a = vmovl_u8(vld1_u8(alpha + ii));
+        if(opacity != 0xFF)
+            a = vshrq_n_u16(vmulq_u16(a, op), 8);
+
+        uint16x8_t zero_mask = vceqq_u16(a, vdupq_n_u16(0));
+        uint64x2_t z64 = vreinterpretq_u64_u16(zero_mask);
+        if(vgetq_lane_u64(z64, 0) == ~0ULL && vgetq_lane_u64(z64, 1) == ~0ULL &&
+           dest == output)
+            continue;
+
+        uint16x8_t d = vld1q_u16(dest + ii);
+        uint16x8_t s = vld1q_u16(src + ii);
+
+        uint16x8_t a2 = vaddq_u16(vshrq_n_u16(a, 2), vdupq_n_u16(1));
+        uint16x8_t inv = vsubq_u16(vdupq_n_u16(0x40), a2);
+
+        uint16x8_t r = vmlaq_u16(vmulq_u16(vshrq_n_u16(d, 11), inv),
+                                 vshrq_n_u16(s, 11), a2);
+        uint16x8_t g = vmlaq_u16(vmulq_u16(vandq_u16(vshrq_n_u16(d, 5), mask6), inv),
+                                 vandq_u16(vshrq_n_u16(s, 5), mask6), a2);
+        uint16x8_t b = vmlaq_u16(vmulq_u16(vandq_u16(d, mask5), inv),
+                                 vandq_u16(s, mask5), a2);
+
+        uint16x8_t result = vorrq_u16(
+                vorrq_u16(vshlq_n_u16(vshrq_n_u16(r, 6), 11),
+                          vshlq_n_u16(vshrq_n_u16(g, 6), 5)),
+                vshrq_n_u16(b, 6));
+        result = vbslq_u16(vceqq_u16(a, ff), s, result);
+        result = vbslq_u16(zero_mask, d, result);
+        vst1q_u16(output + ii, result);
+    }
+
+    if(ii < width)
+        def_blend_rgba16_rgb16(dest + ii, src + ii, alpha + ii, opacity,
+                               width - ii, output + ii);
+}
+
+static void neon_color_rgb16_rgb32(unsigned short *src,
+                                   int width,
+                                   unsigned int *output)
+{
+    int ii = 0;
+    for(; ii + 8 <= width; ii += 8) {
+        uint16x8_t s = vld1q_u16(src + ii);
+
+        uint8x8x4_t out;
+        out.val[0] = vmovn_u16(vshlq_n_u16(s, 3));                      // blue
+        out.val[1] = vshrn_n_u16(vandq_u16(s, vdupq_n_u16(0x07E0)), 3); // green
+        out.val[2] = vshrn_n_u16(s, 8);                                // red
+        out.val[0] = vorr_u8(vand_u8(out.val[0], vdup_n_u8(0xF8)), vdup_n_u8(0x07));
+        out.val[1] = vorr_u8(out.val[1], vdup_n_u8(0x03));
+        out.val[2] = vorr_u8(vand_u8(out.val[2], vdup_n_u8(0xF8)), vdup_n_u8(0x07));
+        out.val[3] = vdup_n_u8(0xFF);
+        vst4_u8((uint8_t *)(output + ii), out);
+    }
+
+    if(ii < width)
+        def_color_rgb16_rgb32(src + ii, width - ii, output + ii);
+}
+
+static void neon_color_rgb32_rgb16(unsigned int *src,
+                                   int width,
+                                   unsigned short *output)
+{
+    int ii = 0;
+    for(; ii + 8 <= width; ii += 8) {
+        uint8x8x4_t s = vld4_u8((const uint8_t *)(src + ii));
+        vst1q_u16(output + ii, neon_pack565(vmovl_u8(s.val[2]),
+                                            vmovl_u8(s.val[1]),
+                                            vmovl_u8(s.val[0])));
+    }
+
+    if(ii < width)
+        def_color_rgb32_rgb16(src + ii, width - ii, output + ii);
+}
+
+/*
+   The blur is a recursive filter, so each row (or column) is inherently
+   serial.  The four channels of a pixel are processed in parallel.
+*/
+
+static inline void neon_blurinner32(unsigned int *ptr, int32x4_t &z, int alpha)
+{
+    uint16x4_t c16 = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(*ptr))));
+    int32x4_t c = vreinterpretq_s32_u32(vmovl_u16(c16));
+
+    int32x4_t delta = vsubq_s32(vshlq_n_s32(c, 8), z);
+    z = vaddq_s32(z, vshrq_n_s32(vmulq_n_s32(delta, alpha), 15));
+
+    uint16x4_t o16 = vmovn_u32(vreinterpretq_u32_s32(vshrq_n_s32(z, 8)));
+    uint8x8_t o8 = vmovn_u16(vcombine_u16(o16, o16));
+    *ptr = vget_lane_u32(vreinterpret_u32_u8(o8), 0);
+}
+
+static inline void neon_blurline32(unsigned int *ptr, int count, int step,
+                                   int alpha)
+{
+    uint16x4_t c16 = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(*ptr))));
+    int32x4_t z = vshlq_n_s32(vreinterpretq_s32_u32(vmovl_u16(c16)), 8);
+
+    for(int index = 1; index < count; ++index)
+        neon_blurinner32(ptr + index * step, z, alpha);
+    for(int index = count - 2; index >= 0; --index)
+        neon_blurinner32(ptr + index * step, z, alpha);
+}
+
+static void neon_blur32(unsigned int *data, int width, int height,
+                        int step_width, int alpha)
+{
+    for(int row = 0; row < height; ++row)
+        neon_blurline32(data + row * step_width, width, 1, alpha);
+    for(int col = 0; col < width; ++col)
+        neon_blurline32(data + col, height, step_width, alpha);
+}
+
+static bool neon_supported()
+{
+#if defined(__aarch64__)
+    // Advanced SIMD is mandatory on AArch64
+    return true;
+#else
+    // getauxval() is not available in the C libraries we support, so read
+    // the hardware capabilities from the auxiliary vector directly.
+    int fd = ::open("/proc/self/auxv", O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    bool supported = false;
+    Elf32_auxv_t aux;
+    while(::read(fd, &aux, sizeof(aux)) == sizeof(aux)) {
+        if(aux.a_type == AT_HWCAP) {
+            supported = aux.a_un.a_val & (1 << 12); // HWCAP_NEON
+            break;
+        }
+    }
+    ::close(fd);
+    return supported;
+#endif
+}
+
+const char *simd_neon_init(PluginRoutines *p)
+{
+    if(!neon_supported())
+        return 0;
+
+    p->blur->blur32 = neon_blur32;
+
+    p->blend->blend_rgba16_rgb16 = neon_blend_rgba16_rgb16;
+    p->blend->blend_argb32p_rgb16 = neon_blend_argb32p_rgb16;
+    p->blend->blend_argb32p_rgb32 = neon_blend_argb32p_rgb32;
+    p->blend->blend_color_rgb32 = neon_blend_color_rgb32;
+
+    p->color->color_rgb16_rgb32 = neon_color_rgb16_rgb32;
+    p->color->color_rgb32_rgb16 = neon_color_rgb32_rgb16;
+
+    return "neon";
+}
+
+#else
+
+const char *simd_neon_init(PluginRoutines *)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,521 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#include "simd.h"
+#include "routines.h"
+
+#if defined(__SSE2__)
+
+#include "def_blend.h"
+#include "def_color.h"
+#include <qglobal.h>
+#include <emmintrin.h>
+#if defined(__i386__)
+#include <cpuid.h>
+#endif
+
+/*
+   All routines in this file produce bit-identical output to their def_*
+   counterparts.  Spans that are too short to fill a vector, and the tail of
+   longer spans, are handed to the def_* routines.
+*/
+
+static inline __m128i sse2_select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Multiplies each 8-bit channel of the four pixels in px by the factor in
+// the corresponding 32-bit lane of f (0 - 256), and divides by 256.
+static inline __m128i sse2_mulChannels(__m128i px, __m128i f)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    f = _mm_or_si128(f, _mm_slli_epi32(f, 16));
+    __m128i lo = _mm_unpacklo_epi8(px, zero);
+    __m128i hi = _mm_unpackhi_epi8(px, zero);
+    lo = _mm_srli_epi16(_mm_mullo_epi16(lo, _mm_unpacklo_epi32(f, f)), 8);
+    hi = _mm_srli_epi16(_mm_mullo_epi16(hi, _mm_unpackhi_epi32(f, f)), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+
+// Low 32 bits of a * b for each lane, where every lane of b holds the same
+// value.
+static inline __m128i sse2_mul32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), b);
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Packs the low 16 bits of each 32-bit lane of a and b
+static inline __m128i sse2_pack32to16(__m128i a, __m128i b)
+{
+    a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    return _mm_packs_epi32(a, b);
+}
+
+// Extracts one 8-bit channel of the eight pixels in s0 and s1 as 16-bit lanes
+static inline __m128i sse2_channel(__m128i s0, __m128i s1, int shift)
+{
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    return _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, shift), mask),
+                           _mm_and_si128(_mm_srli_epi32(s1, shift), mask));
+}
+
+static inline __m128i sse2_pack565(__m128i r, __m128i g, __m128i b)
+{
+    const __m128i rmask = _mm_set1_epi16(0xF8);
+    const __m128i gmask = _mm_set1_epi16(0xFC);
+
+    return _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi16(_mm_and_si128(r, rmask), 8),
+                         _mm_slli_epi16(_mm_and_si128(g, gmask), 3)),
+            _mm_srli_epi16(b, 3));
+}
+
+static inline __m128i sse2_blend_argb32p_rgb32(__m128i d, __m128i s)
+{
+    const __m128i ff = _mm_set1_epi32(0xFF);
+
+    __m128i alpha = _mm_srli_epi32(s, 24);
+    __m128i result = sse2_mulChannels(d, _mm_sub_epi32(ff, alpha));
+    result = _mm_and_si128(result, _mm_set1_epi32(0x00FFFFFF));
+    result = _mm_or_si128(_mm_add_epi32(result, s),
+                          _mm_set1_epi32(0xFF000000));
+
+    result = sse2_select(_mm_cmpeq_epi32(alpha, ff), s, result);
+    return sse2_select(_mm_cmpeq_epi32(alpha, _mm_setzero_si128()), d, result);
+}
+
+static void sse2_blend_argb32p_rgb32(unsigned int *dest,
+                                     unsigned int *src,
+                                     unsigned char opacity,
+                                     int width,
+                                     unsigned int *output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i op = _mm_set1_epi32(opacity + 1);
+
+    int ii = 0;
+    for(; ii + 4 <= width; ii += 4) {
+        __m128i s = _mm_loadu_si128((__m128i *)(src + ii));
+        if(opacity != 0xFF && opacity != 0xFE)
+            s = sse2_mulChannels(s, op);
+
+        int zero_mask = _mm_movemask_epi8(
+                _mm_cmpeq_epi32(_mm_srli_epi32(s, 24), zero));
+        if(zero_mask == 0xFFFF && dest == output)
+            continue;
+
+        __m128i d = _mm_loadu_si128((__m128i *)(dest + ii));
+        _mm_storeu_si128((__m128i *)(output + ii),
+                         sse2_blend_argb32p_rgb32(d, s));
+    }
+
+    if(ii < width)
+        def_blend_argb32p_rgb32(dest + ii, src + ii, opacity,
+                                width - ii, output + ii);
+}
+
+static void sse2_blend_color_rgb32(unsigned int *dest,
+                                   unsigned int src,
+                                   int width,
+                                   unsigned int *output)
+{
+    unsigned int inv_alpha = 0xFF - (src >> 24);
+    // premul_nozero() leaves the destination untouched when src is fully
+    // transparent, which a factor of 256 reproduces exactly.
+    const __m128i f = _mm_set1_epi32(inv_alpha == 0xFF ? 0x100 : inv_alpha);
+    const __m128i s = _mm_set1_epi32(src);
+    const __m128i rgbmask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i amask = _mm_set1_epi32(0xFF000000);
+
+    int ii = 0;
+    for(; ii + 4 <= width; ii += 4) {
+        __m128i d = _mm_loadu_si128((__m128i *)(dest + ii));
+        d = _mm_and_si128(sse2_mulChannels(d, f), rgbmask);
+        _mm_storeu_si128((__m128i *)(output + ii),
+                         _mm_or_si128(_mm_add_epi32(d, s), amask));
+    }
+
+    if(ii < width)
+        def_blend_color_rgb32(dest + ii, src, width - ii, output + ii);
+}
+
+static void sse2_blend_argb32p_rgb16(unsigned short *dest,
+                                     unsigned int *src,
+                                     unsigned char opacity,
+                                     int width,
+                                     unsigned short *output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ff = _mm_set1_epi16(0xFF);
+    const __m128i op = _mm_set1_epi16(opacity + 1);
+    const bool useOpacity = (opacity != 0xFF && opacity != 0xFE);
+
+    int ii = 0;
+    for(; ii + 8 <= width; ii += 8) {
+        __m128i s0 = _mm_loadu_si128((__m128i *)(src + ii));
+        __m128i s1 = _mm_loadu_si128((__m128i *)(src + ii + 4));
+
+        __m128i sa = sse2_channel(s0, s1, 24);
+        __m128i sr = sse2_channel(s0, s1, 16);
+        __m128i sg = sse2_channel(s0, s1, 8);
+        __m128i sb = sse2_channel(s0, s1, 0);
+        if(useOpacity) {
+            sa = _mm_srli_epi16(_mm_mullo_epi16(sa, op), 8);
+            sr = _mm_srli_epi16(_mm_mullo_epi16(sr, op), 8);
+            sg = _mm_srli_epi16(_mm_mullo_epi16(sg, op), 8);
+            sb = _mm_srli_epi16(_mm_mullo_epi16(sb, op), 8);
+        }
+
+        __m128i zero_mask = _mm_cmpeq_epi16(sa, zero);
+        if(_mm_movemask_epi8(zero_mask) == 0xFFFF && dest == output)
+            continue;
+
+        __m128i d = _mm_loadu_si128((__m128i *)(dest + ii));
+        __m128i inv = _mm_sub_epi16(ff, sa);
+
+        // qConvertRgb16To32()
+        __m128i dr = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(d, 8), _mm_set1_epi16(0xF8)), _mm_set1_epi16(0x07));
+        __m128i dg = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(d, 3), _mm_set1_epi16(0xFC)), _mm_set1_epi16(0x03));
+        __m128i db = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(d, 3), _mm_set1_epi16(0xF8)), _mm_set1_epi16(0x07));
+
+        __m128i b = _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(db, inv), 8), sb);
+        __m128i g = _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(dg, inv), 8), sg);
+        __m128i r = _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(dr, inv), 8), sr);
+        // Carry between channels as the packed 32-bit addition would
+        g = _mm_add_epi16(g, _mm_srli_epi16(b, 8));
+        r = _mm_add_epi16(r, _mm_srli_epi16(g, 8));
+        b = _mm_and_si128(b, ff);
+        g = _mm_and_si128(g, ff);
+
+        __m128i result = sse2_pack565(r, g, b);
+        result = sse2_select(_mm_cmpeq_epi16(sa, ff), sse2_pack565(sr, sg, sb), result);
+        result = sse2_select(zero_mask, d, result);
+        _mm_storeu_si128((__m128i *)(output + ii), result);
+    }
+
+    if(ii < width)
+        def_blend_argb32p_rgb16(dest + ii, src + ii, opacity,
+                                width - ii, output + ii);
+}
+
+static void sse2_blend_rgba16_rgb16(unsigned short *dest,
+                                    unsigned short *src,
+                                    unsigned char *alpha,
+                                    unsigned char opacity,
+                                    int width,
+                                    unsigned short *output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ff = _mm_set1_epi16(0xFF);
+    const __m128i op = _mm_set1_epi16(opacity + 1);
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+
+    int ii = 0;
+    for(; ii + 8 <= width; ii += 8) {
+        __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)(alpha + ii)), zero);
+        if(opacity != 0xFF)
+            a = _mm_srli_epi16(_mm_mullo_epi16(a, op), 8);
+
+        __m128i zero_mask = _mm_cmpeq_epi16(a, zero);
+        if(_mm_movemask_epi8(zero_mask) == 0xFFFF && dest == output)
+            continue;
+
+        __m128i d = _mm_loadu_si128((__m128i *)(dest + ii));
+        __m128i s = _mm_loadu_si128((__m128i *)(src + ii));
+
+        __m128i a2 = _mm_add_epi16(_mm_srli_epi16(a, 2), _mm_set1_epi16(1));
+        __m128i inv = _mm_sub_epi16(_mm_set1_epi16(0x40), a2);
+
+        __m128i r = _mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(d, 11), inv),
+                                  _mm_mullo_epi16(_mm_srli_epi16(s, 11), a2));
+        __m128i g = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(d, 5), mask6), inv),
+                                  _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(s, 5), mask6), a2));
+        __m128i b = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(d, mask5), inv),
+                                  _mm_mullo_epi16(_mm_and_si128(s, mask5), a2));
+
+        __m128i result = _mm_or_si128(
+                _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 6), 11),
+                             _mm_slli_epi16(_mm_srli_epi16(g, 6), 5)),
+                _mm_srli_epi16(b, 6));
+        result = sse2_select(_mm_cmpeq_epi16(a, ff), s, result);
+        result = sse2_select(zero_mask, d, result);
+        _mm_storeu_si128((__m128i *)(output + ii), result);
+    }
+
+    if(ii < width)
+        def_blend_rgba16_rgb16(dest + ii, src + ii, alpha + ii, opacity,
+                               width - ii, output + ii);
+}
+
+static void sse2_color_argb32_argb32p(unsigned int *src,
+                                      int width,
+                                      unsigned int *output)
+{
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i amask = _mm_set1_epi32(0xFF000000);
+
+    int ii = 0;
+    for(; ii + 4 <= width; ii += 4) {
+        __m128i s = _mm_loadu_si128((__m128i *)(src + ii));
+        __m128i f = _mm_add_epi32(_mm_srli_epi32(s, 24), one);
+        _mm_storeu_si128((__m128i *)(output + ii),
+                         _mm_or_si128(sse2_mulChannels(s, f),
+                                      _mm_and_si128(s, amask)));
+    }
+
+    if(ii < width)
+        def_color_argb32_argb32p(src + ii, width - ii, output + ii);
+}
+
+static inline __m128i sse2_rgb16_rgb32(__m128i s)
+{
+    return _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(s, _mm_set1_epi32(0xF800)), 8),
+                         _mm_slli_epi32(_mm_and_si128(s, _mm_set1_epi32(0x07E0)), 5)),
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(s, _mm_set1_epi32(0x001F)), 3),
+                         _mm_set1_epi32(0xFF070307)));
+}
+
+static void sse2_color_rgb16_rgb32(unsigned short *src,
+                                   int width,
+                                   unsigned int *output)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    int ii = 0;
+    for(; ii + 8 <= width; ii += 8) {
+        __m128i s = _mm_loadu_si128((__m128i *)(src + ii));
+        _mm_storeu_si128((__m128i *)(output + ii),
+                         sse2_rgb16_rgb32(_mm_unpacklo_epi16(s, zero)));
+        _mm_storeu_si128((__m128i *)(output + ii + 4),
+                         sse2_rgb16_rgb32(_mm_unpackhi_epi16(s, zero)));
+    }
+
+    if(ii < width)
+        def_color_rgb16_rgb32(src + ii, width - ii, output + ii);
+}
+
+static inline __m128i sse2_rgb32_rgb16(__m128i s)
+{
+    return _mm_or_si128(
+            _mm_or_si128(_mm_srli_epi32(_mm_and_si128(s, _mm_set1_epi32(0xF80000)), 8),
+                         _mm_srli_epi32(_mm_and_si128(s, _mm_set1_epi32(0x00FC00)), 5)),
+            _mm_srli_epi32(_mm_and_si128(s, _mm_set1_epi32(0x0000F8)), 3));
+}
+
+static void sse2_color_rgb32_rgb16(unsigned int *src,
+                                   int width,
+                                   unsigned short *output)
+{
+    int ii = 0;
+    for(; ii + 8 <= width; ii += 8) {
+        __m128i s0 = sse2_rgb32_rgb16(_mm_loadu_si128((__m128i *)(src + ii)));
+        __m128i s1 = sse2_rgb32_rgb16(_mm_loadu_si128((__m128i *)(src + ii + 4)));
+        _mm_storeu_si128((__m128i *)(output + ii), sse2_pack32to16(s0, s1));
+    }
+
+    if(ii < width)
+        def_color_rgb32_rgb16(src + ii, width - ii, output + ii);
+}
+
+/*
+   The blur is a recursive filter, so each row (or column) is inherently
+   serial.  The 32-bit blur processes the four channels of a pixel in
+   parallel; the 16-bit blur processes four rows (or columns) in parallel.
+*/
+
+static inline void sse2_blurinner32(unsigned int *ptr, __m128i &z, __m128i alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*ptr), zero);
+    c = _mm_unpacklo_epi16(c, zero);
+
+    __m128i delta = _mm_sub_epi32(_mm_slli_epi32(c, 8), z);
+    z = _mm_add_epi32(z, _mm_srai_epi32(sse2_mul32(delta, alpha), 15));
+
+    c = _mm_srli_epi32(z, 8);
+    c = _mm_packs_epi32(c, c);
+    *ptr = _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+}
+
+static inline void sse2_blurline32(unsigned int *ptr, int count, int step,
+                                   __m128i alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i z = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*ptr), zero);
+    z = _mm_slli_epi32(_mm_unpacklo_epi16(z, zero), 8);
+
+    for(int index = 1; index < count; ++index)
+        sse2_blurinner32(ptr + index * step, z, alpha);
+    for(int index = count - 2; index >= 0; --index)
+        sse2_blurinner32(ptr + index * step, z, alpha);
+}
+
+static void sse2_blur32(unsigned int *data, int width, int height,
+                        int step_width, int alpha)
+{
+    const __m128i a = _mm_set1_epi32(alpha);
+
+    for(int row = 0; row < height; ++row)
+        sse2_blurline32(data + row * step_width, width, 1, a);
+    for(int col = 0; col < width; ++col)
+        sse2_blurline32(data + col, height, step_width, a);
+}
+
+struct Sse2Blur16Lanes
+{
+    unsigned short *ptr[4];
+    int step;
+    bool contiguous;
+};
+
+static inline __m128i sse2_load16(const Sse2Blur16Lanes &l, int index)
+{
+    int offset = index * l.step;
+    if(l.contiguous)
+        return _mm_unpacklo_epi16(_mm_loadl_epi64((__m128i *)(l.ptr[0] + offset)),
+                                  _mm_setzero_si128());
+    else
+        return _mm_set_epi32(l.ptr[3][offset], l.ptr[2][offset],
+                             l.ptr[1][offset], l.ptr[0][offset]);
+}
+
+static inline void sse2_store16(const Sse2Blur16Lanes &l, int index, __m128i v)
+{
+    int offset = index * l.step;
+    v = sse2_pack32to16(v, v);
+    if(l.contiguous) {
+        _mm_storel_epi64((__m128i *)(l.ptr[0] + offset), v);
+    } else {
+        // Lanes may alias when there are fewer than four lines left, in
+        // which case they hold identical values.
+        l.ptr[0][offset] = _mm_extract_epi16(v, 0);
+        l.ptr[1][offset] = _mm_extract_epi16(v, 1);
+        l.ptr[2][offset] = _mm_extract_epi16(v, 2);
+        l.ptr[3][offset] = _mm_extract_epi16(v, 3);
+    }
+}
+
+static inline void sse2_blurinner16(const Sse2Blur16Lanes &l, int index,
+                                    __m128i &zR, __m128i &zG, __m128i &zB,
+                                    __m128i alpha)
+{
+    __m128i p = sse2_load16(l, index);
+    __m128i R = _mm_or_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0x07));
+    __m128i G = _mm_or_si128(_mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x07E0)), 3), _mm_set1_epi32(0x03));
+    __m128i B = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x001F)), 3), _mm_set1_epi32(0x07));
+
+    zR = _mm_add_epi32(zR, _mm_srai_epi32(sse2_mul32(_mm_sub_epi32(_mm_slli_epi32(R, 8), zR), alpha), 15));
+    zG = _mm_add_epi32(zG, _mm_srai_epi32(sse2_mul32(_mm_sub_epi32(_mm_slli_epi32(G, 8), zG), alpha), 15));
+    zB = _mm_add_epi32(zB, _mm_srai_epi32(sse2_mul32(_mm_sub_epi32(_mm_slli_epi32(B, 8), zB), alpha), 15));
+
+    p = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(_mm_slli_epi32(_mm_srai_epi32(zR, 8), 8), _mm_set1_epi32(0xF800)),
+                         _mm_and_si128(_mm_slli_epi32(_mm_srai_epi32(zG, 8), 3), _mm_set1_epi32(0x07E0))),
+            _mm_srai_epi32(zB, 11));
+    sse2_store16(l, index, p);
+}
+
+static inline void sse2_blurline16(const Sse2Blur16Lanes &l, int count,
+                                   __m128i alpha)
+{
+    __m128i p = sse2_load16(l, 0);
+    __m128i zR = _mm_slli_epi32(_mm_or_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0x07)), 8);
+    __m128i zG = _mm_slli_epi32(_mm_or_si128(_mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x07E0)), 3), _mm_set1_epi32(0x03)), 8);
+    __m128i zB = _mm_slli_epi32(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x001F)), 3), _mm_set1_epi32(0x07)), 8);
+
+    for(int index = 1; index < count; ++index)
+        sse2_blurinner16(l, index, zR, zG, zB, alpha);
+    for(int index = count - 2; index >= 0; --index)
+        sse2_blurinner16(l, index, zR, zG, zB, alpha);
+}
+
+static void sse2_blur16(unsigned short *data, int width, int height,
+                        int step_width, int alpha)
+{
+    const __m128i a = _mm_set1_epi32(alpha >> 1);
+
+    Sse2Blur16Lanes l;
+    l.step = 1;
+    l.contiguous = false;
+    for(int row = 0; row < height; row += 4) {
+        for(int ii = 0; ii < 4; ++ii)
+            l.ptr[ii] = data + qMin(row + ii, height - 1) * step_width;
+        sse2_blurline16(l, width, a);
+    }
+
+    l.step = step_width;
+    for(int col = 0; col < width; col += 4) {
+        l.contiguous = (col + 4 <= width);
+        for(int ii = 0; ii < 4; ++ii)
+            l.ptr[ii] = data + qMin(col + ii, width - 1);
+        sse2_blurline16(l, height, a);
+    }
+}
+
+static bool sse2_supported()
+{
+#if defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    return edx & bit_SSE2;
+#else
+    // SSE2 is part of the x86-64 baseline
+    return true;
+#endif
+}
+
+const char *simd_sse2_init(PluginRoutines *p)
+{
+    if(!sse2_supported())
+        return 0;
+
+    p->blur->blur32 = sse2_blur32;
+    p->blur->blur16 = sse2_blur16;
+
+    p->blend->blend_rgba16_rgb16 = sse2_blend_rgba16_rgb16;
+    p->blend->blend_argb32p_rgb16 = sse2_blend_argb32p_rgb16;
+    p->blend->blend_argb32p_rgb32 = sse2_blend_argb32p_rgb32;
+    p->blend->blend_color_rgb32 = sse2_blend_color_rgb32;
+
+    p->color->color_argb32_argb32p = sse2_color_argb32_argb32p;
+    p->color->color_rgb16_rgb32 = sse2_color_rgb16_rgb32;
+    p->color->color_rgb32_rgb16 = sse2_color_rgb32_rgb16;
+
+    return "sse2";
+}
+
+#else
+
+const char *simd_sse2_init(PluginRoutines *)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,5 @@
+TEMPLATE=app
+CONFIG+=qtopia unittest
+QTOPIA*=gfx
+TARGET=tst_gfxpainter
+SOURCES=tst_gfxpainter.cpp
@@ -0,0 +1,153 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+#include <gfx.h>
+#include <gfxpainter.h>
+#include <QObject>
+#include <QTest>
+#include <QImage>
+#include <QMatrix>
+#include <QtopiaApplication>
+
+#include <shared/qtopiaunittest.h>
+
+//TESTED_CLASS=GfxPainter
+//TESTED_FILES=src/libraries/qtopiagfx/gfxpainter.cpp,src/libraries/qtopiagfx/gfxthreadpool.cpp
+
+/*
+    The tst_GfxPainter class provides unit tests for the GfxPainter class.
+*/
+class tst_GfxPainter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+
+    void threadedOutput_data();
+    void threadedOutput();
+    void unthreadedPainter();
+
+private:
+    static QImage source();
+    static QImage paint(QImage::Format format, bool threaded = true);
+};
+
+QTEST_APP_MAIN( tst_GfxPainter, QtopiaApplication )
+#include "tst_gfxpainter.moc"
+
+void tst_GfxPainter::cleanup()
+{
+    Gfx::setThreadCount(1);
+}
+
+// Returns an image with detail in every row, so that a misplaced band shows.
+QImage tst_GfxPainter::source()
+{
+    QImage img(300, 300, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < img.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(img.scanLine(y));
+        for (int x = 0; x < img.width(); ++x) {
+            int alpha = (x + y) & 0xFF;
+            line[x] = qRgba((x * 7) % (alpha + 1), (y * 5) % (alpha + 1),
+                            (x ^ y) % (alpha + 1), alpha);
+        }
+    }
+    return img;
+}
+
+// Paints a blit, a fill and transformed draws large enough to be banded.
+QImage tst_GfxPainter::paint(QImage::Format format, bool threaded)
+{
+    QImage src = source();
+    QImage out(480, 400, format);
+    out.fill(0);
+
+    GfxPainter painter(out);
+    painter.setThreaded(threaded);
+    painter.fillRect(QRect(10, 10, 400, 300), QColor(40, 80, 120));
+    painter.setOpacity(0.6);
+    painter.drawImage(20, 30, src);
+
+    QMatrix m;
+    m.translate(240, 200);
+    m.rotate(33);
+    m.scale(1.2, 0.9);
+    m.translate(-150, -150);
+    painter.drawImageTransformed(m, src, false);
+
+    m.translate(15, -10);
+    painter.drawImageTransformed(m, src, true);
+
+    m.rotate(-50);
+    painter.fillRectTransformed(m, QSize(200, 260), QColor(200, 30, 60, 128), true);
+    return out;
+}
+
+void tst_GfxPainter::threadedOutput_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("RGB16, 2 threads") << int(QImage::Format_RGB16) << 2;
+    QTest::newRow("RGB16, 4 threads") << int(QImage::Format_RGB16) << 4;
+    QTest::newRow("RGB32, 2 threads") << int(QImage::Format_RGB32) << 2;
+    QTest::newRow("RGB32, 3 threads") << int(QImage::Format_RGB32) << 3;
+}
+
+/*?
+    Test that painting in bands on several threads gives exactly the same
+    output as painting on one thread.
+*/
+void tst_GfxPainter::threadedOutput()
+{
+    QFETCH(int, format);
+    QFETCH(int, threads);
+
+    Gfx::setThreadCount(1);
+    QCOMPARE(Gfx::threadCount(), 1);
+    QImage expected = paint(QImage::Format(format));
+
+    Gfx::setThreadCount(threads);
+    QCOMPARE(Gfx::threadCount(), threads);
+    QImage actual = paint(QImage::Format(format));
+
+    QVERIFY(actual == expected);
+}
+
+/*?
+    Test that a painter that opted out of threaded painting reports so and
+    still paints the same output.
+*/
+void tst_GfxPainter::unthreadedPainter()
+{
+    QImage expected = paint(QImage::Format_RGB32);
+
+    Gfx::setThreadCount(4);
+    {
+        QImage img(10, 10, QImage::Format_RGB32);
+        GfxPainter painter(img);
+        QVERIFY(painter.isThreaded());
+        painter.setThreaded(false);
+        QVERIFY(!painter.isThreaded());
+        painter.setThreaded(true);
+        QVERIFY(painter.isThreaded());
+    }
+
+    QVERIFY(paint(QImage::Format_RGB32, false) == expected);
+}
@@ -84,6 +84,22 @@ void LongStream::append(QString str)
     updateStatus();
 }
 
+// Raw data is written straight to the file, bypassing the text codec
+void LongStream::append(const QByteArray &data)
+{
+    *ts << flush;
+    qint64 written = tmpFile->write(data);
+    if (written > 0)
+        len += written;
+
+    // A short write, or a failure to flush the file's buffer, means the disk is full
+    if ((written != data.length()) || !tmpFile->flush()) {
+        setStatus( LongStream::OutOfSpace );
+        return;
+    }
+    updateStatus();
+}
+
 int LongStream::length()
 {
     return len;
@@ -45,6 +45,7 @@ public:
     void reset();
     QString detach();
     void append(QString str);
+    void append(const QByteArray &data);
     int length();
     QString fileName();
     QString readLine();
@@ -25,6 +25,7 @@
 #include <qtopialog.h>
 
 #include <ctype.h>
+#include <string.h>
 
 // Allow these values to be reduced from test harness code:
 int QTOPIAMAIL_EXPORT MaxCharacters = QMailCodec::ChunkCharacters;
@@ -150,16 +151,21 @@ void QMailCodec::encode(QDataStream& out, QTextStream& in, const QString& charse
 {
     if (QTextCodec* codec = codecForName(charset.toLatin1()))
     {
+        // The encoder retains state, so characters can be split between chunks
+        QTextEncoder* encoder = codec->makeEncoder();
+
         while (!in.atEnd())
         {
             QString chunk = in.read(MaxCharacters);
-            QByteArray charsetEncoded = codec->fromUnicode(chunk);
+            QByteArray charsetEncoded = encoder->fromUnicode(chunk);
 
             encodeChunk(out, 
                         reinterpret_cast<const unsigned char*>(charsetEncoded.constData()), 
                         charsetEncoded.length(),
                         in.atEnd());
         }
+
+        delete encoder;
     }
 }
 
@@ -174,26 +180,26 @@ void QMailCodec::decode(QTextStream& out, QDataStream& in, const QString& charse
 {
     if (QTextCodec* codec = codecForName(charset.toLatin1()))
     {
+        // Convert each decoded chunk as it is produced, rather than accumulating 
+        // the entire decoded content; the decoder retains any partial character
+        QTextDecoder* decoder = codec->makeDecoder();
+
         QByteArray decoded;
+        while (!in.atEnd())
         {
-            QDataStream decodedStream(&decoded, QIODevice::WriteOnly);
+            char buffer[MaxCharacters];
+            int length = in.readRawData(buffer, MaxCharacters);
 
-            while (!in.atEnd())
+            decoded.clear();
             {
-                char buffer[MaxCharacters];
-                int length = in.readRawData(buffer, MaxCharacters);
-
-                // Allow for decoded data to be twice the size without reallocation
-                decoded.reserve(decoded.size() + (MaxCharacters * 2));
-
+                QDataStream decodedStream(&decoded, QIODevice::WriteOnly);
                 decodeChunk(decodedStream, buffer, length, in.atEnd());
             }
+
+            out << decoder->toUnicode(decoded);
         }
 
-        // This is an unfortunately-necessary copy operation; we should investigate
-        // modifying QTextCodec to support a stream interface
-        QString unicode = codec->toUnicode(decoded);
-        out << unicode;
+        delete decoder;
         out.flush();
     }
 }
@@ -344,26 +350,141 @@ const unsigned char Minus = 0x2d;
 const unsigned char Slash = 0x2f;
 const unsigned char Underscore = 0x5f;
 
+static void writeStream(QDataStream& out, const char* it, int length)
+{
+    int totalWritten = 0;
+    while (totalWritten < length)
+    {
+        int bytesWritten = out.writeRawData(it + totalWritten, length - totalWritten);
+        if (bytesWritten == -1)
+            return;
+
+        totalWritten += bytesWritten;
+    }
+}
+
+// Collects coded output so that it is written to the stream in blocks, rather than by octet
+class OutputBuffer
+{
+public:
+    OutputBuffer(QDataStream& out)
+        : _out(out),
+          _it(_buffer),
+          _end(_buffer + BufferSize)
+    {
+    }
+
+    ~OutputBuffer()
+    {
+        flush();
+    }
+
+    inline void append(unsigned char value)
+    {
+        if (_it == _end)
+            flush();
+
+        *_it++ = static_cast<char>(value);
+    }
+
+    void append(const char* data, int length)
+    {
+        if (length > (_end - _it))
+        {
+            flush();
+            if (length >= BufferSize)
+            {
+                writeStream(_out, data, length);
+                return;
+            }
+        }
+
+        ::memcpy(_it, data, length);
+        _it += length;
+    }
+
+    void flush()
+    {
+        if (_it != _buffer)
+        {
+            writeStream(_out, _buffer, (_it - _buffer));
+            _it = _buffer;
+        }
+    }
+
+private:
+    enum { BufferSize = 4096 };
+
+    QDataStream& _out;
+    char _buffer[BufferSize];
+    char* _it;
+    char* const _end;
+};
+
 // Static data and functions for Base 64 codec
 static const char Base64Characters[64 + 1] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 static const unsigned char* Base64Values = reinterpret_cast<const unsigned char*>(Base64Characters);
 static const unsigned char Base64PaddingByte = 0x3d;
 
+// Maps each ASCII value to its Base64 index; padding is 64, anything invalid is 65
+static const unsigned char Base64Indices[256] = 
+{
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 62, 65, 65, 65, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 65, 65, 65, 64, 65, 65,
+    65,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 65, 65, 65, 65, 65,
+    65, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65
+};
+
 static inline unsigned char base64Index(const char ascii)
 {
-    if (ascii >= 'A' && ascii <= 'Z')
-        return (ascii - 'A');
-    if (ascii >= 'a' && ascii <= 'z')
-        return (ascii - 'a') + 26;
-    if (ascii >= '0' && ascii <= '9')
-        return (ascii - '0') + 52;
-    if (ascii == '+')
-        return 62;
-    if (ascii == '/')
-        return 63;
-    if (ascii == Base64PaddingByte)
-        return 64;
-    return 65;
+    return Base64Indices[static_cast<unsigned char>(ascii)];
+}
+
+static inline void encodeBase64Group(OutputBuffer& output, const unsigned char* input)
+{
+    output.append(Base64Values[(input[0] >> 2) & 0x3f]);
+    output.append(Base64Values[(((input[0] & 0x03) << 4) | (input[1] >> 4)) & 0x3f]);
+    output.append(Base64Values[(((input[1] & 0x0f) << 2) | (input[2] >> 6)) & 0x3f]);
+    output.append(Base64Values[input[2] & 0x3f]);
+}
+
+static inline bool isNewline(unsigned char value)
+{
+    return ((value == CarriageReturn) || (value == LineFeed));
+}
+
+static inline void appendDecoded(OutputBuffer& output, unsigned char value, bool text, unsigned char* lastChar)
+{
+    if (text && isNewline(value))
+    {
+        if (*lastChar == CarriageReturn && value == LineFeed)
+        {
+            // We have already processed this sequence
+        }
+        else
+        {
+            // We should output the local newline sequence, but we can't
+            // because we don't know what it is, and C++ translation-from-\n will
+            // only work if the stream is a file...
+            output.append('\n');
+        }
+
+        *lastChar = value;
+    }
+    else
+        output.append(value);
 }
 
 
@@ -443,7 +564,10 @@ QMailBase64Codec::QMailBase64Codec(ContentType content, int maximumLineLength)
 /*! \internal */
 void QMailBase64Codec::encodeChunk(QDataStream& out, const unsigned char* it, int length, bool finalChunk)
 {
+    OutputBuffer output(out);
+
     unsigned char* bufferEnd = _encodeBuffer + 3;
+    const int lineChars = (_maximumLineLength / 4 * 3);
 
     // Set the input pointers relative to this input
     const unsigned char* lineEnd = it + _encodeLineCharsRemaining;
@@ -451,10 +575,34 @@ void QMailBase64Codec::encodeChunk(QDataStream& out, const unsigned char* it, in
 
     while (it != end)
     {
+        if (_encodeBufferOut == _encodeBuffer)
+        {
+            // Encode whole groups directly from the input, until we reach a newline in text content
+            while ((end - it) >= 3)
+            {
+                if ((_content == Text) && (isNewline(it[0]) || isNewline(it[1]) || isNewline(it[2])))
+                    break;
+
+                encodeBase64Group(output, it);
+                it += 3;
+
+                if ((it >= lineEnd) && ((it != end) || !finalChunk))
+                {
+                    // Insert an ASCII CRLF sequence
+                    output.append(CarriageReturn);
+                    output.append(LineFeed);
+                    lineEnd += lineChars;
+                }
+            }
+
+            if (it == end)
+                break;
+        }
+
         bool trailingLF = false;
 
         const unsigned char input = *it++;
-        if ((input == CarriageReturn || input == LineFeed) && (_content == Text))
+        if (isNewline(input) && (_content == Text))
         {
             if (_lastChar == CarriageReturn && input == LineFeed)
             {
@@ -488,17 +636,15 @@ void QMailBase64Codec::encodeChunk(QDataStream& out, const unsigned char* it, in
         if (_encodeBufferOut == bufferEnd)
         {
             // We have buffered 3 input bytes - write them out as four output bytes
-            out << Base64Values[(_encodeBuffer[0] >> 2) & 0x3f];
-            out << Base64Values[(((_encodeBuffer[0] & 0x03) << 4) | (_encodeBuffer[1] >> 4)) & 0x3f];
-            out << Base64Values[(((_encodeBuffer[1] & 0x0f) << 2) | (_encodeBuffer[2] >> 6)) & 0x3f];
-            out << Base64Values[_encodeBuffer[2] & 0x3f];
+            encodeBase64Group(output, _encodeBuffer);
 
             _encodeBufferOut = _encodeBuffer;
             if ((it >= lineEnd) && ((it != end) || !finalChunk))
             {
                 // Insert an ASCII CRLF sequence
-                out << static_cast<unsigned char>(CarriageReturn) << static_cast<unsigned char>(LineFeed);
-                lineEnd += (_maximumLineLength / 4 * 3);
+                output.append(CarriageReturn);
+                output.append(LineFeed);
+                lineEnd += lineChars;
             }
         }
 
@@ -516,19 +662,19 @@ void QMailBase64Codec::encodeChunk(QDataStream& out, const unsigned char* it, in
             // We have some data still buffered - pad buffer with zero bits
             *_encodeBufferOut = 0;
 
-            out << Base64Values[(_encodeBuffer[0] >> 2) & 0x3f];
-            out << Base64Values[(((_encodeBuffer[0] & 0x03) << 4) | (_encodeBuffer[1] >> 4)) & 0x3f];
+            output.append(Base64Values[(_encodeBuffer[0] >> 2) & 0x3f]);
+            output.append(Base64Values[(((_encodeBuffer[0] & 0x03) << 4) | (_encodeBuffer[1] >> 4)) & 0x3f]);
 
             // Indicate unused bytes with the padding character
             if (bufferedBytesRemaining == 1)
             {
-                out << Base64PaddingByte;
-                out << Base64PaddingByte;
+                output.append(Base64PaddingByte);
+                output.append(Base64PaddingByte);
             }
             else // must be two
             {
-                out << Base64Values[(((_encodeBuffer[1] & 0x0f) << 2) | (_encodeBuffer[2] >> 6)) & 0x3f];
-                out << Base64PaddingByte;
+                output.append(Base64Values[(((_encodeBuffer[1] & 0x0f) << 2) | (_encodeBuffer[2] >> 6)) & 0x3f]);
+                output.append(Base64PaddingByte);
             }
         }
     }
@@ -542,11 +688,38 @@ void QMailBase64Codec::encodeChunk(QDataStream& out, const unsigned char* it, in
 /*! \internal */
 void QMailBase64Codec::decodeChunk(QDataStream& out, const char* it, int length, bool finalChunk)
 {
+    OutputBuffer output(out);
+
     unsigned char* bufferEnd = _decodeBuffer + 4;
+    const bool text = (_content == Text);
 
     const char* const end = it + length;
     while (it != end)
     {
+        if ((_decodeBufferOut == _decodeBuffer) && (_decodePaddingCount == 0))
+        {
+            // Decode whole groups of valid characters directly from the input
+            while ((end - it) >= 4)
+            {
+                const unsigned char a = base64Index(it[0]);
+                const unsigned char b = base64Index(it[1]);
+                const unsigned char c = base64Index(it[2]);
+                const unsigned char d = base64Index(it[3]);
+
+                // Padding, line breaks and invalid characters all have index values above 63
+                if ((a | b | c | d) & 0xc0)
+                    break;
+
+                appendDecoded(output, static_cast<unsigned char>((a << 2) | (b >> 4)), text, &_lastChar);
+                appendDecoded(output, static_cast<unsigned char>((b << 4) | (c >> 2)), text, &_lastChar);
+                appendDecoded(output, static_cast<unsigned char>((c << 6) | d), text, &_lastChar);
+                it += 4;
+            }
+
+            if (it == end)
+                break;
+        }
+
         // Convert each character to the index value
         *_decodeBufferOut = base64Index(*it++);
         if (*_decodeBufferOut == 64)
@@ -566,26 +739,7 @@ void QMailBase64Codec::decodeChunk(QDataStream& out, const char* it, int length,
 
             int remainingChars = (3 - _decodePaddingCount);
             for (int i = 0; i < remainingChars; ++i)
-            {
-                if ((decoded[i] == CarriageReturn || decoded[i] == LineFeed) && (_content == Text))
-                {
-                    if (_lastChar == CarriageReturn && decoded[i] == LineFeed)
-                    {
-                        // We have already processed this sequence
-                    }
-                    else
-                    {
-                        // We should output the local newline sequence, but we can't
-                        // because we don't know what it is, and C++ translation-from-\n will
-                        // only work if the stream is a file...
-                        out << static_cast<unsigned char>('\n');
-                    }
-
-                    _lastChar = decoded[i];
-                }
-                else
-                    out << decoded[i];
-            }
+                appendDecoded(output, decoded[i], text, &_lastChar);
 
             _decodeBufferOut = _decodeBuffer;
         }
@@ -608,7 +762,7 @@ static const unsigned char NilPreceding = 0x7f;
 static const char QuotedPrintableCharacters[16 + 1] = "0123456789ABCDEF";
 static const unsigned char* QuotedPrintableValues = reinterpret_cast<const unsigned char*>(QuotedPrintableCharacters);
 
-static bool requiresEscape(unsigned char input, QMailQuotedPrintableCodec::ConformanceType conformance, int charsRemaining)
+static bool escapeRequired(unsigned char input, QMailQuotedPrintableCodec::ConformanceType conformance)
 {
     // For both, we need to escape '=' and anything unprintable
     bool escape = ((input > MaxPrintableRange) || 
@@ -628,6 +782,31 @@ static bool requiresEscape(unsigned char input, QMailQuotedPrintableCodec::Confo
         }
     }
 
+    return escape;
+}
+
+// Precomputed escape requirements for each octet value, under each conformance type
+struct QuotedPrintableEscapes
+{
+    QuotedPrintableEscapes()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            rfc2045[i] = escapeRequired(static_cast<unsigned char>(i), QMailQuotedPrintableCodec::Rfc2045);
+            rfc2047[i] = escapeRequired(static_cast<unsigned char>(i), QMailQuotedPrintableCodec::Rfc2047);
+        }
+    }
+
+    bool rfc2045[256];
+    bool rfc2047[256];
+};
+
+static const QuotedPrintableEscapes quotedPrintableEscapes;
+
+static inline bool requiresEscape(unsigned char input, QMailQuotedPrintableCodec::ConformanceType conformance, int charsRemaining)
+{
+    bool escape = (conformance == QMailQuotedPrintableCodec::Rfc2047 ? quotedPrintableEscapes.rfc2047[input] : quotedPrintableEscapes.rfc2045[input]);
+
     if (!escape && (input == HorizontalTab || input == Space))
     {
         // The (potentially) last whitespace character on a line must be escaped
@@ -638,17 +817,17 @@ static bool requiresEscape(unsigned char input, QMailQuotedPrintableCodec::Confo
     return escape;
 }
 
-static inline void encodeCharacter(QDataStream& out, unsigned char value)
+static inline void encodeCharacter(OutputBuffer& output, unsigned char value)
 {
-    out << static_cast<unsigned char>(Equals);
-    out << QuotedPrintableValues[value >> 4];
-    out << QuotedPrintableValues[value & 0x0f];
+    output.append(Equals);
+    output.append(QuotedPrintableValues[value >> 4]);
+    output.append(QuotedPrintableValues[value & 0x0f]);
 }
 
-static inline void lineBreak(QDataStream& out, int* _encodeLineCharsRemaining, int maximumLineLength)
+static inline void lineBreak(OutputBuffer& output, int* _encodeLineCharsRemaining, int maximumLineLength)
 {
-    out << static_cast<unsigned char>(Equals);
-    out << static_cast<unsigned char>(LineFeed);
+    output.append(Equals);
+    output.append(LineFeed);
 
     *_encodeLineCharsRemaining = maximumLineLength;
 }
@@ -661,6 +840,13 @@ static inline unsigned char decodeCharacter(unsigned char value)
     return (value - 0x30);
 }
 
+static inline bool requiresDecoding(unsigned char input, bool text, QMailQuotedPrintableCodec::ConformanceType conformance)
+{
+    return ((input == Equals) ||
+            (text && isNewline(input)) ||
+            ((input == Underscore) && (conformance == QMailQuotedPrintableCodec::Rfc2047)));
+}
+
 
 /*!
   \class QMailQuotedPrintableCodec
@@ -756,6 +942,8 @@ QMailQuotedPrintableCodec::QMailQuotedPrintableCodec(ContentType content, Confor
 /*! \internal */
 void QMailQuotedPrintableCodec::encodeChunk(QDataStream& out, const unsigned char* it, int length, bool finalChunk)
 {
+    OutputBuffer output(out);
+
     // Set the input pointers relative to this input
     const unsigned char* const end = it + length;
 
@@ -772,7 +960,8 @@ void QMailQuotedPrintableCodec::encodeChunk(QDataStream& out, const unsigned cha
             else 
             {
                 // We must replace this character with ascii CRLF
-                out << CarriageReturn << LineFeed;
+                output.append(CarriageReturn);
+                output.append(LineFeed);
             }
 
             _encodeLastChar = input;
@@ -785,7 +974,7 @@ void QMailQuotedPrintableCodec::encodeChunk(QDataStream& out, const unsigned cha
         // If we can't fit this character on the line, insert a line break
         if (charsRequired > _encodeLineCharsRemaining)
         {
-            lineBreak(out, &_encodeLineCharsRemaining, _maximumLineLength); 
+            lineBreak(output, &_encodeLineCharsRemaining, _maximumLineLength); 
 
             // We may no longer need the encoding after the line break
             if (input == Space || (input == HorizontalTab && _conformance != Rfc2047))
@@ -795,17 +984,17 @@ void QMailQuotedPrintableCodec::encodeChunk(QDataStream& out, const unsigned cha
         if (charsRequired == 1)
         {
             if (input == Space && _conformance == Rfc2047) // output space as '_'
-                out << static_cast<unsigned char>(Underscore);
+                output.append(Underscore);
             else
-                out << input;
+                output.append(input);
         }
         else
-            encodeCharacter(out, input);
+            encodeCharacter(output, input);
 
         _encodeLineCharsRemaining -= charsRequired;
 
         if ((_encodeLineCharsRemaining == 0) && !(finalChunk && (it == end)))
-            lineBreak(out, &_encodeLineCharsRemaining, _maximumLineLength); 
+            lineBreak(output, &_encodeLineCharsRemaining, _maximumLineLength); 
 
         _encodeLastChar = input;
     }
@@ -816,6 +1005,9 @@ void QMailQuotedPrintableCodec::encodeChunk(QDataStream& out, const unsigned cha
 /*! \internal */
 void QMailQuotedPrintableCodec::decodeChunk(QDataStream& out, const char* it, int length, bool finalChunk)
 {
+    OutputBuffer output(out);
+
+    const bool text = (_content == Text);
     const char* const end = it + length;
 
     // The variable _decodePrecedingInput holds any unprocessed input from a previous call:
@@ -846,7 +1038,7 @@ void QMailQuotedPrintableCodec::decodeChunk(QDataStream& out, const char* it, in
 
         if (it != end && _decodePrecedingInput != NilPreceding)
         {
-            out << static_cast<unsigned char>((value << 4) | decodeCharacter(*it++));
+            output.append(static_cast<unsigned char>((value << 4) | decodeCharacter(*it++)));
             _decodePrecedingInput = NilPreceding;
         }
     }
@@ -879,14 +1071,14 @@ void QMailQuotedPrintableCodec::decodeChunk(QDataStream& out, const char* it, in
                     }
                     else
                     {
-                        out << static_cast<unsigned char>((value << 4) | decodeCharacter(*it++));
+                        output.append(static_cast<unsigned char>((value << 4) | decodeCharacter(*it++)));
                     }
                 }
             }
         }
         else 
         {
-            if ((input == CarriageReturn || input == LineFeed) && (_content == Text))
+            if (isNewline(input) && text)
             {
                 if (_decodeLastChar == CarriageReturn && input == LineFeed)
                 {
@@ -897,13 +1089,21 @@ void QMailQuotedPrintableCodec::decodeChunk(QDataStream& out, const char* it, in
                     // We should output the local newline sequence, but we can't
                     // because we don't know what it is, and C++ translation-from-\n will
                     // only work if the stream is a file...
-                    out << static_cast<unsigned char>('\n');
+                    output.append('\n');
                 }
             }
             else if (input == Underscore && _conformance == Rfc2047)
-                out << static_cast<unsigned char>(Space);
+                output.append(Space);
             else
-                out << input;
+            {
+                // Copy the run of literal characters starting here as a block
+                const char* begin = it - 1;
+                while ((it != end) && !requiresDecoding(*it, text, _conformance))
+                    ++it;
+
+                output.append(begin, (it - begin));
+                input = *(it - 1);
+            }
         }
 
         _decodeLastChar = input;
@@ -915,19 +1115,6 @@ void QMailQuotedPrintableCodec::decodeChunk(QDataStream& out, const char* it, in
     }
 }
 
-static void writeStream(QDataStream& out, const char* it, int length)
-{
-    int totalWritten = 0;
-    while (totalWritten < length)
-    {
-        int bytesWritten = out.writeRawData(it + totalWritten, length - totalWritten);
-        if (bytesWritten == -1)
-            return;
-
-        totalWritten += bytesWritten;
-    }
-}
-
 /*!
   \class QMailPassThroughCodec
     \inpublicgroup QtMessagingModule
@@ -34,6 +34,7 @@
 
 static const int nameCacheSize = 50;
 static const int fullRefreshCutoff = 10;
+static const int prefetchWindow = 50;
 
 class QMailMessageListModelPrivate
 {
@@ -68,6 +69,8 @@ public:
 
     void invalidateCache();
 
+    void prefetch(int row) const;
+
 public:
     QMailMessageKey key;
     QMailMessageSortKey sortKey;
@@ -75,6 +78,8 @@ public:
     mutable QList<Item> itemList;
     mutable bool init;
     mutable bool needSynchronize;
+    mutable int prefetchBegin;
+    mutable int prefetchEnd;
     QCache<QString,QString> nameCache;
     QContactModel contactModel;
 };
@@ -138,6 +143,8 @@ QMailMessageListModelPrivate::QMailMessageListModelPrivate(const QMailMessageKey
     ignoreUpdates(ignoreUpdates),
     init(false),
     needSynchronize(true),
+    prefetchBegin(0),
+    prefetchEnd(0),
     nameCache(nameCacheSize)
 {
 }
@@ -157,6 +164,7 @@ const QList<QMailMessageListModelPrivate::Item>& QMailMessageListModelPrivate::i
 
         init = true;
         needSynchronize = false;
+        prefetchBegin = prefetchEnd = 0;
     }
 
     return itemList;
@@ -217,6 +225,28 @@ void QMailMessageListModelPrivate::invalidateCache()
     nameCache.clear();
 }
 
+void QMailMessageListModelPrivate::prefetch(int row) const
+{
+    if ((row >= prefetchBegin) && (row < prefetchEnd))
+        return;
+
+    // Load the next window in the direction the view is moving, or around the row after a jump
+    int begin = row - (prefetchWindow / 2);
+    if ((row >= prefetchEnd) && (row < (prefetchEnd + prefetchWindow)))
+        begin = row;
+    else if ((row < prefetchBegin) && (row >= (prefetchBegin - prefetchWindow)))
+        begin = row - prefetchWindow + 1;
+
+    prefetchBegin = qMax(begin, 0);
+    prefetchEnd = qMin(prefetchBegin + prefetchWindow, itemList.count());
+
+    QMailMessageIdList ids;
+    for (int i = prefetchBegin; i < prefetchEnd; ++i)
+        ids.append(itemList[i].id());
+
+    QMailStore::instance()->prefetchMessagesMetaData(ids);
+}
+
 
 /*!
   \class QMailMessageListModel 
@@ -399,6 +429,7 @@ QVariant QMailMessageListModel::data(const QModelIndex& index, int role) const
     }
 
     // Otherwise, load the message data
+    d->prefetch(index.row());
     QMailMessageMetaData message(id);
 
     bool sent(message.status() & QMailMessage::Sent);
@@ -526,6 +526,33 @@ QMailMessageMetaData QMailStore::messageMetaData(const QString& uid, const QMail
     return QMailMessageMetaData();
 }
 
+/*!
+    Loads the meta data for each message identified in \a ids into the message store's
+    header cache, using a single query for all messages not already cached.  Subsequent
+    calls to messageMetaData() for those messages can then be satisfied without accessing
+    the database, subject to the capacity of the cache.
+
+    Views presenting part of a long list of messages can use this function to load the
+    messages they are about to display before requesting them individually.
+
+    \sa messageMetaData()
+*/
+void QMailStore::prefetchMessagesMetaData(const QMailMessageIdList& ids) const
+{
+    QMailMessageIdList uncachedIds;
+    foreach (const QMailMessageId& id, ids)
+        if (id.isValid() && !d->headerCache.contains(id))
+            uncachedIds.append(id);
+
+    if (uncachedIds.isEmpty())
+        return;
+
+    QMailMessageKey key(uncachedIds);
+    foreach (const QMailMessageMetaData& metaData, messagesMetaData(key, QMailStorePrivate::allMessageProperties()))
+        if (metaData.id().isValid())
+            d->headerCache.insert(metaData);
+}
+
 /*!
     \enum QMailStore::ReturnOption
     This enum defines the meta data list return option for QMailStore::messagesMetaData()
@@ -2253,15 +2280,7 @@ void QMailStore::preloadHeaderCache(const QMailMessageId& id) const
             d->lastQueryMessageResult = QMailMessageIdList();
     }
 
-    QMailMessageMetaData result;
-    QMailMessageKey key(idBatch);
-    foreach (const QMailMessageMetaData& metaData, messagesMetaData(key, QMailStorePrivate::allMessageProperties())) {
-        if (metaData.id().isValid()) {
-            d->headerCache.insert(metaData);
-            if (metaData.id() == id)
-                result = metaData;
-        }
-    }
+    prefetchMessagesMetaData(idBatch);
 }
 
 /*! \internal */
@@ -122,6 +122,7 @@ public:
     const QMailMessageMetaDataList messagesMetaData(const QMailMessageKey& key,
                                                     const QMailMessageKey::Properties& properties,
                                                     ReturnOption option = ReturnAll) const;
+    void prefetchMessagesMetaData(const QMailMessageIdList& ids) const;
 
     const QMailMessageRemovalRecordList messageRemovalRecords(const QMailAccountId& parentAccountId,
                                                               const QString& fromMailbox = QString()) const;
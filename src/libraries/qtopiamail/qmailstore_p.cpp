@@ -36,6 +36,7 @@
 #include "semaphore_p.h"
 #include "accountconfiguration_p.h"
 
+#include <QSet>
 #include <QSettings>
 #include <qtopialog.h>
 #include <QSqlQuery>
@@ -58,14 +59,98 @@ using namespace QMailDataComparator;
 
 // We allow queries to be specified by supplying a list of message IDs against
 // which candidates will be matched; this list can become too large to be 
-// expressed directly in SQL.  Instead, we will build a temporary table to
-// match against when required...
+// expressed directly in SQL as bound values.  Instead, we will sort the IDs and
+// write them into the statement as literal integer ranges when required...
 // The most IDs we can include in a query is currently 999; set an upper limit  
 // below this to allow for other variables in the same query, bearing in mind 
 // that there may be more than one clause containing this number of IDs in the 
 // same query...
 const int IdLookupThreshold = 256;
 
+// Only runs of at least this many consecutive IDs are worth a range term
+const int IdRangeMinimum = 16;
+
+// Each range term adds to the depth of the OR expression, which SQLite limits 
+// to SQLITE_MAX_EXPR_DEPTH (1000); keep well below that
+const int IdRangeLimit = 100;
+
+static bool longerRange(const QPair<quint64, quint64> &lhs, const QPair<quint64, quint64> &rhs)
+{
+    return (lhs.second - lhs.first) > (rhs.second - rhs.first);
+}
+
+// Build an SQL expression matching column against the IDs in valueList, without 
+// using bind values: the longest runs of consecutive IDs become ranges, and the
+// remainder become a single literal IN list
+static QString idMatchClause(const QString &columnName, const QVariantList &valueList)
+{
+    QList<quint64> ids;
+    foreach (const QVariant &var, valueList) {
+        quint64 id = 0;
+
+        if (qVariantCanConvert<QMailMessageId>(var)) {
+            id = var.value<QMailMessageId>().toULongLong(); 
+        } else if (qVariantCanConvert<QMailFolderId>(var)) {
+            id = var.value<QMailFolderId>().toULongLong(); 
+        } else if (qVariantCanConvert<QMailAccountId>(var)) {
+            id = var.value<QMailAccountId>().toULongLong(); 
+        }
+
+        if (id != 0) {
+            ids.append(id);
+        } else {
+            qLog(Messaging) << "Unable to extract ID value from valuelist!";
+        }
+    }
+    qSort(ids);
+
+    // Find the runs of consecutive IDs, ignoring duplicates
+    QList<QPair<quint64, quint64> > runs;
+    int i = 0;
+    while (i < ids.count()) {
+        int j = i;
+        while ((j + 1 < ids.count()) && (ids.at(j + 1) <= ids.at(j) + 1))
+            ++j;
+
+        runs.append(qMakePair(ids.at(i), ids.at(j)));
+        i = j + 1;
+    }
+
+    // Select the longest runs to be expressed as ranges
+    QList<QPair<quint64, quint64> > longest(runs);
+    qStableSort(longest.begin(), longest.end(), longerRange);
+
+    QSet<quint64> rangeStarts;
+    for (int k = 0; (k < longest.count()) && (k < IdRangeLimit); ++k) {
+        if ((longest.at(k).second - longest.at(k).first + 1) < IdRangeMinimum)
+            break;
+        rangeStarts.insert(longest.at(k).first);
+    }
+
+    QStringList ranges;
+    QStringList values;
+
+    typedef QPair<quint64, quint64> Run;
+    foreach (const Run &run, runs) {
+        if (rangeStarts.contains(run.first)) {
+            ranges.append(QString("%1 BETWEEN %2 AND %3").arg(columnName).arg(run.first).arg(run.second));
+        } else {
+            for (quint64 id = run.first; id <= run.second; ++id)
+                values.append(QString::number(id));
+        }
+    }
+
+    if (!values.isEmpty())
+        ranges.append(columnName + " IN (" + values.join(",") + ")");
+
+    if (ranges.isEmpty()) {
+        // No valid IDs - nothing can match
+        return "0";
+    }
+
+    return "(" + ranges.join(" OR ") + ")";
+}
+
 
 // Helper class for automatic unlocking
 template<typename Mutex>
@@ -825,7 +910,7 @@ QString whereClauseItem<QMailAccountKeyPrivate::Argument, QMailAccountKey>(const
 }
 
 template<>
-QString whereClauseItem<QMailMessageKeyPrivate::Argument, QMailMessageKey>(const QMailMessageKeyPrivate::Argument &a, const QMailMessageKey &key, const QMailStorePrivate &store)
+QString whereClauseItem<QMailMessageKeyPrivate::Argument, QMailMessageKey>(const QMailMessageKeyPrivate::Argument &a, const QMailMessageKey &, const QMailStorePrivate &store)
 {
     QString item;
     {
@@ -854,7 +939,7 @@ QString whereClauseItem<QMailMessageKeyPrivate::Argument, QMailMessageKey>(const
         {
         case QMailMessageKey::Id:
             if (a.valueList.count() >= IdLookupThreshold) {
-                q << columnName << " IN ( SELECT id from " << QMailStorePrivate::temporaryTableName(key) << ")";
+                q << idMatchClause(columnName, a.valueList);
             } else {
                 q << columnName << comparator << QMailStorePrivate::expandValueList(a.valueList); 
             }
@@ -1015,6 +1100,23 @@ QPair<quint64, QString> folderInfo(QMailFolder::StandardFolder id, const QString
 
 } // namespace
 
+int mailStoreCacheCost(const QMailMessageMetaData& metaData)
+{
+    // Estimate the memory held by a cached header: a fixed allowance for the
+    // object and its private data, plus the variable-length text fields
+    static const int fixedCost = 256;
+
+    int length = metaData.subject().length()
+                 + metaData.from().toString().length()
+                 + metaData.fromAccount().length()
+                 + metaData.fromMailbox().length()
+                 + metaData.serverUid().length();
+    foreach (const QMailAddress& address, metaData.to())
+        length += address.toString().length();
+
+    return fixedCost + (length * static_cast<int>(sizeof(QChar)));
+}
+
 bool QMailStorePrivate::init = false;
 
 // QMailStorePrivate
@@ -1275,6 +1377,17 @@ int QMailStorePrivate::accountSettingsFileIdentifier()
     return id;
 }
 
+int QMailStorePrivate::headerCacheBudget()
+{
+    // The budget is configured in kilobytes, and header cache items are costed in bytes
+    QSettings settings(accountSettingsPrefix(), accountSettingsFileName());
+    settings.beginGroup("cache");
+    int budget = settings.value("headerCacheKB", defaultHeaderCacheBudget).toInt();
+    settings.endGroup();
+
+    return qMax(budget, static_cast<int>(minimumHeaderCacheBudget)) * 1024;
+}
+
 QString QMailStorePrivate::messageFilePath(const QString &fileName)
 {
     return messagesBodyPath() + "/" + fileName;
@@ -1298,7 +1411,7 @@ QMailStorePrivate::QMailStorePrivate(QMailStore* parent)
 :
     QObject(parent),
     q(parent),
-    headerCache(headerCacheSize),
+    headerCache(headerCacheBudget()),
     folderCache(folderCacheSize),
     accountCache(accountCacheSize),
     inTransaction(false),
@@ -1382,9 +1495,6 @@ bool QMailStorePrivate::transaction(void)
 
     clearLastError();
 
-    // Ensure any outstanding temp tables are removed before we begin this transaction
-    destroyTemporaryTables();
-
     if (!database.transaction()) {
         setLastError(database.lastError(), "Failed to initiate transaction");
         return false;
@@ -1396,62 +1506,10 @@ bool QMailStorePrivate::transaction(void)
 
 QSqlQuery QMailStorePrivate::prepare(const QString& sql)
 {
-    if (!inTransaction) {
-        // Ensure any outstanding temp tables are removed before we begin this query
-        destroyTemporaryTables();
-    }
-
     clearLastError();
 
     QSqlQuery query(database);
     
-    // Create any temporary tables needed for this query
-    while (!requiredTableKeys.isEmpty()) {
-        const QMailMessageKey *key = requiredTableKeys.takeFirst();
-        if (!temporaryTableKeys.contains(key)) {
-            QString tableName = temporaryTableName(*key);
-
-            bool ok = true;
-            QSqlQuery tableQuery(database);
-            if (!tableQuery.exec(QString("CREATE TEMP TABLE %1 ( id INTEGER PRIMARY KEY )").arg(tableName))) { 
-                ok = false;
-            } else {
-                temporaryTableKeys.append(key);
-
-                // Add the ID values to the temp table
-                foreach (const QVariant &var, key->d->arguments.first().valueList) {
-                    quint64 id = 0;
-
-                    if (qVariantCanConvert<QMailMessageId>(var)) {
-                        id = var.value<QMailMessageId>().toULongLong(); 
-                    } else if (qVariantCanConvert<QMailFolderId>(var)) {
-                        id = var.value<QMailFolderId>().toULongLong(); 
-                    } else if (qVariantCanConvert<QMailAccountId>(var)) {
-                        id = var.value<QMailAccountId>().toULongLong(); 
-                    }
-
-                    if (id != 0) {
-                        tableQuery = QSqlQuery(database);
-                        if (!tableQuery.exec(QString("INSERT INTO %1 VALUES (%2)").arg(tableName).arg(id))) { 
-                            ok = false;
-                            break;
-                        }
-                    } else {
-                        qLog(Messaging) << "Unable to extract ID value from valuelist!";
-                        ok = false;
-                        break;
-                    }
-                }
-            }
-            
-            if (!ok) {
-                setLastError(tableQuery.lastError(), "Failed to create temporary table", tableQuery.lastQuery());
-                qLog(Messaging) << "Unable to prepare query:" << sql;
-                return query;
-            }
-        }
-    }
-
     if (!query.prepare(sql)) {
         setLastError(query.lastError(), "Failed to prepare query", query.lastQuery());
     }
@@ -1471,12 +1529,6 @@ bool QMailStorePrivate::execute(QSqlQuery& query, bool batch)
     qLog(Messaging) << "(" << ::getpid() << ")" << query.executedQuery().simplified();
 #endif
 
-    if (!inTransaction) {
-        // We should be finished with these temporary tables
-        expiredTableKeys = temporaryTableKeys;
-        temporaryTableKeys.clear();
-    }
-
     return true;
 }
 
@@ -1492,10 +1544,6 @@ bool QMailStorePrivate::commit(void)
         return false;
     } else {
         inTransaction = false;
-
-        // Expire any temporary tables we were using
-        expiredTableKeys = temporaryTableKeys;
-        temporaryTableKeys.clear();
     }
 
     return true;
@@ -1540,46 +1588,6 @@ void QMailStorePrivate::clearLastError(void)
     lastError = 0;
 }
 
-template<bool PtrSizeExceedsLongSize>
-QString numericPtrValue(const void *ptr)
-{
-    return QString::number(reinterpret_cast<unsigned long long>(ptr), 16).rightJustified(16, '0');
-}
-
-template<>
-QString numericPtrValue<false>(const void *ptr)
-{
-    return QString::number(reinterpret_cast<unsigned long>(ptr), 16).rightJustified(8, '0');;
-}
-
-QString QMailStorePrivate::temporaryTableName(const QMailMessageKey& key)
-{
-    const QMailMessageKey *ptr = &key;
-    return QString("qtopiamail_idmatch_%1").arg(numericPtrValue<(sizeof(void*) > sizeof(unsigned long))>(ptr));
-}
-
-void QMailStorePrivate::createTemporaryTable(const QMailMessageKey& key) const
-{
-    requiredTableKeys.append(&key);
-}
-
-void QMailStorePrivate::destroyTemporaryTables()
-{
-    while (!expiredTableKeys.isEmpty()) {
-        const QMailMessageKey *key = expiredTableKeys.takeFirst();
-        QString tableName = temporaryTableName(*key);
-
-        QSqlQuery tableQuery(database);
-        if (!tableQuery.exec(QString("DROP TABLE %1").arg(tableName))) {
-            QString sql = tableQuery.lastQuery().simplified();
-            QString err = tableQuery.lastError().text();
-
-            qLog(Messaging) << "(" << ::getpid() << ")" << "Failed to drop temporary table - query:" << qPrintable(sql) << "; error:" << qPrintable(err);
-            qWarning() << "Failed to drop temporary table - query:" << qPrintable(sql) << "; error:" << qPrintable(err);
-        }
-    }
-}
-
 bool QMailStorePrivate::idValueExists(quint64 id, const QString& table)
 {
     QSqlQuery query(database);
@@ -1800,13 +1808,6 @@ bool QMailStorePrivate::containsProperty(const QMailMessageSortKey::Property& p,
 
 QString QMailStorePrivate::buildWhereClause(const QMailMessageKey& key) const
 {
-    // See if we need to create any temporary tables to use in this query
-    foreach (const QMailMessageKeyPrivate::Argument &a, key.d->arguments) {
-        if (a.property == QMailMessageKey::Id && a.valueList.count() >= IdLookupThreshold) {
-            createTemporaryTable(key);
-        }
-    }
-
     return ::buildWhereClause<QMailMessageKeyPrivate>(key, key.d->combiner, key.d->arguments, key.d->subKeys, key.d->negated, *this);
 }
 
@@ -1866,7 +1867,7 @@ QVariantList QMailStorePrivate::whereClauseValues(const QMailMessageKey& key)
                 if (a.valueList.count() < IdLookupThreshold) {
                     values += extractor.id();
                 } else {
-                    // This value match has been replaced by a table lookup
+                    // This value match has been written into the statement
                 }
                 break;
 
@@ -71,7 +71,16 @@ class ProcessReadLock;
 typedef QMap<QMailMessageKey::Property,QString> MessagePropertyMap;
 typedef QList<QMailMessageKey::Property> MessagePropertyList;
 
-template <typename T, typename ID> 
+// Items are charged one unit each, except where an overload provides a better estimate
+template <typename T>
+int mailStoreCacheCost(const T&)
+{
+    return 1;
+}
+
+int mailStoreCacheCost(const QMailMessageMetaData& metaData);
+
+template <typename T, typename ID>
 class MailStoreCache
 {
 public:
@@ -118,7 +127,8 @@ class QMailStorePrivate : public QObject
     Q_OBJECT
 
 public:
-    static const int headerCacheSize = 100;
+    static const int defaultHeaderCacheBudget = 512;
+    static const int minimumHeaderCacheBudget = 64;
     static const int folderCacheSize = 10;
     static const int accountCacheSize = 10;
     static const int lookAhead = 5;
@@ -151,6 +161,7 @@ public:
     static int accountSettingsFileIdentifier();
     static QString messageFilePath(const QString &fileName);
     static int messageFileIdentifier(const QString &filePath);
+    static int headerCacheBudget();
 
     int databaseIdentifier(int n) const;
 
@@ -277,8 +288,6 @@ public:
     QSqlQuery simpleQuery(const QString& statement, const QMailAccountKey& key, const QString& descriptor, bool batch = false);
     QSqlQuery simpleQuery(const QString& statement, const QVariantList& bindValues, const QMailAccountKey& key, const QString& descriptor, bool batch = false);
 
-    void createTemporaryTable(const QMailMessageKey &key) const;
-
     bool asynchronousEmission() const;
 
     void flushIpcNotifications();
@@ -299,8 +308,6 @@ public:
 
     static void updateMessageValues(const QMailMessageKey::Properties& properties, const QVariantList& values, QMailMessageMetaData& metaData);
 
-    static QString temporaryTableName(const QMailMessageKey &key);
-
     template<typename ValueType>
     static ValueType extractValue(const QVariant& var, const ValueType &defaultValue = ValueType());
 
@@ -345,8 +352,6 @@ private:
     void setLastError(const QSqlError&, const QString& description = QString(), const QString& statement = QString());
     void clearLastError(void);
 
-    void destroyTemporaryTables(void);
-
     bool emitIpcNotification();
 
     typedef QMap<QString, void (QMailStore::*)(const QMailAccountIdList&)> AccountUpdateSignalMap;
@@ -366,9 +371,6 @@ public:
     mutable MailStoreCache<QMailMessageMetaData, QMailMessageId> headerCache;
     mutable MailStoreCache<QMailFolder, QMailFolderId> folderCache;
     mutable MailStoreCache<QMailAccount, QMailAccountId> accountCache;
-    mutable QList<const QMailMessageKey*> requiredTableKeys;
-    mutable QList<const QMailMessageKey*> temporaryTableKeys;
-    QList<const QMailMessageKey*> expiredTableKeys;
     bool inTransaction;
     bool asyncEmission;
     mutable int lastError;
@@ -448,7 +450,7 @@ void MailStoreCache<T, ID>::insert(const T& item)
     if(!item.id().isValid())
         return;
     else
-        mCache.insert(item.id().toULongLong(),new T(item));
+        mCache.insert(item.id().toULongLong(),new T(item),mailStoreCacheCost(item));
 }
 
 template <typename T, typename ID> 
@@ -527,6 +527,27 @@ void tst_QMailCodec::buffer_sizes()
         QCOMPARE(reversed, plaintext);
     }
 
+    // Multi-byte characters will be split between input chunks
+    QString multibyte(QString::fromUtf8("\xc3\xa9t\xc3\xa9 \xe2\x82\xac\xe2\x82\xac \xe6\x97\xa5\xe6\x9c\xac"));
+    {
+        QMailBase64Codec codec(QMailBase64Codec::Binary);
+        encoded = codec.encode(multibyte, charset);
+    }
+    {
+        QMailBase64Codec codec(QMailBase64Codec::Binary);
+        reversed = codec.decode(encoded, charset);
+        QCOMPARE(reversed, multibyte);
+    }
+    {
+        QMailQuotedPrintableCodec codec(QMailQuotedPrintableCodec::Text, QMailQuotedPrintableCodec::Rfc2045);
+        encoded = codec.encode(multibyte, charset);
+    }
+    {
+        QMailQuotedPrintableCodec codec(QMailQuotedPrintableCodec::Text, QMailQuotedPrintableCodec::Rfc2045);
+        reversed = codec.decode(encoded, charset);
+        QCOMPARE(reversed, multibyte);
+    }
+
     MaxCharacters = originalMaxCharacters;
     Base64MaxLineLength = originalBase64MaxLineLength;
     QuotedPrintableMaxLineLength = originalQuotedPrintableMaxLineLength;
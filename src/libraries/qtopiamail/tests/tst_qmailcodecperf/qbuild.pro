@@ -0,0 +1,5 @@
+TEMPLATE=app
+CONFIG+=qtopia benchmark
+QTOPIA*=mail
+TARGET=tst_qmailcodecperf
+SOURCES += tst_qmailcodecperf.cpp
@@ -0,0 +1,208 @@
+/****************************************************************************
+**
+** This file is part of the Qt Extended Opensource Package.
+**
+** Copyright (C) 2009 Trolltech ASA.
+**
+** Contact: Qt Extended Information (info@qtextended.org)
+**
+** This file may be used under the terms of the GNU General Public License
+** version 2.0 as published by the Free Software Foundation and appearing
+** in the file LICENSE.GPL included in the packaging of this file.
+**
+** Please review the following information to ensure GNU General Public
+** Licensing requirements will be met:
+**     http://www.fsf.org/licensing/licenses/info/GPLv2.html.
+**
+**
+****************************************************************************/
+
+#include <QtopiaApplication>
+#include <QObject>
+#include <QTest>
+#include <QBuffer>
+#include <QMailCodec>
+#include <qbenchmark.h>
+
+//TESTED_CLASS=QMailCodec
+//TESTED_FILES=src/libraries/qtopiamail/qmailcodec.cpp
+
+/*
+    This class measures the throughput of the Base64 and quoted-printable codecs
+*/
+class tst_QMailCodecPerf : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_QMailCodecPerf();
+    virtual ~tst_QMailCodecPerf();
+
+private slots:
+    virtual void initTestCase();
+
+    void base64_encode_data();
+    void base64_encode();
+    void base64_decode_data();
+    void base64_decode();
+    void quotedPrintable_encode_data();
+    void quotedPrintable_encode();
+    void quotedPrintable_decode_data();
+    void quotedPrintable_decode();
+
+private:
+    QByteArray binaryData;
+    QByteArray textData;
+};
+
+QTEST_APP_MAIN( tst_QMailCodecPerf, QtopiaApplication )
+
+#include "tst_qmailcodecperf.moc"
+
+// Large enough to resemble a multi-megabyte attachment
+static const int DataSize = 2 * 1024 * 1024;
+
+static QByteArray streamCoded(QMailCodec& codec, const QByteArray& input, bool encode)
+{
+    // Code between device-backed streams, as is done for message body files
+    QByteArray output;
+    {
+        QBuffer inBuffer(const_cast<QByteArray*>(&input));
+        inBuffer.open(QIODevice::ReadOnly);
+        QBuffer outBuffer(&output);
+        outBuffer.open(QIODevice::WriteOnly);
+
+        QDataStream in(&inBuffer);
+        QDataStream out(&outBuffer);
+        if (encode)
+            codec.encode(out, in);
+        else
+            codec.decode(out, in);
+    }
+
+    return output;
+}
+
+tst_QMailCodecPerf::tst_QMailCodecPerf()
+{
+}
+
+tst_QMailCodecPerf::~tst_QMailCodecPerf()
+{
+}
+
+void tst_QMailCodecPerf::initTestCase()
+{
+    qsrand(1);
+
+    binaryData.resize(DataSize);
+    for (int i = 0; i < DataSize; ++i)
+        binaryData[i] = static_cast<char>(qrand() & 0xff);
+
+    // Mostly-ASCII text with regular line breaks and occasional 8-bit characters
+    static const char sample[] = "The quick brown fox jumps over the lazy dog = 42\xe9\xe8 ";
+    textData.reserve(DataSize);
+    while (textData.size() < DataSize) {
+        textData.append(sample);
+        if ((qrand() % 4) == 0)
+            textData.append("\r\n");
+    }
+}
+
+void tst_QMailCodecPerf::base64_encode_data()
+{
+    QTest::addColumn<int>("content");
+    QTest::addColumn<QByteArray>("input");
+
+    QTest::newRow("binary") << static_cast<int>(QMailBase64Codec::Binary) << binaryData;
+    QTest::newRow("text") << static_cast<int>(QMailBase64Codec::Text) << textData;
+}
+
+void tst_QMailCodecPerf::base64_encode()
+{
+    QFETCH(int, content);
+    QFETCH(QByteArray, input);
+
+    QByteArray encoded;
+    QBENCHMARK {
+        QMailBase64Codec codec(static_cast<QMailBase64Codec::ContentType>(content));
+        encoded = streamCoded(codec, input, true);
+    }
+
+    QVERIFY(encoded.size() > (input.size() / 3 * 4));
+}
+
+void tst_QMailCodecPerf::base64_decode_data()
+{
+    QTest::addColumn<int>("content");
+    QTest::addColumn<QByteArray>("input");
+
+    QMailBase64Codec binaryCodec(QMailBase64Codec::Binary);
+    QMailBase64Codec textCodec(QMailBase64Codec::Text);
+
+    QTest::newRow("binary") << static_cast<int>(QMailBase64Codec::Binary) << binaryCodec.encode(binaryData);
+    QTest::newRow("text") << static_cast<int>(QMailBase64Codec::Text) << textCodec.encode(textData);
+}
+
+void tst_QMailCodecPerf::base64_decode()
+{
+    QFETCH(int, content);
+    QFETCH(QByteArray, input);
+
+    QByteArray decoded;
+    QBENCHMARK {
+        QMailBase64Codec codec(static_cast<QMailBase64Codec::ContentType>(content));
+        decoded = streamCoded(codec, input, false);
+    }
+
+    QVERIFY(!decoded.isEmpty());
+}
+
+void tst_QMailCodecPerf::quotedPrintable_encode_data()
+{
+    QTest::addColumn<int>("content");
+    QTest::addColumn<QByteArray>("input");
+
+    QTest::newRow("binary") << static_cast<int>(QMailQuotedPrintableCodec::Binary) << binaryData;
+    QTest::newRow("text") << static_cast<int>(QMailQuotedPrintableCodec::Text) << textData;
+}
+
+void tst_QMailCodecPerf::quotedPrintable_encode()
+{
+    QFETCH(int, content);
+    QFETCH(QByteArray, input);
+
+    QByteArray encoded;
+    QBENCHMARK {
+        QMailQuotedPrintableCodec codec(static_cast<QMailQuotedPrintableCodec::ContentType>(content), QMailQuotedPrintableCodec::Rfc2045);
+        encoded = streamCoded(codec, input, true);
+    }
+
+    QVERIFY(encoded.size() >= input.size());
+}
+
+void tst_QMailCodecPerf::quotedPrintable_decode_data()
+{
+    QTest::addColumn<int>("content");
+    QTest::addColumn<QByteArray>("input");
+
+    QMailQuotedPrintableCodec binaryCodec(QMailQuotedPrintableCodec::Binary, QMailQuotedPrintableCodec::Rfc2045);
+    QMailQuotedPrintableCodec textCodec(QMailQuotedPrintableCodec::Text, QMailQuotedPrintableCodec::Rfc2045);
+
+    QTest::newRow("binary") << static_cast<int>(QMailQuotedPrintableCodec::Binary) << binaryCodec.encode(binaryData);
+    QTest::newRow("text") << static_cast<int>(QMailQuotedPrintableCodec::Text) << textCodec.encode(textData);
+}
+
+void tst_QMailCodecPerf::quotedPrintable_decode()
+{
+    QFETCH(int, content);
+    QFETCH(QByteArray, input);
+
+    QByteArray decoded;
+    QBENCHMARK {
+        QMailQuotedPrintableCodec codec(static_cast<QMailQuotedPrintableCodec::ContentType>(content), QMailQuotedPrintableCodec::Rfc2045);
+        decoded = streamCoded(codec, input, false);
+    }
+
+    QVERIFY(!decoded.isEmpty());
+}
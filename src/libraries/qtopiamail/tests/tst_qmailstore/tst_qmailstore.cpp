@@ -28,6 +28,8 @@
 #undef private
 #include <QMailStore>
 #include <QMailFolder>
+#include <QMailMessage>
+#include <QMailMessageKey>
 
 
 //TESTED_CLASS=QMailStore
@@ -58,6 +60,7 @@ private slots:
     void removeMessage();
     void queryFolders();
     void queryMessages();
+    void queryManyRuns();
     void countFolders();
     void countMessages();
     void folder();
@@ -251,7 +254,76 @@ void tst_QMailStore::queryFolders()
 
 void tst_QMailStore::queryMessages()
 {
+    QMailFolder folder("query folder");
+    QVERIFY(QMailStore::instance()->addFolder(&folder));
+
+    QMailMessageIdList ids;
+    for (int i = 0; i < 400; ++i) {
+        QMailMessageMetaData metaData;
+        metaData.setMessageType(QMailMessage::Email);
+        metaData.setParentFolderId(folder.id());
+        metaData.setSubject(QString("message %1").arg(i));
+        QVERIFY(QMailStore::instance()->addMessage(&metaData));
+        ids.append(metaData.id());
+    }
+
+    QMailMessageKey folderKey(QMailMessageKey::ParentFolderId, folder.id());
+    QCOMPARE(QMailStore::instance()->countMessages(folderKey), 400);
+
+    // An ID list large enough to be matched by ranges, with gaps and out of order
+    QMailMessageIdList selected;
+    for (int i = ids.count() - 1; i >= 0; --i)
+        if ((i % 7) != 3)
+            selected.append(ids.at(i));
+    QVERIFY(selected.count() > 256);
+
+    QMailMessageIdList result = QMailStore::instance()->queryMessages(QMailMessageKey(selected));
+    QCOMPARE(result.count(), selected.count());
+    foreach (const QMailMessageId &id, selected)
+        QVERIFY(result.contains(id));
 
+    QCOMPARE(QMailStore::instance()->countMessages(folderKey & ~QMailMessageKey(selected)), ids.count() - selected.count());
+
+    // Duplicated IDs should not produce duplicate results
+    QCOMPARE(QMailStore::instance()->countMessages(QMailMessageKey(selected + selected)), selected.count());
+
+    QVERIFY(QMailStore::instance()->removeFolder(folder.id()));
+}
+
+void tst_QMailStore::queryManyRuns()
+{
+    QMailFolder folder("runs folder");
+    QVERIFY(QMailStore::instance()->addFolder(&folder));
+
+    QMailMessageIdList ids;
+    for (int i = 0; i < 2600; ++i) {
+        QMailMessageMetaData metaData;
+        metaData.setMessageType(QMailMessage::Email);
+        metaData.setParentFolderId(folder.id());
+        metaData.setSubject(QString("message %1").arg(i));
+        QVERIFY(QMailStore::instance()->addMessage(&metaData));
+        ids.append(metaData.id());
+    }
+
+    // More separate runs of IDs than SQLite allows terms in one expression,
+    // followed by some runs long enough to be matched as ranges
+    QMailMessageIdList selected;
+    for (int i = 0; i < 2200; i += 2)
+        selected.append(ids.at(i));
+    for (int i = 2200; i < ids.count(); ++i)
+        if ((i % 20) != 0)
+            selected.append(ids.at(i));
+    QVERIFY(selected.count() > 1000);
+
+    QMailMessageIdList result = QMailStore::instance()->queryMessages(QMailMessageKey(selected));
+    QCOMPARE(result.count(), selected.count());
+    foreach (const QMailMessageId &id, selected)
+        QVERIFY(result.contains(id));
+
+    QMailMessageKey folderKey(QMailMessageKey::ParentFolderId, folder.id());
+    QCOMPARE(QMailStore::instance()->countMessages(folderKey & ~QMailMessageKey(selected)), ids.count() - selected.count());
+
+    QVERIFY(QMailStore::instance()->removeFolder(folder.id()));
 }
 
 void tst_QMailStore::countFolders()
@@ -277,7 +349,35 @@ void tst_QMailStore::message()
 
 void tst_QMailStore::messageHeader()
 {
+    QMailFolder folder("header folder");
+    QVERIFY(QMailStore::instance()->addFolder(&folder));
+
+    QMailMessageIdList ids;
+    for (int i = 0; i < 60; ++i) {
+        QMailMessageMetaData metaData;
+        metaData.setMessageType(QMailMessage::Email);
+        metaData.setParentFolderId(folder.id());
+        metaData.setSubject(QString("header %1").arg(i));
+        QVERIFY(QMailStore::instance()->addMessage(&metaData));
+        ids.append(metaData.id());
+    }
+
+    // Prefetching should not alter the meta data subsequently returned for each message
+    QMailStore::instance()->prefetchMessagesMetaData(ids.mid(10, 40) << QMailMessageId());
+    for (int i = 0; i < ids.count(); ++i) {
+        QMailMessageMetaData metaData = QMailStore::instance()->messageMetaData(ids.at(i));
+        QCOMPARE(metaData.id(), ids.at(i));
+        QCOMPARE(metaData.subject(), QString("header %1").arg(i));
+    }
+
+    // Updates must be visible through the cached meta data
+    QMailMessageMetaData updated = QMailStore::instance()->messageMetaData(ids.at(20));
+    updated.setSubject("updated header");
+    QVERIFY(QMailStore::instance()->updateMessage(&updated));
+    QMailStore::instance()->prefetchMessagesMetaData(ids);
+    QCOMPARE(QMailStore::instance()->messageMetaData(ids.at(20)).subject(), QString("updated header"));
 
+    QVERIFY(QMailStore::instance()->removeFolder(folder.id()));
 }
 
 //these functions should not fail
@@ -443,6 +443,10 @@ void SXEPolicyManager::policyCheck( QTransportAuth::Data &d, const QString &req
 
     if ( request.endsWith("_fragment_") )
             request.chop( 10 );//size of "_fragment_"
+    else if ( request.endsWith("_shared_") )
+            request.chop( 8 );//size of "_shared_"
+    if ( request.endsWith("_compact_") )
+            request.chop( 9 );//size of "_compact_"
 
 #ifdef PERMISSIVE
     if ( d.status == QTransportAuth::Allow ) return;
@@ -35,6 +35,7 @@
 #include <qtopiaipcenvelope.h>
 #include <qtopiaabstractservice.h>
 #include <qtopialog.h>
+#include <qperformancelog.h>
 #ifdef Q_WS_QWS
 #include <QWSServer>
 #endif
@@ -1489,6 +1490,10 @@ ApplicationLauncher::ApplicationLauncher()
 
     m_vso = new QValueSpaceObject("/System/Applications", this);
 
+    QtopiaChannel *channel = new QtopiaChannel("QPE/QtopiaApplication", this);
+    connect(channel, SIGNAL(received(QString,QByteArray)),
+            this, SLOT(qtopiaApplicationChannel(QString,QByteArray)));
+
     new LegacyLauncherService(this);
 
 }
@@ -1540,6 +1545,9 @@ ApplicationLauncher::handleStateChange(const QString &app,
 
         m_vso->setAttribute(app + "/Info/State", stateText);
         qLog(QtopiaServer) << "ApplicationLauncher::handleStateChanged(" << app << ", " << stateText << ")";
+
+        if (ApplicationTypeLauncher::Running == state)
+            traceLaunch(app, QLatin1String("Running"));
     }
 
     if (busyApps.count() != oldBusyCount)
@@ -1602,6 +1610,10 @@ ApplicationLauncher::terminated(const QString &app,
     m_runningApps.remove(app);
     m_orderedApps.removeAll(app);
 
+    // The application never reported its side of the launch.
+    if (m_launchTraces.contains(app))
+        writeLaunchTrace(app, QList<int>(), QStringList());
+
     bool filtered = false;
     QList<ApplicationTerminationHandler *> termHandlers =
         qtopiaTasks<ApplicationTerminationHandler>();
@@ -1680,19 +1692,115 @@ bool ApplicationLauncher::launch(const QString &app)
     if (m_runningApps.contains(app))
         return true;
 
+    bool trace = QPerformanceLog::enabled();
+    if (trace) {
+        m_launchTraces.remove(app);
+        traceLaunch(app, QPerformanceLog::stringFromEvent(
+                QPerformanceLog::Begin | QPerformanceLog::Launch));
+    }
+
     for (int ii=0; ii < m_launchers.count(); ++ii) {
         if (m_launchers[ii]->canLaunch(app)) {
             m_runningApps.insert(app,m_launchers[ii]);
             m_orderedApps.append(app);
+            if (trace) {
+                traceLaunch(app, QPerformanceLog::stringFromEvent(
+                        QPerformanceLog::End | QPerformanceLog::Routing) +
+                        QLatin1Char(' ') + m_launchers[ii]->metaObject()->className());
+                traceLaunch(app, QPerformanceLog::stringFromEvent(
+                        QPerformanceLog::Begin | QPerformanceLog::ProcessStart));
+            }
             m_launchers[ii]->launch(app);
+            if (trace)
+                traceLaunch(app, QLatin1String("Handoff"));
             return true;
         }
     }
 
+    m_launchTraces.remove(app);
     emit applicationNotFound(app);
     return false;
 }
 
+/*!
+  \internal
+
+  Records \a event in the launch trace of \a app, if one is being recorded.
+  */
+void ApplicationLauncher::traceLaunch(const QString &app, const QString &event)
+{
+    if (!QPerformanceLog::enabled())
+        return;
+
+    QMap<QString, LaunchTrace>::Iterator iter = m_launchTraces.find(app);
+    if (iter == m_launchTraces.end()) {
+        // Only launches that were traced from the request are interesting.
+        if (!event.startsWith(QLatin1String("Begin")))
+            return;
+        iter = m_launchTraces.insert(app, LaunchTrace());
+    }
+
+    iter->times.append(QPerformanceLog::currentTime());
+    iter->events.append(event);
+    QPerformanceLog(app) << event;
+}
+
+/*!
+  \internal
+
+  Writes the launch timeline of \a app, merging the server's events with
+  the events the application reported, \a times and \a events.  Times are
+  written relative to the launch request.
+  */
+void ApplicationLauncher::writeLaunchTrace(const QString &app,
+                                           const QList<int> &times,
+                                           const QStringList &events)
+{
+    LaunchTrace trace = m_launchTraces.take(app);
+    if (trace.times.isEmpty())
+        return;
+
+    const int day = 24 * 60 * 60 * 1000;
+    int start = trace.times.first();
+    QStringList timeline;
+    int ii = 0;
+    int jj = 0;
+    while (ii < trace.times.count() || jj < times.count()) {
+        bool server = jj >= times.count() ||
+            (ii < trace.times.count() && trace.times.at(ii) <= times.at(jj));
+        int time = server ? trace.times.at(ii) : times.at(jj);
+        QString event = server ? trace.events.at(ii++) : events.value(jj++);
+
+        int offset = time - start;
+        if (offset < 0)
+            offset += day;  // The launch spanned midnight
+        timeline.append(QString("+%1 %2").arg(offset).arg(event));
+    }
+
+    QPerformanceLog(app) << QString("Launch timeline [%1]:").arg(trace.pid)
+                         << timeline.join(QLatin1String(", "));
+}
+
+/*! \internal */
+void ApplicationLauncher::qtopiaApplicationChannel(const QString &message,
+                                                   const QByteArray &data)
+{
+    if (message == "launchTrace(QString,int,QList<int>,QStringList)") {
+        QDataStream ds(data);
+        QString app;
+        int pid;
+        QList<int> times;
+        QStringList events;
+        ds >> app >> pid >> times >> events;
+
+        QMap<QString, LaunchTrace>::Iterator iter = m_launchTraces.find(app);
+        if (iter == m_launchTraces.end())
+            return;
+        iter->pid = pid;
+        writeLaunchTrace(app, times, events);
+    }
+}
+
 /*!
   \internal
 
@@ -109,8 +109,20 @@ class ApplicationLauncher : public QObject
 			   ApplicationTypeLauncher::ApplicationState);
     void terminated(const QString &,
                     ApplicationTypeLauncher::TerminationReason);
+    void qtopiaApplicationChannel(const QString &, const QByteArray &);
 
   private:
+    struct LaunchTrace {
+        LaunchTrace() : pid(0) {}
+        int pid;
+        QList<int> times;
+        QStringList events;
+    };
+    void traceLaunch(const QString &, const QString &);
+    void writeLaunchTrace(const QString &, const QList<int> &,
+                          const QStringList &);
+
+    QMap<QString, LaunchTrace> m_launchTraces;
     QList<QString> m_orderedApps;
     QMap<QString, ApplicationTypeLauncher *> m_runningApps;
     QList<ApplicationTypeLauncher *> m_launchers;
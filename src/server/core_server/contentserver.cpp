@@ -38,11 +38,52 @@
 #include <QCryptographicHash>
 #include <QDirIterator>
 #include <QContentPlugin>
+#include <QFileMonitor>
+
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 // Making this larger will cause the scanner to go more deeply into
 // subdirectories
 static const int MaxSearchDepth = 10;
 
+// Milliseconds to wait for a burst of file system changes to settle before
+// rescanning the changed directories.
+static const int ChangeScanDelay = 1000;
+
+/*
+  Persistent record of the state of each scanned directory.  A directory whose
+  modification time, size and number of entries are unchanged since it was last
+  scanned, and which still has the same number of documents in the database, is
+  not compared against the database again.
+ */
+class DirectoryJournal
+{
+public:
+    DirectoryJournal();
+
+    struct Entry {
+        Entry() : modified(0), size(0), entryCount(0), contentCount(-1) {}
+
+        quint32 modified;
+        qint64 size;
+        int entryCount;
+        int contentCount;
+    };
+
+    bool isCurrent(const QString &path, const Entry &entry) const;
+    void update(const QString &path, const Entry &entry);
+    void remove(const QString &path);
+
+    void load();
+    void save();
+
+private:
+    QHash<QString, Entry> m_entries;
+    bool m_dirty;
+};
+
 /*
   Recursive threaded background directory scanner for advanced use only.
   This class is used behind the scenes in the ContentServer and should
@@ -58,16 +99,20 @@ public:
 
 public slots:
     void scan(const QString &path, int priority);
+    void rescan(const QString &path, int priority);
 
 signals:
     void scanning(bool scanning);
+    void directoryScanned(const QString &path);
 
 private slots:
     void scan();
 
 private:
-    void addPath(const QString &path, int depth, int priority);
-    void scanPath(const QString& path, int depth, int priority);
+    void addPath(const QString &path, int depth, int priority, bool force = false);
+    void scanPath(const QString& path, int depth, int priority, bool force);
+    bool readDirectory(const QString &path, QStringList *entries, QStringList *directories) const;
+    void updateJournal();
     void cleanupThumbnails(const QDateTime &threshold);
     QString thumbnailDir(const QString &path) const;
     QString thumbnailPath(const QString &thumbnailDir, const QString &fileName) const;
@@ -81,6 +126,7 @@ private:
         QString path;
         int priority;
         int depth;
+        bool force;
 
         bool operator<(const PendingPath &pp) const {
             return priority < pp.priority;
@@ -91,6 +137,10 @@ private:
     QFileInfoList m_pendingInstalls;
     QContentIdList m_pendingUninstalls;
 
+    DirectoryJournal m_journal;
+    QList<QPair<QString, DirectoryJournal::Entry> > m_journalUpdates;
+    bool m_skippedDirectories;
+
     bool m_scanning;
 };
 
@@ -126,6 +176,10 @@ ContentServer::ContentServer( QObject *parent )
 
     scannerVSObject = new QValueSpaceObject("/Documents", this);
 
+    m_changeTimer.setSingleShot(true);
+    m_changeTimer.setInterval(ChangeScanDelay);
+    connect(&m_changeTimer, SIGNAL(timeout()), this, SLOT(scanChanged()));
+
     // force early initialisation of QMimeType to remove the chance of issues later on when we're in threads.
     QContentPlugin::preloadPlugins();
     QDrmContentPlugin::initialize();
@@ -134,6 +188,7 @@ ContentServer::ContentServer( QObject *parent )
 
 ContentServer::~ContentServer()
 {
+    qDeleteAll(m_monitors);
 }
 
 /*!
@@ -153,8 +208,10 @@ void ContentServer::run()
     DirectoryScanner scanner;
 
     connect(this, SIGNAL(scan(QString,int)), &scanner, SLOT(scan(QString,int)));
+    connect(this, SIGNAL(rescan(QString,int)), &scanner, SLOT(rescan(QString,int)));
 
     connect(&scanner, SIGNAL(scanning(bool)), this, SLOT(scanning(bool)));
+    connect(&scanner, SIGNAL(directoryScanned(QString)), this, SLOT(directoryScanned(QString)));
 
     exec();
 }
@@ -169,6 +226,73 @@ void ContentServer::scanning(bool scanning)
     scannerVSObject->setAttribute(QLatin1String("Scanning"), scanning);
 }
 
+/*!
+  \internal
+  Starts monitoring the entries of the directory at \a path once it has been
+  scanned, so later changes are picked up without a full rescan.
+
+  The monitors are owned by the ContentServer object rather than the scanner as
+  the file monitor back ends aren't thread safe.
+*/
+void ContentServer::directoryScanned(const QString &path)
+{
+    if (m_monitors.contains(path))
+        return;
+
+    QFileMonitor *monitor = new QFileMonitor(path + QLatin1String("/*"));
+
+    if (monitor->isValid()) {
+        connect(monitor, SIGNAL(fileChanged(QString)), this, SLOT(directoryChanged(QString)));
+
+        m_monitors.insert(path, monitor);
+    } else {
+        delete monitor;
+    }
+}
+
+void ContentServer::directoryChanged(const QString &fileName)
+{
+    QString path = fileName.left(fileName.length() - 2);
+
+    // If the directory itself has gone rescan its parent instead.
+    if (!QFile::exists(path)) {
+        removeMonitors(path);
+
+        path = path.left(path.lastIndexOf(QLatin1Char('/')));
+    }
+
+    if (!path.isEmpty())
+        m_changedPaths.insert(path);
+
+    if (!m_changeTimer.isActive())
+        m_changeTimer.start();
+}
+
+void ContentServer::scanChanged()
+{
+    foreach (const QString &path, m_changedPaths)
+        emit rescan(path, 1);
+
+    m_changedPaths.clear();
+}
+
+void ContentServer::removeMonitors(const QString &path)
+{
+    const QString subPath = path + QLatin1Char('/');
+
+    QHash<QString, QFileMonitor *>::iterator it = m_monitors.begin();
+
+    while (it != m_monitors.end()) {
+        if (it.key() == path || it.key().startsWith(subPath)) {
+            it.value()->deleteLater();
+
+            it = m_monitors.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 static bool binaryStringLessThan(const QString &string1, const QString &string2)
 {
   int length = qMin(string1.length(), string2.length()) * 2;
@@ -197,8 +321,10 @@ static bool binaryStringCompare(const QString &string1, const QString &string2)
    one directory
 */
 DirectoryScanner::DirectoryScanner()
-    : m_scanning(false)
+    : m_skippedDirectories(false)
+    , m_scanning(false)
 {
+    m_journal.load();
 }
 
 /*!
@@ -225,14 +351,30 @@ void DirectoryScanner::scan(const QString &path, int priority)
     }
 }
 
-void DirectoryScanner::addPath(const QString &path, int depth, int priority)
+/*!
+    Scans \a path with the given \a priority even if the journal records it as
+    unchanged.
+
+    This is used for directories a file monitor has reported changes in, as
+    modifying a file in place doesn't alter any of the directory attributes
+    the journal compares.  Sub-directories are still checked against the
+    journal.
+*/
+void DirectoryScanner::rescan(const QString &path, int priority)
+{
+    addPath(path, 0, priority, true);
+}
+
+void DirectoryScanner::addPath(const QString &path, int depth, int priority, bool force)
 {
     PendingPath pp;
     pp.path = path;
     pp.priority = priority;
     pp.depth = depth;
+    pp.force = force;
     for (int i = 0; i < m_pendingPaths.count(); ++i) {
         if (m_pendingPaths.at(i).path == path) {
+            pp.force = pp.force || m_pendingPaths.at(i).force;
             m_pendingPaths.removeAt(i);
             break;
         }
@@ -252,17 +394,24 @@ void DirectoryScanner::scan()
     if (!m_pendingPaths.isEmpty()) {
         PendingPath pending = m_pendingPaths.takeLast();
 
-        scanPath(pending.path, pending.depth, pending.priority);
+        scanPath(pending.path, pending.depth, pending.priority, pending.force);
 
         QTimer::singleShot(0, this, SLOT(scan()));
     } else {
         flushInstalls();
         flushUninstalls();
 
+        updateJournal();
+
         if (!m_startTime.isNull()) {
-            cleanupThumbnails(m_startTime);
+            // Thumbnails are only marked as in use when their directory is
+            // compared against the database, so unused thumbnails can only be
+            // identified after a scan which didn't skip any directories.
+            if (!m_skippedDirectories)
+                cleanupThumbnails(m_startTime);
 
             m_startTime = QDateTime();
+            m_skippedDirectories = false;
 
             QTimer::singleShot(0, this, SLOT(scan()));
         } else {
@@ -273,7 +422,7 @@ void DirectoryScanner::scan()
     }
 }
 
-void DirectoryScanner::scanPath(const QString& path, int depth, int priority)
+void DirectoryScanner::scanPath(const QString& path, int depth, int priority, bool force)
 {
     const QString cleanPath = QDir::cleanPath(path);
     const QString dirPath = cleanPath + QLatin1Char('/');
@@ -293,25 +442,57 @@ void DirectoryScanner::scanPath(const QString& path, int depth, int priority)
 
                 foreach (QContentId contentId, contentIds)
                     uninstall(contentId);
+
+                m_journal.remove(path);
             }
         }
     }
 
-    const QString thumbDir = thumbnailDir(cleanPath);
-
     QContentSet dirContents;
     dirContents.setCriteria(QContentFilter::Directory, cleanPath);
     dirContents.setSortCriteria(QContentSortCriteria(QContentSortCriteria::FileName));
 
-    QStringList fileNames = QDir(dirPath).entryList(
-            QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    QStringList fileNames;
+    QStringList subDirectories;
+
+    DirectoryJournal::Entry journalEntry;
+
+    struct stat statBuffer;
+
+    if (readDirectory(dirPath, &fileNames, &subDirectories)
+        && ::stat(QFile::encodeName(cleanPath).constData(), &statBuffer) == 0) {
+        journalEntry.modified = statBuffer.st_mtime;
+        journalEntry.size = statBuffer.st_size;
+        journalEntry.entryCount = fileNames.count();
+    } else {
+        m_journal.remove(cleanPath);
+    }
+
+    const int dbCount = dirContents.count();
+
+    journalEntry.contentCount = dbCount;
+
+    if (!force && m_journal.isCurrent(cleanPath, journalEntry)) {
+        qLog(DocAPI) << "skipping unchanged directory" << cleanPath;
+
+        m_skippedDirectories = true;
+
+        emit directoryScanned(cleanPath);
+
+        if (depth < MaxSearchDepth)
+            foreach (QString fileName, subDirectories)
+                addPath(dirPath + fileName, depth + 1, priority - 1);
+
+        return;
+    }
+
+    const QString thumbDir = thumbnailDir(cleanPath);
 
     qSort(fileNames.begin(), fileNames.end(), binaryStringLessThan);
 
     int db = 0;
     int fs = 0;
 
-    const int dbCount = dirContents.count();
     const int fsCount = fileNames.count();
 
     char buffer[16];
@@ -356,11 +537,190 @@ void DirectoryScanner::scanPath(const QString& path, int depth, int priority)
     while(fs < fsCount)
         install(QFileInfo(dirPath + fileNames.at(fs++)));
 
+    // The number of documents is only known once the pending installs and
+    // uninstalls have been written, so the journal is updated at the end of
+    // the scan.
+    if (journalEntry.modified != 0) {
+        m_journalUpdates.append(qMakePair(cleanPath, journalEntry));
+
+        emit directoryScanned(cleanPath);
+    }
+
     if (depth < MaxSearchDepth)
-        foreach (QString fileName, QDir(dirPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+        foreach (QString fileName, subDirectories)
             addPath(dirPath + fileName, depth + 1, priority - 1);
 }
 
+/*!
+    Reads the names of the entries of the directory at \a path into \a entries and
+    the names of its sub-directories into \a directories.
+
+    The entry types are taken from the directory itself where the file system
+    provides them, so unchanged files aren't stat()ed.
+
+    Returns false if the directory could not be read.
+*/
+bool DirectoryScanner::readDirectory(const QString &path, QStringList *entries, QStringList *directories) const
+{
+    DIR *dir = ::opendir(QFile::encodeName(path).constData());
+
+    if (!dir)
+        return false;
+
+    while (struct dirent *entry = ::readdir(dir)) {
+        // Hidden files are ignored, as are the . and .. entries.
+        if (entry->d_name[0] == '.')
+            continue;
+
+        const QString name = QFile::decodeName(entry->d_name);
+
+        bool isDirectory = false;
+
+        if (entry->d_type == DT_DIR) {
+            isDirectory = true;
+        } else if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+            // Follow links, ignoring dangling links and special files as QDir would.
+            QFileInfo info(path + name);
+
+            if (info.isDir())
+                isDirectory = true;
+            else if (!info.isFile())
+                continue;
+        } else if (entry->d_type != DT_REG) {
+            continue;
+        }
+
+        entries->append(name);
+
+        if (isDirectory)
+            directories->append(name);
+    }
+
+    ::closedir(dir);
+
+    return true;
+}
+
+/*!
+    Records the state of the directories scanned since the last update in the
+    journal, once their documents have been written to the database.
+*/
+void DirectoryScanner::updateJournal()
+{
+    if (m_journalUpdates.isEmpty())
+        return;
+
+    for (int i = 0; i < m_journalUpdates.count(); ++i) {
+        DirectoryJournal::Entry entry = m_journalUpdates.at(i).second;
+
+        entry.contentCount = QContentSet(QContentFilter::Directory, m_journalUpdates.at(i).first).count();
+
+        m_journal.update(m_journalUpdates.at(i).first, entry);
+    }
+
+    m_journalUpdates.clear();
+
+    m_journal.save();
+}
+
+DirectoryJournal::DirectoryJournal()
+    : m_dirty(false)
+{
+}
+
+bool DirectoryJournal::isCurrent(const QString &path, const Entry &entry) const
+{
+    QHash<QString, Entry>::const_iterator it = m_entries.find(path);
+
+    return it != m_entries.end()
+        && entry.modified != 0
+        && it->modified == entry.modified
+        && it->size == entry.size
+        && it->entryCount == entry.entryCount
+        && it->contentCount == entry.contentCount;
+}
+
+void DirectoryJournal::update(const QString &path, const Entry &entry)
+{
+    m_entries.insert(path, entry);
+
+    m_dirty = true;
+}
+
+void DirectoryJournal::remove(const QString &path)
+{
+    const QString subPath = path + QLatin1Char('/');
+
+    QHash<QString, Entry>::iterator it = m_entries.begin();
+
+    while (it != m_entries.end()) {
+        if (it.key() == path || it.key().startsWith(subPath)) {
+            it = m_entries.erase(it);
+
+            m_dirty = true;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DirectoryJournal::load()
+{
+    QFile file(Qtopia::applicationFileName(QLatin1String("ContentServer"), QLatin1String("journal")));
+
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+
+    quint32 version;
+
+    stream >> version;
+
+    if (version != 1)
+        return;
+
+    while (!stream.atEnd() && stream.status() == QDataStream::Ok) {
+        QString path;
+        Entry entry;
+
+        stream >> path >> entry.modified >> entry.size >> entry.entryCount >> entry.contentCount;
+
+        if (stream.status() == QDataStream::Ok)
+            m_entries.insert(path, entry);
+    }
+}
+
+void DirectoryJournal::save()
+{
+    if (!m_dirty)
+        return;
+
+    QString fileName = Qtopia::applicationFileName(QLatin1String("ContentServer"), QLatin1String("journal"));
+
+    QFile file(fileName + QLatin1String(".new"));
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        qLog(DocAPI) << "couldn't write the content journal" << file.fileName();
+
+        return;
+    }
+
+    QDataStream stream(&file);
+
+    stream << quint32(1);
+
+    for (QHash<QString, Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+        stream << it.key() << it->modified << it->size << it->entryCount << it->contentCount;
+
+    file.close();
+
+    QFile::remove(fileName);
+    QFile::rename(file.fileName(), fileName);
+
+    m_dirty = false;
+}
+
 void DirectoryScanner::cleanupThumbnails(const QDateTime &startTime)
 {
     const QString thumbnails(QLatin1String("Thumbnails"));
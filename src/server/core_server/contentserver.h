@@ -23,6 +23,7 @@
 #include <QThread>
 #include <QStringList>
 #include <QSet>
+#include <QHash>
 #include <QTimer>
 
 #include <qcontent.h>
@@ -36,6 +37,7 @@
 class ServerInterface;
 class AppLoaderPrivate;
 class QValueSpaceObject;
+class QFileMonitor;
 
 class ContentServer : public QThread
 {
@@ -48,16 +50,25 @@ public:
 
 signals:
     void scan(const QString &path, int priority);
+    void rescan(const QString &path, int priority);
 
 public slots:
     void scanAll();
 
 private slots:
     void scanning(bool scanning);
+    void directoryScanned(const QString &path);
+    void directoryChanged(const QString &fileName);
+    void scanChanged();
 
 private:
+    void removeMonitors(const QString &path);
+
     QtopiaIpcAdaptor *requestQueue;
     QValueSpaceObject *scannerVSObject;
+    QHash<QString, QFileMonitor *> m_monitors;
+    QSet<QString> m_changedPaths;
+    QTimer m_changeTimer;
 };
 
 // declare ContentServerTask
@@ -23,7 +23,12 @@
 #include <QBuffer>
 #include <QDataStream>
 #include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QFileMonitor>
 #include "applicationlauncher.h"
+#include <private/qtopiaipcprofile_p.h>
+#include <private/qtopiachannel_p.h>
 
 #include <errno.h>
 #include <unistd.h>
@@ -51,15 +56,45 @@
 
   The QCopRouter class provides an implementation of the ApplicationIpcRouter
   for the QCop transport.  
+
+  Every message to a \c {QPE/Application/*} or \c {QPE/Service/*} channel
+  passes through the router on the server's GUI thread, so the work done per
+  message is kept small.  The application that provides each installed
+  service is cached until the service definitions or the user's service
+  bindings change.  Names of services that aren't installed come from client
+  messages and are never cached, so they can't grow the router's state.
   
   This class is part of the Qt Extended server and cannot be used by other Qt Extended applications.
 */
 
+/*
+  Large messages arrive as a handle to shared memory.  The data is copied out
+  as soon as the message arrives, as the receiver may have to be launched
+  before it reads the message, and the reference the sender handed over is
+  released whether or not the message is then routed.  Returns false if the
+  data of the message \a message with \a data could not be read.
+ */
+static bool readSharedMessage(QString *message, QByteArray *data)
+{
+    if(!qtopia_isSharedMessage(*message))
+        return true;
+
+    QString sharedMessage;
+    QByteArray sharedData;
+    if(!qtopia_readSharedMessage(*message, *data, &sharedMessage, &sharedData, true))
+        return false;
+
+    *message = sharedMessage;
+    *data = sharedData;
+    return true;
+}
+
 QTOPIA_TASK(IpcRouter, QCopRouter);
 QTOPIA_TASK_PROVIDES(IpcRouter, ApplicationIpcRouter);
 
 /*!  \internal */
 QCopRouter::QCopRouter()
+: m_servicesMonitor(0), m_servicesListed(false)
 {
     // cleanup old messages
     QDir dir( Qtopia::tempDir(), "qcop-msg-*" );
@@ -81,6 +116,15 @@ QCopRouter::QCopRouter()
     channel = new QCopChannel( "QPE/Service/*", this );
     connect( channel, SIGNAL(received(QString,QByteArray)),
              this, SLOT(serviceMessage(QString,QByteArray)) );
+
+    // Service lookups are cached until a service is installed or removed, or
+    // the user binds a service to another application.  Each cached service
+    // has its own monitors, see monitorService().
+    m_servicesMonitor = new QFileMonitor(Qtopia::qtopiaDir() + QLatin1String("services/*"), this);
+    connect(m_servicesMonitor, SIGNAL(fileChanged(QString)),
+            this, SLOT(servicesChanged()));
+
+    m_bindingsPath = QFileInfo(QSettings("Trolltech", "Launcher").fileName()).absolutePath();
 }
 
 /*!  \internal */
@@ -102,6 +146,9 @@ void QCopRouter::applicationMessage
         stream >> channel;
         stream >> message;
         stream >> newData;
+        if ( !readSharedMessage( &message, &newData ) )
+            return;
+        QtopiaIpcProfile::recordReceive(channel, message, newData);
 
         QString app = channel.mid(16 /* ::strlen("QPE/Application/") */);
         routeMessage(app, message, newData);
@@ -120,25 +167,94 @@ void QCopRouter::serviceMessage( const QString& msg, const QByteArray& data )
         stream >> channel;
         stream >> message;
         stream >> newData;
+        if ( !readSharedMessage( &message, &newData ) )
+            return;
+        QtopiaIpcProfile::recordReceive(channel, message, newData);
 
         // Bail out if it doesn't look like a valid service request.
         if ( !channel.startsWith( QLatin1String( "QPE/Service/" ) ) )
             return;
 
-        // Look up the application channel that handles the service.
-        QString appChannel = QtopiaService::channel( channel.mid(12) );
-        if ( appChannel.isEmpty() ) {
+        // Look up the application that handles the service.
+        QString app = serviceApplication( channel.mid(12) );
+        if ( app.isEmpty() ) {
             qWarning( "No service mapping for %s, cannot forward %s",
                       channel.toLatin1().constData(),
                       message.toLatin1().constData() );
             return;
         }
 
-        QString app = appChannel.mid(16 /* ::strlen("QPE/Application/") */);
         routeMessage(app, message, newData);
     }
 }
 
+/*!  \internal */
+void QCopRouter::servicesChanged()
+{
+    m_serviceApps.clear();
+    m_services.clear();
+    m_servicesListed = false;
+}
+
+/*!
+  \internal
+  Returns the application that provides \a service, or an empty string if
+  no application does.  Reading the service bindings touches several files,
+  so the result is cached.
+  */
+QString QCopRouter::serviceApplication(const QString &service)
+{
+    QHash<QString, QString>::ConstIterator iter = m_serviceApps.find(service);
+    if(iter != m_serviceApps.end())
+        return *iter;
+
+    // Only installed services are cached, and the list of them is only
+    // current while the services directory is monitored.
+    if(!m_servicesListed && m_servicesMonitor->isValid()) {
+        m_services = QtopiaService::list().toSet();
+        m_servicesListed = true;
+    }
+
+    // Monitor before reading so a change made during the lookup isn't lost.
+    bool monitored = m_servicesListed && m_services.contains(service)
+                     && monitorService(service);
+
+    QString app = QtopiaService::app(service);
+
+    // Without a way to hear about changes every lookup must be fresh.
+    if(monitored)
+        m_serviceApps.insert(service, app);
+    return app;
+}
+
+/*!
+  \internal
+  Monitors the files that QtopiaService::app() reads for \a service: the
+  service's directory of providing applications and the user's binding file.
+  The binding file is monitored alone rather than the whole settings
+  directory, as other settings in that directory are rewritten constantly.
+  Returns false if either can't be monitored.
+  */
+bool QCopRouter::monitorService(const QString &service)
+{
+    QStringList fileNames;
+    fileNames << Qtopia::qtopiaDir() + QLatin1String("services/") + service + QLatin1String("/*")
+              << m_bindingsPath + QLatin1Char('/') + QtopiaService::binding(service) + QLatin1String(".conf");
+
+    bool valid = true;
+    foreach(const QString &fileName, fileNames) {
+        QFileMonitor *monitor = m_serviceMonitors.value(fileName);
+        if(!monitor) {
+            monitor = new QFileMonitor(fileName, this);
+            connect(monitor, SIGNAL(fileChanged(QString)),
+                    this, SLOT(servicesChanged()));
+            m_serviceMonitors.insert(fileName, monitor);
+        }
+        valid = valid && monitor->isValid();
+    }
+    return valid;
+}
+
 /*!  \internal */
 void QCopRouter::routeMessage(const QString &dest,
                               const QString &message,
@@ -158,11 +274,13 @@ void QCopRouter::routeMessage(const QString &dest,
     if(l)
         l->launch(dest);
 
-    QMultiMap<QString, RouteDestination *>::Iterator iter = m_routes.find(dest);
-    while(iter != m_routes.end() && iter.key() == dest) {
-        if(!m_cRouted.contains(*iter))
-            (*iter)->routeMessage(dest, message, data);
-        ++iter;
+    // Destinations may add or remove routes while routing, so route to a
+    // copy of the list and skip any destination that has since been removed.
+    QList<RouteDestination *> routes = m_routes.value(dest);
+    for(int ii = 0; ii < routes.count(); ++ii) {
+        RouteDestination *route = routes.at(ii);
+        if(!m_cRouted.contains(route) && m_routes.value(dest).contains(route))
+            route->routeMessage(dest, message, data);
     }
 
     m_cDest.clear();
@@ -176,7 +294,7 @@ void QCopRouter::addRoute(const QString &app, RouteDestination *dest)
 {
     Q_ASSERT(dest);
     Q_ASSERT(!app.isEmpty());
-    m_routes.insert(app, dest);
+    m_routes[app].append(dest);
     if(app == m_cDest) {
         dest->routeMessage(m_cDest, m_cMessage, m_cData);
         m_cRouted.insert(dest);
@@ -187,13 +305,11 @@ void QCopRouter::addRoute(const QString &app, RouteDestination *dest)
 void QCopRouter::remRoute(const QString &app, RouteDestination *dest)
 {
     Q_ASSERT(dest);
-    QMultiMap<QString, RouteDestination *>::Iterator iter = m_routes.find(app);
-    while(iter != m_routes.end() && iter.key() == app) {
-        if(iter.value() == dest) {
+    QHash<QString, QList<RouteDestination *> >::Iterator iter = m_routes.find(app);
+    if(iter != m_routes.end()) {
+        iter->removeOne(dest);
+        if(iter->isEmpty())
             m_routes.erase(iter);
-            return;
-        }
-        ++iter;
     }
 }
 #endif
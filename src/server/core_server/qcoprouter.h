@@ -22,7 +22,7 @@
 
 #if !defined(QT_NO_COP)
 
-#include <QMultiMap>
+#include <QHash>
 #include "applicationlauncher.h"
 #include <QSet>
 #ifdef Q_WS_X11
@@ -31,6 +31,8 @@
 #include <qcopchannel_qws.h>
 #endif
 
+class QFileMonitor;
+
 class QCopRouter : public ApplicationIpcRouter
 {
     Q_OBJECT
@@ -44,10 +46,20 @@ public:
 private slots:
     void applicationMessage( const QString& msg, const QByteArray& data );
     void serviceMessage( const QString& msg, const QByteArray& data );
+    void servicesChanged();
 
 private:
+    QString serviceApplication(const QString &);
+    bool monitorService(const QString &);
     void routeMessage(const QString &, const QString &, const QByteArray &);
-    QMultiMap<QString, RouteDestination *> m_routes;
+
+    QHash<QString, QList<RouteDestination *> > m_routes;
+    QHash<QString, QString> m_serviceApps;
+    QSet<QString> m_services;
+    bool m_servicesListed;
+    QFileMonitor *m_servicesMonitor;
+    QHash<QString, QFileMonitor *> m_serviceMonitors;
+    QString m_bindingsPath;
 
     // In-progress route
     QString m_cDest;
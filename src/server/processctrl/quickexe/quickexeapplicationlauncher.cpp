@@ -30,6 +30,10 @@
 #include <QProcess>
 #include <QFile>
 #include <QTimer>
+#include <QTime>
+#include <QSettings>
+#include <QMap>
+#include <QHash>
 
 // Systme includes
 #include <sys/types.h>
@@ -40,6 +44,10 @@
 #include <sys/resource.h>
 // Constants
 static const int NUM_POOLED_QLPROCESSES = 2;
+static const int MAX_POOLED_QLPROCESSES = 4;
+static const int POOL_WINDOW = 60;          // seconds
+static const int USAGE_AGE_LIMIT = 1000;    // launches before usage counts are halved
+static const int USAGE_SAVE_DELAY = 60000;  // ms before changed usage counts are saved
 
 // ============================================================================
 //
@@ -67,29 +75,77 @@ class QuickExeApplicationLauncherPrivate : public SystemShutdownHandler
 {
     Q_OBJECT
 public:
-    QuickExeApplicationLauncherPrivate() : isShutdown(false), mQlProcesses() {}
+    QuickExeApplicationLauncherPrivate();
 
     void addProcess( QProcess* process );
     QProcess* removeProcess( const int pid );
     void processAvailable( const int pid );
     bool ready() const;
     QProcess* nextProcess();
+    QProcess* excessProcess();
     bool createProcess() const;
 
+    void recordLaunch( const QString &app );
+    int targetCount() const;
+    int window() const { return mWindow; }
+
     virtual bool systemRestart();
     virtual bool systemShutdown();
 
     bool shutdown() const { return isShutdown; }
     QString quicklaunchExecutable();
 
+public slots:
+    void saveUsage();
+
 private:
     void killAll();
+    void expireLaunches();
+    void updatePreloadList( const QString &app );
     bool isShutdown;
 
     QString mQlExecutable;
     QList<QlProcessInfo*> mQlProcesses;
+
+    int mMinProcesses;
+    int mMaxProcesses;
+    int mWindow;
+    int mPreloadCount;
+    QTime mClock;
+    QList<int> mLaunchTimes;
+    QStringList mPreloadApps;
+    QHash<QString, int> mUsage;
+    bool mUsageChanged;
+    bool mPreloadChanged;
+    QTimer mSaveTimer;
 };
 
+QuickExeApplicationLauncherPrivate::QuickExeApplicationLauncherPrivate()
+: isShutdown(false), mQlProcesses(), mUsageChanged(false), mPreloadChanged(false)
+{
+    QSettings cfg("Trolltech","Launcher");
+    cfg.beginGroup("QuickLaunch");
+    mMinProcesses = qMax(1, cfg.value("PoolMinimum", NUM_POOLED_QLPROCESSES).toInt());
+    mMaxProcesses = qMax(mMinProcesses, cfg.value("PoolMaximum", MAX_POOLED_QLPROCESSES).toInt());
+    mWindow = qMax(1, cfg.value("PoolWindow", POOL_WINDOW).toInt());
+    mPreloadCount = qMax(0, cfg.value("PreloadCount", 0).toInt());
+    mPreloadApps = cfg.value("PreloadApplications").toStringList();
+    cfg.endGroup();
+
+    if ( mPreloadCount > 0 ) {
+        cfg.beginGroup("QuickLaunchUsage");
+        foreach ( QString key, cfg.childKeys() )
+            mUsage.insert(key, cfg.value(key).toInt());
+        cfg.endGroup();
+    }
+
+    mSaveTimer.setSingleShot(true);
+    mSaveTimer.setInterval(USAGE_SAVE_DELAY);
+    connect(&mSaveTimer, SIGNAL(timeout()), this, SLOT(saveUsage()));
+
+    mClock.start();
+}
+
 QString QuickExeApplicationLauncherPrivate::quicklaunchExecutable()
 {
     if(mQlExecutable.isEmpty()) {
@@ -113,6 +169,7 @@ bool QuickExeApplicationLauncherPrivate::systemRestart()
 {
     isShutdown = true;
     killAll();
+    saveUsage();
     return true;
 }
 
@@ -120,6 +177,7 @@ bool QuickExeApplicationLauncherPrivate::systemShutdown()
 {
     isShutdown = true;
     killAll();
+    saveUsage();
     return true;
 }
 
@@ -182,14 +240,136 @@ QProcess* QuickExeApplicationLauncherPrivate::nextProcess()
     return 0;
 }
 
+/*
+  Returns a ready quicklauncher that is no longer needed because the pool
+  is larger than the current target size, or 0 if there is none.  The
+  process is removed from the pool.
+ */
+QProcess* QuickExeApplicationLauncherPrivate::excessProcess()
+{
+    if ( mQlProcesses.count() <= targetCount() )
+        return 0;
+
+    return nextProcess();
+}
+
 bool QuickExeApplicationLauncherPrivate::createProcess() const
 {
-    if ( mQlProcesses.count() < NUM_POOLED_QLPROCESSES )
+    if ( mQlProcesses.count() < targetCount() )
         return true;
 
     return false;
 }
 
+/*
+  Drops launches that happened more than one pool window ago.
+ */
+void QuickExeApplicationLauncherPrivate::expireLaunches()
+{
+    int now = mClock.elapsed();
+    while ( !mLaunchTimes.isEmpty() ) {
+        int age = now - mLaunchTimes.first();
+        // QTime wraps after 24 hours, treat a negative age as expired.
+        if ( age >= 0 && age < mWindow * 1000 )
+            break;
+        mLaunchTimes.removeFirst();
+    }
+}
+
+/*
+  Returns the number of quicklaunchers that should be kept in the pool.
+  Every launch within the last pool window beyond the first asks for one
+  more warm process, so bursts of launches grow the pool up to the
+  configured maximum and it shrinks back once the burst has aged out.
+ */
+int QuickExeApplicationLauncherPrivate::targetCount() const
+{
+    const_cast<QuickExeApplicationLauncherPrivate*>(this)->expireLaunches();
+
+    int target = mMinProcesses;
+    if ( mLaunchTimes.count() > 1 )
+        target += mLaunchTimes.count() - 1;
+
+    return qMin(target, mMaxProcesses);
+}
+
+void QuickExeApplicationLauncherPrivate::recordLaunch( const QString &app )
+{
+    mLaunchTimes.append( mClock.elapsed() );
+    if ( mLaunchTimes.count() > mMaxProcesses )
+        mLaunchTimes.removeFirst();
+
+    if ( mPreloadCount > 0 )
+        updatePreloadList( app );
+}
+
+/*
+  Counts launches of \a app and keeps the most frequently launched
+  applications as the preload list, so that new quicklaunchers can load their
+  plugins while they are idle.  The counts are kept in memory and saved to the
+  Launcher configuration by saveUsage() some time after they change, rather
+  than rewriting the configuration on every launch.
+ */
+void QuickExeApplicationLauncherPrivate::updatePreloadList( const QString &app )
+{
+    int count = ++mUsage[app];
+    if ( count >= USAGE_AGE_LIMIT ) {
+        // Age the counts so the list follows changing usage patterns.
+        QHash<QString, int>::Iterator it;
+        for ( it = mUsage.begin(); it != mUsage.end(); ++it )
+            *it /= 2;
+    }
+
+    QMultiMap<int, QString> byUsage;
+    QHash<QString, int>::ConstIterator usage;
+    for ( usage = mUsage.constBegin(); usage != mUsage.constEnd(); ++usage )
+        byUsage.insert(usage.value(), usage.key());
+
+    QStringList preload;
+    QMapIterator<int, QString> it(byUsage);
+    it.toBack();
+    while ( it.hasPrevious() && preload.count() < mPreloadCount )
+        preload.append(it.previous().value());
+
+    mUsageChanged = true;
+
+    if ( preload != mPreloadApps ) {
+        mPreloadApps = preload;
+        mPreloadChanged = true;
+    }
+
+    if ( !mSaveTimer.isActive() )
+        mSaveTimer.start();
+}
+
+/*
+  Writes changed usage counts and the preload list to the Launcher
+  configuration.  Quicklaunchers read the preload list when they start.
+ */
+void QuickExeApplicationLauncherPrivate::saveUsage()
+{
+    mSaveTimer.stop();
+
+    if ( !mUsageChanged )
+        return;
+
+    QSettings cfg("Trolltech","Launcher");
+    cfg.beginGroup("QuickLaunchUsage");
+    QHash<QString, int>::ConstIterator usage;
+    for ( usage = mUsage.constBegin(); usage != mUsage.constEnd(); ++usage )
+        cfg.setValue(usage.key(), usage.value());
+    cfg.endGroup();
+
+    if ( mPreloadChanged ) {
+        cfg.beginGroup("QuickLaunch");
+        cfg.setValue("PreloadApplications", mPreloadApps);
+        cfg.endGroup();
+    }
+
+    mUsageChanged = false;
+    mPreloadChanged = false;
+}
+
 /*!
   \class QuickExeApplicationLauncher
     \inpublicgroup QtBaseModule
@@ -244,7 +424,28 @@ bool QuickExeApplicationLauncherPrivate::createProcess() const
   anticipation of an application launch.
 
   Once a \c {quicklauncher} instance has transformed itself into a running
-  application, the QuickExeApplicationLauncher class starts another.  When the
+  application, the QuickExeApplicationLauncher class starts another.  A pool
+  of idle \c {quicklauncher} instances is kept so that launches in quick
+  succession can all be quicklaunched.  The pool grows by one instance for
+  every launch within the last pool window beyond the first, and idle
+  instances are stopped again once the launches have aged out of the window.
+  The pool is configured in the \c {QuickLaunch} group of the \c {Launcher}
+  configuration file:
+
+  \table
+  \header \o Key \o Description
+  \row \o \c PoolMinimum \o The number of idle instances kept when no
+         applications are being launched.  Defaults to 2.
+  \row \o \c PoolMaximum \o The largest number of idle instances kept
+         during bursts of launches.  Defaults to 4.
+  \row \o \c PoolWindow \o The time in seconds a launch counts towards the
+         pool size.  Defaults to 60.
+  \row \o \c PreloadCount \o The number of most frequently launched
+         applications whose plugins are loaded by idle instances.  Defaults
+         to 0, which disables plugin preloading.
+  \row \o \c PreloadFonts \o A list of additional font families loaded by
+         idle instances.
+  \endtable  When the
   system shuts down, the QuickExeApplicationLauncher will ensure that the 
   running \c {quicklauncher} instance is stopped.
 
@@ -269,6 +470,9 @@ QuickExeApplicationLauncher::QuickExeApplicationLauncher()
 {
     QtopiaServerApplication::addAggregateObject(this, d);
     QtopiaChannel *channel = new QtopiaChannel("QPE/QuickLauncher", this);
+    QTimer *trimTimer = new QTimer(this);
+    connect( trimTimer, SIGNAL(timeout()), this, SLOT(trimPool()) );
+    trimTimer->start( d->window() * 1000 / 2 );
     connect( channel,
              SIGNAL(received(QString,QByteArray)),
              this,
@@ -284,6 +488,7 @@ QuickExeApplicationLauncher::QuickExeApplicationLauncher()
  */
 QuickExeApplicationLauncher::~QuickExeApplicationLauncher()
 {
+    d->saveUsage();
     delete d;
 }
 
@@ -332,8 +537,9 @@ void QuickExeApplicationLauncher::launch(const QString &app)
     process->disconnect(); // We don't want error signals anymore
     addStartingApplication( app, process );
 
+    d->recordLaunch( app );
     if ( d->createProcess() )
-        respawnQuicklauncher( false );
+        respawnQuicklauncher( !d->ready() );
 }
 
 /*! \internal */
@@ -354,7 +560,7 @@ void QuickExeApplicationLauncher::quickLauncherChannel(const QString &message,
 /*! \internal */
 void QuickExeApplicationLauncher::startNewQuicklauncher()
 {
-    if(d->shutdown()) return;
+    if(d->shutdown() || !d->createProcess()) return;
 
     // Create the new quicklauncher process
     QProcess* process = new QProcess( this );
@@ -419,6 +625,22 @@ void QuickExeApplicationLauncher::qlProcessError( QProcess::ProcessError /*error
     }
 }
 
+/*! \internal */
+void QuickExeApplicationLauncher::trimPool()
+{
+    // Stop one idle quicklauncher at a time so the pool shrinks gradually.
+    QProcess* process = d->excessProcess();
+    if ( !process )
+        return;
+
+    process->disconnect();
+    connect( process, SIGNAL(finished(int)), process, SLOT(deleteLater()) );
+
+    QString qlch("QPE/QuickLauncher-");
+    qlch += QString::number( process->pid() );
+    QtopiaIpcEnvelope env( qlch, "quit()" );
+}
+
 /*! \internal */
 void QuickExeApplicationLauncher::respawnQuicklauncher( bool fast )
 {
@@ -39,6 +39,7 @@ private slots:
     void startNewQuicklauncher();
     void qlProcessExited(int);
     void qlProcessError(QProcess::ProcessError);
+    void trimPool();
 
 private:
     void respawnQuicklauncher(bool);
@@ -529,6 +529,7 @@ void ImapClient::handleSearch()
 
         if ((_unseenUids.count() + _seenUids.count()) == client.exists()) {
             // We have a consistent set of search results
+            recordSearch();
             searchCompleted();
         } else {
             qLog(IMAP) << "Inconsistent UID SEARCH result using SEEN/UNSEEN; reverting to ALL";
@@ -549,6 +550,8 @@ void ImapClient::handleSearch()
 
             // No consistent search result, so don't delete anything
             _searchStatus = Inconclusive;
+        } else {
+            recordSearch();
         }
 
         searchCompleted();
@@ -559,6 +562,43 @@ void ImapClient::handleSearch()
     }
 }
 
+/*  With CONDSTORE, the HIGHESTMODSEQ of a mailbox changes whenever a message
+    is added or has its flags altered.  Expunges are only guaranteed to change
+    it with QRESYNC (RFC 5162), not plain CONDSTORE (RFC 4551), so the message
+    count must also match the previous search results before they are reused.
+*/
+bool ImapClient::searchUnchanged()
+{
+    QMap<QMailFolderId, SearchState>::const_iterator it = searchState.find(currentMailbox.id());
+    if (it == searchState.end())
+        return false;
+
+    if (client.highestModSeq().isEmpty()
+        || (it->highestModSeq != client.highestModSeq())
+        || (it->mailboxUid != client.mailboxUid())
+        || (client.exists() != it->seenUids.count() + it->unseenUids.count()))
+        return false;
+
+    _seenUids = it->seenUids;
+    _unseenUids = it->unseenUids;
+    return true;
+}
+
+void ImapClient::recordSearch()
+{
+    if (client.highestModSeq().isEmpty()) {
+        searchState.remove(currentMailbox.id());
+        return;
+    }
+
+    SearchState state;
+    state.mailboxUid = client.mailboxUid();
+    state.highestModSeq = client.highestModSeq();
+    state.seenUids = _seenUids;
+    state.unseenUids = _unseenUids;
+    searchState.insert(currentMailbox.id(), state);
+}
+
 static QStringList inFirstAndSecond(const QStringList &first, const QStringList &second)
 {
     QStringList result;
@@ -644,14 +684,23 @@ void ImapClient::searchCompleted()
     }
 }
 
+// Maximum number of UIDs addressed by a single FETCH or STORE command
+static const int MaxUidBatch = 50;
+
+static QStringList takeUidBatch(QStringList &uids)
+{
+    QStringList batch = uids.mid(0, MaxUidBatch);
+    uids = uids.mid(batch.count());
+    return batch;
+}
+
 bool ImapClient::setNextSeen()
 {
     if (!_readUids.isEmpty()) {
-        msgUidl = _readUids.first();
-        _readUids.removeAll( msgUidl );
+        QString uidSet = ImapProtocol::uidSequence(takeUidBatch(_readUids));
 
-        emit updateStatus( QMailMessageServer::None, tr("Marking message %1 read").arg(msgUidl) );
-        client.uidStore(MFlag_Seen, ImapProtocol::uid(msgUidl));
+        emit updateStatus( QMailMessageServer::None, tr("Marking message %1 read").arg(uidSet) );
+        client.uidStore(MFlag_Seen, uidSet);
         return true;
     }
 
@@ -662,15 +711,15 @@ bool ImapClient::setNextDeleted()
 {
     if (_config.canDeleteMail()) {
         if (!_removedUids.isEmpty()) {
-            msgUidl = _removedUids.first();
-            _removedUids.removeAll( msgUidl );
+            QStringList batch = takeUidBatch(_removedUids);
+            QString uidSet = ImapProtocol::uidSequence(batch);
 
-            emit updateStatus( QMailMessageServer::None, tr("Deleting message %1").arg(msgUidl) );
+            emit updateStatus( QMailMessageServer::None, tr("Deleting message %1").arg(uidSet) );
 
             //remove records of deleted messages
-            QMailStore::instance()->purgeMessageRemovalRecords(accountId, QStringList() << msgUidl);
+            QMailStore::instance()->purgeMessageRemovalRecords(accountId, batch);
 
-            client.uidStore(MFlag_Deleted, ImapProtocol::uid(msgUidl));
+            client.uidStore(MFlag_Deleted, uidSet);
             return true;
         } else if (_expungeRequired) {
             // All messages flagged as deleted, expunge them
@@ -685,9 +734,8 @@ bool ImapClient::setNextDeleted()
 void ImapClient::handleUid()
 {
     if (_newUids.count() > 0) {
-        // TODO: We should find a compromise between retrieving all messages and retrieving messages individually:
-        //client.uidFetch(F_Uid | F_Rfc822_Size | F_Rfc822_Header, ImapProtocol::uidRange(_newUids.first(), _newUids.last()) );
-        client.uidFetch(F_Uid | F_Rfc822_Size | F_Rfc822_Header, ImapProtocol::uid(_newUids.takeFirst()));
+        // Fetch the headers in batches, rather than one message per round trip
+        client.uidFetch(F_Uid | F_Rfc822_Size | F_Rfc822_Header, ImapProtocol::uidSequence(takeUidBatch(_newUids)));
     } else if (!selectNextMailbox()) {
         if ((status == Fetch) || (_retrieveUids.isEmpty())) {
             previewCompleted();
@@ -721,11 +769,15 @@ void ImapClient::handleSelect()
         handleUid();
     } else {
         // We're searching mailboxes
-        if (client.exists() > 0) {
+        if (searchUnchanged()) {
+            // Nothing has changed on the server since our last search
+            searchCompleted();
+        } else if (client.exists() > 0) {
             // Start by looking for previously-seen messages
             client.uidSearch(MFlag_Seen);
         } else {
             // No messages, so no need to perform search
+            recordSearch();
             searchCompleted();
         }
     }
@@ -874,6 +926,9 @@ void ImapClient::setAccount(const QMailAccountId &id)
         return;
     }
 
+    if (id != accountId)
+        searchState.clear();
+
     accountId = id;
 }
 
@@ -94,6 +94,14 @@ private:
         All, Seen, Unseen, Inconclusive
     };
 
+    struct SearchState
+    {
+        QString mailboxUid;
+        QString highestModSeq;
+        QStringList seenUids;
+        QStringList unseenUids;
+    };
+
     void removeDeletedMailboxes();
     bool selectNextMailbox();
     bool nextMailbox();
@@ -101,6 +109,8 @@ private:
     void handleUid();
     void handleUidFetch();
     void handleSearch();
+    bool searchUnchanged();
+    void recordSearch();
 
     bool setNextSeen();
     bool setNextDeleted();
@@ -144,6 +154,7 @@ private:
     bool tlsEnabled;
 
     QMap<QMailFolderId, FolderStatus> folderStatus;
+    QMap<QMailFolderId, SearchState> searchState;
 
     bool supportsIdle;
     bool idling;
@@ -27,6 +27,8 @@
 #include <private/longstring_p.h>
 #include <QMailMessage>
 
+#include <ctype.h>
+
 #ifndef QT_NO_OPENSSL
 #include <QSslError>
 #endif
@@ -127,6 +129,60 @@ static uint extractSize(const QString& field)
     return 0;
 }
 
+// Returns the keyword of an untagged response "* <n> <keyword>", or an empty array
+static QByteArray numericResponseKeyword(const QByteArray& line)
+{
+    const char *begin = line.constData();
+    const char *end = begin + line.length();
+    const char *p = begin;
+
+    if ((p == end) || (*p++ != '*'))
+        return QByteArray();
+
+    const char *start = p;
+    while ((p != end) && isspace(static_cast<unsigned char>(*p)))
+        ++p;
+    if (p == start)
+        return QByteArray();
+
+    start = p;
+    while ((p != end) && isdigit(static_cast<unsigned char>(*p)))
+        ++p;
+    if (p == start)
+        return QByteArray();
+
+    start = p;
+    while ((p != end) && isspace(static_cast<unsigned char>(*p)))
+        ++p;
+    if (p == start)
+        return QByteArray();
+
+    start = p;
+    while ((p != end) && (isalnum(static_cast<unsigned char>(*p)) || (*p == '_')))
+        ++p;
+
+    return line.mid(start - begin, p - start);
+}
+
+// Returns the size of the literal announced at the end of line, or -1 if there is none
+static int literalSize(const QByteArray& line)
+{
+    int end = line.length();
+    while ((end > 0) && ((line[end - 1] == '\n') || (line[end - 1] == '\r')))
+        --end;
+
+    if ((end == 0) || (line[end - 1] != '}'))
+        return -1;
+
+    int start = line.lastIndexOf('{', end - 1);
+    if (start == -1)
+        return -1;
+
+    bool ok;
+    int size = line.mid(start + 1, end - start - 2).toInt(&ok);
+    return ((ok && (size >= 0)) ? size : -1);
+}
+
 static bool parseFlags(const QString& field, MessageFlags& flags)
 {
     QRegExp pattern("FLAGS *\\((.*)\\)");
@@ -159,6 +215,7 @@ ImapProtocol::ImapProtocol()
     read = 0;
     firstParseFetch = true;
     transport = 0;
+    literalLength = 0;
     d = new LongStream();
     newMessage = true;
     fetchAllFailed = false;
@@ -190,6 +247,7 @@ bool ImapProtocol::open( const AccountConfiguration& config )
     request.clear();
     d->reset();
     newMessage = true;
+    literalLength = 0;
 
     if (!transport) {
         transport = new ImapTransport("IMAP");
@@ -216,6 +274,7 @@ void ImapProtocol::close()
         transport->close();
     d->reset();
     newMessage = true;
+    literalLength = 0;
 }
 
 bool ImapProtocol::connected() const
@@ -243,6 +302,11 @@ QString ImapProtocol:: mailboxUid()
     return _mailboxUid;
 }
 
+QString ImapProtocol::highestModSeq()
+{
+    return _highestModSeq;
+}
+
 QString ImapProtocol::flags()
 {
     return _flags;
@@ -307,7 +371,12 @@ void ImapProtocol::select( QString mailbox )
 {
     status = IMAP_Select;
     _name = mailbox;
-    sendCommand( "SELECT " + quoteImapString(mailbox) );
+
+    // With CONDSTORE enabled, the server reports the mailbox HIGHESTMODSEQ
+    if (supportsCapability("CONDSTORE"))
+        sendCommand( "SELECT " + quoteImapString(mailbox) + " (CONDSTORE)" );
+    else
+        sendCommand( "SELECT " + quoteImapString(mailbox) );
 }
 
 void ImapProtocol::uidSearch( MessageFlags flags, const QString &range)
@@ -437,43 +506,67 @@ void ImapProtocol::sendCommand( QString cmd )
 void ImapProtocol::incomingData()
 {
     int readLines = 0;
-    while (transport->canReadLine()) {
-        response = transport->readLine();
-        readLines++;
-        read += response.length();
+    while ((literalLength > 0) ? (transport->bytesAvailable() > 0) : transport->canReadLine()) {
+        QByteArray data;
+        bool literal = (literalLength > 0);
+        if (literal) {
+            // Literal content is copied through in bulk, without being inspected
+            data = transport->read(qMin<qint64>(transport->bytesAvailable(), literalLength));
+            literalLength -= data.length();
+        } else {
+            data = transport->readLine();
+            response = data;
 
-        if (response.length() > 1)
-            qLog(IMAP) << "RECV:" << qPrintable(response.left(response.length() - 2));
+            if (data.length() > 1)
+                qLog(IMAP) << "RECV:" << qPrintable(response.left(response.length() - 2));
 
-        if (status == IMAP_Idle || status == IMAP_Idle_Done) {
-            emit finished(status, operationState);
-            response = "";
-            read = 0;
-            return;
+            if (status == IMAP_Idle || status == IMAP_Idle_Done) {
+                emit finished(status, operationState);
+                response = "";
+                read = 0;
+                return;
+            }
+
+            int size = literalSize(data);
+            if (size > 0)
+                literalLength = size;
         }
+        readLines++;
+        read += data.length();
+
         if (status != IMAP_Init) {
-            if (status == IMAP_UIDFetch && newMessage) {
-                QString str = response;
-                QRegExp fetchResponsePattern("\\*\\s+\\d+\\s+(\\w+)");
-                if (fetchResponsePattern.indexIn(str) == 0) {
-                    if (fetchResponsePattern.cap(1).compare("FETCH", Qt::CaseInsensitive) == 0) {
+            QByteArray keyword;
+            if (!literal && status == IMAP_UIDFetch) {
+                keyword = numericResponseKeyword(data);
+                if (!newMessage && (qstricmp(keyword.constData(), "FETCH") == 0)) {
+                    // A UID set fetch returns one response per message; the
+                    // previous message is complete once the next one begins
+                    parseFetchedMessage();
+                    newMessage = true;
+                }
+            }
+
+            if (!literal && status == IMAP_UIDFetch && newMessage) {
+                if (!keyword.isEmpty()) {
+                    if (qstricmp(keyword.constData(), "FETCH") == 0) {
                         newMessage = false;
-                        newMsgUid = extractUid(str, _name);
-                        newMsgSize = extractSize(str);
+                        newMsgUid = extractUid(response, _name);
+                        newMsgSize = extractSize(response);
                         newMsgFlags = 0;
-                        newMsgFlagsParsed = parseFlags(str, newMsgFlags);
+                        newMsgFlagsParsed = parseFlags(response, newMsgFlags);
+                        firstParseFetch = true;
                         d->reset();
                     }
-                } else if (str.toUpper().startsWith("* NO")) {
+                } else if (qstrnicmp(data.constData(), "* NO", 4) == 0) {
                     newMessage = false;
                     fetchAllFailed = true;
-                    fetchAllFailMsg = str;
+                    fetchAllFailMsg = response;
                 } else {
                     nonExistentMsg = true;
                     nonExistentMsgStr = messageUid(_name, fetchUid);
                 }
             } else {
-                d->append( response );
+                d->append( data );
             }
             if (d->status() == LongStream::OutOfSpace) {
                 operationState = OpFailed;
@@ -482,13 +575,14 @@ void ImapProtocol::incomingData()
                 emit finished(status, operationState);
                 response = "";
                 read = 0;
+                literalLength = 0;
                 return;
             }
         }
 
         if ((status == IMAP_UIDFetch) && (dataItems & F_Rfc822)) {
-            if (!response.startsWith("* "))
-                messageLength += response.length();
+            if (literal || !data.startsWith("* "))
+                messageLength += data.length();
 
             if (readLines > MAX_LINES)
                 emit downloadSize(messageLength);
@@ -604,15 +698,7 @@ void ImapProtocol::nextAction()
     }
 
     if (status == IMAP_UIDFetch) {
-        //temporary for now
-        bool parsedInput = false;
-        if (dataItems & F_Rfc822_Header) {
-            parsedInput = parseFetch();
-        } else {
-            parsedInput = parseFetchAll();
-        }
-        
-        if (parsedInput)
+        if (parseFetchedMessage())
             operationCompleted(status, operationState);
 
         fetchUid = QString();
@@ -723,6 +809,7 @@ void ImapProtocol::parseSelect()
     _recent = 0;
     _flags = "";
     _mailboxUid = "";
+    _highestModSeq = "";
     for (str = d->first(); str != QString::null; str = d->next()) {
 
         if (str.indexOf("EXISTS", 0) != -1) {
@@ -740,6 +827,10 @@ void ImapProtocol::parseSelect()
         } else if (str.startsWith("* FLAGS")) {
             start = 0;
             _flags = token( str, '(', ')', &start );
+        } else if (str.indexOf("HIGHESTMODSEQ", 0) != -1) {
+            start = 0;
+            temp = token( str, '[', ']', &start );
+            _highestModSeq = temp.mid( 14 ).trimmed();
         } else if (str.indexOf("UIDVALIDITY", 0) != -1) {
             start = 0;
             temp = token( str, '[', ']', &start );
@@ -748,6 +839,14 @@ void ImapProtocol::parseSelect()
     }
 }
 
+bool ImapProtocol::parseFetchedMessage()
+{
+    if (dataItems & F_Rfc822_Header)
+        return parseFetch();
+
+    return parseFetchAll();
+}
+
 bool ImapProtocol::parseFetch()
 {
     static const QByteArray crlfSequence( QMailMessage::CRLF );
@@ -955,6 +1054,39 @@ QString ImapProtocol::uidRange( const QString &from, const QString &to )
     return messageId(from) + ':' + messageId(to);
 }
 
+/*  Returns a UID set describing identifiers, with consecutive UIDs
+    collapsed into ranges: "1:4,7,9:10"  */
+QString ImapProtocol::uidSequence( const QStringList &identifiers )
+{
+    QList<uint> numbers;
+    QStringList others;
+    foreach (const QString &identifier, identifiers) {
+        bool ok;
+        uint number = messageId(identifier).toUInt(&ok);
+        if (ok)
+            numbers.append(number);
+        else
+            others.append(messageId(identifier));
+    }
+    qSort(numbers);
+
+    QStringList sequence;
+    int i = 0;
+    while (i < numbers.count()) {
+        int j = i;
+        while ((j + 1 < numbers.count()) && (numbers.at(j + 1) <= numbers.at(j) + 1))
+            ++j;
+
+        if (numbers.at(j) == numbers.at(i))
+            sequence.append(ImapProtocol::sequence(numbers.at(i)));
+        else
+            sequence.append(sequenceRange(numbers.at(i), numbers.at(j)));
+        i = j + 1;
+    }
+
+    return (sequence + others).join(",");
+}
+
 bool ImapProtocol::supportsCapability(const QString& name) const
 {
     return _capabilities.contains(name);
@@ -122,6 +122,7 @@ public:
     int exists();
     int recent();
     QString mailboxUid();
+    QString highestModSeq();
     QString flags();
     QStringList mailboxUidList();
 
@@ -139,6 +140,7 @@ public:
     static QString uid(const QString &identifier);
     static QString sequenceRange(uint from, uint to);
     static QString uidRange(const QString &from, const QString &to);
+    static QString uidSequence(const QStringList &identifiers);
 
 signals:
     void mailboxListed(QString &flags, QString &delimiter, QString &name);
@@ -171,6 +173,7 @@ private:
     void parseUid();
     void parseChange();
     void parseList(QString in);
+    bool parseFetchedMessage();
 
     void createMail( QString& uid, int size, uint flags);
 
@@ -185,7 +188,7 @@ private:
     /*  Associated with the Mailbox */
     QString _name;
     int _exists, _recent;
-    QString _flags, _mailboxUid;
+    QString _flags, _mailboxUid, _highestModSeq;
     QStringList uidList;
 
     QString request;
@@ -193,6 +196,7 @@ private:
     LongStream *d;
     int requestCount, internalId;
     int messageLength;
+    int literalLength;
 
     QString _lastError;
     QString response;
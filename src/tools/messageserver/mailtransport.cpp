@@ -201,6 +201,16 @@ QByteArray MailTransport::readLine(qint64 maxSize)
     return mSocket->readLine(maxSize);
 }
 
+qint64 MailTransport::bytesAvailable() const
+{
+    return mSocket->bytesAvailable();
+}
+
+QByteArray MailTransport::read(qint64 maxSize)
+{
+    return mSocket->read(maxSize);
+}
+
 void MailTransport::connectionEstablished()
 {
     connectToHostTimeOut->stop();
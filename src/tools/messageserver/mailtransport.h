@@ -67,6 +67,10 @@ public:
     bool canReadLine() const;
     QByteArray readLine(qint64 maxSize = 0);
 
+    // Read unstructured data from the transport (must have an open connection)
+    qint64 bytesAvailable() const;
+    QByteArray read(qint64 maxSize);
+
 signals:
     void connected(AccountConfiguration::EncryptType encryptType);
     void readyRead();
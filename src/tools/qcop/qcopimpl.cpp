@@ -19,12 +19,15 @@
 
 #include "qcopimpl.h"
 #include <qtopiaservices.h>
+#include <qtopiachannel.h>
 #include <quuid.h>
 #include <quniqueid.h>
 #include <QContent>
 
 #include <QDateTime>
 #include <QApplication>
+#include <QMap>
+#include <QtAlgorithms>
 
 void doqcopusage()
 {
@@ -40,6 +43,9 @@ void doqcopusage()
     fprintf( stderr, "    Query the supported messages on \"channel\".\n" );
     fprintf( stderr, "list\n" );
     fprintf( stderr, "    List all available services and their application mappings.\n" );
+    fprintf( stderr, "profile [reset]\n" );
+    fprintf( stderr, "    Print the IPC traffic recorded by processes started with\n" );
+    fprintf( stderr, "    QTOPIA_IPC_PROFILE set, or clear their records.\n" );
     fprintf( stderr, "\n" );
     fprintf( stderr, "The following modifiers can appear before a command:\n");
     fprintf( stderr, "\n" );
@@ -597,6 +603,22 @@ void parseCommands( QApplication& app, int argc, char **argv )
             }
             checkEnd( argc, argv );
 
+        } else if ( cmd == "profile" ) {
+
+            // Collect the IPC profiles of all profiling processes, or
+            // clear them.
+            if ( argc > 1 && QString( argv[1] ) == "reset" ) {
+                ++argv;
+                --argc;
+                QCopEnvelope *env = new QCopEnvelope
+                    ( QTOPIA_IPC_PROFILE_CHANNEL, "reset()" );
+                handler = new QCopSender( env, &app );
+            } else {
+                handler = new QCopProfiler( timeout, &app );
+            }
+            addHandler( first, last, handler );
+            checkEnd( argc, argv );
+
         } else if ( cmd == "timeout" ) {
 
             // Set the timeout interval on the next command.
@@ -820,7 +842,8 @@ void QCopWatcher::printMessage( const QString& msg, const QByteArray& data )
     QDataStream stream( data );
     ParamInfo info = parseParameters( msg );
 
-    if ( !info.parameters.isEmpty() && !msg.endsWith( "_fragment_" ) ) {
+    if ( !info.parameters.isEmpty() && !msg.endsWith( "_fragment_" ) && !msg.endsWith( "_shared_" ) &&
+         !msg.endsWith( "_compact_" ) ) {
         printf( "%s( ", info.name.toLatin1().constData() );
         QStringList::Iterator it;
         bool comma = false;
@@ -968,3 +991,153 @@ void QCopQuery::gotTimeout()
         emit done( true );
     }
 }
+
+QCopProfiler::QCopProfiler( int timeout, QObject *parent )
+    : QCopHandler( parent )
+{
+    this->timeout = ( timeout < 0 ? 1000 : timeout );// Default 1 sec timeout.
+    this->finished = false;
+}
+
+QCopProfiler::~QCopProfiler()
+{
+}
+
+void QCopProfiler::start( bool ok )
+{
+    QCopHandler::start( ok );
+    if ( ok ) {
+        // Hook onto the response channel.  Profiles of busy processes can
+        // be large enough to arrive fragmented or through shared memory,
+        // which QtopiaChannel reassembles.
+        QString responseChannel = "QPE/Query/" + QUuid::createUuid().toString();
+        QtopiaChannel *chan = new QtopiaChannel( responseChannel, this );
+        QObject::connect
+            ( chan, SIGNAL(received(QString,QByteArray)),
+              this, SLOT(received(QString,QByteArray)) );
+        QTimer::singleShot( timeout, this, SLOT(gotTimeout()) );
+
+        // Ask every profiling process for its records.
+        QCopEnvelope env( QTOPIA_IPC_PROFILE_CHANNEL, "dump(QString)" );
+        env << responseChannel;
+    }
+}
+
+void QCopProfiler::received( const QString& msg, const QByteArray& data )
+{
+    if ( msg != "profile(QString,int,QByteArray)" || finished )
+        return;
+
+    QDataStream stream( data );
+    QString name;
+    int pid;
+    QByteArray recordData;
+    stream >> name >> pid >> recordData;
+    processes += QString( "%1 [%2]" ).arg( name ).arg( pid );
+
+    QList<QtopiaIpcProfile::Record> list;
+    QDataStream recordStream( recordData );
+    recordStream >> list;
+
+    // Combine the records of all processes.
+    foreach ( const QtopiaIpcProfile::Record& record, list ) {
+        QPair<QString, QString> key( record.channel, record.message );
+        if ( !records.contains( key ) ) {
+            records.insert( key, record );
+            continue;
+        }
+        QtopiaIpcProfile::Record& total = records[key];
+        total.sent += record.sent;
+        total.received += record.received;
+        total.sentBytes += record.sentBytes;
+        total.receivedBytes += record.receivedBytes;
+        for ( int bucket = 0; bucket < QtopiaIpcProfile::LatencyBuckets; ++bucket )
+            total.latency[bucket] += record.latency[bucket];
+    }
+}
+
+void QCopProfiler::gotTimeout()
+{
+    if ( !finished ) {
+        finished = true;
+        printRecords();
+        emit done( true );
+    }
+}
+
+static bool busierRecord( const QtopiaIpcProfile::Record& r1,
+                          const QtopiaIpcProfile::Record& r2 )
+{
+    return ( r1.sent + r1.received ) > ( r2.sent + r2.received );
+}
+
+// Returns the latency below which \a fraction of the messages in \a record
+// were delivered, as a bucket bound.
+static QString latencyPercentile( const QtopiaIpcProfile::Record& record,
+                                  double fraction )
+{
+    quint32 total = 0;
+    for ( int bucket = 0; bucket < QtopiaIpcProfile::LatencyBuckets; ++bucket )
+        total += record.latency[bucket];
+    if ( !total )
+        return "-";
+
+    quint32 count = 0;
+    for ( int bucket = 0; bucket < QtopiaIpcProfile::LatencyBuckets; ++bucket ) {
+        count += record.latency[bucket];
+        if ( count >= total * fraction ) {
+            int limit = QtopiaIpcProfile::latencyLimit( bucket );
+            if ( limit == -1 )
+                return QString( ">%1ms" ).arg( QtopiaIpcProfile::latencyLimit( bucket - 1 ) );
+            return QString( "<=%1ms" ).arg( limit );
+        }
+    }
+    return "-";
+}
+
+void QCopProfiler::printRecords()
+{
+    printf( "Profiles from %d processes:", processes.count() );
+    foreach ( const QString& process, processes )
+        printf( " %s", process.toLatin1().constData() );
+    printf( "\n\n" );
+
+    // Totals for each channel.
+    QMap<QString, QtopiaIpcProfile::Record> channels;
+    foreach ( const QtopiaIpcProfile::Record& record, records ) {
+        QtopiaIpcProfile::Record& total = channels[record.channel];
+        total.channel = record.channel;
+        total.sent += record.sent;
+        total.received += record.received;
+        total.sentBytes += record.sentBytes;
+        total.receivedBytes += record.receivedBytes;
+    }
+    QList<QtopiaIpcProfile::Record> list = channels.values();
+    qSort( list.begin(), list.end(), busierRecord );
+
+    printf( "%8s %8s %10s %10s  %s\n", "sent", "received", "sent bytes",
+            "recv bytes", "channel" );
+    foreach ( const QtopiaIpcProfile::Record& record, list ) {
+        printf( "%8u %8u %10llu %10llu  %s\n", record.sent, record.received,
+                (unsigned long long)record.sentBytes,
+                (unsigned long long)record.receivedBytes,
+                record.channel.toLatin1().constData() );
+    }
+    printf( "\n" );
+
+    // Each message, with its delivery latency.
+    list = records.values();
+    qSort( list.begin(), list.end(), busierRecord );
+
+    printf( "%8s %8s %10s %10s %8s %8s  %s\n", "sent", "received", "sent bytes",
+            "recv bytes", "median", "90%", "channel message" );
+    foreach ( const QtopiaIpcProfile::Record& record, list ) {
+        printf( "%8u %8u %10llu %10llu %8s %8s  %s %s\n", record.sent, record.received,
+                (unsigned long long)record.sentBytes,
+                (unsigned long long)record.receivedBytes,
+                latencyPercentile( record, 0.5 ).toLatin1().constData(),
+                latencyPercentile( record, 0.9 ).toLatin1().constData(),
+                record.channel.toLatin1().constData(),
+                record.message.toLatin1().constData() );
+    }
+}
@@ -28,6 +28,9 @@
 #endif
 
 #include <qstringlist.h>
+#include <qhash.h>
+#include <qpair.h>
+#include <private/qtopiaipcprofile_p.h>
 #include <qdatastream.h>
 #include <qtimer.h>
 
@@ -169,4 +172,29 @@ private:
     bool finished;
 };
 
+// Handler that collects IPC profiles from all profiling processes and
+// prints the combined traffic once the timeout expires.
+class QCopProfiler : public QCopHandler
+{
+    Q_OBJECT
+public:
+    QCopProfiler( int timeout = -1, QObject *parent = 0 );
+    ~QCopProfiler();
+
+public slots:
+    void start( bool ok );
+
+private slots:
+    void received( const QString& msg, const QByteArray& data );
+    void gotTimeout();
+
+private:
+    int timeout;
+    bool finished;
+    QStringList processes;
+    QHash< QPair<QString, QString>, QtopiaIpcProfile::Record > records;
+
+    void printRecords();
+};
+
 #endif
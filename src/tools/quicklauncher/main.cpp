@@ -25,12 +25,15 @@
 #include <QIcon>
 #include <qtimezone.h>
 #include <qtopiaapplication.h>
+#include <qtopianamespace.h>
 #include <qpluginmanager.h>
 #include <qapplicationplugin.h>
 #include <QSocketNotifier>
 #include <qtopialog.h>
 #include <QImageReader>
 #include <QtopiaSql>
+#include <QSettings>
+#include <QLibrary>
 #include <qtopia/qsoftmenubar.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -52,6 +55,47 @@ QSXE_APP_KEY
 
 extern char **environ;
 
+/*
+  Loads the fonts and application plugins listed in the QuickLaunch group of
+  the Launcher configuration so applications launched from this process
+  don't have to.  The server maintains the list of the most frequently
+  launched applications.
+ */
+static void preloadConfigured()
+{
+    QSettings cfg("Trolltech","Launcher");
+    cfg.beginGroup("QuickLaunch");
+
+    QStringList fonts = cfg.value("PreloadFonts").toStringList();
+    foreach ( QString family, fonts ) {
+        QFont f( QApplication::font() );
+        f.setFamily( family );
+        QFontMetrics fm( f );
+        fm.ascent(); // causes font load.
+        f.setWeight( QFont::Bold );
+        QFontMetrics fmb( f );
+        fmb.ascent(); // causes font load.
+    }
+
+#if !defined(SINGLE_EXEC) && defined(QT_NO_SXE)
+    // With SXE the process key must be cleared before any application code
+    // runs, so plugins are only preloaded when SXE is disabled.
+    QStringList apps = cfg.value("PreloadApplications").toStringList();
+    QStringList paths = Qtopia::installPaths();
+    foreach ( QString app, apps ) {
+        for ( int ii = 0; ii < paths.count(); ++ii ) {
+            QLibrary lib( paths.at(ii) + "plugins/application/lib" + app + ".so" );
+            if ( lib.load() ) {
+                // The library is intentionally never unloaded, the plugin
+                // loader reuses it when the application is launched.
+                qLog(Quicklauncher) << "Preloaded" << app.toLatin1();
+                break;
+            }
+        }
+    }
+#endif
+}
+
 int MAIN_FUNC( int argc, char** argv )
 {
 #ifdef QTOPIA_SETPROC_ARGV0
@@ -124,6 +168,7 @@ int MAIN_FUNC( int argc, char** argv )
         QtopiaSql::instance()->systemDatabase();
 
         QSoftMenuBar::menuKey(); // read config.
+        preloadConfigured();
 
         // Create a widget to force initialization of title bar images, etc.
         QObject::disconnect(QuickLauncher::app, SIGNAL(lastWindowClosed()), QuickLauncher::app, SLOT(hideOrQuit()));
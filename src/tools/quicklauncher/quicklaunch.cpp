@@ -25,6 +25,7 @@
 #include <qtopiachannel.h>
 #include <QIcon>
 #include <qtopialog.h>
+#include <qperformancelog.h>
 
 #include <qtimezone.h>
 #include <qtopiaapplication.h>
@@ -157,6 +158,7 @@ void QuickLauncher::exec( int argc, char **argv )
 
 #ifndef SINGLE_EXEC
     qLog(Quicklauncher) << "begin library loading";
+    QPerformanceLog() << QPerformanceLog::Begin << QPerformanceLog::LibraryLoading;
 #ifndef QT_NO_SXE
     // loader invokes the constructor - need to clear the key before this
     guaranteed_memset( _key, 0, QSXE_KEY_LEN );
@@ -172,6 +174,7 @@ void QuickLauncher::exec( int argc, char **argv )
         qWarning( "Could not find app for suid: %s", qPrintable( appName ));
 #endif
     appInstance = loader->instance(appName);
+    QPerformanceLog() << QPerformanceLog::End << QPerformanceLog::LibraryLoading;
     qLog(Quicklauncher) << "end library loading";
     appIface = qobject_cast<QApplicationFactoryInterface*>(appInstance);
     if ( !appIface ) {
@@ -183,7 +186,9 @@ void QuickLauncher::exec( int argc, char **argv )
     appIface->setProcessKey( appName );
 #endif
     qLog(Quicklauncher) << "begin main window create";
+    QPerformanceLog() << QPerformanceLog::Begin << QPerformanceLog::MainWindow;
     mainWindow = appIface->createMainWindow( appName );
+    QPerformanceLog() << QPerformanceLog::End << QPerformanceLog::MainWindow;
     qLog(Quicklauncher) << "end main window create";
 #else
     if ( qpeAppMap()->contains(appName) ) {